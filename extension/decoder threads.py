@@ -0,0 +1,91 @@
+# Decoder threads check using the C extension version of sphinxwrapper.
+#
+# Decodes a WAVE file with one decoder per thread for increasing numbers of
+# threads. Every decoder must produce the same hypotheses as a decoder run on
+# its own, and on free-threaded builds of Python the throughput must grow with
+# the number of threads while there are enough CPUs. Exits with status 1 if
+# either check fails.
+
+import os
+import sys
+import threading
+import time
+
+from sphinxwrapper import PocketSphinx, AudioFile
+
+# Least speedup over one thread accepted for each extra thread on
+# free-threaded builds.
+MIN_SPEEDUP_PER_THREAD = 0.5
+
+
+def make_decoder():
+    # Return the decoder with the list its hypotheses are added to.
+    ps = PocketSphinx(["-logfn", os.devnull])
+    hypotheses = []
+    ps.hypothesis_callback = lambda hyp: hypotheses.append(hyp)
+    return ps, hypotheses
+
+
+def decode(ps, hypotheses, path):
+    # Each AudioData object references the file's memory mapping.
+    del hypotheses[:]
+    for audio in AudioFile(path):
+        ps.process_audio(audio)
+    ps.end_utterance()
+
+
+def run(decoders, path):
+    threads = [threading.Thread(target=decode, args=(ps, hypotheses, path))
+               for ps, hypotheses in decoders]
+    start = time.time()
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    return time.time() - start
+
+
+def main():
+    if len(sys.argv) < 2:
+        print("usage: python \"decoder threads.py\" file.wav [max threads]")
+        return 2
+    path = sys.argv[1]
+    max_threads = int(sys.argv[2]) if len(sys.argv) > 2 else 4
+    duration = AudioFile(path).duration
+
+    # Load the decoders first so that only decoding is timed.
+    decoders = [make_decoder() for _ in range(max_threads)]
+
+    # Decode on one thread first for the expected hypotheses and throughput.
+    single_elapsed = run(decoders[:1], path)
+    expected = list(decoders[0][1])
+    print("expected hypotheses: %r" % expected)
+
+    gil_enabled = getattr(sys, "_is_gil_enabled", lambda: True)()
+    n_cpus = os.cpu_count() if hasattr(os, "cpu_count") else 1
+    print("GIL enabled: %s, CPUs: %s" % (gil_enabled, n_cpus))
+    failed = False
+    for n in range(1, max_threads + 1):
+        elapsed = run(decoders[:n], path)
+        print("%d thread(s): %.1f seconds of audio per second"
+              % (n, n * duration / elapsed))
+
+        for i, (ps, hypotheses) in enumerate(decoders[:n]):
+            if hypotheses != expected:
+                print("FAIL: decoder %d of %d heard %r"
+                      % (i + 1, n, hypotheses))
+                failed = True
+
+        # Threads only decode in parallel without the GIL.
+        speedup = n * single_elapsed / elapsed
+        wanted = 1 + (n - 1) * MIN_SPEEDUP_PER_THREAD
+        if not gil_enabled and n <= (n_cpus or 1) and speedup < wanted:
+            print("FAIL: %d threads were only %.1f times as fast as one, "
+                  "expected at least %.1f" % (n, speedup, wanted))
+            failed = True
+
+    print("FAIL" if failed else "OK")
+    return 1 if failed else 0
+
+if __name__ == "__main__":
+    sys.exit(main())
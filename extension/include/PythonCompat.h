@@ -72,6 +72,13 @@
 #define PYCOMPAT_INIT_ERROR return NULL
 #endif
 
+// Python 3.11 and above can find the module that defined a type, so the
+// extension's types are heap types and its state is kept per module. This lets
+// the module be imported into subinterpreters with their own GIL.
+#if PY_VERSION_HEX >= 0x030B0000
+#define PYCOMPAT_MODULE_STATE
+#endif
+
 // Define the return type of module init functions if necessary
 #ifndef PyMODINIT_FUNC /* declarations for DLL import/export */
 #define PyMODINIT_FUNC void
@@ -56,16 +56,31 @@
 // Includes Python.h and useful definitions for 2.x and 3.x compatibility.
 #include "PythonCompat.h"
 
+#include "modstate.h"
+#include "objlock.h"
+
 typedef struct {
     PyObject_HEAD
     int16 audio_buffer[2048]; // array used to store audio data
+    int16 *samples; // audio to process: audio_buffer or another object's memory
+    PyObject *base; // object owning the memory samples points into, or NULL
     int32 n_samples;
     bool is_set; // used to check if the object is set up correctly
+
+    // Held while the samples are filled or decoded, so that on free-threaded
+    // builds one thread can't read into the object while another decodes it.
+    // Objects on the free list keep theirs.
+    obj_lock_t lock;
 } AudioDataObj;
 
-PyTypeObject AudioDataType;
+extern PyTypeObject AudioDataType;
 
-PyObject *AudioDataError;
+/* Create an AudioData object referencing audio owned by another object without
+ * copying it. The base object is kept alive for as long as the view is.
+ */
+PyObject *
+AudioDataObj_new_view(module_state *state, PyObject *base, int16 *samples,
+                      int32 n_samples);
 
 void
 AudioDataObj_dealloc(AudioDataObj *self);
@@ -82,6 +97,7 @@ typedef struct {
     PyObject *name;
     bool open;
     bool recording;
+    obj_lock_t lock; // held while methods use the device
 } AudioDeviceObj;
 
 PyObject *
@@ -99,6 +115,9 @@ AudioDeviceObj_close(AudioDeviceObj *self);
 PyObject *
 AudioDeviceObj_read_audio(AudioDeviceObj *self);
 
+PyObject *
+AudioDeviceObj_read_into(AudioDeviceObj *self, PyObject *args, PyObject *kwds);
+
 void
 AudioDeviceObj_dealloc(AudioDeviceObj *self);
 
@@ -114,9 +133,56 @@ AudioDeviceObj_set_name(AudioDeviceObj *self, PyObject *value, void *closure);
 PyObject *
 AudioDeviceObj_get_name(AudioDeviceObj *self, void *closure);
 
-PyTypeObject AudioDeviceType;
+extern PyTypeObject AudioDeviceType;
+
+typedef struct {
+    PyObject_HEAD
+    void *map; // memory mapping of the whole file
+    size_t map_size;
+    int16 *samples; // start of the audio data within the mapping
+    size_t n_samples;
+    size_t position; // index of the next sample to read
+    int32 sample_rate;
+    obj_lock_t lock; // held while methods move the read position
+} AudioFileObj;
+
+PyObject *
+AudioFileObj_read_audio(AudioFileObj *self, PyObject *args, PyObject *kwds);
+
+PyObject *
+AudioFileObj_seek(AudioFileObj *self, PyObject *args, PyObject *kwds);
+
+PyObject *
+AudioFileObj_tell(AudioFileObj *self);
 
-PyObject *AudioDeviceError;
+PyObject *
+AudioFileObj_iternext(AudioFileObj *self);
+
+PyObject *
+AudioFileObj_get_sample_rate(AudioFileObj *self, void *closure);
+
+PyObject *
+AudioFileObj_get_duration(AudioFileObj *self, void *closure);
+
+void
+AudioFileObj_dealloc(AudioFileObj *self);
+
+PyObject *
+AudioFileObj_new(PyTypeObject *type, PyObject *args, PyObject *kwds);
+
+int
+AudioFileObj_init(AudioFileObj *self, PyObject *args, PyObject *kwds);
+
+extern PyTypeObject AudioFileType;
+
+/*
+ * Get the samples of an AudioFile, AudioData or buffer of raw 16-bit audio.
+ * Release the view with PyBuffer_Release when finished with the samples.
+ * @return 0 on success, -1 with an exception set on failure
+ */
+int
+get_audio_samples(module_state *state, PyObject *audio, Py_buffer *view,
+                  int16 const **samples, size_t *n_samples);
 
 PyObject *
 initaudio(PyObject *module);
@@ -0,0 +1,127 @@
+/*
+ * audioring.h
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#ifndef AUDIORING_H_
+#define AUDIORING_H_
+
+#include <stddef.h>
+#include <sys/types.h>
+#include <sphinxbase/prim_type.h>
+
+/* A ring buffer of 16-bit audio in POSIX shared memory, for handing audio from
+ * a capture process to decoder processes without copying or serialising it.
+ *
+ * The writer reserves space in the ring, fills it and commits it. The reader
+ * acquires the audio in place and releases it once decoded, which frees the
+ * space for the writer again. A full ring makes the writer wait, so a slow
+ * reader applies backpressure rather than losing audio. Waiting processes
+ * sleep on futexes in the shared memory and are only woken when there is a
+ * waiter.
+ */
+typedef struct audio_ring_header_s audio_ring_header_t;
+
+typedef struct {
+    audio_ring_header_t *header;
+    int16 *samples; // capacity samples following the header
+    size_t map_size;
+    char *name; // shared memory object name
+    pid_t creator; // process that created the ring, or 0 if it was opened
+} audio_ring_t;
+
+/*
+ * Create a ring with room for capacity samples, which must be a power of two.
+ * The name is removed when the creating process frees the ring.
+ * @return new ring or NULL on failure with errno set (EINVAL for a bad
+ * capacity, EEXIST if the name is in use)
+ */
+audio_ring_t *
+audio_ring_create(const char *name, uint32 capacity);
+
+/*
+ * Open a ring created by another process.
+ * @return new ring or NULL on failure with errno set (EINVAL if the shared
+ * memory isn't an audio ring)
+ */
+audio_ring_t *
+audio_ring_open(const char *name);
+
+void
+audio_ring_free(audio_ring_t *ring);
+
+/*
+ * Wait up to timeout_ms milliseconds, or forever if negative, for free space
+ * and point *samples at it.
+ * @return number of contiguous samples that may be written, at most max, 0 on
+ * timeout or -1 if the ring is closed
+ */
+int32
+audio_ring_reserve(audio_ring_t *ring, int32 max, int16 **samples,
+                   int timeout_ms);
+
+/* Make n reserved samples available to the reader. */
+void
+audio_ring_commit(audio_ring_t *ring, int32 n);
+
+/*
+ * Copy samples into the ring, waiting for space as audio_ring_reserve does.
+ * @return number of samples written, which is less than n_samples on timeout,
+ * or -1 if the ring is closed
+ */
+int32
+audio_ring_write(audio_ring_t *ring, int16 const *samples, size_t n_samples,
+                 int timeout_ms);
+
+/*
+ * Wait up to timeout_ms milliseconds, or forever if negative, for audio and
+ * point *samples at it. The audio stays in place until it is released.
+ * @return number of contiguous samples available, at most max, 0 on timeout
+ * or -1 if the ring is closed and empty
+ */
+int32
+audio_ring_acquire(audio_ring_t *ring, int32 max, int16 const **samples,
+                   int timeout_ms);
+
+/* Free the space of n acquired samples for the writer. */
+void
+audio_ring_release(audio_ring_t *ring, int32 n);
+
+/* Mark the end of the audio and wake any waiting processes. */
+void
+audio_ring_close(audio_ring_t *ring);
+
+int
+audio_ring_closed(audio_ring_t *ring);
+
+uint32
+audio_ring_capacity(audio_ring_t *ring);
+
+/* Number of samples committed but not yet released. */
+uint32
+audio_ring_available(audio_ring_t *ring);
+
+#endif /* AUDIORING_H_ */
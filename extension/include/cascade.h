@@ -0,0 +1,88 @@
+/*
+ * cascade.h
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#ifndef CASCADE_H_
+#define CASCADE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <pocketsphinx.h>
+#include <sphinxbase/prim_type.h>
+
+#include "utterance.h"
+
+/* Wake word cascade: a cheap keyphrase search runs until the keyphrase is
+ * detected, then the decoder switches to a command search within the same
+ * chunk and decodes the audio following the keyphrase with it. After the
+ * command utterance ends or the timeout passes, the keyphrase search is used
+ * again.
+ */
+typedef struct cascade_s cascade_t;
+
+/*
+ * @param timeout seconds of audio after the keyphrase before falling back
+ * @return new cascade
+ */
+cascade_t *
+cascade_init(const char *wake_search, const char *command_search,
+             float32 timeout, float32 samprate, int32 frate);
+
+/*
+ * Process raw audio with whichever search the cascade is using, starting an
+ * utterance if necessary and moving the utterance state along. Events are
+ * only reported for the command search. When the keyphrase is detected,
+ * *keyphrase is set to it; otherwise it's set to NULL. The string is valid
+ * until the next call.
+ * @return the event that occurred while processing the audio
+ */
+utterance_event_t
+cascade_process_raw(cascade_t *cascade, ps_decoder_t *ps,
+                    utterance_state_t *state, int16 const *buf,
+                    size_t n_samples, const char **keyphrase);
+
+/* End the current utterance if one was in progress and go back to the
+ * keyphrase search.
+ * @return true if an utterance was in progress
+ */
+bool
+cascade_end(cascade_t *cascade, ps_decoder_t *ps, utterance_state_t *state);
+
+const char *
+cascade_wake_search(cascade_t *cascade);
+
+const char *
+cascade_command_search(cascade_t *cascade);
+
+/* Whether the command search is in use. */
+bool
+cascade_listening(cascade_t *cascade);
+
+void
+cascade_free(cascade_t *cascade);
+
+#endif /* CASCADE_H_ */
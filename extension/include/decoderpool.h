@@ -0,0 +1,68 @@
+/*
+ * decoderpool.h
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#ifndef DECODERPOOL_H_
+#define DECODERPOOL_H_
+
+#include <pocketsphinx.h>
+#include <sphinxbase/cmd_ln.h>
+
+#include "searches.h"
+
+/* Decoders kept between uses by the helpers that decode with searches other
+ * than the active one. Each has every search from the search sources set up.
+ * Decoders are only handed out again while the config and the sources are
+ * unchanged, with their normalisation state reset to that of a new decoder;
+ * out of date ones are freed instead. The pool is thread safe.
+ */
+typedef struct decoder_pool_s decoder_pool_t;
+
+decoder_pool_t *
+decoder_pool_init(void);
+
+/*
+ * Take an idle decoder, or create one from config with every search from
+ * sources, and activate the named search if active isn't NULL.
+ * @return the decoder, which must be given back with decoder_pool_return, or
+ * NULL on failure
+ */
+ps_decoder_t *
+decoder_pool_take(decoder_pool_t *pool, cmd_ln_t *config,
+                  search_source_t *sources, const char *active);
+
+/* Give a decoder back once it has no utterance in progress. Decoders in an
+ * unknown state should be freed with ps_free instead.
+ */
+void
+decoder_pool_return(decoder_pool_t *pool, ps_decoder_t *ps);
+
+/* Free the idle decoders. Decoders still taken must not be returned after. */
+void
+decoder_pool_free(decoder_pool_t *pool);
+
+#endif /* DECODERPOOL_H_ */
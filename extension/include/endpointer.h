@@ -0,0 +1,82 @@
+/*
+ * endpointer.h
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#ifndef ENDPOINTER_H_
+#define ENDPOINTER_H_
+
+#include <stddef.h>
+#include <pocketsphinx.h>
+#include <sphinxbase/cmd_ln.h>
+#include <sphinxbase/prim_type.h>
+
+#include "utterance.h"
+
+/* Decides where utterances start and end from the decoder's voice activity
+ * detection, in place of the plain state machine of utterance_process_raw.
+ *
+ * An utterance only starts once speech has lasted the minimum speech
+ * duration; shorter bursts of noise are discarded without an event. It ends
+ * once silence has lasted the trailing silence duration, in addition to the
+ * detector's own -vad_postspeech, or is forced to end once it reaches the
+ * maximum length. This bounds the latency and memory of ps_end_utt in rooms
+ * where the detector rarely hears silence.
+ *
+ * Durations are in samples and checked after each chunk of audio, so they are
+ * rounded up to chunk boundaries.
+ */
+typedef struct {
+    size_t trailing_silence;
+    size_t min_speech;
+    size_t max_utterance; // 0 for no limit
+    float32 samprate;
+
+    size_t utt_samples; // audio processed since speech was detected
+    size_t speech_samples; // speech since speech was detected
+    size_t silence_samples; // silence since speech was last detected
+    bool speech_pending; // speech was detected but is shorter than min_speech
+    int n_forced; // utterances ended at the maximum length
+} endpointer_t;
+
+/* Create an endpointer with durations given in seconds. */
+endpointer_t *
+endpointer_init(cmd_ln_t *config, float64 trailing_silence,
+                float64 min_speech, float64 max_utterance);
+
+/* Process raw audio as utterance_process_raw does, deciding where utterances
+ * start and end with the endpointer. It may be called without the GIL.
+ * @return the event that occurred while processing the audio
+ */
+utterance_event_t
+endpointer_process_raw(endpointer_t *ep, ps_decoder_t *ps,
+                       utterance_state_t *state, int16 const *buf,
+                       size_t n_samples);
+
+void
+endpointer_free(endpointer_t *ep);
+
+#endif /* ENDPOINTER_H_ */
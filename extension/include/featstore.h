@@ -0,0 +1,97 @@
+/*
+ * featstore.h
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#ifndef FEATSTORE_H_
+#define FEATSTORE_H_
+
+#include <stddef.h>
+#include <pocketsphinx.h>
+#include <sphinxbase/cmd_ln.h>
+#include <sphinxbase/prim_type.h>
+
+#include "decoderpool.h"
+#include "searches.h"
+
+/* Cepstral frames extracted from audio once so that they can be decoded many
+ * times without running the front end again. The frames are never modified.
+ */
+typedef struct {
+    int32 n_frames;
+    int32 n_ceps; // values per frame
+    mfcc_t *frames; // n_frames * n_ceps values
+    void *map; // file mapping holding the frames if loaded, otherwise NULL
+    size_t map_size;
+} feat_store_t;
+
+/*
+ * Run the front end configured by config over audio and store the frames.
+ * @return new store or NULL on failure
+ */
+feat_store_t *
+feat_store_extract(cmd_ln_t *config, int16 const *samples, size_t n_samples);
+
+/*
+ * Save a store to a file that can be memory mapped by feat_store_load.
+ * @return 0 on success, -1 on failure with errno set
+ */
+int
+feat_store_save(feat_store_t *store, const char *path);
+
+/*
+ * Memory map a store saved by feat_store_save.
+ * @return new store or NULL on failure with errno set (EINVAL if the file
+ * isn't a feature store)
+ */
+feat_store_t *
+feat_store_load(const char *path);
+
+void
+feat_store_free(feat_store_t *store);
+
+/*
+ * Decode all stored frames as one utterance with the decoder's active
+ * search. Decoding modifies frames in place, so a private copy is used.
+ * @return 0 on success, -1 on failure
+ */
+int
+feat_store_decode(feat_store_t *store, ps_decoder_t *ps);
+
+/*
+ * Decode the stored frames with each of the named searches concurrently,
+ * using one decoder per search taken from the pool.
+ * hyps[i] is set to a copy of the hypothesis of searches[i] (free with
+ * ckd_free) or NULL if there wasn't one.
+ * @return 0 on success, -1 on failure
+ */
+int
+feat_store_decode_searches(feat_store_t *store, decoder_pool_t *pool,
+                           cmd_ln_t *config, search_source_t *sources,
+                           char const **searches, int n_searches,
+                           char **hyps);
+
+#endif /* FEATSTORE_H_ */
@@ -0,0 +1,86 @@
+/*
+ * fsgedit.h
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#ifndef FSGEDIT_H_
+#define FSGEDIT_H_
+
+#include <pocketsphinx.h>
+#include <sphinxbase/fsg_model.h>
+#include <sphinxbase/prim_type.h>
+
+typedef enum {
+    FSG_EDIT_ADD,   // add a transition
+    FSG_EDIT_REMOVE // remove the transitions of a word
+} fsg_edit_type_t;
+
+/* A change to the finite state grammar of a live search. Edits are kept with
+ * the search's source so they can be made again wherever the search is set up
+ * from it.
+ */
+typedef struct fsg_edit_s {
+    struct fsg_edit_s *next;
+    fsg_edit_type_t type;
+    char *word; // NULL for a null transition
+    int32 from_state; // -1 matches any state when removing
+    int32 to_state; // -1 matches any state when removing
+    float32 prob; // transition probability when adding
+} fsg_edit_t;
+
+fsg_edit_t *
+fsg_edit_init(fsg_edit_type_t type, const char *word, int32 from_state,
+              int32 to_state, float32 prob);
+
+fsg_edit_t *
+fsg_edit_copy(fsg_edit_t const *edit);
+
+/* Free a list of edits. */
+void
+fsg_edits_free(fsg_edit_t *edits);
+
+/*
+ * Make an edit to a grammar. Transitions are added in place. Removing them
+ * builds a copy of the grammar without them, as grammars can't have
+ * transitions removed.
+ * @return the edited grammar with a new reference, or NULL if a state is out
+ * of range
+ */
+fsg_model_t *
+fsg_edit_apply(fsg_model_t *fsg, fsg_edit_t const *edit);
+
+/*
+ * Make a list of edits to a copy of the grammar of a decoder's FSG search and
+ * set the search up again from the copy. Only the search structures are
+ * rebuilt; the grammar isn't compiled again. If any edit or setting the search
+ * up fails, the search keeps its grammar unchanged.
+ * @return 0 on success, -1 if there is no such FSG search or on failure
+ */
+int
+fsg_edits_apply_to_search(ps_decoder_t *ps, const char *name,
+                          fsg_edit_t const *edits);
+
+#endif /* FSGEDIT_H_ */
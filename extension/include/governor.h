@@ -0,0 +1,146 @@
+/*
+ * governor.h
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#ifndef GOVERNOR_H_
+#define GOVERNOR_H_
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+#include <sphinxbase/cmd_ln.h>
+#include <sphinxbase/prim_type.h>
+
+// Pruning beams adjusted by the governor, in config argument order
+#define GOVERNOR_N_BEAMS 3
+
+/* Set the decoder's active search up again with the beams written by
+ * governor_apply, if the decoder is free and between utterances. Called on the
+ * governor's thread, which holds no locks of the caller's.
+ */
+typedef void (*governor_rebuild_fn)(void *arg);
+
+/* Real time factor governor. It measures how long each chunk of audio takes
+ * to decode compared to its duration and narrows the pruning beams when the
+ * average real time factor is above the target, widening them again when
+ * there is headroom.
+ *
+ * Beams can't be changed on a live search, so new beams are written to the
+ * decoder's config and take effect when the active search is set up again
+ * with refresh_ps_search. That takes longest exactly when decoding is behind,
+ * so it is done by the rebuild function on the governor's own thread rather
+ * than the thread processing audio. The caller asks for it with
+ * governor_request at utterance boundaries, and the rebuild function reports
+ * the outcome with governor_applied. Levels change at most once per
+ * GOVERNOR_MIN_INTERVAL seconds of audio. Other searches keep the beams they
+ * were set up with.
+ */
+typedef struct {
+    float64 target_rtf;
+    float64 rtf; // moving average of the real time factor
+    float64 base_beams[GOVERNOR_N_BEAMS]; // configured beams
+    float64 beams[GOVERNOR_N_BEAMS]; // beams currently in the config
+    int level; // 0 for the configured beams, higher for narrower beams
+    int pending_level; // level to apply at the next utterance boundary
+    int n_adjustments; // levels applied to the active search
+    int n_failures; // levels the active search couldn't be set up with
+    float64 seconds_since_change; // audio processed since the last level
+    float32 samprate;
+    struct timespec chunk_start;
+
+    // Thread setting the search up again
+    governor_rebuild_fn rebuild;
+    void *rebuild_arg;
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    bool requested; // protected by mutex
+    bool stopping; // protected by mutex
+} governor_t;
+
+// Seconds of audio to decode at a level before moving to another
+#define GOVERNOR_MIN_INTERVAL 5.0
+
+extern const char *governor_beam_names[GOVERNOR_N_BEAMS];
+
+/*
+ * Start a governor and its thread, which calls rebuild with arg when asked to.
+ * @return NULL on failure
+ */
+governor_t *
+governor_init(cmd_ln_t *config, float64 target_rtf,
+              governor_rebuild_fn rebuild, void *arg);
+
+/* Mark the start of processing a chunk. */
+void
+governor_start(governor_t *governor);
+
+/* Update the real time factor with the chunk processed since
+ * governor_start and decide whether the beams should change.
+ */
+void
+governor_stop(governor_t *governor, size_t n_samples);
+
+/* Ask the governor's thread to call the rebuild function if the level should
+ * change. Call this when the decoder is between utterances.
+ */
+void
+governor_request(governor_t *governor);
+
+/*
+ * Write the beams for the pending level to the config if it differs from the
+ * current level.
+ * @return true if the beams changed and the search should be set up again
+ */
+bool
+governor_apply(governor_t *governor, cmd_ln_t *config);
+
+/* Record whether the active search was set up again with the beams written
+ * by governor_apply. If it wasn't, the current level's beams are written back
+ * and the pending level is dropped.
+ */
+void
+governor_applied(governor_t *governor, cmd_ln_t *config, bool applied);
+
+/* Take the config's current beams as the configured beams, such as after
+ * they were set by the user.
+ */
+void
+governor_reset(governor_t *governor, cmd_ln_t *config);
+
+/* Write the configured beams back to the config. */
+void
+governor_restore(governor_t *governor, cmd_ln_t *config);
+
+/* Stop the thread and free the governor. The rebuild function must not be
+ * waiting for anything the caller holds.
+ */
+void
+governor_free(governor_t *governor);
+
+#endif /* GOVERNOR_H_ */
@@ -0,0 +1,144 @@
+/*
+ * grammar.h
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#ifndef GRAMMAR_H_
+#define GRAMMAR_H_
+
+#include <stdbool.h>
+#include <sphinxbase/fsg_model.h>
+#include <sphinxbase/logmath.h>
+#include <sphinxbase/prim_type.h>
+
+#include "fsgedit.h"
+#include "searches.h"
+
+typedef enum {
+    GRAMMAR_COMPILING, // waiting for or being compiled by the thread
+    GRAMMAR_COMPILED,  // compiled, waiting to be set on the decoder
+    GRAMMAR_APPLIED,   // set on the decoder
+    GRAMMAR_FAILED     // compiling or setting failed; see the error
+} grammar_state_t;
+
+/* A grammar search to compile and set on a decoder. Jobs are reference
+ * counted because both the compiler and a future waiting on them hold them.
+ */
+typedef struct grammar_job_s grammar_job_t;
+
+/* Compiles JSGF and FSG searches into FSG models on a background thread, in
+ * the order they are submitted, so that the thread processing audio only has
+ * to set the compiled model on the decoder.
+ */
+typedef struct grammar_compiler_s grammar_compiler_t;
+
+/*
+ * Start a compiler thread. toprule may be NULL to use the first public rule
+ * of JSGF grammars.
+ * @return NULL on failure
+ */
+grammar_compiler_t *
+grammar_compiler_init(logmath_t *lmath, float32 lw, const char *toprule);
+
+/*
+ * Queue a JSGF_FILE, JSGF_STR or FSG_FILE search for compiling. If interrupt
+ * is true, the search may be set in the middle of an utterance.
+ * @return the job, with a reference held for the caller
+ */
+grammar_job_t *
+grammar_compiler_submit(grammar_compiler_t *gc, ps_search_type type,
+                        const char *name, const char *value, bool interrupt);
+
+/*
+ * Queue an edit to the grammar of the named search, taking ownership of it.
+ * The job needs no compiling, but is applied in order with the other jobs.
+ * @return the job, with a reference held for the caller
+ */
+grammar_job_t *
+grammar_compiler_submit_edit(grammar_compiler_t *gc, const char *name,
+                             fsg_edit_t *edit, bool interrupt);
+
+/* The oldest job if it is no longer compiling, or NULL. */
+grammar_job_t *
+grammar_compiler_peek(grammar_compiler_t *gc);
+
+/* Remove the oldest job from the queue, passing its reference to the caller. */
+grammar_job_t *
+grammar_compiler_pop(grammar_compiler_t *gc);
+
+/* The number of jobs in the queue. */
+int
+grammar_compiler_pending(grammar_compiler_t *gc);
+
+/* Stop the thread. Jobs still queued fail. */
+void
+grammar_compiler_free(grammar_compiler_t *gc);
+
+grammar_state_t
+grammar_job_state(grammar_job_t *job);
+
+/* Wait up to timeout seconds, or forever if timeout is negative, for a job to
+ * stop compiling.
+ * @return the job's state
+ */
+grammar_state_t
+grammar_job_wait(grammar_job_t *job, double timeout);
+
+/* Finish a compiled job, with an error message if setting it failed. */
+void
+grammar_job_finish(grammar_job_t *job, const char *error);
+
+ps_search_type
+grammar_job_type(grammar_job_t *job);
+
+const char *
+grammar_job_name(grammar_job_t *job);
+
+const char *
+grammar_job_value(grammar_job_t *job);
+
+bool
+grammar_job_interrupts(grammar_job_t *job);
+
+/* The compiled model, owned by the job, or NULL. */
+fsg_model_t *
+grammar_job_fsg(grammar_job_t *job);
+
+/* The edit to make if the job edits a search, owned by the job, or NULL. */
+fsg_edit_t *
+grammar_job_edit(grammar_job_t *job);
+
+/* Why the job failed, or NULL. */
+const char *
+grammar_job_error(grammar_job_t *job);
+
+grammar_job_t *
+grammar_job_retain(grammar_job_t *job);
+
+void
+grammar_job_free(grammar_job_t *job);
+
+#endif /* GRAMMAR_H_ */
@@ -0,0 +1,78 @@
+/*
+ * logqueue.h
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#ifndef LOGQUEUE_H_
+#define LOGQUEUE_H_
+
+#include <stddef.h>
+#include <sphinxbase/err.h>
+#include <sphinxbase/prim_type.h>
+
+/* A queue that sphinxbase's log messages are routed into instead of its log
+ * file, so that another thread can pass them on.
+ *
+ * Messages below the minimum level are discarded by the first comparison in
+ * the sphinxbase callback. Threads add messages without locking or waiting;
+ * when the queue is full, messages are dropped and counted instead.
+ */
+
+// Number of messages the queue holds.
+#define LOG_QUEUE_SIZE 256
+
+// Longest message kept, including the terminating null. Longer messages are
+// truncated.
+#define LOG_MESSAGE_SIZE 512
+
+/* Route sphinxbase's messages at or above min_level into the queue. */
+void
+log_queue_start(err_lvl_t min_level);
+
+/* Route sphinxbase's messages back to its log file. */
+void
+log_queue_stop(void);
+
+void
+log_queue_set_level(err_lvl_t min_level);
+
+/*
+ * Wait up to timeout_ms milliseconds, or forever if negative, for a message
+ * and copy it into message. Only one thread may take messages at a time.
+ * @return 1 if a message was taken, or 0 on timeout or log_queue_wake
+ */
+int
+log_queue_pop(err_lvl_t *level, char *message, int timeout_ms);
+
+/* Make a thread waiting in log_queue_pop return. */
+void
+log_queue_wake(void);
+
+/* Get the number of messages dropped since the last call. */
+uint32
+log_queue_take_dropped(void);
+
+#endif /* LOGQUEUE_H_ */
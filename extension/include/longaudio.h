@@ -0,0 +1,69 @@
+/*
+ * longaudio.h
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#ifndef LONGAUDIO_H_
+#define LONGAUDIO_H_
+
+#include <stddef.h>
+#include <pocketsphinx.h>
+#include <sphinxbase/cmd_ln.h>
+#include <sphinxbase/prim_type.h>
+
+#include "searches.h"
+
+typedef struct {
+    float32 segment_length; // target segment length in seconds
+    float32 overlap; // audio decoded either side of a segment in seconds
+    float32 min_silence; // shortest silence to split at in seconds
+    int n_workers;
+} long_audio_opts_t;
+
+typedef struct {
+    char *word;
+    float64 start; // seconds from the start of the audio
+    float64 end;
+} long_audio_word_t;
+
+/*
+ * Decode a long recording by splitting it at silences and decoding the
+ * segments in parallel, each worker using its own decoder set up from a copy
+ * of config and the search sources with the active search selected. Words in
+ * the filler dictionary are left out.
+ *
+ * This doesn't use any Python API, so the GIL can be released around it.
+ * @return number of words stored in *words, or -1 on failure
+ */
+ssize_t
+decode_long_audio(cmd_ln_t *config, search_source_t *sources,
+                  const char *active, int16 const *samples, size_t n_samples,
+                  long_audio_opts_t const *opts, long_audio_word_t **words);
+
+void
+long_audio_words_free(long_audio_word_t *words, size_t n_words);
+
+#endif /* LONGAUDIO_H_ */
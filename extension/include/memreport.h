@@ -0,0 +1,67 @@
+/*
+ * memreport.h
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#ifndef MEMREPORT_H_
+#define MEMREPORT_H_
+
+#include <stddef.h>
+#include <pocketsphinx.h>
+#include <sphinxbase/cmd_ln.h>
+
+/* Estimates of the memory used by parts of a decoder. Pocket Sphinx doesn't
+ * expose the sizes of its structures, so the estimates are built from the
+ * sizes of the model files and counts of what each model holds, multiplied
+ * by the approximate size of the structures made for them.
+ */
+
+typedef enum {
+    SEARCH_NGRAM, // n-gram language model search
+    SEARCH_FSG,   // finite state grammar search, including JSGF
+    SEARCH_KWS,   // key word/phrase search
+    SEARCH_OTHER  // any other search, such as phone loops
+} mem_search_type_t;
+
+/* Bytes of acoustic model files loaded by a decoder using config. */
+size_t
+mem_acoustic_model(cmd_ln_t *config);
+
+/* Bytes of dictionary files loaded by a decoder using config. */
+size_t
+mem_dictionary(cmd_ln_t *config);
+
+/* Bytes used by the named search of a decoder, including its lexicon tree.
+ * type is set to the kind of search it is.
+ */
+size_t
+mem_search(ps_decoder_t *ps, const char *name, mem_search_type_t *type);
+
+/* Bytes used by a word lattice, or 0 if dag is NULL. */
+size_t
+mem_lattice(ps_lattice_t *dag);
+
+#endif /* MEMREPORT_H_ */
@@ -0,0 +1,116 @@
+/*
+ * modstate.h
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#ifndef MODSTATE_H_
+#define MODSTATE_H_
+
+// Includes Python.h and useful definitions for 2.x and 3.x compatibility.
+#include "PythonCompat.h"
+
+// Maximum number of deallocated AudioData objects kept for reuse.
+#define AUDIO_DATA_FREE_LIST_SIZE 16
+
+/* The types, exceptions and caches of one sphinxwrapper module.
+ *
+ * Where PYCOMPAT_MODULE_STATE is defined, each module object has its own state
+ * and its own heap types, built from the static type definitions which then
+ * only serve as templates. Otherwise the static types are used directly and
+ * there is a single state shared by the process.
+ */
+typedef struct {
+    PyTypeObject *PSType;
+    PyTypeObject *AudioDataType;
+    PyTypeObject *AudioDeviceType;
+    PyTypeObject *AudioFileType;
+    PyTypeObject *StreamManagerType;
+    PyTypeObject *FeaturesType;
+    PyTypeObject *LatticeType;
+    PyTypeObject *SearchFutureType;
+    PyTypeObject *AudioRingType;
+
+    PyObject *PocketSphinxError;
+    PyObject *AudioDataError;
+    PyObject *AudioDeviceError;
+    PyObject *AudioFileError;
+    PyObject *StreamManagerError;
+    PyObject *FeaturesError;
+    PyObject *AudioRingError;
+
+    // Deallocated AudioData objects kept for reuse by AudioDataObj_new.
+    PyObject *audio_data_free_list[AUDIO_DATA_FREE_LIST_SIZE];
+    int audio_data_n_free;
+} module_state;
+
+#ifdef PYCOMPAT_MODULE_STATE
+extern struct PyModuleDef sphinxwrapper_moduledef;
+#endif
+
+module_state *
+get_module_state(PyObject *module);
+
+/* Get the state of the module that defined a type or one of its bases. */
+module_state *
+get_type_state(PyTypeObject *type);
+
+// Get the module state of an object of one of the module's types.
+#define GET_MODULE_STATE(obj) get_type_state(Py_TYPE(obj))
+
+/*
+ * Set up a type from its static definition and add it to the module under the
+ * last part of its tp_name.
+ * @return a borrowed reference to the type, or NULL with an exception set
+ */
+PyTypeObject *
+add_module_type(PyObject *module, PyTypeObject *type);
+
+/*
+ * Create an exception named like "sphinxwrapper.<name>" and add it to the
+ * module.
+ * @return a borrowed reference to the exception, or NULL with an exception set
+ */
+PyObject *
+add_module_exception(PyObject *module, const char *name);
+
+/* Free an object of one of the module's types from its tp_dealloc function.
+ * Objects of heap types also release their reference to their type.
+ */
+void
+free_module_object(PyObject *self);
+
+#ifdef PYCOMPAT_MODULE_STATE
+int
+module_state_traverse(PyObject *module, visitproc visit, void *arg);
+
+int
+module_state_clear(PyObject *module);
+
+void
+module_state_free(void *module);
+#endif
+
+#endif /* MODSTATE_H_ */
@@ -0,0 +1,91 @@
+/*
+ * multisearch.h
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#ifndef MULTISEARCH_H_
+#define MULTISEARCH_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <pocketsphinx.h>
+#include <sphinxbase/cmd_ln.h>
+#include <sphinxbase/prim_type.h>
+
+#include "decoderpool.h"
+#include "searches.h"
+#include "utterance.h"
+
+/* Several searches decoding the same audio concurrently. Features are computed
+ * once per chunk by a shared front end and the frames are decoded by one
+ * decoder per search, each on its own thread. Utterances are started and
+ * ended for all searches together using the front end's voice activity
+ * detection.
+ */
+typedef struct multi_search_s multi_search_t;
+
+/*
+ * Take decoders for the named searches from the pool, which sets them up from
+ * config and the search sources, and start their threads.
+ * @return NULL on failure
+ */
+multi_search_t *
+multi_search_init(decoder_pool_t *pool, cmd_ln_t *config,
+                  search_source_t *sources, char const **names,
+                  int n_searches);
+
+/* Compute features from raw audio and decode them with every search.
+ * Hypotheses are available from multi_search_hyp on a hypothesis event.
+ * @return the event that occurred while processing the audio
+ */
+utterance_event_t
+multi_search_process_raw(multi_search_t *ms, int16 const *buf,
+                         size_t n_samples);
+
+/* End the current utterance for every search if one was in progress.
+ * @return true if an utterance was in progress
+ */
+bool
+multi_search_end_utt(multi_search_t *ms);
+
+uint8
+multi_search_in_speech(multi_search_t *ms);
+
+int
+multi_search_count(multi_search_t *ms);
+
+const char *
+multi_search_name(multi_search_t *ms, int i);
+
+/* Hypothesis of the i-th search for the last utterance, or NULL. */
+const char *
+multi_search_hyp(multi_search_t *ms, int i);
+
+/* Stop the threads and give the decoders back to the pool. */
+void
+multi_search_free(multi_search_t *ms);
+
+#endif /* MULTISEARCH_H_ */
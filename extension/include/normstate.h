@@ -0,0 +1,78 @@
+/*
+ * normstate.h
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#ifndef NORMSTATE_H_
+#define NORMSTATE_H_
+
+#include <stddef.h>
+#include <pocketsphinx.h>
+
+/* Snapshots of a decoder's live cepstral mean normalisation (CMN) estimate and
+ * automatic gain control (AGC) maximum as a small binary blob, so that a new
+ * session can start from a warm estimate instead of the defaults.
+ */
+
+/*
+ * @return size of the decoder's normalisation state blob, or 0 if the
+ * decoder has no feature computation set up
+ */
+size_t
+norm_state_size(ps_decoder_t *ps);
+
+/*
+ * Write the decoder's normalisation state into buf, which must be
+ * norm_state_size bytes long.
+ * @return 0 on success, -1 on failure
+ */
+int
+norm_state_get(ps_decoder_t *ps, void *buf, size_t size);
+
+/*
+ * Restore normalisation state saved by norm_state_get. The state must come
+ * from a decoder with the same feature vector length.
+ * @return 0 on success, -1 if the blob is invalid or doesn't match
+ */
+int
+norm_state_set(ps_decoder_t *ps, void const *buf, size_t size);
+
+/*
+ * Save the decoder's normalisation state to a file.
+ * @return 0 on success, -1 on failure with errno set
+ */
+int
+norm_state_save(ps_decoder_t *ps, const char *path);
+
+/*
+ * Restore normalisation state from a file saved by norm_state_save.
+ * @return 0 on success, -1 on failure with errno set (EINVAL if the state
+ * is invalid or doesn't match)
+ */
+int
+norm_state_load(ps_decoder_t *ps, const char *path);
+
+#endif /* NORMSTATE_H_ */
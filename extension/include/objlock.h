@@ -0,0 +1,133 @@
+/*
+ * objlock.h
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#ifndef OBJLOCK_H_
+#define OBJLOCK_H_
+
+// Includes Python.h and useful definitions for 2.x and 3.x compatibility.
+#include "PythonCompat.h"
+
+#include <pythread.h>
+
+/* A reentrant lock serialising the threads using an object.
+ *
+ * The GIL doesn't do this on free-threaded builds of Python, nor while a
+ * method has released it to decode audio, so objects with state changed by
+ * their methods hold their own lock. The owning thread may acquire the lock
+ * again, for example from a callback calling another of the object's methods.
+ */
+typedef struct {
+    PyThread_type_lock lock;
+    unsigned long owner; // ident of the thread holding the lock, or 0
+    int depth; // number of times the owner has acquired the lock
+} obj_lock_t;
+
+/*
+ * Allocate a lock's underlying lock.
+ * @return 0 on success, -1 with a MemoryError set on failure
+ */
+int
+obj_lock_init(obj_lock_t *lock);
+
+void
+obj_lock_free(obj_lock_t *lock);
+
+/* Acquire a lock, waiting without the GIL if another thread holds it. */
+void
+obj_lock_acquire(obj_lock_t *lock);
+
+/*
+ * Acquire a lock only if no other thread holds it. Unlike obj_lock_acquire,
+ * this never touches the GIL, so native threads can use it.
+ * @return 1 if the lock was acquired, 0 if another thread holds it
+ */
+int
+obj_lock_try_acquire(obj_lock_t *lock);
+
+void
+obj_lock_release(obj_lock_t *lock);
+
+/* Define a wrapper of a method, accessor or slot function which holds the
+ * object's lock, named lock, while it runs. The wrapper's name is the
+ * function's name followed by _locked.
+ */
+#define OBJ_LOCKED_NOARGS(type, method)                 \
+    static PyObject *                                   \
+    method##_locked(type *self, PyObject *unused) {     \
+        obj_lock_acquire(&self->lock);                  \
+        PyObject *result = method(self);                \
+        obj_lock_release(&self->lock);                  \
+        return result;                                  \
+    }
+
+#define OBJ_LOCKED_O(type, method)                      \
+    static PyObject *                                   \
+    method##_locked(type *self, PyObject *arg) {        \
+        obj_lock_acquire(&self->lock);                  \
+        PyObject *result = method(self, arg);           \
+        obj_lock_release(&self->lock);                  \
+        return result;                                  \
+    }
+
+#define OBJ_LOCKED_KWARGS(type, method)                                 \
+    static PyObject *                                                   \
+    method##_locked(type *self, PyObject *args, PyObject *kwds) {       \
+        obj_lock_acquire(&self->lock);                                  \
+        PyObject *result = method(self, args, kwds);                    \
+        obj_lock_release(&self->lock);                                  \
+        return result;                                                  \
+    }
+
+#define OBJ_LOCKED_INIT(type, init)                                     \
+    static int                                                          \
+    init##_locked(type *self, PyObject *args, PyObject *kwds) {         \
+        obj_lock_acquire(&self->lock);                                  \
+        int result = init(self, args, kwds);                            \
+        obj_lock_release(&self->lock);                                  \
+        return result;                                                  \
+    }
+
+#define OBJ_LOCKED_GETTER(type, getter)                 \
+    static PyObject *                                   \
+    getter##_locked(type *self, void *closure) {        \
+        obj_lock_acquire(&self->lock);                  \
+        PyObject *result = getter(self, closure);       \
+        obj_lock_release(&self->lock);                  \
+        return result;                                  \
+    }
+
+#define OBJ_LOCKED_SETTER(type, setter)                                 \
+    static int                                                          \
+    setter##_locked(type *self, PyObject *value, void *closure) {       \
+        obj_lock_acquire(&self->lock);                                  \
+        int result = setter(self, value, closure);                      \
+        obj_lock_release(&self->lock);                                  \
+        return result;                                                  \
+    }
+
+#endif /* OBJLOCK_H_ */
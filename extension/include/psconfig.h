@@ -0,0 +1,77 @@
+/*
+ * psconfig.h
+ *
+ * Part of this file is based on source code from the CMU Pocket Sphinx project.
+ * As such, the below copyright notice and conditions apply IN ADDITION TO the 
+ * sphinxwrapper project's LICENSE file.
+ *
+ * ====================================================================
+ * Copyright (c) 1999-2016 Carnegie Mellon University.  All rights
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND 
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ *
+ */
+
+#ifndef PSCONFIG_H_
+#define PSCONFIG_H_
+
+#include <stdbool.h>
+#include <pocketsphinx.h>
+#include <sphinxbase/cmd_ln.h>
+
+/* Argument definitions used for all decoder configurations. This is the same
+ * as pocketsphinx_continuous's without the audio input arguments.
+ */
+extern const arg_t cont_args_def[];
+
+/*
+ * Parse Pocket Sphinx decoder arguments, including any -argfile, and set the
+ * default search arguments.
+ * @return new config on success, NULL on failure
+ */
+cmd_ln_t *
+parse_ps_args(int argc, char *argv[]);
+
+/*
+ * Copy every argument of a config made by parse_ps_args into a new config,
+ * so that the copy can be changed without affecting decoders using the
+ * original.
+ * @return new config on success, NULL on failure
+ */
+cmd_ln_t *
+copy_ps_args(cmd_ln_t *config);
+
+/*
+ * Check whether two configs made by parse_ps_args have the same value for
+ * every argument.
+ */
+bool
+ps_args_equal(cmd_ln_t *a, cmd_ln_t *b);
+
+#endif /* PSCONFIG_H_ */
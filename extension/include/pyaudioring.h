@@ -0,0 +1,99 @@
+/*
+ * pyaudioring.h
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#ifndef PYAUDIORING_H_
+#define PYAUDIORING_H_
+
+// Includes Python.h and useful definitions for 2.x and 3.x compatibility.
+#include "PythonCompat.h"
+
+#include "audio.h"
+#include "audioring.h"
+#include "modstate.h"
+#include "objlock.h"
+
+typedef struct {
+    PyObject_HEAD
+    audio_ring_t *ring;
+    int32 n_acquired; // samples referenced by the last AudioData read
+    AudioDataObj *view; // last AudioData read if still alive (borrowed), or NULL
+    obj_lock_t read_lock; // held while reading or releasing audio
+    obj_lock_t write_lock; // held while writing audio
+} AudioRingObj;
+
+/* Stop tracking an AudioData object that no longer views the ring. */
+void
+AudioRingObj_forget_view(AudioRingObj *self, AudioDataObj *view);
+
+PyObject *
+AudioRingObj_write(AudioRingObj *self, PyObject *args, PyObject *kwds);
+
+PyObject *
+AudioRingObj_read_audio(AudioRingObj *self, PyObject *args, PyObject *kwds);
+
+PyObject *
+AudioRingObj_release(AudioRingObj *self);
+
+PyObject *
+AudioRingObj_close(AudioRingObj *self);
+
+PyObject *
+AudioRingObj_iternext(AudioRingObj *self);
+
+PyObject *
+AudioRingObj_get_name(AudioRingObj *self, void *closure);
+
+PyObject *
+AudioRingObj_get_capacity(AudioRingObj *self, void *closure);
+
+PyObject *
+AudioRingObj_get_available(AudioRingObj *self, void *closure);
+
+PyObject *
+AudioRingObj_get_closed(AudioRingObj *self, void *closure);
+
+void
+AudioRingObj_dealloc(AudioRingObj *self);
+
+PyObject *
+AudioRingObj_new(PyTypeObject *type, PyObject *args, PyObject *kwds);
+
+int
+AudioRingObj_init(AudioRingObj *self, PyObject *args, PyObject *kwds);
+
+extern PyTypeObject AudioRingType;
+
+/* Read audio from an AudioDevice straight into the free space of a ring. */
+PyObject *
+AudioDeviceObj_read_into_ring(AudioDeviceObj *self, PyObject *args,
+                              PyObject *kwds);
+
+PyObject *
+initaudioring(PyObject *module);
+
+#endif /* PYAUDIORING_H_ */
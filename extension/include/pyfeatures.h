@@ -0,0 +1,70 @@
+/*
+ * pyfeatures.h
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#ifndef PYFEATURES_H_
+#define PYFEATURES_H_
+
+// Includes Python.h and useful definitions for 2.x and 3.x compatibility.
+#include "PythonCompat.h"
+
+#include "featstore.h"
+#include "modstate.h"
+
+typedef struct {
+    PyObject_HEAD
+    feat_store_t *store;
+} FeaturesObj;
+
+/* Create a Features object owning a feature store. */
+PyObject *
+FeaturesObj_from_store(module_state *state, feat_store_t *store);
+
+PyObject *
+FeaturesObj_save(FeaturesObj *self, PyObject *args, PyObject *kwds);
+
+PyObject *
+FeaturesObj_get_n_frames(FeaturesObj *self, void *closure);
+
+PyObject *
+FeaturesObj_get_n_ceps(FeaturesObj *self, void *closure);
+
+void
+FeaturesObj_dealloc(FeaturesObj *self);
+
+PyObject *
+FeaturesObj_new(PyTypeObject *type, PyObject *args, PyObject *kwds);
+
+int
+FeaturesObj_init(FeaturesObj *self, PyObject *args, PyObject *kwds);
+
+extern PyTypeObject FeaturesType;
+
+PyObject *
+initfeatures(PyObject *module);
+
+#endif /* PYFEATURES_H_ */
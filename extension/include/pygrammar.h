@@ -0,0 +1,73 @@
+/*
+ * pygrammar.h
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#ifndef PYGRAMMAR_H_
+#define PYGRAMMAR_H_
+
+// Includes Python.h and useful definitions for 2.x and 3.x compatibility.
+#include "PythonCompat.h"
+
+#include "grammar.h"
+
+typedef struct {
+    PyObject_HEAD
+    grammar_job_t *job; // job the future reports on, or NULL
+    PyObject *decoder; // PocketSphinx object the search is set on
+} SearchFutureObj;
+
+/* Create a SearchFuture object taking over a reference to a job. */
+PyObject *
+SearchFutureObj_from_job(grammar_job_t *job, PyObject *decoder);
+
+PyObject *
+SearchFutureObj_done(SearchFutureObj *self);
+
+PyObject *
+SearchFutureObj_wait(SearchFutureObj *self, PyObject *args, PyObject *kwds);
+
+PyObject *
+SearchFutureObj_result(SearchFutureObj *self, PyObject *args, PyObject *kwds);
+
+PyObject *
+SearchFutureObj_get_name(SearchFutureObj *self, void *closure);
+
+void
+SearchFutureObj_dealloc(SearchFutureObj *self);
+
+PyObject *
+SearchFutureObj_new(PyTypeObject *type, PyObject *args, PyObject *kwds);
+
+int
+SearchFutureObj_init(SearchFutureObj *self, PyObject *args, PyObject *kwds);
+
+extern PyTypeObject SearchFutureType;
+
+PyObject *
+initgrammar(PyObject *module);
+
+#endif /* PYGRAMMAR_H_ */
@@ -0,0 +1,68 @@
+/*
+ * pylattice.h
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#ifndef PYLATTICE_H_
+#define PYLATTICE_H_
+
+// Includes Python.h and useful definitions for 2.x and 3.x compatibility.
+#include "PythonCompat.h"
+
+#include <pocketsphinx.h>
+
+#include "modstate.h"
+
+typedef struct {
+    PyObject_HEAD
+    ps_lattice_t *dag; // retained word lattice, or NULL
+} LatticeObj;
+
+/* Create a Lattice object holding a new reference to a word lattice. */
+PyObject *
+LatticeObj_from_lattice(module_state *state, ps_lattice_t *dag);
+
+PyObject *
+LatticeObj_write(LatticeObj *self, PyObject *args, PyObject *kwds);
+
+PyObject *
+LatticeObj_get_n_frames(LatticeObj *self, void *closure);
+
+void
+LatticeObj_dealloc(LatticeObj *self);
+
+PyObject *
+LatticeObj_new(PyTypeObject *type, PyObject *args, PyObject *kwds);
+
+int
+LatticeObj_init(LatticeObj *self, PyObject *args, PyObject *kwds);
+
+extern PyTypeObject LatticeType;
+
+PyObject *
+initlattice(PyObject *module);
+
+#endif /* PYLATTICE_H_ */
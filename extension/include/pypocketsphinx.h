@@ -53,22 +53,26 @@
 #include <sphinxbase/prim_type.h>
 
 #include "audio.h"
+#include "modstate.h"
+#include "objlock.h"
+#include "psconfig.h"
 #include "pyutil.h"
-
-typedef enum {
-    IDLE,
-    STARTED,
-    ENDED
-} utterance_state_t;
-
-typedef enum {
-    JSGF_FILE, // JSpeech Grammar Format search from file
-    JSGF_STR,  // JSpeech Grammar Format search from string
-    LM_FILE,   // Language model search from file
-    FSG_FILE,  // Finite state grammar search from file
-    KWS_FILE,  // Key word/phrase search from file
-    KWS_STR    // Key word/phrase search from string
-} ps_search_type;
+#include "searches.h"
+#include "longaudio.h"
+#include "decoderpool.h"
+#include "multisearch.h"
+#include "cascade.h"
+#include "governor.h"
+#include "endpointer.h"
+#include "memreport.h"
+#include "normstate.h"
+#include "rescore.h"
+#include "snapshot.h"
+#include "twopass.h"
+#include "grammar.h"
+#include "utterance.h"
+
+#define PS_DEFAULT_SEARCH "_default"
 
 typedef struct {
     PyObject_HEAD
@@ -79,6 +83,35 @@ typedef struct {
     PyObject *search_name; // string
     // Utterance state used in processing methods
     utterance_state_t utterance_state;
+    // Sources of the searches set up through set_*_search methods and the
+    // words added with add_word
+    search_source_t *search_sources;
+    // Searches decoded concurrently instead of the active search, or NULL
+    multi_search_t *multi_search;
+    PyObject *search_hypothesis_callback; // callable or None
+    // Wake word cascade used instead of the active search, or NULL
+    cascade_t *cascade;
+    PyObject *keyphrase_callback; // callable or None
+    // Real time factor governor adjusting the beams, or NULL
+    governor_t *governor;
+    // Endpointer deciding where utterances start and end, or NULL
+    endpointer_t *endpointer;
+    // Background rescoring of each utterance's lattice, or NULL
+    rescorer_t *rescorer;
+    PyObject *rescored_hypothesis_callback; // callable or None
+    // Background second pass decoding of each utterance's audio, or NULL
+    second_pass_t *second_pass;
+    PyObject *corrected_hypothesis_callback; // callable or None
+    // Limits on the searches set up on the decoder, or 0 for no limit
+    int max_searches;
+    size_t max_search_bytes;
+    uint64 search_clock; // incremented whenever a search is used
+    // Background compiler for the *_search_async methods, or NULL
+    grammar_compiler_t *grammar_compiler;
+    // Decoders kept for decoding features and for concurrent searches
+    decoder_pool_t *decoder_pool;
+    // Held while methods use the decoder
+    obj_lock_t lock;
 } PSObj;
 
 PyObject *
@@ -116,12 +149,157 @@ PSObj_set_keyphrase_search(PSObj *self, PyObject *args, PyObject *kwds);
 PyObject *
 PSObj_set_keyphrases_search(PSObj *self, PyObject *args, PyObject *kwds);
 
+PyObject *
+PSObj_add_word(PSObj *self, PyObject *args, PyObject *kwds);
+
+PyObject *
+PSObj_set_search_async_internal(PSObj *self, ps_search_type search_type,
+                                PyObject *args, PyObject *kwds);
+
+PyObject *
+PSObj_set_jsgf_file_search_async(PSObj *self, PyObject *args, PyObject *kwds);
+
+PyObject *
+PSObj_set_jsgf_str_search_async(PSObj *self, PyObject *args, PyObject *kwds);
+
+PyObject *
+PSObj_set_fsg_search_async(PSObj *self, PyObject *args, PyObject *kwds);
+
+PyObject *
+PSObj_add_fsg_transition(PSObj *self, PyObject *args, PyObject *kwds);
+
+PyObject *
+PSObj_remove_fsg_transitions(PSObj *self, PyObject *args, PyObject *kwds);
+
+PyObject *
+PSObj_get_fsg_states(PSObj *self, PyObject *args, PyObject *kwds);
+
+/*
+ * Set up the named search again if it was evicted and mark it as the most
+ * recently used, then evict the least recently used searches over the
+ * decoder's limits. The named search, the active search and any cascade's
+ * searches are kept.
+ * @return 0 on success, -1 if the search couldn't be set up again
+ */
+int
+PSObj_use_search(PSObj *self, const char *name);
+
+PyObject *
+PSObj_set_search_limit(PSObj *self, PyObject *args, PyObject *kwds);
+
+/* Set searches compiled by the grammar compiler on the decoder, as far as the
+ * utterance state allows. Failures are reported through the searches'
+ * futures.
+ */
+void
+PSObj_apply_grammars(PSObj *self);
+
 PyObject *
 PSObj_set_config_argument(PSObj *self, PyObject *args, PyObject *kwds);
 
 PyObject *
 PSObj_get_config_argument(PSObj *self, PyObject *args, PyObject *kwds);
 
+PyObject *
+PSObj_warm_up(PSObj *self);
+
+PyObject *
+PSObj_reset(PSObj *self);
+
+PyObject *
+PSObj_fork_workers(PSObj *self, PyObject *args, PyObject *kwds);
+
+PyObject *
+PSObj_set_cascade(PSObj *self, PyObject *args, PyObject *kwds);
+
+PyObject *
+PSObj_clear_cascade(PSObj *self);
+
+PyObject *
+PSObj_enable_governor(PSObj *self, PyObject *args, PyObject *kwds);
+
+PyObject *
+PSObj_disable_governor(PSObj *self);
+
+PyObject *
+PSObj_set_endpointer(PSObj *self, PyObject *args, PyObject *kwds);
+
+PyObject *
+PSObj_clear_endpointer(PSObj *self);
+
+PyObject *
+PSObj_memory_report(PSObj *self, PyObject *args, PyObject *kwds);
+
+PyObject *
+PSObj_get_normalisation_state(PSObj *self);
+
+PyObject *
+PSObj_set_normalisation_state(PSObj *self, PyObject *args, PyObject *kwds);
+
+PyObject *
+PSObj_save_normalisation_state(PSObj *self, PyObject *args, PyObject *kwds);
+
+PyObject *
+PSObj_save_snapshot(PSObj *self, PyObject *args, PyObject *kwds);
+
+PyObject *
+PSObj_load_normalisation_state(PSObj *self, PyObject *args, PyObject *kwds);
+
+PyObject *
+PSObj_get_lattice(PSObj *self);
+
+/* Hand the lattice of the utterance that just ended to the rescorer, if
+ * rescoring is enabled.
+ */
+void
+PSObj_rescore_utterance(PSObj *self);
+
+/* Call the rescored hypothesis callback with each finished rescoring result.
+ * @return -1 if the callback raised an exception
+ */
+int
+PSObj_dispatch_rescored(PSObj *self);
+
+PyObject *
+PSObj_enable_rescoring(PSObj *self, PyObject *args, PyObject *kwds);
+
+PyObject *
+PSObj_disable_rescoring(PSObj *self);
+
+PyObject *
+PSObj_wait_for_rescoring(PSObj *self);
+
+/* Hand the audio of the utterance that just ended to the second pass, if it
+ * is enabled, or drop the audio if submit is false.
+ */
+void
+PSObj_second_pass_utterance(PSObj *self, const char *hyp, bool submit);
+
+/* Call the corrected hypothesis callback with each finished second pass
+ * result that differs from the first pass hypothesis.
+ * @return -1 if the callback raised an exception
+ */
+int
+PSObj_dispatch_second_pass(PSObj *self);
+
+PyObject *
+PSObj_enable_two_pass(PSObj *self);
+
+PyObject *
+PSObj_disable_two_pass(PSObj *self);
+
+PyObject *
+PSObj_wait_for_second_pass(PSObj *self);
+
+PyObject *
+PSObj_decode_long(PSObj *self, PyObject *args, PyObject *kwds);
+
+PyObject *
+PSObj_extract_features(PSObj *self, PyObject *args, PyObject *kwds);
+
+PyObject *
+PSObj_decode_features(PSObj *self, PyObject *args, PyObject *kwds);
+
 PyObject *
 PSObj_new(PyTypeObject *type, PyObject *args, PyObject *kwds);
 
@@ -155,6 +333,27 @@ PSObj_get_in_speech(PSObj *self, void *closure);
 PyObject *
 PSObj_get_active_search(PSObj *self, void *closure);
 
+PyObject *
+PSObj_get_concurrent_searches(PSObj *self, void *closure);
+
+PyObject *
+PSObj_get_search_hypothesis_callback(PSObj *self, void *closure);
+
+PyObject *
+PSObj_get_keyphrase_callback(PSObj *self, void *closure);
+
+PyObject *
+PSObj_get_governor_stats(PSObj *self, void *closure);
+
+PyObject *
+PSObj_get_endpointer_stats(PSObj *self, void *closure);
+
+PyObject *
+PSObj_get_rescored_hypothesis_callback(PSObj *self, void *closure);
+
+PyObject *
+PSObj_get_corrected_hypothesis_callback(PSObj *self, void *closure);
+
 int
 PSObj_set_speech_start_callback(PSObj *self, PyObject *value, void *closure);
 
@@ -164,7 +363,25 @@ PSObj_set_hypothesis_callback(PSObj *self, PyObject *value, void *closure);
 int
 PSObj_set_active_search(PSObj *self, PyObject *value, void *closure);
 
-PyTypeObject PSType;
+int
+PSObj_set_concurrent_searches(PSObj *self, PyObject *value, void *closure);
+
+int
+PSObj_set_search_hypothesis_callback(PSObj *self, PyObject *value,
+                                     void *closure);
+
+int
+PSObj_set_keyphrase_callback(PSObj *self, PyObject *value, void *closure);
+
+int
+PSObj_set_rescored_hypothesis_callback(PSObj *self, PyObject *value,
+                                       void *closure);
+
+int
+PSObj_set_corrected_hypothesis_callback(PSObj *self, PyObject *value,
+                                        void *closure);
+
+extern PyTypeObject PSType;
 
 /*
  * Initialise a Pocket Sphinx decoder with arguments.
@@ -173,6 +390,14 @@ PyTypeObject PSType;
 bool
 init_ps_decoder_with_args(PSObj *self, int argc, char *argv[]);
 
+/*
+ * Initialise a Pocket Sphinx decoder with a config parsed by parse_ps_args or
+ * snapshot_config.
+ * @return true on success, false on failure
+ */
+bool
+init_ps_decoder_with_config(PSObj *self, cmd_ln_t *config);
+
 PyObject *
 initpocketsphinx(PyObject *module);
 
@@ -49,4 +49,14 @@
 bool
 assert_callable_arg_count(PyObject *value, const unsigned int arg_count);
 
+/* Converts a Python list of strings into a C string array, such as the argv
+ * array used to initialise Pocket Sphinx decoders. The strings are borrowed
+ * from the list's items, so the list must outlive the array.
+ *
+ * Returns the array, which must be released with PyMem_Free, and sets *size
+ * to its length. Returns NULL with a Python exception set on failure.
+ */
+char **
+string_list_to_array(PyObject *list, Py_ssize_t *size);
+
 #endif /* PYUTIL_H_ */
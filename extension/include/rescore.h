@@ -0,0 +1,91 @@
+/*
+ * rescore.h
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#ifndef RESCORE_H_
+#define RESCORE_H_
+
+#include <stdbool.h>
+#include <pocketsphinx.h>
+#include <sphinxbase/cmd_ln.h>
+#include <sphinxbase/logmath.h>
+#include <sphinxbase/prim_type.h>
+
+/* A copy of the links of a word lattice, in topological order, holding only
+ * what is needed to rescore it. Copying the lattice means the decoder is free
+ * to start the next utterance while the copy is rescored on another thread.
+ */
+typedef struct rescore_graph_s rescore_graph_t;
+
+/* Copy the links of a lattice reachable from its start node.
+ * @return NULL on failure or if dag is NULL
+ */
+rescore_graph_t *
+rescore_graph_from_lattice(ps_lattice_t *dag);
+
+void
+rescore_graph_free(rescore_graph_t *graph);
+
+/* A background thread rescoring lattices with an n-gram language model,
+ * normally a larger one than the first pass search could use at real time.
+ */
+typedef struct rescorer_s rescorer_t;
+
+/*
+ * Load the language model at lm_path and start the rescoring thread. The
+ * model's scores are weighted with lw and the word insertion penalty in
+ * config.
+ * @return NULL on failure
+ */
+rescorer_t *
+rescorer_init(cmd_ln_t *config, logmath_t *lmath, const char *lm_path,
+              float32 lw);
+
+/* Queue a graph for rescoring. The rescorer takes ownership of the graph,
+ * which may be NULL if the utterance had no lattice.
+ */
+void
+rescorer_submit(rescorer_t *rescorer, rescore_graph_t *graph);
+
+/*
+ * Take the oldest finished result, if there is one. Results come out in the
+ * order graphs were submitted. hyp is set to a string the caller must free
+ * with ckd_free, or to NULL if nothing could be recognised.
+ * @return true if a result was taken
+ */
+bool
+rescorer_poll(rescorer_t *rescorer, char **hyp);
+
+/* Wait until every submitted graph has been rescored. */
+void
+rescorer_wait(rescorer_t *rescorer);
+
+/* Stop the thread, discarding unfinished work, and free the model. */
+void
+rescorer_free(rescorer_t *rescorer);
+
+#endif /* RESCORE_H_ */
@@ -0,0 +1,178 @@
+/*
+ * searches.h
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#ifndef SEARCHES_H_
+#define SEARCHES_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <pocketsphinx.h>
+#include <sphinxbase/prim_type.h>
+
+#include "fsgedit.h"
+
+typedef enum {
+    JSGF_FILE, // JSpeech Grammar Format search from file
+    JSGF_STR,  // JSpeech Grammar Format search from string
+    LM_FILE,   // Language model search from file
+    FSG_FILE,  // Finite state grammar search from file
+    KWS_FILE,  // Key word/phrase search from file
+    KWS_STR,   // Key word/phrase search from string
+    FSG_STR,   // Finite state grammar search from string
+    DICT_WORD  // Word added to the dictionary, with its phones as the value
+} ps_search_type;
+
+/* Where a named search came from, so that it can be set up again on other
+ * decoders. Words added to the dictionary are kept in the same list, before
+ * the searches using them.
+ */
+typedef struct search_source_s {
+    struct search_source_s *next;
+    ps_search_type type;
+    char *name;
+    char *value; // file path or string, depending on the type
+    fsg_edit_t *edits; // edits made to the search's grammar since it was set
+
+    // Set by search_sources_used for the decoder owning the list
+    bool resident; // whether the search is set up on the decoder
+    uint64 last_used; // tick the search was last set up or activated at
+    size_t bytes; // estimated memory used by the search, or 0 if unknown
+
+    uint64 version; // increases whenever the source is set or edited
+} search_source_t;
+
+/*
+ * Add a Pocket Sphinx search to a decoder without activating it. Setting an
+ * already used search name replaces that search. DICT_WORD adds the named word
+ * to the dictionary instead.
+ * @return 0 on success, -1 on failure
+ */
+int
+add_ps_search(ps_decoder_t *ps, ps_search_type type, const char *name,
+              const char *value);
+
+/*
+ * Add a word to the decoder's dictionary. If update is true, the active search
+ * is set up again so that it can recognise the word and any added before it
+ * without updating.
+ * @return 0 on success, -1 on failure
+ */
+int
+add_ps_word(ps_decoder_t *ps, const char *word, const char *phones,
+            bool update);
+
+/*
+ * Set the named search up again with the grammar or language model it already
+ * uses, picking up changes to the decoder's config such as its beams, and
+ * activate it. No files are read, so this works for searches without a
+ * source too. Keyphrase searches can't be set up again this way.
+ * @return 0 on success, -1 on failure
+ */
+int
+refresh_ps_search(ps_decoder_t *ps, const char *name);
+
+/*
+ * Remember the source of a search just set up on the decoder owning the list,
+ * replacing any source with the same name.
+ * @return the new list of sources
+ */
+search_source_t *
+search_sources_add(search_source_t *sources, ps_search_type type,
+                   const char *name, const char *value);
+
+/*
+ * Remember an edit made to the grammar of the named search, taking ownership
+ * of it. Edits are made again whenever the search is set up from its source.
+ * @return 0 on success, -1 if there is no such source
+ */
+int
+search_sources_add_edit(search_source_t *sources, const char *name,
+                        fsg_edit_t *edit);
+
+/* The highest version of the sources, which changes whenever a source is
+ * added, replaced or edited. Decoders set up from the sources are out of date
+ * if it has changed since.
+ */
+uint64
+search_sources_version(search_source_t *sources);
+
+/* Find the source of the named search, or return NULL. Added words are
+ * skipped.
+ */
+search_source_t *
+search_sources_find(search_source_t *sources, const char *name);
+
+/*
+ * Add every remembered search to a decoder and activate the named search if
+ * active isn't NULL.
+ * @return 0 on success, -1 on failure
+ */
+int
+search_sources_apply(search_source_t *sources, ps_decoder_t *ps,
+                     const char *active);
+
+/* Record that the named search was set up or activated on the decoder at
+ * tick, estimating its memory use if it wasn't already.
+ */
+void
+search_sources_used(search_source_t *sources, ps_decoder_t *ps,
+                    const char *name, uint64 tick);
+
+/*
+ * Set up the named search on the decoder again from its source if it was
+ * evicted. Searches that don't come from a source are left alone.
+ * @return 0 on success, -1 on failure
+ */
+int
+search_sources_restore(search_source_t *sources, ps_decoder_t *ps,
+                       const char *name);
+
+/*
+ * Record that the decoder has lost every search and added word, such as after
+ * ps_reinit. The words are added again straight away, while the searches are
+ * set up again from their sources when they are next used.
+ * @return 0 on success, -1 if a word couldn't be added again
+ */
+int
+search_sources_reinit(search_source_t *sources, ps_decoder_t *ps);
+
+/*
+ * Unset the least recently used searches from the decoder until at most
+ * max_searches searches from sources remain, using at most max_bytes. A limit
+ * of 0 means no limit. The n_keep names in keep are never evicted.
+ * @return the number of searches evicted
+ */
+int
+search_sources_evict(search_source_t *sources, ps_decoder_t *ps,
+                     int max_searches, size_t max_bytes,
+                     char const **keep, int n_keep);
+
+void
+search_sources_free(search_source_t *sources);
+
+#endif /* SEARCHES_H_ */
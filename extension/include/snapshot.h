@@ -0,0 +1,83 @@
+/*
+ * snapshot.h
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#ifndef SNAPSHOT_H_
+#define SNAPSHOT_H_
+
+#include <pocketsphinx.h>
+#include <sphinxbase/cmd_ln.h>
+
+#include "searches.h"
+
+/* A decoder saved to a file: its config, the words added to its dictionary,
+ * its searches and the name of its active search. Grammar searches are saved
+ * as compiled FSGs with any edits made, so a decoder restored from the file
+ * doesn't compile them again. Other searches are saved as their sources.
+ *
+ * Snapshot files are memory-mapped while a decoder is restored from them.
+ */
+typedef struct snapshot_s snapshot_t;
+
+/*
+ * Save a snapshot of a decoder, which was initialised with config and had the
+ * searches in sources set up on it, to path. Evicted searches are set up
+ * again while they are written.
+ * @return 0 on success, -1 with errno set on failure
+ */
+int
+snapshot_save(const char *path, ps_decoder_t *ps, cmd_ln_t *config,
+              search_source_t *sources);
+
+/*
+ * Map a snapshot file.
+ * @return NULL with errno set on failure, EINVAL if the file isn't a snapshot
+ */
+snapshot_t *
+snapshot_open(const char *path);
+
+/*
+ * Parse the config saved in a snapshot.
+ * @return new config on success, NULL on failure
+ */
+cmd_ln_t *
+snapshot_config(snapshot_t *snap);
+
+/*
+ * Add the words and searches saved in a snapshot to a decoder initialised with
+ * the snapshot's config, remembering their sources, and activate the saved
+ * active search.
+ * @return 0 on success, -1 on failure
+ */
+int
+snapshot_restore(snapshot_t *snap, ps_decoder_t *ps,
+                 search_source_t **sources);
+
+void
+snapshot_close(snapshot_t *snap);
+
+#endif /* SNAPSHOT_H_ */
@@ -0,0 +1,85 @@
+/*
+ * streammanager.h
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#ifndef STREAMMANAGER_H_
+#define STREAMMANAGER_H_
+
+#include <pthread.h>
+#include <stdbool.h>
+
+// Includes Python.h and useful definitions for 2.x and 3.x compatibility.
+#include "PythonCompat.h"
+
+#include "streampool.h"
+
+typedef struct stream_event_s {
+    struct stream_event_s *next;
+    int64 stream_id;
+    utterance_event_t event;
+    char *hyp; // NULL unless there was a hypothesis
+} stream_event_t;
+
+typedef struct {
+    PyObject_HEAD
+    stream_pool_t *pool;
+    // Events reported by the pool's worker threads, oldest first
+    pthread_mutex_t events_lock;
+    pthread_cond_t events_ready;
+    stream_event_t *events_head;
+    stream_event_t *events_tail;
+} StreamManagerObj;
+
+PyObject *
+StreamManagerObj_push(StreamManagerObj *self, PyObject *args, PyObject *kwds);
+
+PyObject *
+StreamManagerObj_close_stream(StreamManagerObj *self, PyObject *args,
+                              PyObject *kwds);
+
+PyObject *
+StreamManagerObj_get_events(StreamManagerObj *self, PyObject *args,
+                            PyObject *kwds);
+
+PyObject *
+StreamManagerObj_get_stream_count(StreamManagerObj *self, void *closure);
+
+void
+StreamManagerObj_dealloc(StreamManagerObj *self);
+
+PyObject *
+StreamManagerObj_new(PyTypeObject *type, PyObject *args, PyObject *kwds);
+
+int
+StreamManagerObj_init(StreamManagerObj *self, PyObject *args, PyObject *kwds);
+
+extern PyTypeObject StreamManagerType;
+
+PyObject *
+initstreammanager(PyObject *module);
+
+#endif /* STREAMMANAGER_H_ */
@@ -0,0 +1,118 @@
+/*
+ * streampool.h
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#ifndef STREAMPOOL_H_
+#define STREAMPOOL_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <pocketsphinx.h>
+#include <sphinxbase/cmd_ln.h>
+#include <sphinxbase/prim_type.h>
+
+#include "utterance.h"
+
+/* Native pool of per-stream Pocket Sphinx decoders.
+ *
+ * Audio for any number of streams can be pushed from any thread. Streams with
+ * pending audio are kept in a run queue and a fixed number of worker threads
+ * take turns processing one chunk per stream, so that a stream with a lot of
+ * audio cannot starve the others.
+ *
+ * Each open stream needs its own decoder, but the decoders of closed streams
+ * are kept and handed to new streams, so models are only loaded when more
+ * streams are open at once than ever before.
+ *
+ * Nothing in here touches Python objects.
+ */
+typedef struct stream_pool_s stream_pool_t;
+
+/* Called from worker threads when a stream's utterance state changes, or with
+ * UTT_EVENT_ERROR if the stream's decoder couldn't be set up, after which the
+ * stream's audio is dropped. hyp is the hypothesis for UTT_EVENT_HYPOTHESIS
+ * events, which may be NULL if there wasn't one, and the error message for
+ * UTT_EVENT_ERROR events. It is only valid for the duration of the call.
+ */
+typedef void (*stream_event_cb)(void *user_data, int64 stream_id,
+                                utterance_event_t event, char const *hyp);
+
+/* Called from a worker thread after a closed stream's last event has been
+ * reported and just before its decoder is returned to the pool.
+ */
+typedef void (*stream_closed_cb)(void *user_data, int64 stream_id);
+
+/*
+ * Create a stream pool and start its worker threads. Each stream gets a
+ * decoder initialised from config, which is retained by the pool.
+ * @return new stream pool on success, NULL on failure
+ */
+stream_pool_t *
+stream_pool_init(cmd_ln_t *config, int n_workers, stream_event_cb callback,
+                 void *user_data);
+
+/*
+ * Queue audio for a stream, creating the stream if it doesn't exist yet. The
+ * audio is copied.
+ * @return 0 on success, -1 on failure
+ */
+int
+stream_pool_push(stream_pool_t *pool, int64 stream_id, int16 const *buf,
+                 size_t n_samples);
+
+/*
+ * Close a stream once its pending audio has been processed. Any utterance in
+ * progress is ended and its hypothesis reported.
+ * @return 0 on success, -1 if there is no such stream
+ */
+int
+stream_pool_close_stream(stream_pool_t *pool, int64 stream_id);
+
+/* Set a callback to be notified when closed streams are finished with. This
+ * should be set before any streams are closed.
+ */
+void
+stream_pool_set_closed_callback(stream_pool_t *pool,
+                                stream_closed_cb closed_callback);
+
+/* Get the number of samples queued for a stream that haven't been processed
+ * yet, or 0 if there is no such stream.
+ */
+size_t
+stream_pool_pending(stream_pool_t *pool, int64 stream_id);
+
+/* Get the number of open streams. */
+size_t
+stream_pool_n_streams(stream_pool_t *pool);
+
+/* Stop the worker threads and free the pool along with any open streams and
+ * idle decoders.
+ */
+void
+stream_pool_free(stream_pool_t *pool);
+
+#endif /* STREAMPOOL_H_ */
@@ -0,0 +1,88 @@
+/*
+ * trace.h
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <stdio.h>
+#include <sphinxbase/prim_type.h>
+
+/* Opt-in tracing of the native phases of decoding, written out in the Chrome
+ * trace event format for viewing in Perfetto or chrome://tracing.
+ *
+ * Each thread records its spans into a buffer of its own without locking.
+ * While tracing is disabled, trace_begin only loads a flag and trace_end
+ * only tests a value, so the spans can stay in the decoding loops.
+ */
+
+// Maximum number of spans kept per thread for one trace.
+#define TRACE_BUFFER_SIZE 16384
+
+extern int trace_enabled;
+
+uint64
+trace_now(void);
+
+/* Record a span that started at start, in trace_now nanoseconds, and ends
+ * now. The name must be a string constant.
+ */
+void
+trace_record(const char *name, uint64 start);
+
+/* Start a span, returning 0 if tracing is disabled. */
+static inline uint64
+trace_begin(void) {
+    return __atomic_load_n(&trace_enabled, __ATOMIC_RELAXED) ? trace_now() : 0;
+}
+
+/* End a span started by trace_begin. */
+static inline void
+trace_end(uint64 start, const char *name) {
+    if (start != 0)
+        trace_record(name, start);
+}
+
+/* Discard the spans of any previous trace and start recording. */
+void
+trace_start(void);
+
+void
+trace_stop(void);
+
+/*
+ * Write the spans recorded since trace_start as Chrome trace event JSON.
+ * @return 0 on success, -1 on failure with errno set
+ */
+int
+trace_write_json(FILE *file);
+
+/* Number of spans not recorded since trace_start because a buffer was full. */
+uint64
+trace_dropped(void);
+
+#endif /* TRACE_H_ */
@@ -0,0 +1,98 @@
+/*
+ * twopass.h
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#ifndef TWOPASS_H_
+#define TWOPASS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <pocketsphinx.h>
+#include <sphinxbase/cmd_ln.h>
+#include <sphinxbase/prim_type.h>
+
+#include "searches.h"
+
+/* A background thread decoding each finished utterance again with a slower,
+ * more accurate second decoder. The second decoder uses a copy of the first
+ * decoder's config with the flat lexicon search and best path search turned
+ * on, so the first decoder can run without them and report its hypothesis
+ * straight away.
+ *
+ * The audio of the current utterance is kept by the caller's thread with
+ * second_pass_retain and handed to the thread with second_pass_submit.
+ */
+typedef struct second_pass_s second_pass_t;
+
+/*
+ * Create the second decoder from a copy of config, add the searches from
+ * sources and activate the named search if it isn't NULL, then start the
+ * thread.
+ * @return NULL on failure
+ */
+second_pass_t *
+second_pass_init(cmd_ln_t *config, search_source_t *sources,
+                 const char *search);
+
+/* Keep a chunk of audio for the current utterance. If restart is true, the
+ * audio kept so far is dropped first and the chunk is kept only as leading
+ * context for an utterance that hasn't started yet.
+ */
+void
+second_pass_retain(second_pass_t *sp, int16 const *samples, size_t n_samples,
+                   bool restart);
+
+/* Queue the audio kept for the utterance that just ended to be decoded with
+ * the named search. first_hyp is the first decoder's hypothesis, or NULL,
+ * which the result is compared with.
+ */
+void
+second_pass_submit(second_pass_t *sp, const char *search,
+                   const char *first_hyp);
+
+/*
+ * Take the oldest finished result, if there is one. Results come out in the
+ * order utterances were submitted; utterances decoded with a search the
+ * second decoder doesn't have are skipped. first_hyp and hyp are set to the
+ * first and second decoders' hypotheses, strings the caller must free with
+ * ckd_free or NULL if nothing was recognised, and changed to whether they
+ * differ.
+ * @return true if a result was taken
+ */
+bool
+second_pass_poll(second_pass_t *sp, char **first_hyp, char **hyp,
+                 bool *changed);
+
+/* Wait until every submitted utterance has been decoded. */
+void
+second_pass_wait(second_pass_t *sp);
+
+/* Stop the thread, discarding unfinished work, and free the decoder. */
+void
+second_pass_free(second_pass_t *sp);
+
+#endif /* TWOPASS_H_ */
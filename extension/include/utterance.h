@@ -0,0 +1,77 @@
+/*
+ * utterance.h
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#ifndef UTTERANCE_H_
+#define UTTERANCE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <pocketsphinx.h>
+#include <sphinxbase/prim_type.h>
+
+typedef enum {
+    IDLE,
+    STARTED,
+    ENDED
+} utterance_state_t;
+
+typedef enum {
+    UTT_EVENT_NONE,         // nothing happened worth reporting
+    UTT_EVENT_SPEECH_START, // idle -> started transition
+    UTT_EVENT_HYPOTHESIS,   // started -> ended transition; ps_get_hyp is ready
+    UTT_EVENT_ERROR         // a stream's decoder couldn't be set up
+} utterance_event_t;
+
+/* Process raw audio with a decoder, starting an utterance if necessary, and
+ * move the utterance state along.
+ *
+ * This is the native equivalent of the idle/started/ended state machine used
+ * by the processing methods. It doesn't touch any Python objects, so it may be
+ * called without holding the GIL.
+ *
+ * @return the event that occurred while processing the audio
+ */
+utterance_event_t
+utterance_process_raw(ps_decoder_t *ps, utterance_state_t *state,
+                      int16 const *buf, size_t n_samples);
+
+/* Move the utterance state along given whether speech is detected. The
+ * caller is responsible for ending the decoder's utterance on a hypothesis
+ * event.
+ * @return the event that occurred
+ */
+utterance_event_t
+utterance_update(utterance_state_t *state, uint8 in_speech);
+
+/* End the current utterance if one was in progress.
+ * @return true if an utterance was in progress
+ */
+bool
+utterance_end(ps_decoder_t *ps, utterance_state_t *state);
+
+#endif /* UTTERANCE_H_ */
@@ -26,6 +26,9 @@ def main():
     # decoder configuration. The following will suppress log output.
     ps = PocketSphinx(["-logfn", os.devnull])
 
+    # Alternatively, the log output can be passed to Python's logging module
+    # by calling sphinxwrapper.start_logging() before creating the decoder.
+
     # Set up callback functions.
     ps.speech_start_callback = speech_start_callback
     ps.hypothesis_callback = hyp_callback
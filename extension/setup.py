@@ -5,36 +5,116 @@ This is here mostly for historical reasons. You probably want to install the pur
 Python version that uses the CMU Sphinx Swig modules instead.
 """
 
-from setuptools import setup, Extension
+from distutils.ccompiler import new_compiler
+from distutils.sysconfig import customize_compiler
+
+from setuptools import setup, Command, Extension
+
+include_dirs = [
+    'include',
+    '/usr/local/include',
+    '/usr/local/include/sphinxbase',
+    '/usr/local/include/pocketsphinx',
+    '/usr/include',
+    '/usr/include/sphinxbase',
+    '/usr/include/pocketsphinx'
+]
+
+library_dirs = ['/usr/local/lib']
 
 module1 = Extension('sphinxwrapper',
                     sources=[
                         'src/sphinxwrapper.c',
                         'src/pypocketsphinx.c',
                         'src/audio.c',
-                        'src/pyutil.c'
-                    ],
-                    include_dirs=[
-                         'include',
-                         '/usr/local/include',
-                         '/usr/local/include/sphinxbase',
-                         '/usr/local/include/pocketsphinx',
-                         '/usr/include',
-                         '/usr/include/sphinxbase',
-                         '/usr/include/pocketsphinx'
+                        'src/audioring.c',
+                        'src/pyaudioring.c',
+                        'src/pyutil.c',
+                        'src/modstate.c',
+                        'src/objlock.c',
+                        'src/trace.c',
+                        'src/pytrace.c',
+                        'src/logqueue.c',
+                        'src/pylog.c',
+                        'src/psconfig.c',
+                        'src/utterance.c',
+                        'src/streampool.c',
+                        'src/streammanager.c',
+                        'src/forkserver.c',
+                        'src/searches.c',
+                        'src/longaudio.c',
+                        'src/decoderpool.c',
+                        'src/featstore.c',
+                        'src/pyfeatures.c',
+                        'src/multisearch.c',
+                        'src/cascade.c',
+                        'src/governor.c',
+                        'src/endpointer.c',
+                        'src/memreport.c',
+                        'src/normstate.c',
+                        'src/rescore.c',
+                        'src/twopass.c',
+                        'src/pytwopass.c',
+                        'src/pylattice.c',
+                        'src/grammar.c',
+                        'src/pygrammar.c',
+                        'src/fsgedit.c',
+                        'src/snapshot.c'
                     ],
+                    include_dirs=include_dirs,
                     libraries=[
                          'pocketsphinx',
                          'sphinxbase',
-                         'sphinxad'
+                         'sphinxad',
+                         'pthread',
+                         'rt',
+                         'm'
                     ],
-                    library_dirs=['/usr/local/lib']
+                    library_dirs=library_dirs
                     )
 
+
+class BuildDaemon(Command):
+    """
+    Build the standalone sphinxwrapper-daemon program, which decodes audio sent
+    to it over a Unix domain socket without using Python.
+    """
+
+    description = "build the sphinxwrapper-daemon program"
+    user_options = []
+
+    sources = [
+        'src/daemon.c',
+        'src/psconfig.c',
+        'src/utterance.c',
+        'src/streampool.c',
+        'src/trace.c'
+    ]
+
+    def initialize_options(self):
+        pass
+
+    def finalize_options(self):
+        pass
+
+    def run(self):
+        compiler = new_compiler()
+        customize_compiler(compiler)
+        objects = compiler.compile(self.sources, output_dir='build',
+                                   include_dirs=include_dirs,
+                                   extra_preargs=['-std=gnu99'])
+        compiler.link_executable(objects, 'sphinxwrapper-daemon',
+                                 output_dir='build',
+                                 libraries=['pocketsphinx', 'sphinxbase',
+                                            'pthread'],
+                                 library_dirs=library_dirs)
+
+
 setup(name='sphinxwrapper',
       version='0.1',
       description='Simplified Python API for using Pocket Sphinx',
       author='Dane Finlay',
       author_email='Danesprite@gmail.com',
-      ext_modules=[module1]
+      ext_modules=[module1],
+      cmdclass={'build_daemon': BuildDaemon}
       )
@@ -40,26 +40,109 @@
  * ====================================================================
  */
 
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include "audio.h"
+#include "pyaudioring.h"
+#include "trace.h"
+
+// Deallocated AudioData objects of the exact AudioData type are kept on the
+// module state's free list and handed out again by AudioDataObj_new, saving an
+// allocation of the 4 KB audio buffer on every read. Access is serialised by
+// the GIL, so the free list isn't used on free-threaded builds of Python.
+
+/* Stop viewing another object's memory. */
+static void
+clear_base(AudioDataObj *self) {
+    PyObject *base = self->base;
+    if (base != NULL &&
+        PyObject_TypeCheck(base, GET_MODULE_STATE(self)->AudioRingType))
+        AudioRingObj_forget_view((AudioRingObj *)base, self);
+    Py_CLEAR(self->base);
+}
 
 void
 AudioDataObj_dealloc(AudioDataObj *self) {
+    clear_base(self);
+
+    // Keep the object for reuse if there is room on the free list.
+    // Subclass instances may have a different size, so they are always freed.
+#ifndef Py_GIL_DISABLED
+    module_state *state = GET_MODULE_STATE(self);
+    if (Py_TYPE(self) == state->AudioDataType &&
+        state->audio_data_n_free < AUDIO_DATA_FREE_LIST_SIZE) {
+        state->audio_data_free_list[state->audio_data_n_free++] =
+            (PyObject *)self;
+#ifdef PYCOMPAT_MODULE_STATE
+        // The type reference is taken again when the object is reused.
+        Py_DECREF(Py_TYPE(self));
+#endif
+        return;
+    }
+#endif
+
+    obj_lock_free(&self->lock);
+
     // Free the Python type object
-    Py_TYPE(self)->tp_free((PyObject*)self);
+    free_module_object((PyObject *)self);
 }
 
 PyObject *
 AudioDataObj_new(PyTypeObject *type, PyObject *args, PyObject *kwds) {
     AudioDataObj *self;
 
+#ifndef Py_GIL_DISABLED
+    module_state *state = get_type_state(type);
+    if (type == state->AudioDataType && state->audio_data_n_free > 0) {
+        // Reinitialise an object from the free list. Its memory was never
+        // released, so only the reference count and type need resetting.
+        self = (AudioDataObj *)
+            state->audio_data_free_list[--state->audio_data_n_free];
+        PyObject_Init((PyObject *)self, type);
+    } else {
+        self = (AudioDataObj *)type->tp_alloc(type, 0);
+    }
+#else
     self = (AudioDataObj *)type->tp_alloc(type, 0);
+#endif
+
     if (self != NULL) {
+        self->samples = self->audio_buffer;
+        self->base = NULL;
+        self->n_samples = 0;
         self->is_set = false;
+
+        // Reused objects already have a lock.
+        if (self->lock.lock == NULL && obj_lock_init(&self->lock) < 0) {
+            Py_DECREF(self);
+            return NULL;
+        }
     }
 
     return (PyObject *)self;
 }
 
+PyObject *
+AudioDataObj_new_view(module_state *state, PyObject *base, int16 *samples,
+                      int32 n_samples) {
+    PyObject *audio_data = PyObject_CallObject(
+        (PyObject *)state->AudioDataType, NULL);
+    if (audio_data == NULL)
+        return NULL;
+
+    AudioDataObj *audio_data_c = (AudioDataObj *)audio_data;
+    Py_INCREF(base);
+    audio_data_c->base = base;
+    audio_data_c->samples = samples;
+    audio_data_c->n_samples = n_samples;
+    audio_data_c->is_set = true;
+    return audio_data;
+}
+
 int
 AudioDataObj_init(AudioDataObj *self, PyObject *args, PyObject *kwds) {
     static char *kwlist[] = {NULL};
@@ -125,7 +208,8 @@ PyTypeObject AudioDataType = {
 PyObject *
 AudioDeviceObj_open(AudioDeviceObj *self) {
     if (self->open) {
-        PyErr_SetString(AudioDeviceError, "Audio device is already open.");
+        PyErr_SetString(GET_MODULE_STATE(self)->AudioDeviceError,
+                        "Audio device is already open.");
         return NULL;
     }
     const char *dev = NULL;
@@ -148,7 +232,7 @@ AudioDeviceObj_open(AudioDeviceObj *self) {
 
     // If it's still NULL, then that's an error.
     if (self->ad == NULL) {
-        PyErr_SetString(AudioDeviceError,
+        PyErr_SetString(GET_MODULE_STATE(self)->AudioDeviceError,
                         "Failed to open audio device");
         return NULL;
     }
@@ -162,19 +246,21 @@ AudioDeviceObj_open(AudioDeviceObj *self) {
 PyObject *
 AudioDeviceObj_record(AudioDeviceObj *self) {
     if (self->recording) {
-        PyErr_SetString(AudioDeviceError,
+        PyErr_SetString(GET_MODULE_STATE(self)->AudioDeviceError,
                         "Audio device is already recording.");
         return NULL;
     }
 
     if (self->ad == NULL) {
-        PyErr_SetString(AudioDeviceError, "Failed to start recording: device is "
+        PyErr_SetString(GET_MODULE_STATE(self)->AudioDeviceError,
+                        "Failed to start recording: device is "
                         "not open.");
         return NULL;
     }
 
     if (ad_start_rec(self->ad) < 0) {
-        PyErr_SetString(AudioDeviceError, "Failed to start recording.");
+        PyErr_SetString(GET_MODULE_STATE(self)->AudioDeviceError,
+                        "Failed to start recording.");
         return NULL;
     }
 
@@ -187,14 +273,15 @@ AudioDeviceObj_record(AudioDeviceObj *self) {
 PyObject *
 AudioDeviceObj_stop_recording(AudioDeviceObj *self) {
     if (!self->recording) {
-        PyErr_SetString(AudioDeviceError,
+        PyErr_SetString(GET_MODULE_STATE(self)->AudioDeviceError,
                         "Audio device is not recording.");
         return NULL;
     }
 
     if (self->ad != NULL) {
         if (ad_stop_rec(self->ad) < 0) {
-            PyErr_SetString(AudioDeviceError, "Failed to stop recording.");
+            PyErr_SetString(GET_MODULE_STATE(self)->AudioDeviceError,
+                            "Failed to stop recording.");
             return NULL;
         }
     }
@@ -220,13 +307,13 @@ AudioDeviceObj_close(AudioDeviceObj *self) {
         }
 
         if (!self->open) {
-            PyErr_SetString(AudioDeviceError,
+            PyErr_SetString(GET_MODULE_STATE(self)->AudioDeviceError,
                             "Audio device is already closed.");
             return NULL;
         }
 
         if (ad_close(ad) < 0) {
-            PyErr_SetString(AudioDeviceError,
+            PyErr_SetString(GET_MODULE_STATE(self)->AudioDeviceError,
                             "Failed to close audio device.");
             return NULL;
         }
@@ -242,24 +329,76 @@ AudioDeviceObj_close(AudioDeviceObj *self) {
 PyObject *
 AudioDeviceObj_read_audio(AudioDeviceObj *self) {
     if (self->ad == NULL) {
-        PyErr_SetString(AudioDeviceError,
+        PyErr_SetString(GET_MODULE_STATE(self)->AudioDeviceError,
                         "Failed to read audio. Have you called open() and "
                         "record()?");
         return NULL;
     }
 
     // Create a new audio buffer to use
-    PyObject *audio_data = PyObject_CallObject((PyObject *)&AudioDataType, NULL);
+    PyObject *audio_data = PyObject_CallObject(
+        (PyObject *)GET_MODULE_STATE(self)->AudioDataType, NULL);
+    if (audio_data == NULL)
+        return NULL;
+    AudioDataObj *audio_data_c = (AudioDataObj *)audio_data;
+
+    uint64 span = trace_begin();
+    int32 n_samples = ad_read(self->ad, audio_data_c->audio_buffer, 2048);
+    trace_end(span, "ad_read");
+    if (n_samples < 0) {
+        Py_DECREF(audio_data);
+        PyErr_SetString(GET_MODULE_STATE(self)->AudioDeviceError,
+                        "Failed to read audio.");
+        return NULL;
+    }
+
+    audio_data_c->n_samples = n_samples;
+    audio_data_c->is_set = true;
+    return audio_data;
+}
+
+PyObject *
+AudioDeviceObj_read_into(AudioDeviceObj *self, PyObject *args, PyObject *kwds) {
+    PyObject *audio_data = NULL;
+    static char *kwlist[] = {"audio_data", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!", kwlist,
+                                     GET_MODULE_STATE(self)->AudioDataType,
+                                     &audio_data))
+        return NULL;
+
+    if (self->ad == NULL) {
+        PyErr_SetString(GET_MODULE_STATE(self)->AudioDeviceError,
+                        "Failed to read audio. Have you called open() and "
+                        "record()?");
+        return NULL;
+    }
+
+    // Detach the object from any memory it was viewing so that the audio is
+    // read into its own buffer. Nothing else may use the object meanwhile.
     AudioDataObj *audio_data_c = (AudioDataObj *)audio_data;
+    obj_lock_acquire(&audio_data_c->lock);
+    clear_base(audio_data_c);
+    audio_data_c->samples = audio_data_c->audio_buffer;
+    audio_data_c->n_samples = 0;
+    audio_data_c->is_set = false;
 
+    uint64 span = trace_begin();
     int32 n_samples = ad_read(self->ad, audio_data_c->audio_buffer, 2048);
+    trace_end(span, "ad_read");
     if (n_samples < 0) {
-        PyErr_SetString(AudioDeviceError, "Failed to read audio.");
+        obj_lock_release(&audio_data_c->lock);
+        PyErr_SetString(GET_MODULE_STATE(self)->AudioDeviceError,
+                        "Failed to read audio.");
         return NULL;
     }
 
     audio_data_c->n_samples = n_samples;
     audio_data_c->is_set = true;
+    obj_lock_release(&audio_data_c->lock);
+
+    // Return the same object so that calls can be chained.
+    Py_INCREF(audio_data);
     return audio_data;
 }
 
@@ -274,9 +413,10 @@ AudioDeviceObj_dealloc(AudioDeviceObj *self) {
     }
 
     Py_XDECREF(self->name);
+    obj_lock_free(&self->lock);
 
     // Free the Python type object
-    Py_TYPE(self)->tp_free((PyObject*)self);
+    free_module_object((PyObject *)self);
 }
 
 PyObject *
@@ -294,6 +434,11 @@ AudioDeviceObj_new(PyTypeObject *type, PyObject *args, PyObject *kwds) {
 
         self->open = false;
         self->recording = false;
+
+        if (obj_lock_init(&self->lock) < 0) {
+            Py_DECREF(self);
+            return NULL;
+        }
     }
 
     return (PyObject *)self;
@@ -341,30 +486,65 @@ AudioDeviceObj_get_name(AudioDeviceObj *self, void *closure) {
     return self->name;
 }
 
+// Hold the device's lock while its methods run so that threads can't open,
+// close or read from it at the same time.
+OBJ_LOCKED_NOARGS(AudioDeviceObj, AudioDeviceObj_open)
+OBJ_LOCKED_NOARGS(AudioDeviceObj, AudioDeviceObj_record)
+OBJ_LOCKED_NOARGS(AudioDeviceObj, AudioDeviceObj_stop_recording)
+OBJ_LOCKED_NOARGS(AudioDeviceObj, AudioDeviceObj_read_audio)
+OBJ_LOCKED_KWARGS(AudioDeviceObj, AudioDeviceObj_read_into)
+OBJ_LOCKED_KWARGS(AudioDeviceObj, AudioDeviceObj_read_into_ring)
+OBJ_LOCKED_NOARGS(AudioDeviceObj, AudioDeviceObj_close)
+OBJ_LOCKED_GETTER(AudioDeviceObj, AudioDeviceObj_get_name)
+OBJ_LOCKED_SETTER(AudioDeviceObj, AudioDeviceObj_set_name)
+OBJ_LOCKED_INIT(AudioDeviceObj, AudioDeviceObj_init)
+
 PyMethodDef AudioDeviceObj_methods[] = {
     {"open",
-     (PyCFunction)AudioDeviceObj_open, METH_NOARGS,
+     (PyCFunction)AudioDeviceObj_open_locked, METH_NOARGS,
      PyDoc_STR("Open the audio device.")},
     {"record",
-     (PyCFunction)AudioDeviceObj_record, METH_NOARGS,
+     (PyCFunction)AudioDeviceObj_record_locked, METH_NOARGS,
      PyDoc_STR("Start recording from the audio device.")},
     {"stop_recording",
-     (PyCFunction)AudioDeviceObj_stop_recording, METH_NOARGS,
+     (PyCFunction)AudioDeviceObj_stop_recording_locked, METH_NOARGS,
      PyDoc_STR("Stop recording from the audio device.")},
     {"read_audio",
-     (PyCFunction)AudioDeviceObj_read_audio, METH_NOARGS,
+     (PyCFunction)AudioDeviceObj_read_audio_locked, METH_NOARGS,
      PyDoc_STR("Read audio from the audio device if it is open and recording.\n"
                ":rtype: AudioData")},
+    {"read_into",
+     (PyCFunction)AudioDeviceObj_read_into_locked, METH_KEYWORDS | METH_VARARGS,
+     PyDoc_STR("Read audio from the audio device into an existing AudioData "
+               "object, replacing its contents. Reusing one object avoids "
+               "allocating a new buffer for every read.\n"
+               "The object is returned.\n"
+               "\n"
+               "Keyword arguments:\n"
+               "audio_data -- AudioData object to read into.\n"
+               ":rtype: AudioData")},
+    {"read_into_ring",
+     (PyCFunction)AudioDeviceObj_read_into_ring_locked,
+     METH_KEYWORDS | METH_VARARGS,
+     PyDoc_STR("Read audio from the audio device straight into an AudioRing, "
+               "waiting for room if the ring is full. Return the number of "
+               "samples read.\n"
+               "\n"
+               "Keyword arguments:\n"
+               "ring -- AudioRing to write into.\n"
+               "timeout -- seconds to wait for room, or None to wait as long "
+               "as needed (default None).\n"
+               ":rtype: int")},
     {"close",
-     (PyCFunction)AudioDeviceObj_close, METH_NOARGS,
+     (PyCFunction)AudioDeviceObj_close_locked, METH_NOARGS,
      PyDoc_STR("If it's open, close the audio device.")},
     {NULL}  /* Sentinel */
 };
 
 PyGetSetDef AudioDeviceObj_getseters[] = {
     {"name",
-     (getter)AudioDeviceObj_get_name,
-     (setter)AudioDeviceObj_set_name,
+     (getter)AudioDeviceObj_get_name_locked,
+     (setter)AudioDeviceObj_set_name_locked,
      "The name of this audio device.", NULL},
     {NULL}  /* Sentinel */
 };
@@ -407,41 +587,434 @@ PyTypeObject AudioDeviceType = {
     0,                                  /* tp_descr_get */
     0,                                  /* tp_descr_set */
     0,                                  /* tp_dictoffset */
-    (initproc)AudioDeviceObj_init,      /* tp_init */
+    (initproc)AudioDeviceObj_init_locked, /* tp_init */
     0,                                  /* tp_alloc */
     AudioDeviceObj_new,                 /* tp_new */
 };
 
+/* Find the audio data in a memory mapped RIFF WAVE file and check that it is
+ * 16-bit mono PCM. Returns false with a Python exception set on failure.
+ */
+static bool
+AudioFileObj_parse_wav(AudioFileObj *self) {
+    const uint8 *data = (const uint8 *)self->map;
+    size_t size = self->map_size;
+    bool found_format = false;
+
+    if (size < 12 || memcmp(data, "RIFF", 4) != 0 ||
+        memcmp(data + 8, "WAVE", 4) != 0) {
+        PyErr_SetString(GET_MODULE_STATE(self)->AudioFileError,
+                        "file is not a WAVE file.");
+        return false;
+    }
+
+    // Chunk sizes are little-endian and chunks are padded to an even length.
+    size_t offset = 12;
+    while (offset + 8 <= size) {
+        const uint8 *chunk = data + offset;
+        size_t chunk_size = chunk[4] | (chunk[5] << 8) | (chunk[6] << 16) |
+            ((size_t)chunk[7] << 24);
+        const uint8 *body = chunk + 8;
+        size_t available = size - offset - 8;
+
+        if (memcmp(chunk, "fmt ", 4) == 0 && chunk_size >= 16 &&
+            available >= 16) {
+            int format = body[0] | (body[1] << 8);
+            int channels = body[2] | (body[3] << 8);
+            int bits = body[14] | (body[15] << 8);
+            if (format != 1 || channels != 1 || bits != 16) {
+                PyErr_SetString(GET_MODULE_STATE(self)->AudioFileError,
+                                "only 16-bit mono PCM WAVE "
+                                "files are supported.");
+                return false;
+            }
+
+            self->sample_rate = body[4] | (body[5] << 8) | (body[6] << 16) |
+                (body[7] << 24);
+            found_format = true;
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            if (!found_format)
+                break;
+
+            // Tolerate truncated files and oversized chunk lengths.
+            if (chunk_size > available)
+                chunk_size = available;
+            self->samples = (int16 *)body;
+            self->n_samples = chunk_size / sizeof(int16);
+            return true;
+        }
+
+        offset += 8 + chunk_size + (chunk_size & 1);
+    }
+
+    PyErr_SetString(GET_MODULE_STATE(self)->AudioFileError,
+                    "WAVE file has no audio data or format.");
+    return false;
+}
+
+/* Get a view of up to n_samples of audio at the current position and move the
+ * position past it. Returns None at the end of the file.
+ */
+static PyObject *
+AudioFileObj_read_view(AudioFileObj *self, int n_samples) {
+    if (self->map == NULL) {
+        PyErr_SetString(GET_MODULE_STATE(self)->AudioFileError,
+                        "AudioFile is not initialised.");
+        return NULL;
+    }
+
+    // Return None at the end of the file
+    size_t remaining = self->n_samples - self->position;
+    if (remaining == 0) {
+        Py_INCREF(Py_None);
+        return Py_None;
+    }
+
+    if ((size_t)n_samples > remaining)
+        n_samples = (int)remaining;
+
+    PyObject *result = AudioDataObj_new_view(
+        GET_MODULE_STATE(self), (PyObject *)self,
+        self->samples + self->position, n_samples);
+    if (result != NULL)
+        self->position += n_samples;
+    return result;
+}
+
 PyObject *
-initaudio(PyObject *module) {
-    AudioDataType.tp_new = AudioDataObj_new;
-    if (PyType_Ready(&AudioDataType) < 0) {
+AudioFileObj_read_audio(AudioFileObj *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"n_samples", NULL};
+    int n_samples = 2048;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|i", kwlist, &n_samples))
+        return NULL;
+
+    if (n_samples < 1) {
+        PyErr_SetString(PyExc_ValueError, "'n_samples' must be at least 1.");
+        return NULL;
+    }
+
+    return AudioFileObj_read_view(self, n_samples);
+}
+
+PyObject *
+AudioFileObj_seek(AudioFileObj *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"seconds", NULL};
+    double seconds = 0.0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "d", kwlist, &seconds))
+        return NULL;
+
+    if (seconds < 0.0) {
+        PyErr_SetString(PyExc_ValueError, "cannot seek to a negative time.");
+        return NULL;
+    }
+
+    // Seeking past the end leaves the file at the end.
+    double position = seconds * self->sample_rate;
+    if (position > (double)self->n_samples)
+        self->position = self->n_samples;
+    else
+        self->position = (size_t)position;
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+PyObject *
+AudioFileObj_tell(AudioFileObj *self) {
+    return PyFloat_FromDouble((double)self->position / self->sample_rate);
+}
+
+PyObject *
+AudioFileObj_iternext(AudioFileObj *self) {
+    obj_lock_acquire(&self->lock);
+    PyObject *result = AudioFileObj_read_view(self, 2048);
+    obj_lock_release(&self->lock);
+
+    // None signals the end of iteration, which is done by returning NULL
+    // without an exception set.
+    if (result == Py_None) {
+        Py_DECREF(result);
         return NULL;
     }
+    return result;
+}
 
-    Py_INCREF(&AudioDataType);
-    PyModule_AddObject(module, "AudioData", (PyObject *)&AudioDataType);
+PyObject *
+AudioFileObj_get_sample_rate(AudioFileObj *self, void *closure) {
+    return PyLong_FromLong(self->sample_rate);
+}
+
+PyObject *
+AudioFileObj_get_duration(AudioFileObj *self, void *closure) {
+    return PyFloat_FromDouble((double)self->n_samples / self->sample_rate);
+}
+
+void
+AudioFileObj_dealloc(AudioFileObj *self) {
+    // AudioData views keep this object alive, so nothing can still be using
+    // the mapping at this point.
+    if (self->map != NULL)
+        munmap(self->map, self->map_size);
+    obj_lock_free(&self->lock);
+
+    // Free the Python type object
+    free_module_object((PyObject *)self);
+}
+
+PyObject *
+AudioFileObj_new(PyTypeObject *type, PyObject *args, PyObject *kwds) {
+    AudioFileObj *self;
+
+    self = (AudioFileObj *)type->tp_alloc(type, 0);
+    if (self != NULL) {
+        self->map = NULL;
+        self->map_size = 0;
+        self->samples = NULL;
+        self->n_samples = 0;
+        self->position = 0;
+        self->sample_rate = 16000;
+
+        if (obj_lock_init(&self->lock) < 0) {
+            Py_DECREF(self);
+            return NULL;
+        }
+    }
+
+    return (PyObject *)self;
+}
+
+int
+AudioFileObj_init(AudioFileObj *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"path", "raw", "sample_rate", NULL};
+    const char *path = NULL;
+    PyObject *raw = Py_False;
+    int sample_rate = -1; // not given
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|Oi", kwlist, &path, &raw,
+                                     &sample_rate))
+        return -1;
+
+    if (!PyBool_Check(raw)) {
+        PyErr_SetString(PyExc_TypeError, "'raw' parameter must be a boolean "
+                        "value.");
+        return -1;
+    }
+
+    if (sample_rate != -1 && sample_rate < 1) {
+        PyErr_SetString(PyExc_ValueError, "'sample_rate' must be positive.");
+        return -1;
+    }
+
+    if (self->map != NULL) {
+        PyErr_SetString(GET_MODULE_STATE(self)->AudioFileError,
+                        "AudioFile is already initialised.");
+        return -1;
+    }
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        PyErr_SetFromErrnoWithFilename(PyExc_IOError, path);
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        PyErr_SetFromErrnoWithFilename(PyExc_IOError, path);
+        close(fd);
+        return -1;
+    }
+
+    if (st.st_size == 0) {
+        PyErr_Format(GET_MODULE_STATE(self)->AudioFileError,
+                     "'%s' is empty.", path);
+        close(fd);
+        return -1;
+    }
+
+    // The mapping is shared, so processes decoding the same file share its
+    // pages through the page cache. The descriptor isn't needed afterwards.
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        PyErr_SetFromErrnoWithFilename(PyExc_IOError, path);
+        return -1;
+    }
+
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+    self->map = map;
+    self->map_size = st.st_size;
+    self->sample_rate = sample_rate != -1 ? sample_rate : 16000;
+
+    if (raw == Py_True) {
+        self->samples = (int16 *)map;
+        self->n_samples = st.st_size / sizeof(int16);
+    } else if (!AudioFileObj_parse_wav(self)) {
+        munmap(self->map, self->map_size);
+        self->map = NULL;
+        return -1;
+    } else if (sample_rate != -1 && sample_rate != self->sample_rate) {
+        // The header's rate is the one the audio was recorded at.
+        PyErr_Format(PyExc_ValueError, "'sample_rate' is %d but '%s' was "
+                     "recorded at %d Hz.", sample_rate, path,
+                     (int)self->sample_rate);
+        munmap(self->map, self->map_size);
+        self->map = NULL;
+        return -1;
+    }
+
+    self->position = 0;
+    return 0;
+}
+
+// Hold the file's lock while its methods use the read position so that each
+// block of audio is read by only one thread.
+OBJ_LOCKED_KWARGS(AudioFileObj, AudioFileObj_read_audio)
+OBJ_LOCKED_KWARGS(AudioFileObj, AudioFileObj_seek)
+OBJ_LOCKED_NOARGS(AudioFileObj, AudioFileObj_tell)
+OBJ_LOCKED_INIT(AudioFileObj, AudioFileObj_init)
+
+PyMethodDef AudioFileObj_methods[] = {
+    {"read_audio",
+     (PyCFunction)AudioFileObj_read_audio_locked, METH_KEYWORDS | METH_VARARGS,
+     PyDoc_STR("Read audio from the current position in the file, or return None "
+               "at the end of the file.\n"
+               "The AudioData object references the file's memory mapping "
+               "instead of copying the audio.\n\n"
+               "Keyword arguments:\n"
+               "n_samples -- maximum number of samples to read (default 2048)\n"
+               ":rtype: AudioData")},
+    {"seek",
+     (PyCFunction)AudioFileObj_seek_locked, METH_KEYWORDS | METH_VARARGS,
+     PyDoc_STR("Move the read position to a time in the file.\n\n"
+               "Keyword arguments:\n"
+               "seconds -- time from the start of the audio in seconds.\n")},
+    {"tell",
+     (PyCFunction)AudioFileObj_tell_locked, METH_NOARGS,
+     PyDoc_STR("Return the read position in seconds.")},
+    {NULL}  /* Sentinel */
+};
+
+PyGetSetDef AudioFileObj_getseters[] = {
+    {"sample_rate",
+     (getter)AudioFileObj_get_sample_rate, NULL,
+     "The sample rate of the audio.", NULL},
+    {"duration",
+     (getter)AudioFileObj_get_duration, NULL,
+     "The duration of the audio in seconds.", NULL},
+    {NULL}  /* Sentinel */
+};
+
+PyTypeObject AudioFileType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "sphinxwrapper.AudioFile",          /* tp_name */
+    sizeof(AudioFileObj),               /* tp_basicsize */
+    0,                                  /* tp_itemsize */
+    (destructor)AudioFileObj_dealloc,   /* tp_dealloc */
+    0,                                  /* tp_print */
+    0,                                  /* tp_getattr */
+    0,                                  /* tp_setattr */
+    0,                                  /* tp_compare */
+    0,                                  /* tp_repr */
+    0,                                  /* tp_as_number */
+    0,                                  /* tp_as_sequence */
+    0,                                  /* tp_as_mapping */
+    0,                                  /* tp_hash */
+    0,                                  /* tp_call */
+    0,                                  /* tp_str */
+    0,                                  /* tp_getattro */
+    0,                                  /* tp_setattro */
+    0,                                  /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT |
+    Py_TPFLAGS_BASETYPE,                /* tp_flags */
+    "Audio file object for reading "
+    "memory mapped 16-bit mono WAVE "
+    "or raw audio files.",              /* tp_doc */
+    0,                                  /* tp_traverse */
+    0,                                  /* tp_clear */
+    0,                                  /* tp_richcompare */
+    0,                                  /* tp_weaklistoffset */
+    PyObject_SelfIter,                  /* tp_iter */
+    (iternextfunc)AudioFileObj_iternext, /* tp_iternext */
+    AudioFileObj_methods,               /* tp_methods */
+    0,                                  /* tp_members */
+    AudioFileObj_getseters,             /* tp_getset */
+    0,                                  /* tp_base */
+    0,                                  /* tp_dict */
+    0,                                  /* tp_descr_get */
+    0,                                  /* tp_descr_set */
+    0,                                  /* tp_dictoffset */
+    (initproc)AudioFileObj_init_locked, /* tp_init */
+    0,                                  /* tp_alloc */
+    AudioFileObj_new,                   /* tp_new */
+};
+
+int
+get_audio_samples(module_state *state, PyObject *audio, Py_buffer *view,
+                  int16 const **samples, size_t *n_samples) {
+    view->obj = NULL;
+    if (PyObject_TypeCheck(audio, state->AudioFileType)) {
+        AudioFileObj *audio_file = (AudioFileObj *)audio;
+        if (audio_file->map == NULL) {
+            PyErr_SetString(state->AudioFileError, "AudioFile is not "
+                            "initialised.");
+            return -1;
+        }
+        *samples = audio_file->samples;
+        *n_samples = audio_file->n_samples;
+    } else if (PyObject_TypeCheck(audio, state->AudioDataType)) {
+        AudioDataObj *audio_data = (AudioDataObj *)audio;
+        if (!audio_data->is_set) {
+            PyErr_SetString(state->AudioDataError, "AudioData object is not "
+                            "set up properly. Try using the result from "
+                            "AudioDevice.read_audio()");
+            return -1;
+        }
+        *samples = audio_data->samples;
+        *n_samples = audio_data->n_samples;
+    } else {
+        if (PyObject_GetBuffer(audio, view, PyBUF_SIMPLE) < 0)
+            return -1;
+        *samples = (int16 const *)view->buf;
+        *n_samples = view->len / sizeof(int16);
+    }
+    return 0;
+}
+
+PyObject *
+initaudio(PyObject *module) {
+    module_state *state = get_module_state(module);
+    AudioDataType.tp_new = AudioDataObj_new;
+    state->AudioDataType = add_module_type(module, &AudioDataType);
+    if (state->AudioDataType == NULL)
+        return NULL;
 
     // Define a new Python exception for when an invalid AudioData object is used.
-    AudioDataError = PyErr_NewException("sphinxwrapper.AudioDataError", NULL, NULL);
-    Py_INCREF(AudioDataError);
-    PyModule_AddObject(module, "AudioDataError", AudioDataError);
+    state->AudioDataError = add_module_exception(module, "AudioDataError");
+    if (state->AudioDataError == NULL)
+        return NULL;
 
     // Set up the AudioDevice type using a non-generic new method
     AudioDeviceType.tp_new = AudioDeviceObj_new;
-    if (PyType_Ready(&AudioDeviceType) < 0) {
+    state->AudioDeviceType = add_module_type(module, &AudioDeviceType);
+    if (state->AudioDeviceType == NULL)
         return NULL;
-    }
-
-    Py_INCREF(&AudioDeviceType);
-    PyModule_AddObject(module, "AudioDevice", (PyObject *)&AudioDeviceType);
 
     // Define another new exception for failing to open the audio device or read
     // audio from it
-    AudioDeviceError = PyErr_NewException("sphinxwrapper.AudioDeviceError", NULL, NULL);
-    Py_INCREF(AudioDeviceError);
-    PyModule_AddObject(module, "AudioDeviceError", AudioDeviceError);
+    state->AudioDeviceError = add_module_exception(module, "AudioDeviceError");
+    if (state->AudioDeviceError == NULL)
+        return NULL;
+
+    // Set up the AudioFile type and its exception for unusable files
+    state->AudioFileType = add_module_type(module, &AudioFileType);
+    if (state->AudioFileType == NULL)
+        return NULL;
+
+    state->AudioFileError = add_module_exception(module, "AudioFileError");
+    if (state->AudioFileError == NULL)
+        return NULL;
 
     return module;
 }
-
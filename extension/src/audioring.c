@@ -0,0 +1,425 @@
+/*
+ * audioring.c
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <sphinxbase/ckd_alloc.h>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+#include "audioring.h"
+
+#define AUDIO_RING_MAGIC "SWRING1"
+
+/* Header at the start of the shared memory, followed by the samples.
+ *
+ * Positions count samples since the ring was created and wrap around, so the
+ * difference between them is the amount of audio in the ring. Each side's
+ * fields are on their own cache line so that the processes don't contend for
+ * one line on every read and write.
+ */
+struct audio_ring_header_s {
+    char magic[8];
+    uint32 capacity;
+    uint32 closed;
+    struct {
+        uint32 pos; // position of the next sample to write
+        uint32 seq; // futex word bumped when audio is committed
+        uint32 waiters; // writers waiting for the reader's seq to change
+    } __attribute__((aligned(64))) writer;
+    struct {
+        uint32 pos; // position of the next sample to release
+        uint32 seq; // futex word bumped when audio is released
+        uint32 waiters; // readers waiting for the writer's seq to change
+    } __attribute__((aligned(64))) reader;
+};
+
+#ifdef __linux__
+static void
+futex_wait(uint32 *word, uint32 value, const struct timespec *timeout) {
+    // Not FUTEX_PRIVATE_FLAG, as the word is shared between processes.
+    syscall(SYS_futex, word, FUTEX_WAIT, value, timeout, NULL, 0);
+}
+
+static void
+futex_wake(uint32 *word) {
+    syscall(SYS_futex, word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+#else
+// Without futexes, waiting processes poll the word every millisecond.
+static void
+futex_wait(uint32 *word, uint32 value, const struct timespec *timeout) {
+    struct timespec poll = {0, 1000000};
+    if (timeout != NULL && timeout->tv_sec == 0 &&
+        timeout->tv_nsec < poll.tv_nsec)
+        poll = *timeout;
+    nanosleep(&poll, NULL);
+}
+
+static void
+futex_wake(uint32 *word) {
+}
+#endif
+
+/* Set the deadline for a timeout in milliseconds.
+ * @return deadline, or NULL to wait forever
+ */
+static const struct timespec *
+get_deadline(int timeout_ms, struct timespec *deadline) {
+    if (timeout_ms < 0)
+        return NULL;
+
+    clock_gettime(CLOCK_MONOTONIC, deadline);
+    deadline->tv_sec += timeout_ms / 1000;
+    deadline->tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (deadline->tv_nsec >= 1000000000L) {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000L;
+    }
+    return deadline;
+}
+
+/* Wait for a futex word to change from seq, counting this process as a waiter
+ * so that it is woken.
+ * @return 0 if the deadline had already passed, otherwise 1
+ */
+static int
+ring_wait(uint32 *seq_word, uint32 *waiters, uint32 seq,
+          const struct timespec *deadline) {
+    struct timespec remaining, *timeout = NULL;
+    if (deadline != NULL) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        remaining.tv_sec = deadline->tv_sec - now.tv_sec;
+        remaining.tv_nsec = deadline->tv_nsec - now.tv_nsec;
+        if (remaining.tv_nsec < 0) {
+            remaining.tv_sec--;
+            remaining.tv_nsec += 1000000000L;
+        }
+        if (remaining.tv_sec < 0)
+            return 0;
+        timeout = &remaining;
+    }
+
+    // If the word changes after seq was read, the wait returns immediately.
+    __atomic_add_fetch(waiters, 1, __ATOMIC_SEQ_CST);
+    futex_wait(seq_word, seq, timeout);
+    __atomic_sub_fetch(waiters, 1, __ATOMIC_SEQ_CST);
+    return 1;
+}
+
+/* Bump a futex word and wake the other side if it's waiting on it. */
+static void
+ring_signal(uint32 *seq_word, uint32 *waiters) {
+    __atomic_add_fetch(seq_word, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(waiters, __ATOMIC_SEQ_CST) > 0)
+        futex_wake(seq_word);
+}
+
+/* Get the shared memory object name for a ring name, which must start with a
+ * slash.
+ */
+static char *
+get_shm_name(const char *name) {
+    if (name[0] == '/')
+        return ckd_salloc(name);
+
+    size_t length = strlen(name);
+    char *shm_name = ckd_calloc(length + 2, 1);
+    shm_name[0] = '/';
+    memcpy(shm_name + 1, name, length);
+    return shm_name;
+}
+
+static audio_ring_t *
+map_ring(int fd, size_t map_size, char *shm_name) {
+    void *map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                     0);
+    if (map == MAP_FAILED)
+        return NULL;
+
+    audio_ring_t *ring = ckd_calloc(1, sizeof(*ring));
+    ring->header = map;
+    ring->samples = (int16 *)(ring->header + 1);
+    ring->map_size = map_size;
+    ring->name = shm_name;
+    return ring;
+}
+
+audio_ring_t *
+audio_ring_create(const char *name, uint32 capacity) {
+    // Positions wrap around, so the capacity must divide 2^32.
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0 ||
+        capacity > (1u << 30)) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    char *shm_name = get_shm_name(name);
+    int fd = shm_open(shm_name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        ckd_free(shm_name);
+        return NULL;
+    }
+
+    size_t map_size = sizeof(audio_ring_header_t) + capacity * sizeof(int16);
+    audio_ring_t *ring = NULL;
+    if (ftruncate(fd, map_size) == 0)
+        ring = map_ring(fd, map_size, shm_name);
+    int saved_errno = errno;
+    close(fd);
+    if (ring == NULL) {
+        shm_unlink(shm_name);
+        ckd_free(shm_name);
+        errno = saved_errno;
+        return NULL;
+    }
+
+    // The memory starts zeroed. The magic is stored last so that processes
+    // opening the ring never see a partly initialised header.
+    ring->header->capacity = capacity;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(ring->header->magic, AUDIO_RING_MAGIC, sizeof(AUDIO_RING_MAGIC));
+    ring->creator = getpid();
+    return ring;
+}
+
+audio_ring_t *
+audio_ring_open(const char *name) {
+    char *shm_name = get_shm_name(name);
+    int fd = shm_open(shm_name, O_RDWR, 0);
+    if (fd < 0) {
+        ckd_free(shm_name);
+        return NULL;
+    }
+
+    struct stat st;
+    audio_ring_t *ring = NULL;
+    if (fstat(fd, &st) == 0) {
+        if ((size_t)st.st_size < sizeof(audio_ring_header_t))
+            errno = EINVAL;
+        else
+            ring = map_ring(fd, st.st_size, shm_name);
+    }
+    int saved_errno = errno;
+    close(fd);
+    if (ring == NULL) {
+        ckd_free(shm_name);
+        errno = saved_errno;
+        return NULL;
+    }
+
+    audio_ring_header_t *header = ring->header;
+    if (memcmp(header->magic, AUDIO_RING_MAGIC, sizeof(AUDIO_RING_MAGIC)) != 0 ||
+        ring->map_size != sizeof(*header) +
+        (size_t)header->capacity * sizeof(int16)) {
+        audio_ring_free(ring);
+        errno = EINVAL;
+        return NULL;
+    }
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return ring;
+}
+
+void
+audio_ring_free(audio_ring_t *ring) {
+    if (ring == NULL)
+        return;
+
+    // Processes which have the ring open keep their mapping. Children forked
+    // from the creator don't remove the name.
+    munmap(ring->header, ring->map_size);
+    if (ring->creator != 0 && ring->creator == getpid())
+        shm_unlink(ring->name);
+    ckd_free(ring->name);
+    ckd_free(ring);
+}
+
+int32
+audio_ring_reserve(audio_ring_t *ring, int32 max, int16 **samples,
+                   int timeout_ms) {
+    audio_ring_header_t *header = ring->header;
+    uint32 capacity = header->capacity;
+    struct timespec deadline_buf;
+    const struct timespec *deadline = get_deadline(timeout_ms, &deadline_buf);
+
+    uint32 write_pos = header->writer.pos;
+    uint32 n_free;
+    for (;;) {
+        uint32 seq = __atomic_load_n(&header->reader.seq, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&header->closed, __ATOMIC_ACQUIRE))
+            return -1;
+
+        uint32 read_pos = __atomic_load_n(&header->reader.pos,
+                                          __ATOMIC_ACQUIRE);
+        n_free = capacity - (write_pos - read_pos);
+        if (n_free > 0)
+            break;
+
+        // The ring is full, so wait for the reader to release audio.
+        if (timeout_ms == 0 || !ring_wait(&header->reader.seq,
+                                          &header->writer.waiters, seq,
+                                          deadline))
+            return 0;
+    }
+
+    // Only return space up to the end of the buffer.
+    uint32 index = write_pos & (capacity - 1);
+    if (n_free > capacity - index)
+        n_free = capacity - index;
+    if (max >= 0 && n_free > (uint32)max)
+        n_free = max;
+
+    *samples = ring->samples + index;
+    return n_free;
+}
+
+void
+audio_ring_commit(audio_ring_t *ring, int32 n) {
+    audio_ring_header_t *header = ring->header;
+    __atomic_store_n(&header->writer.pos, header->writer.pos + n,
+                     __ATOMIC_RELEASE);
+    ring_signal(&header->writer.seq, &header->reader.waiters);
+}
+
+int32
+audio_ring_write(audio_ring_t *ring, int16 const *samples, size_t n_samples,
+                 int timeout_ms) {
+    struct timespec deadline_buf;
+    const struct timespec *deadline = get_deadline(timeout_ms, &deadline_buf);
+
+    size_t n_written = 0;
+    while (n_written < n_samples) {
+        // Wait for what remains of the timeout.
+        int remaining_ms = -1;
+        if (deadline != NULL) {
+            struct timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            remaining_ms = (deadline->tv_sec - now.tv_sec) * 1000 +
+                (deadline->tv_nsec - now.tv_nsec) / 1000000L;
+            if (remaining_ms < 0)
+                remaining_ms = 0;
+        }
+
+        size_t n_left = n_samples - n_written;
+        int16 *space;
+        int32 n_space = audio_ring_reserve(ring, n_left > INT32_MAX ?
+                                           INT32_MAX : (int32)n_left,
+                                           &space, remaining_ms);
+        if (n_space < 0)
+            return n_written > 0 ? (int32)n_written : -1;
+        if (n_space == 0)
+            break;
+
+        memcpy(space, samples + n_written, n_space * sizeof(int16));
+        audio_ring_commit(ring, n_space);
+        n_written += n_space;
+    }
+    return n_written;
+}
+
+int32
+audio_ring_acquire(audio_ring_t *ring, int32 max, int16 const **samples,
+                   int timeout_ms) {
+    audio_ring_header_t *header = ring->header;
+    uint32 capacity = header->capacity;
+    struct timespec deadline_buf;
+    const struct timespec *deadline = get_deadline(timeout_ms, &deadline_buf);
+
+    uint32 read_pos = header->reader.pos;
+    uint32 n_available;
+    for (;;) {
+        uint32 seq = __atomic_load_n(&header->writer.seq, __ATOMIC_SEQ_CST);
+        uint32 closed = __atomic_load_n(&header->closed, __ATOMIC_ACQUIRE);
+
+        uint32 write_pos = __atomic_load_n(&header->writer.pos,
+                                           __ATOMIC_ACQUIRE);
+        n_available = write_pos - read_pos;
+        if (n_available > 0)
+            break;
+        if (closed)
+            return -1;
+
+        // The ring is empty, so wait for the writer to commit audio.
+        if (timeout_ms == 0 || !ring_wait(&header->writer.seq,
+                                          &header->reader.waiters, seq,
+                                          deadline))
+            return 0;
+    }
+
+    uint32 index = read_pos & (capacity - 1);
+    if (n_available > capacity - index)
+        n_available = capacity - index;
+    if (max >= 0 && n_available > (uint32)max)
+        n_available = max;
+
+    *samples = ring->samples + index;
+    return n_available;
+}
+
+void
+audio_ring_release(audio_ring_t *ring, int32 n) {
+    audio_ring_header_t *header = ring->header;
+    __atomic_store_n(&header->reader.pos, header->reader.pos + n,
+                     __ATOMIC_RELEASE);
+    ring_signal(&header->reader.seq, &header->writer.waiters);
+}
+
+void
+audio_ring_close(audio_ring_t *ring) {
+    audio_ring_header_t *header = ring->header;
+    __atomic_store_n(&header->closed, 1, __ATOMIC_RELEASE);
+    ring_signal(&header->writer.seq, &header->reader.waiters);
+    ring_signal(&header->reader.seq, &header->writer.waiters);
+}
+
+int
+audio_ring_closed(audio_ring_t *ring) {
+    return __atomic_load_n(&ring->header->closed, __ATOMIC_ACQUIRE) != 0;
+}
+
+uint32
+audio_ring_capacity(audio_ring_t *ring) {
+    return ring->header->capacity;
+}
+
+uint32
+audio_ring_available(audio_ring_t *ring) {
+    audio_ring_header_t *header = ring->header;
+    return __atomic_load_n(&header->writer.pos, __ATOMIC_ACQUIRE) -
+        __atomic_load_n(&header->reader.pos, __ATOMIC_ACQUIRE);
+}
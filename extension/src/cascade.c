@@ -0,0 +1,251 @@
+/*
+ * cascade.c
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#include <string.h>
+#include <sphinxbase/ckd_alloc.h>
+
+#include "cascade.h"
+#include "trace.h"
+
+// Seconds of audio kept while waiting for the keyphrase so that speech
+// following it can be decoded again with the command search.
+#define HISTORY_SECONDS 2
+
+struct cascade_s {
+    char *wake_search;
+    char *command_search;
+    char *keyphrase; // last keyphrase detected
+    size_t timeout_samples;
+    size_t frame_shift; // samples per frame
+    bool listening; // whether the command search is in use
+    bool fallback_pending; // switch back once the hypothesis has been read
+    size_t listened; // samples decoded with the command search
+
+    // Ring buffer of the most recent audio
+    int16 *history;
+    size_t history_size;
+    size_t history_start;
+    size_t history_len;
+};
+
+static void
+history_append(cascade_t *cascade, int16 const *buf, size_t n_samples) {
+    size_t size = cascade->history_size;
+    if (n_samples > size) {
+        buf += n_samples - size;
+        n_samples = size;
+    }
+
+    for (size_t i = 0; i < n_samples; i++) {
+        size_t end = (cascade->history_start + cascade->history_len) % size;
+        cascade->history[end] = buf[i];
+        if (cascade->history_len < size)
+            cascade->history_len++;
+        else
+            cascade->history_start = (cascade->history_start + 1) % size;
+    }
+}
+
+/* Copy the last n_samples samples of the history into buf. */
+static void
+history_tail(cascade_t *cascade, int16 *buf, size_t n_samples) {
+    size_t size = cascade->history_size;
+    size_t start = cascade->history_start + cascade->history_len - n_samples;
+    for (size_t i = 0; i < n_samples; i++)
+        buf[i] = cascade->history[(start + i) % size];
+}
+
+/* Return the number of samples processed after the detected keyphrase, given
+ * the last chunk of audio processed, the decoder's frame count before it and
+ * whether speech was already in progress.
+ *
+ * With -remove_silence on, the search only counts the frames the voice
+ * activity detector let through, so frame counts don't map directly onto the
+ * audio. Silence removed from the chunk is taken to be at its end if speech
+ * was in progress when it started, and at its start otherwise. Frames from
+ * earlier chunks are taken to be speech, as they were while the keyphrase was
+ * being spoken.
+ */
+static size_t
+samples_after_keyphrase(cascade_t *cascade, ps_decoder_t *ps, size_t n_samples,
+                        int frames_before, bool speech_before) {
+    int end_frame = -1;
+    for (ps_seg_t *seg = ps_seg_iter(ps); seg != NULL; seg = ps_seg_next(seg)) {
+        int sf, ef;
+        ps_seg_frames(seg, &sf, &ef);
+        end_frame = ef;
+    }
+    if (end_frame < 0 || cascade->frame_shift == 0)
+        return 0;
+
+    size_t n_after;
+    int chunk_frames = ps_get_n_frames(ps) - frames_before;
+    int k = end_frame + 1 - frames_before; // chunk frames up to the keyphrase
+    if (k <= 0) {
+        // The keyphrase ended before the chunk.
+        n_after = n_samples + (size_t)-k * cascade->frame_shift;
+    } else if (k >= chunk_frames) {
+        n_after = 0;
+    } else if (speech_before) {
+        size_t offset = (size_t)k * cascade->frame_shift;
+        n_after = offset < n_samples ? n_samples - offset : 0;
+    } else {
+        n_after = (size_t)(chunk_frames - k) * cascade->frame_shift;
+    }
+
+    return n_after < cascade->history_len ? n_after : cascade->history_len;
+}
+
+static void
+fall_back(cascade_t *cascade, ps_decoder_t *ps) {
+    ps_set_search(ps, cascade->wake_search);
+    cascade->listening = false;
+    cascade->fallback_pending = false;
+    cascade->history_len = 0;
+}
+
+cascade_t *
+cascade_init(const char *wake_search, const char *command_search,
+             float32 timeout, float32 samprate, int32 frate) {
+    cascade_t *cascade = ckd_calloc(1, sizeof(*cascade));
+    cascade->wake_search = ckd_salloc(wake_search);
+    cascade->command_search = ckd_salloc(command_search);
+    cascade->timeout_samples = (size_t)(timeout * samprate);
+    cascade->frame_shift = frate > 0 ? (size_t)(samprate / frate) : 0;
+    cascade->history_size = (size_t)(samprate * HISTORY_SECONDS);
+    if (cascade->history_size == 0)
+        cascade->history_size = 1;
+    cascade->history = ckd_calloc(cascade->history_size, sizeof(int16));
+    return cascade;
+}
+
+utterance_event_t
+cascade_process_raw(cascade_t *cascade, ps_decoder_t *ps,
+                    utterance_state_t *state, int16 const *buf,
+                    size_t n_samples, const char **keyphrase) {
+    *keyphrase = NULL;
+    if (cascade->fallback_pending)
+        fall_back(cascade, ps);
+
+    if (cascade->listening) {
+        utterance_event_t event = utterance_process_raw(ps, state, buf,
+                                                        n_samples);
+        cascade->listened += n_samples;
+
+        // Give up on the command once the timeout passes, reporting what was
+        // said if speech had started.
+        if (event != UTT_EVENT_HYPOTHESIS &&
+            cascade->listened >= cascade->timeout_samples) {
+            bool started = *state == STARTED;
+            utterance_end(ps, state);
+            if (started)
+                event = UTT_EVENT_HYPOTHESIS;
+            else
+                event = UTT_EVENT_NONE;
+        }
+
+        // Keep the command search until the hypothesis has been read.
+        if (*state == ENDED) {
+            if (event == UTT_EVENT_HYPOTHESIS)
+                cascade->fallback_pending = true;
+            else
+                fall_back(cascade, ps);
+        }
+        return event;
+    }
+
+    // Waiting for the keyphrase. Events from the keyphrase search aren't
+    // reported; the keyphrase search has a hypothesis as soon as it spots
+    // the keyphrase.
+    history_append(cascade, buf, n_samples);
+    int frames_before = *state == ENDED ? 0 : ps_get_n_frames(ps);
+    bool speech_before = *state == STARTED;
+    utterance_process_raw(ps, state, buf, n_samples);
+    uint64 span = trace_begin();
+    const char *hyp = ps_get_hyp(ps, NULL);
+    trace_end(span, "ps_get_hyp");
+    if (hyp == NULL)
+        return UTT_EVENT_NONE;
+
+    ckd_free(cascade->keyphrase);
+    cascade->keyphrase = ckd_salloc(hyp);
+    *keyphrase = cascade->keyphrase;
+
+    // Switch to the command search and decode the audio after the keyphrase
+    // again with it so that the start of the command isn't lost.
+    size_t n_tail = samples_after_keyphrase(cascade, ps, n_samples,
+                                            frames_before, speech_before);
+    utterance_end(ps, state);
+    if (ps_set_search(ps, cascade->command_search) < 0) {
+        fall_back(cascade, ps);
+        return UTT_EVENT_NONE;
+    }
+
+    cascade->listening = true;
+    cascade->listened = 0;
+    int16 *tail = ckd_calloc(n_tail + 1, sizeof(int16));
+    history_tail(cascade, tail, n_tail);
+    cascade->history_len = 0;
+    utterance_event_t event = utterance_process_raw(ps, state, tail, n_tail);
+    ckd_free(tail);
+    return event;
+}
+
+bool
+cascade_end(cascade_t *cascade, ps_decoder_t *ps, utterance_state_t *state) {
+    bool ended = utterance_end(ps, state);
+    if (cascade->listening)
+        fall_back(cascade, ps);
+    return ended;
+}
+
+const char *
+cascade_wake_search(cascade_t *cascade) {
+    return cascade->wake_search;
+}
+
+const char *
+cascade_command_search(cascade_t *cascade) {
+    return cascade->command_search;
+}
+
+bool
+cascade_listening(cascade_t *cascade) {
+    return cascade->listening && !cascade->fallback_pending;
+}
+
+void
+cascade_free(cascade_t *cascade) {
+    if (cascade == NULL)
+        return;
+    ckd_free(cascade->wake_search);
+    ckd_free(cascade->command_search);
+    ckd_free(cascade->keyphrase);
+    ckd_free(cascade->history);
+    ckd_free(cascade);
+}
@@ -0,0 +1,547 @@
+/*
+ * daemon.c
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+/*
+ * Standalone decoding daemon.
+ *
+ * The daemon loads the decoder configuration once and listens on a Unix domain
+ * socket. Each client connection is decoded as a separate stream by a pool of
+ * native worker threads (see streampool.h); Python isn't involved at all.
+ *
+ * Every message in either direction is a frame that starts with an eight byte
+ * header made up of two unsigned 32-bit integers in network byte order: the
+ * frame type and the length of the payload that follows in bytes.
+ *
+ * Clients send FRAME_AUDIO frames containing raw 16-bit mono samples in host
+ * byte order at the decoder's sample rate. The daemon sends FRAME_SPEECH_START
+ * frames, which have no payload, and FRAME_HYPOTHESIS frames containing the
+ * UTF-8 hypothesis, which is empty if there wasn't one. FRAME_ERROR frames
+ * containing a UTF-8 message are sent if the client's decoder couldn't be set
+ * up, after which its audio is dropped. When a client shuts down its side of
+ * the connection, any utterance in progress is ended, its hypothesis is sent
+ * and then the daemon closes the connection.
+ *
+ * Frames are queued for each client and sent by the main loop, so a client
+ * that stops reading doesn't hold up any other. The daemon stops reading from
+ * a client while it has too much audio waiting to be decoded or too many
+ * frames it hasn't read.
+ *
+ * Usage:
+ *   sphinxwrapper-daemon [-socket PATH] [-workers N] [decoder arguments...]
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sphinxbase/ckd_alloc.h>
+#include <sphinxbase/err.h>
+
+#include "psconfig.h"
+#include "streampool.h"
+
+#define DAEMON_DEFAULT_SOCKET "/tmp/sphinxwrapper.sock"
+#define DAEMON_DEFAULT_WORKERS 4
+#define DAEMON_HEADER_SIZE 8
+#define DAEMON_MAX_PAYLOAD (1 << 20)
+#define DAEMON_READ_SIZE 65536
+#define DAEMON_POLL_TIMEOUT_MS 500
+#define DAEMON_PAUSED_POLL_MS 10
+// Reading from a client stops while it is over either limit: about ten
+// seconds of 16 kHz audio waiting to be decoded, or a megabyte of frames it
+// hasn't read.
+#define DAEMON_MAX_PENDING_SAMPLES (16000 * 10)
+#define DAEMON_MAX_OUTPUT (1 << 20)
+
+enum {
+    FRAME_AUDIO = 1,        // client -> daemon
+    FRAME_SPEECH_START = 2, // daemon -> client
+    FRAME_HYPOTHESIS = 3,   // daemon -> client
+    FRAME_ERROR = 4         // daemon -> client
+};
+
+typedef struct client_s {
+    struct client_s *next;
+    int64 id; // stream ID used for the client's audio
+    int fd; // non-blocking
+    bool reading; // still being polled for audio
+    bool has_stream; // audio has been pushed to the stream pool
+    uint8 *buf; // audio frames read so far
+    size_t buf_len;
+    size_t buf_size;
+
+    // Guards the fields below, which worker threads change as well
+    pthread_mutex_t lock;
+    uint8 *out; // frames waiting to be sent by the main loop
+    size_t out_len;
+    size_t out_size;
+    bool write_failed; // the client stopped accepting frames
+    bool closed; // the stream's final frame has been queued
+} client_t;
+
+static volatile sig_atomic_t stopping = 0;
+
+// Guards the clients list, which worker threads use to look up clients.
+static pthread_mutex_t clients_lock = PTHREAD_MUTEX_INITIALIZER;
+static client_t *clients = NULL;
+
+// Written to by worker threads to wake the main loop when frames are queued.
+static int wake_fds[2] = {-1, -1};
+
+static void
+daemon_stop(int signum) {
+    stopping = 1;
+}
+
+static void
+daemon_wake(void) {
+    char byte = 0;
+    ssize_t n = write(wake_fds[1], &byte, 1);
+    (void)n; // the pipe being full already means the loop will wake
+}
+
+static client_t *
+daemon_find_client(int64 id) {
+    pthread_mutex_lock(&clients_lock);
+    client_t *client = clients;
+    while (client != NULL && client->id != id)
+        client = client->next;
+    pthread_mutex_unlock(&clients_lock);
+    return client;
+}
+
+/* Free a client. Only the main loop frees clients, once their stream has been
+ * closed, so worker threads never see a freed client.
+ */
+static void
+daemon_free_client(client_t *client) {
+    pthread_mutex_lock(&clients_lock);
+    client_t **link = &clients;
+    while (*link != client)
+        link = &(*link)->next;
+    *link = client->next;
+    pthread_mutex_unlock(&clients_lock);
+
+    close(client->fd);
+    pthread_mutex_destroy(&client->lock);
+    ckd_free(client->buf);
+    ckd_free(client->out);
+    ckd_free(client);
+}
+
+/* Queue a frame to be sent to a client by the main loop. Worker threads never
+ * write to sockets themselves, so a client that stops reading can't hold up
+ * the decoding of other streams.
+ */
+static void
+daemon_queue_frame(client_t *client, uint32 type, char const *payload,
+                   size_t length) {
+    uint32 header[2] = {htonl(type), htonl((uint32)length)};
+
+    pthread_mutex_lock(&client->lock);
+    if (!client->write_failed) {
+        size_t needed = client->out_len + sizeof(header) + length;
+        if (needed > client->out_size) {
+            client->out_size = needed * 2;
+            client->out = ckd_realloc(client->out, client->out_size);
+        }
+        memcpy(client->out + client->out_len, header, sizeof(header));
+        if (length > 0)
+            memcpy(client->out + client->out_len + sizeof(header), payload,
+                   length);
+        client->out_len = needed;
+    }
+    pthread_mutex_unlock(&client->lock);
+    daemon_wake();
+}
+
+/* Send as much queued output to a client as its socket will take. */
+static void
+daemon_flush_client(client_t *client) {
+    pthread_mutex_lock(&client->lock);
+    size_t sent = 0;
+    while (sent < client->out_len && !client->write_failed) {
+        ssize_t n = send(client->fd, client->out + sent,
+                         client->out_len - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        if (n <= 0) {
+            // The client has gone away; its stream will be closed when the
+            // main loop notices.
+            client->write_failed = true;
+            sent = client->out_len;
+            break;
+        }
+        sent += n;
+    }
+    memmove(client->out, client->out + sent, client->out_len - sent);
+    client->out_len -= sent;
+    pthread_mutex_unlock(&client->lock);
+}
+
+/* Stream pool callbacks, called from worker threads. */
+static void
+daemon_stream_event(void *user_data, int64 stream_id, utterance_event_t event,
+                    char const *hyp) {
+    client_t *client = daemon_find_client(stream_id);
+    if (client == NULL)
+        return;
+
+    if (event == UTT_EVENT_SPEECH_START)
+        daemon_queue_frame(client, FRAME_SPEECH_START, NULL, 0);
+    else if (event == UTT_EVENT_HYPOTHESIS)
+        daemon_queue_frame(client, FRAME_HYPOTHESIS, hyp,
+                           hyp != NULL ? strlen(hyp) : 0);
+    else if (event == UTT_EVENT_ERROR)
+        daemon_queue_frame(client, FRAME_ERROR, hyp, strlen(hyp));
+}
+
+static void
+daemon_stream_closed(void *user_data, int64 stream_id) {
+    client_t *client = daemon_find_client(stream_id);
+    if (client == NULL)
+        return;
+
+    pthread_mutex_lock(&client->lock);
+    client->closed = true;
+    pthread_mutex_unlock(&client->lock);
+    daemon_wake();
+}
+
+/* Stop reading from a client and close its stream. The client is freed once
+ * the stream's final hypothesis has been sent.
+ */
+static void
+daemon_finish_client(stream_pool_t *pool, client_t *client) {
+    client->reading = false;
+    shutdown(client->fd, SHUT_RD);
+    if (!client->has_stream || stream_pool_close_stream(pool, client->id) < 0) {
+        pthread_mutex_lock(&client->lock);
+        client->closed = true;
+        pthread_mutex_unlock(&client->lock);
+    }
+}
+
+/* Whether a client is too far behind to read more audio from: it has too
+ * much audio waiting to be decoded or hasn't read the frames sent to it.
+ */
+static bool
+daemon_client_backlogged(stream_pool_t *pool, client_t *client) {
+    pthread_mutex_lock(&client->lock);
+    bool backlogged = client->out_len > DAEMON_MAX_OUTPUT;
+    pthread_mutex_unlock(&client->lock);
+    return backlogged || (client->has_stream &&
+        stream_pool_pending(pool, client->id) > DAEMON_MAX_PENDING_SAMPLES);
+}
+
+static void
+daemon_read_client(stream_pool_t *pool, client_t *client) {
+    if (client->buf_size - client->buf_len < DAEMON_READ_SIZE) {
+        client->buf_size = client->buf_len + DAEMON_READ_SIZE;
+        client->buf = ckd_realloc(client->buf, client->buf_size);
+    }
+
+    ssize_t n = read(client->fd, client->buf + client->buf_len,
+                     client->buf_size - client->buf_len);
+    if (n < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK))
+        return;
+    if (n <= 0) {
+        daemon_finish_client(pool, client);
+        return;
+    }
+    client->buf_len += n;
+
+    // Push each complete frame. Payloads are always an even number of bytes,
+    // so samples stay aligned within the buffer.
+    size_t offset = 0;
+    while (client->buf_len - offset >= DAEMON_HEADER_SIZE) {
+        uint32 header[2];
+        memcpy(header, client->buf + offset, sizeof(header));
+        uint32 type = ntohl(header[0]);
+        uint32 length = ntohl(header[1]);
+        if (type != FRAME_AUDIO || length > DAEMON_MAX_PAYLOAD ||
+            length % sizeof(int16) != 0) {
+            E_ERROR("Invalid frame from client %lld; closing connection\n",
+                    (long long)client->id);
+            daemon_finish_client(pool, client);
+            return;
+        }
+
+        if (client->buf_len - offset - DAEMON_HEADER_SIZE < length)
+            break;
+
+        int16 const *samples = (int16 const *)(client->buf + offset +
+                                               DAEMON_HEADER_SIZE);
+        if (stream_pool_push(pool, client->id, samples,
+                             length / sizeof(int16)) == 0)
+            client->has_stream = true;
+        offset += DAEMON_HEADER_SIZE + length;
+    }
+
+    memmove(client->buf, client->buf + offset, client->buf_len - offset);
+    client->buf_len -= offset;
+}
+
+static int
+daemon_listen(const char *path) {
+    struct sockaddr_un addr;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        E_ERROR("Socket path is too long: %s\n", path);
+        return -1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        E_ERROR("Failed to create socket: %s\n", strerror(errno));
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    // Remove a stale socket left behind by a previous daemon.
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(fd, SOMAXCONN) < 0) {
+        E_ERROR("Failed to listen on %s: %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static void
+daemon_accept(int listen_fd) {
+    static int64 next_id = 0;
+
+    int fd = accept(listen_fd, NULL, NULL);
+    if (fd < 0)
+        return;
+    if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) < 0) {
+        close(fd);
+        return;
+    }
+
+    client_t *client = ckd_calloc(1, sizeof(*client));
+    client->id = next_id++;
+    client->fd = fd;
+    client->reading = true;
+    pthread_mutex_init(&client->lock, NULL);
+
+    pthread_mutex_lock(&clients_lock);
+    client->next = clients;
+    clients = client;
+    pthread_mutex_unlock(&clients_lock);
+}
+
+/* Free clients whose stream is closed and whose frames have all been sent or
+ * can't be.
+ */
+static void
+daemon_free_finished_clients(void) {
+    pthread_mutex_lock(&clients_lock);
+    client_t *client = clients;
+    pthread_mutex_unlock(&clients_lock);
+
+    // Only this thread adds or removes clients, so the list can be walked
+    // without the lock.
+    while (client != NULL) {
+        client_t *next = client->next;
+        pthread_mutex_lock(&client->lock);
+        bool finished = client->closed &&
+            (client->out_len == 0 || client->write_failed);
+        pthread_mutex_unlock(&client->lock);
+        if (finished)
+            daemon_free_client(client);
+        client = next;
+    }
+}
+
+static void
+daemon_serve(stream_pool_t *pool, int listen_fd) {
+    size_t poll_size = 0;
+    struct pollfd *fds = NULL;
+    client_t **polled = NULL;
+
+    while (!stopping) {
+        daemon_free_finished_clients();
+
+        // Poll the listening socket, the wake pipe, clients still sending
+        // audio that aren't backlogged and clients with frames to send.
+        size_t n_fds = 2;
+        for (client_t *client = clients; client != NULL; client = client->next)
+            n_fds++;
+        if (n_fds > poll_size) {
+            poll_size = n_fds * 2;
+            fds = ckd_realloc(fds, poll_size * sizeof(*fds));
+            polled = ckd_realloc(polled, poll_size * sizeof(*polled));
+        }
+
+        fds[0].fd = listen_fd;
+        fds[0].events = POLLIN;
+        fds[1].fd = wake_fds[0];
+        fds[1].events = POLLIN;
+        n_fds = 2;
+        bool paused = false;
+        for (client_t *client = clients; client != NULL; client = client->next) {
+            short events = 0;
+            if (client->reading) {
+                if (daemon_client_backlogged(pool, client))
+                    paused = true;
+                else
+                    events |= POLLIN;
+            }
+            pthread_mutex_lock(&client->lock);
+            if (client->out_len > 0 && !client->write_failed)
+                events |= POLLOUT;
+            pthread_mutex_unlock(&client->lock);
+            if (events == 0)
+                continue;
+
+            fds[n_fds].fd = client->fd;
+            fds[n_fds].events = events;
+            polled[n_fds] = client;
+            n_fds++;
+        }
+
+        // Nothing says when a backlog clears, so check paused clients often.
+        int timeout = paused ? DAEMON_PAUSED_POLL_MS : DAEMON_POLL_TIMEOUT_MS;
+        if (poll(fds, n_fds, timeout) <= 0)
+            continue;
+
+        if (fds[1].revents & POLLIN) {
+            char drain[64];
+            while (read(wake_fds[0], drain, sizeof(drain)) > 0)
+                continue;
+        }
+
+        for (size_t i = 2; i < n_fds; i++) {
+            if (fds[i].revents & (POLLOUT | POLLERR))
+                daemon_flush_client(polled[i]);
+            if (polled[i]->reading &&
+                fds[i].revents & (POLLIN | POLLHUP | POLLERR))
+                daemon_read_client(pool, polled[i]);
+        }
+
+        if (fds[0].revents & POLLIN)
+            daemon_accept(listen_fd);
+    }
+
+    ckd_free(fds);
+    ckd_free(polled);
+}
+
+int
+main(int argc, char *argv[]) {
+    const char *socket_path = DAEMON_DEFAULT_SOCKET;
+    int n_workers = DAEMON_DEFAULT_WORKERS;
+
+    // Take out the daemon's own arguments and leave the rest for the decoder.
+    char **ps_argv = ckd_calloc(argc + 1, sizeof(char *));
+    int ps_argc = 0;
+    ps_argv[ps_argc++] = argv[0];
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-socket") == 0 && i + 1 < argc) {
+            socket_path = argv[++i];
+        } else if (strcmp(argv[i], "-workers") == 0 && i + 1 < argc) {
+            n_workers = atoi(argv[++i]);
+        } else {
+            ps_argv[ps_argc++] = argv[i];
+        }
+    }
+
+    if (n_workers < 1) {
+        fprintf(stderr, "-workers must be at least 1\n");
+        return 1;
+    }
+
+    cmd_ln_t *config = parse_ps_args(ps_argc, ps_argv);
+    ckd_free(ps_argv);
+    if (config == NULL) {
+        fprintf(stderr, "Failed to parse the decoder configuration\n");
+        return 1;
+    }
+
+    stream_pool_t *pool = stream_pool_init(config, n_workers,
+                                           daemon_stream_event, NULL);
+    cmd_ln_free_r(config);
+    if (pool == NULL) {
+        fprintf(stderr, "Failed to start the decoder worker threads\n");
+        return 1;
+    }
+    stream_pool_set_closed_callback(pool, daemon_stream_closed);
+
+    int listen_fd = daemon_listen(socket_path);
+    if (listen_fd < 0) {
+        stream_pool_free(pool);
+        return 1;
+    }
+
+    if (pipe(wake_fds) < 0 ||
+        fcntl(wake_fds[0], F_SETFL, O_NONBLOCK) < 0 ||
+        fcntl(wake_fds[1], F_SETFL, O_NONBLOCK) < 0) {
+        fprintf(stderr, "Failed to create the wake pipe\n");
+        stream_pool_free(pool);
+        close(listen_fd);
+        return 1;
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = daemon_stop;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    E_INFO("Listening on %s with %d workers\n", socket_path, n_workers);
+    daemon_serve(pool, listen_fd);
+
+    // Stop decoding before freeing the clients the workers write to.
+    stream_pool_free(pool);
+    while (clients != NULL)
+        daemon_free_client(clients);
+
+    close(wake_fds[0]);
+    close(wake_fds[1]);
+    close(listen_fd);
+    unlink(socket_path);
+    return 0;
+}
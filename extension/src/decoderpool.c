@@ -0,0 +1,179 @@
+/*
+ * decoderpool.c
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#include <stdbool.h>
+#include <pthread.h>
+#include <sphinxbase/ckd_alloc.h>
+
+#include "decoderpool.h"
+#include "normstate.h"
+#include "psconfig.h"
+
+struct decoder_pool_s {
+    pthread_mutex_t lock;
+
+    // What the idle decoders were set up with. ps_init changes the config it
+    // is given, so it gets its own copy and the other is kept to compare
+    // against.
+    cmd_ln_t *config;
+    cmd_ln_t *init_config;
+    uint64 sources_version;
+
+    // Normalisation state of a new decoder, restored on reused ones so that
+    // they decode like new ones, or NULL
+    void *fresh_norm;
+    size_t fresh_norm_size;
+
+    ps_decoder_t **idle;
+    size_t n_idle;
+    size_t idle_size;
+};
+
+decoder_pool_t *
+decoder_pool_init(void) {
+    decoder_pool_t *pool = ckd_calloc(1, sizeof(*pool));
+    pthread_mutex_init(&pool->lock, NULL);
+    return pool;
+}
+
+static void
+free_idle(decoder_pool_t *pool) {
+    for (size_t i = 0; i < pool->n_idle; i++)
+        ps_free(pool->idle[i]);
+    pool->n_idle = 0;
+    ckd_free(pool->fresh_norm);
+    pool->fresh_norm = NULL;
+    pool->fresh_norm_size = 0;
+}
+
+/* Forget the idle decoders if they weren't set up from config and sources.
+ * Called with the lock held.
+ * @return 0 on success, -1 on failure
+ */
+static int
+check_up_to_date(decoder_pool_t *pool, cmd_ln_t *config,
+                 search_source_t *sources) {
+    uint64 version = search_sources_version(sources);
+    if (pool->config != NULL && version == pool->sources_version &&
+        ps_args_equal(pool->config, config))
+        return 0;
+
+    free_idle(pool);
+    if (pool->config != NULL)
+        cmd_ln_free_r(pool->config);
+    if (pool->init_config != NULL)
+        cmd_ln_free_r(pool->init_config);
+    pool->config = copy_ps_args(config);
+    pool->init_config = copy_ps_args(config);
+    pool->sources_version = version;
+    if (pool->config == NULL || pool->init_config == NULL) {
+        if (pool->config != NULL)
+            cmd_ln_free_r(pool->config);
+        if (pool->init_config != NULL)
+            cmd_ln_free_r(pool->init_config);
+        pool->config = pool->init_config = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+ps_decoder_t *
+decoder_pool_take(decoder_pool_t *pool, cmd_ln_t *config,
+                  search_source_t *sources, const char *active) {
+    ps_decoder_t *ps = NULL;
+    pthread_mutex_lock(&pool->lock);
+    if (check_up_to_date(pool, config, sources) == 0) {
+        if (pool->n_idle > 0) {
+            ps = pool->idle[--pool->n_idle];
+            if (pool->fresh_norm != NULL)
+                norm_state_set(ps, pool->fresh_norm, pool->fresh_norm_size);
+        } else {
+            // Decoders are created one at a time because ps_init isn't safe
+            // to call concurrently with a shared config.
+            ps = ps_init(pool->init_config);
+            if (ps != NULL && search_sources_apply(sources, ps, NULL) < 0) {
+                ps_free(ps);
+                ps = NULL;
+            }
+            size_t size = ps != NULL ? norm_state_size(ps) : 0;
+            if (pool->fresh_norm == NULL && size > 0) {
+                pool->fresh_norm = ckd_malloc(size);
+                pool->fresh_norm_size = size;
+                if (norm_state_get(ps, pool->fresh_norm, size) < 0) {
+                    ckd_free(pool->fresh_norm);
+                    pool->fresh_norm = NULL;
+                }
+            }
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    if (ps != NULL && active != NULL && ps_set_search(ps, active) < 0) {
+        decoder_pool_return(pool, ps);
+        ps = NULL;
+    }
+    return ps;
+}
+
+void
+decoder_pool_return(decoder_pool_t *pool, ps_decoder_t *ps) {
+    if (ps == NULL)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+    // Decoders created before the config or sources last changed are freed.
+    bool keep = pool->init_config != NULL &&
+        ps_get_config(ps) == pool->init_config;
+    if (keep) {
+        if (pool->n_idle == pool->idle_size) {
+            pool->idle_size = pool->idle_size ? pool->idle_size * 2 : 4;
+            pool->idle = ckd_realloc(pool->idle,
+                                     pool->idle_size * sizeof(*pool->idle));
+        }
+        pool->idle[pool->n_idle++] = ps;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    if (!keep)
+        ps_free(ps);
+}
+
+void
+decoder_pool_free(decoder_pool_t *pool) {
+    if (pool == NULL)
+        return;
+
+    free_idle(pool);
+    if (pool->config != NULL)
+        cmd_ln_free_r(pool->config);
+    if (pool->init_config != NULL)
+        cmd_ln_free_r(pool->init_config);
+    pthread_mutex_destroy(&pool->lock);
+    ckd_free(pool->idle);
+    ckd_free(pool);
+}
@@ -0,0 +1,127 @@
+/*
+ * endpointer.c
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#include <sphinxbase/ckd_alloc.h>
+
+#include "endpointer.h"
+#include "trace.h"
+
+endpointer_t *
+endpointer_init(cmd_ln_t *config, float64 trailing_silence,
+                float64 min_speech, float64 max_utterance) {
+    endpointer_t *ep = ckd_calloc(1, sizeof(*ep));
+    ep->samprate = cmd_ln_float32_r(config, "-samprate");
+    ep->trailing_silence = (size_t)(trailing_silence * ep->samprate);
+    ep->min_speech = (size_t)(min_speech * ep->samprate);
+    ep->max_utterance = (size_t)(max_utterance * ep->samprate);
+    return ep;
+}
+
+/* End the decoder's utterance without reporting it. */
+static void
+discard_utterance(ps_decoder_t *ps, utterance_state_t *state) {
+    uint64 span = trace_begin();
+    ps_end_utt(ps);
+    trace_end(span, "ps_end_utt");
+    *state = ENDED;
+}
+
+utterance_event_t
+endpointer_process_raw(endpointer_t *ep, ps_decoder_t *ps,
+                       utterance_state_t *state, int16 const *buf,
+                       size_t n_samples) {
+    if (*state == ENDED) {
+        ps_start_utt(ps);
+        *state = IDLE;
+        ep->utt_samples = ep->speech_samples = ep->silence_samples = 0;
+        ep->speech_pending = false;
+    }
+
+    uint64 span = trace_begin();
+    ps_process_raw(ps, buf, n_samples, FALSE, FALSE);
+    trace_end(span, "ps_process_raw");
+    bool in_speech = ps_get_in_speech(ps);
+
+    // Count audio from the first speech onwards.
+    if (*state == STARTED || ep->speech_pending || in_speech) {
+        ep->utt_samples += n_samples;
+        if (in_speech) {
+            ep->speech_samples += n_samples;
+            ep->silence_samples = 0;
+        } else {
+            ep->silence_samples += n_samples;
+        }
+    }
+
+    utterance_event_t event = UTT_EVENT_NONE;
+    if (*state == IDLE) {
+        if (in_speech || ep->speech_pending) {
+            if (ep->speech_samples >= ep->min_speech) {
+                *state = STARTED;
+                ep->speech_pending = false;
+                event = UTT_EVENT_SPEECH_START;
+            } else if (!in_speech) {
+                // Too short to be speech, so start again without it.
+                discard_utterance(ps, state);
+                return UTT_EVENT_NONE;
+            } else {
+                ep->speech_pending = true;
+            }
+        }
+    } else if (*state == STARTED && !in_speech &&
+               ep->silence_samples >= ep->trailing_silence) {
+        event = UTT_EVENT_HYPOTHESIS;
+    }
+
+    // Stop runaway utterances at the maximum length. An utterance which has
+    // only just started is ended with the next chunk, so that its start is
+    // still reported.
+    if (event == UTT_EVENT_NONE && ep->max_utterance > 0 &&
+        ep->utt_samples >= ep->max_utterance) {
+        if (*state == STARTED) {
+            ep->n_forced++;
+            event = UTT_EVENT_HYPOTHESIS;
+        } else if (ep->speech_pending) {
+            discard_utterance(ps, state);
+            return UTT_EVENT_NONE;
+        }
+    }
+
+    if (event == UTT_EVENT_HYPOTHESIS) {
+        *state = ENDED;
+        span = trace_begin();
+        ps_end_utt(ps);
+        trace_end(span, "ps_end_utt");
+    }
+    return event;
+}
+
+void
+endpointer_free(endpointer_t *ep) {
+    ckd_free(ep);
+}
@@ -0,0 +1,279 @@
+/*
+ * featstore.c
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sphinxbase/ckd_alloc.h>
+#include <sphinxbase/fe.h>
+
+#include "featstore.h"
+
+#define FEAT_STORE_MAGIC "SWFEAT1"
+
+// Header at the start of saved feature stores, followed by the frames.
+typedef struct {
+    char magic[8];
+    uint32 mfcc_size; // sizeof(mfcc_t) of the build that saved the file
+    int32 n_ceps;
+    int32 n_frames;
+    int32 reserved;
+} feat_store_header_t;
+
+typedef struct {
+    feat_store_t *store;
+    ps_decoder_t *ps;
+    char *hyp;
+    int result;
+} search_job_t;
+
+feat_store_t *
+feat_store_extract(cmd_ln_t *config, int16 const *samples, size_t n_samples) {
+    fe_t *fe = fe_init_auto_r(config);
+    if (fe == NULL)
+        return NULL;
+
+    int frame_shift, frame_size;
+    fe_get_input_size(fe, &frame_shift, &frame_size);
+    int32 n_ceps = fe_get_output_size(fe);
+
+    // Enough room for every frame plus the one fe_end_utt may produce.
+    int32 max_frames = (int32)(n_samples / (frame_shift > 0 ? frame_shift : 1)) + 2;
+    mfcc_t **cep = ckd_calloc_2d(max_frames, n_ceps, sizeof(mfcc_t));
+
+    int32 n_frames = 0;
+    int failed = fe_start_utt(fe) < 0;
+    while (!failed && n_samples > 0) {
+        int32 n = max_frames - n_frames;
+        if (n <= 1 || fe_process_frames(fe, &samples, &n_samples, cep + n_frames,
+                                        &n, NULL) < 0)
+            failed = 1;
+        n_frames += n;
+    }
+
+    int32 n_last = 0;
+    if (!failed && fe_end_utt(fe, cep[n_frames], &n_last) < 0)
+        failed = 1;
+    n_frames += n_last;
+    fe_free(fe);
+
+    if (failed) {
+        ckd_free_2d(cep);
+        return NULL;
+    }
+
+    // ckd_calloc_2d stores the rows contiguously, so the frames can be copied
+    // in one go.
+    feat_store_t *store = ckd_calloc(1, sizeof(*store));
+    store->n_frames = n_frames;
+    store->n_ceps = n_ceps;
+    store->frames = ckd_calloc((size_t)n_frames * n_ceps + 1, sizeof(mfcc_t));
+    memcpy(store->frames, cep[0], (size_t)n_frames * n_ceps * sizeof(mfcc_t));
+    ckd_free_2d(cep);
+    return store;
+}
+
+int
+feat_store_save(feat_store_t *store, const char *path) {
+    feat_store_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FEAT_STORE_MAGIC, sizeof(FEAT_STORE_MAGIC));
+    header.mfcc_size = sizeof(mfcc_t);
+    header.n_ceps = store->n_ceps;
+    header.n_frames = store->n_frames;
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+        return -1;
+
+    size_t n_values = (size_t)store->n_frames * store->n_ceps;
+    int failed = fwrite(&header, sizeof(header), 1, file) != 1 ||
+        fwrite(store->frames, sizeof(mfcc_t), n_values, file) != n_values;
+    if (fclose(file) != 0)
+        failed = 1;
+    return failed ? -1 : 0;
+}
+
+feat_store_t *
+feat_store_load(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return NULL;
+    }
+
+    if ((size_t)st.st_size < sizeof(feat_store_header_t)) {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    // Decoders read the frames from a private copy, so the mapping is shared
+    // with every other process loading the same file.
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return NULL;
+
+    feat_store_header_t *header = map;
+    size_t n_values = (size_t)header->n_frames * header->n_ceps;
+    if (memcmp(header->magic, FEAT_STORE_MAGIC, sizeof(FEAT_STORE_MAGIC)) != 0 ||
+        header->mfcc_size != sizeof(mfcc_t) || header->n_frames < 0 ||
+        header->n_ceps <= 0 || (size_t)st.st_size != sizeof(*header) +
+        n_values * sizeof(mfcc_t)) {
+        munmap(map, st.st_size);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    feat_store_t *store = ckd_calloc(1, sizeof(*store));
+    store->n_frames = header->n_frames;
+    store->n_ceps = header->n_ceps;
+    store->frames = (mfcc_t *)(header + 1);
+    store->map = map;
+    store->map_size = st.st_size;
+    return store;
+}
+
+void
+feat_store_free(feat_store_t *store) {
+    if (store == NULL)
+        return;
+    if (store->map != NULL)
+        munmap(store->map, store->map_size);
+    else
+        ckd_free(store->frames);
+    ckd_free(store);
+}
+
+int
+feat_store_decode(feat_store_t *store, ps_decoder_t *ps) {
+    if (store->n_ceps != cmd_ln_int32_r(ps_get_config(ps), "-ceplen"))
+        return -1;
+
+    // Cepstral mean normalisation is applied to the frames in place.
+    mfcc_t **cep = ckd_calloc_2d(store->n_frames + 1, store->n_ceps,
+                                 sizeof(mfcc_t));
+    memcpy(cep[0], store->frames,
+           (size_t)store->n_frames * store->n_ceps * sizeof(mfcc_t));
+
+    int result = 0;
+    if (ps_start_utt(ps) < 0 ||
+        ps_process_cep(ps, cep, store->n_frames, FALSE, TRUE) < 0 ||
+        ps_end_utt(ps) < 0)
+        result = -1;
+
+    ckd_free_2d(cep);
+    return result;
+}
+
+static void *
+search_job_main(void *arg) {
+    search_job_t *job = arg;
+    job->result = -1;
+    if (job->ps == NULL)
+        return NULL;
+
+    if (feat_store_decode(job->store, job->ps) < 0)
+        return NULL;
+
+    const char *hyp = ps_get_hyp(job->ps, NULL);
+    job->hyp = hyp != NULL ? ckd_salloc(hyp) : NULL;
+    job->result = 0;
+    return NULL;
+}
+
+int
+feat_store_decode_searches(feat_store_t *store, decoder_pool_t *pool,
+                           cmd_ln_t *config, search_source_t *sources,
+                           char const **searches, int n_searches,
+                           char **hyps) {
+    if (n_searches <= 0)
+        return 0;
+
+    search_job_t *jobs = ckd_calloc(n_searches, sizeof(search_job_t));
+    pthread_t *threads = ckd_calloc(n_searches, sizeof(pthread_t));
+
+    // Decoders kept from earlier calls are reused.
+    int failed = 0;
+    for (int i = 0; i < n_searches && !failed; i++) {
+        search_job_t *job = &jobs[i];
+        job->store = store;
+        job->ps = decoder_pool_take(pool, config, sources, searches[i]);
+        if (job->ps == NULL)
+            failed = 1;
+    }
+
+    int n_threads = 0;
+    if (!failed) {
+        // The calling thread decodes the first search itself.
+        for (n_threads = 1; n_threads < n_searches; n_threads++) {
+            if (pthread_create(&threads[n_threads], NULL, search_job_main,
+                               &jobs[n_threads]) != 0)
+                break;
+        }
+        search_job_main(&jobs[0]);
+        for (int i = 1; i < n_threads; i++)
+            pthread_join(threads[i], NULL);
+        // Decode any searches left over if a thread couldn't be started.
+        for (int i = n_threads; i < n_searches; i++)
+            search_job_main(&jobs[i]);
+    }
+
+    for (int i = 0; i < n_searches; i++) {
+        search_job_t *job = &jobs[i];
+        if (job->result < 0)
+            failed = 1;
+        hyps[i] = job->hyp;
+        // A decoder that failed may still be in an utterance.
+        if (job->result < 0 && job->ps != NULL)
+            ps_free(job->ps);
+        else
+            decoder_pool_return(pool, job->ps);
+    }
+
+    if (failed) {
+        for (int i = 0; i < n_searches; i++) {
+            ckd_free(hyps[i]);
+            hyps[i] = NULL;
+        }
+    }
+
+    ckd_free(threads);
+    ckd_free(jobs);
+    return failed ? -1 : 0;
+}
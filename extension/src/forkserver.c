@@ -0,0 +1,302 @@
+/*
+ * forkserver.c
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <sphinxbase/ckd_alloc.h>
+#include <sphinxbase/feat.h>
+
+#include "pypocketsphinx.h"
+
+// Length of the silent utterance decoded by warm_up(), in samples
+#define WARM_UP_SAMPLES 16000
+
+/* Flush sys.stdout and sys.stderr; forked workers exit without finalising the
+ * interpreter, so anything left in Python's buffers would be lost.
+ */
+static void
+flush_std_streams(void) {
+    const char *names[] = {"stdout", "stderr"};
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        PyObject *stream = PySys_GetObject((char *)names[i]); // borrowed
+        if (stream != NULL && stream != Py_None) {
+            PyObject *result = PyObject_CallMethod(stream, "flush", NULL);
+            Py_XDECREF(result);
+        }
+    }
+    PyErr_Clear();
+}
+
+PyObject *
+PSObj_warm_up(PSObj *self) {
+    ps_decoder_t *ps = get_ps_decoder_t(self);
+    if (ps == NULL)
+        return NULL;
+
+    // End any utterance in progress; warming up uses its own.
+    utterance_end(ps, &self->utterance_state);
+
+    // Decoding adapts the live CMN estimate, so keep the current one to put
+    // back afterwards.
+    feat_t *feat = ps_get_feat(ps);
+    cmn_t *cmn = feat != NULL ? feat->cmn_struct : NULL;
+    mfcc_t *cmn_prior = NULL;
+    if (cmn != NULL) {
+        cmn_prior = ckd_calloc(cmn->veclen, sizeof(mfcc_t));
+        cmn_prior_get(cmn, cmn_prior);
+    }
+
+    int16 *silence = ckd_calloc(WARM_UP_SAMPLES, sizeof(int16));
+    int result;
+    Py_BEGIN_ALLOW_THREADS
+    result = ps_start_utt(ps);
+    if (result >= 0)
+        result = ps_process_raw(ps, silence, WARM_UP_SAMPLES, FALSE, TRUE);
+    if (result >= 0)
+        result = ps_end_utt(ps);
+    Py_END_ALLOW_THREADS
+    ckd_free(silence);
+
+    if (cmn_prior != NULL) {
+        cmn_prior_set(cmn, cmn_prior);
+        ckd_free(cmn_prior);
+    }
+
+    if (result < 0) {
+        PyErr_SetString(GET_MODULE_STATE(self)->PocketSphinxError,
+                        "failed to warm up the decoder.");
+        return NULL;
+    }
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+PyObject *
+PSObj_reset(PSObj *self) {
+    ps_decoder_t *ps = get_ps_decoder_t(self);
+    if (ps == NULL)
+        return NULL;
+
+    // Discard any utterance in progress without reporting it.
+    if (self->cascade != NULL)
+        cascade_end(self->cascade, ps, &self->utterance_state);
+    else
+        utterance_end(ps, &self->utterance_state);
+
+    // Callbacks belong to whoever set them, not to forked workers.
+    Py_DECREF(self->speech_start_callback);
+    Py_INCREF(Py_None);
+    self->speech_start_callback = Py_None;
+    Py_DECREF(self->hypothesis_callback);
+    Py_INCREF(Py_None);
+    self->hypothesis_callback = Py_None;
+    Py_DECREF(self->search_hypothesis_callback);
+    Py_INCREF(Py_None);
+    self->search_hypothesis_callback = Py_None;
+    Py_DECREF(self->keyphrase_callback);
+    Py_INCREF(Py_None);
+    self->keyphrase_callback = Py_None;
+    Py_DECREF(self->rescored_hypothesis_callback);
+    Py_INCREF(Py_None);
+    self->rescored_hypothesis_callback = Py_None;
+    Py_DECREF(self->corrected_hypothesis_callback);
+    Py_INCREF(Py_None);
+    self->corrected_hypothesis_callback = Py_None;
+
+    // Re-activate the current search so its state starts afresh.
+    const char *name = ps_get_search(ps);
+    if (name != NULL && ps_set_search(ps, name) < 0) {
+        PyErr_Format(GET_MODULE_STATE(self)->PocketSphinxError,
+                     "failed to reset Pocket Sphinx search "
+                     "with name '%s'.", name);
+        return NULL;
+    }
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+/* Run a forked worker's target and exit the child process. Never returns. */
+static void
+PSObj_run_forked_worker(PSObj *self, PyObject *target, int index) {
+    int status = 0;
+    PyObject *reset_result = PSObj_reset(self);
+    PyObject *result = NULL;
+    if (reset_result != NULL) {
+        Py_DECREF(reset_result);
+        result = PyObject_CallFunction(target, "Oi", (PyObject *)self, index);
+    }
+
+    if (result == NULL) {
+        PyErr_Print();
+        status = 1;
+    }
+    Py_XDECREF(result);
+
+    flush_std_streams();
+    _exit(status);
+}
+
+/* Terminate and reap the worker processes in a list of process IDs. Any Python
+ * exception already set is preserved.
+ */
+static void
+PSObj_stop_forked_workers(PyObject *pids) {
+    for (Py_ssize_t i = 0; i < PyList_Size(pids); i++) {
+        pid_t pid = (pid_t)PyLong_AsLong(PyList_GetItem(pids, i));
+        kill(pid, SIGTERM);
+        waitpid(pid, NULL, 0);
+    }
+}
+
+PyObject *
+PSObj_fork_workers(PSObj *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"count", "target", "warm_up", NULL};
+    int count = 0;
+    PyObject *target = NULL;
+
+    // True by default. No need to increment this because it's only used internally.
+    PyObject *warm_up = Py_True;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "iO|O", kwlist, &count,
+                                     &target, &warm_up))
+        return NULL;
+
+    if (count < 1) {
+        PyErr_SetString(PyExc_ValueError, "'count' must be at least 1.");
+        return NULL;
+    }
+
+    if (!PyCallable_Check(target)) {
+        PyErr_SetString(PyExc_TypeError, "'target' must be callable.");
+        return NULL;
+    }
+
+    if (!PyBool_Check(warm_up)) {
+        PyErr_SetString(PyExc_TypeError, "'warm_up' parameter must be a "
+                        "boolean value.");
+        return NULL;
+    }
+
+    // Threads don't survive fork, so the workers would wait forever.
+    if (self->multi_search != NULL) {
+        PyErr_SetString(GET_MODULE_STATE(self)->PocketSphinxError,
+                        "concurrent_searches must be None "
+                        "when forking workers.");
+        return NULL;
+    }
+    if (self->rescorer != NULL) {
+        PyErr_SetString(GET_MODULE_STATE(self)->PocketSphinxError,
+                        "rescoring must be disabled when "
+                        "forking workers.");
+        return NULL;
+    }
+    if (self->second_pass != NULL) {
+        PyErr_SetString(GET_MODULE_STATE(self)->PocketSphinxError,
+                        "the second pass must be disabled when "
+                        "forking workers.");
+        return NULL;
+    }
+    if (self->grammar_compiler != NULL) {
+        if (grammar_compiler_pending(self->grammar_compiler) > 0) {
+            PyErr_SetString(GET_MODULE_STATE(self)->PocketSphinxError,
+                            "searches are still being "
+                            "compiled in the background. Wait for them before "
+                            "forking workers.");
+            return NULL;
+        }
+
+        // Stop the idle compiler thread; it is started again when needed.
+        Py_BEGIN_ALLOW_THREADS
+        grammar_compiler_free(self->grammar_compiler);
+        Py_END_ALLOW_THREADS
+        self->grammar_compiler = NULL;
+    }
+
+    if (warm_up == Py_True) {
+        PyObject *warm_up_result = PSObj_warm_up(self);
+        if (warm_up_result == NULL)
+            return NULL;
+        Py_DECREF(warm_up_result);
+    } else if (get_ps_decoder_t(self) == NULL) {
+        return NULL;
+    }
+
+    // Flush now so buffered output isn't written once per child as well.
+    flush_std_streams();
+
+    PyObject *pids = PyList_New(0);
+    if (pids == NULL)
+        return NULL;
+
+    for (int i = 0; i < count; i++) {
+#if PY_VERSION_HEX >= 0x03070000
+        PyOS_BeforeFork();
+#endif
+        pid_t pid = fork();
+        if (pid == 0) {
+#if PY_VERSION_HEX >= 0x03070000
+            PyOS_AfterFork_Child();
+#else
+            PyOS_AfterFork();
+#endif
+            Py_DECREF(pids);
+            PSObj_run_forked_worker(self, target, i);
+        }
+
+#if PY_VERSION_HEX >= 0x03070000
+        PyOS_AfterFork_Parent();
+#endif
+        if (pid < 0) {
+            // Don't leave the workers started so far running unattended.
+            PyErr_SetFromErrno(PyExc_OSError);
+            PSObj_stop_forked_workers(pids);
+            Py_DECREF(pids);
+            return NULL;
+        }
+
+        PyObject *py_pid = PyLong_FromLong((long)pid);
+        if (py_pid == NULL || PyList_Append(pids, py_pid) < 0) {
+            // The new worker isn't in the list, so stop it separately.
+            kill(pid, SIGTERM);
+            waitpid(pid, NULL, 0);
+            Py_XDECREF(py_pid);
+            PSObj_stop_forked_workers(pids);
+            Py_DECREF(pids);
+            return NULL;
+        }
+        Py_DECREF(py_pid);
+    }
+
+    return pids;
+}
@@ -0,0 +1,194 @@
+/*
+ * fsgedit.c
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#include <stdbool.h>
+#include <string.h>
+#include <sphinxbase/bitvec.h>
+#include <sphinxbase/ckd_alloc.h>
+#include <sphinxbase/logmath.h>
+
+#include "fsgedit.h"
+#include "trace.h"
+
+fsg_edit_t *
+fsg_edit_init(fsg_edit_type_t type, const char *word, int32 from_state,
+              int32 to_state, float32 prob) {
+    fsg_edit_t *edit = ckd_calloc(1, sizeof(*edit));
+    edit->type = type;
+    edit->word = word != NULL ? ckd_salloc(word) : NULL;
+    edit->from_state = from_state;
+    edit->to_state = to_state;
+    edit->prob = prob;
+    return edit;
+}
+
+fsg_edit_t *
+fsg_edit_copy(fsg_edit_t const *edit) {
+    return fsg_edit_init(edit->type, edit->word, edit->from_state,
+                         edit->to_state, edit->prob);
+}
+
+void
+fsg_edits_free(fsg_edit_t *edits) {
+    while (edits != NULL) {
+        fsg_edit_t *next = edits->next;
+        ckd_free(edits->word);
+        ckd_free(edits);
+        edits = next;
+    }
+}
+
+static bool
+state_in_range(fsg_model_t *fsg, int32 state, bool allow_any) {
+    return (allow_any && state == -1) ||
+        (state >= 0 && state < fsg_model_n_state(fsg));
+}
+
+/* Whether a grammar word is the word or one of its alternate pronunciations,
+ * which are named like "word(2)".
+ */
+static bool
+word_matches(const char *fsg_word, const char *word) {
+    size_t len = strlen(word);
+    return strncmp(fsg_word, word, len) == 0 &&
+        (fsg_word[len] == '\0' || fsg_word[len] == '(');
+}
+
+static bool
+link_removed(fsg_model_t *fsg, fsg_link_t *link, fsg_edit_t const *edit) {
+    int32 wid = fsg_link_wid(link);
+    return wid >= 0 && word_matches(fsg_model_word_str(fsg, wid), edit->word) &&
+        (edit->from_state == -1 || edit->from_state == fsg_link_from_state(link)) &&
+        (edit->to_state == -1 || edit->to_state == fsg_link_to_state(link));
+}
+
+/* Build a copy of a grammar with the same word IDs, leaving out the
+ * transitions an edit removes if edit isn't NULL.
+ */
+static fsg_model_t *
+copy_without(fsg_model_t *fsg, fsg_edit_t const *edit) {
+    fsg_model_t *copy = fsg_model_init(fsg_model_name(fsg), fsg->lmath,
+                                       fsg->lw, fsg_model_n_state(fsg));
+    copy->start_state = fsg_model_start_state(fsg);
+    copy->final_state = fsg_model_final_state(fsg);
+
+    int32 n_words = fsg_model_n_word(fsg);
+    for (int32 wid = 0; wid < n_words; wid++)
+        fsg_model_word_add(copy, fsg_model_word_str(fsg, wid));
+
+    // Keep the silence and alternate word flags used by the search.
+    if (fsg_model_has_sil(fsg))
+        copy->silwords = bitvec_alloc(copy->n_word_alloc);
+    if (fsg_model_has_alt(fsg))
+        copy->altwords = bitvec_alloc(copy->n_word_alloc);
+    for (int32 wid = 0; wid < n_words; wid++) {
+        if (fsg_model_is_filler(fsg, wid))
+            bitvec_set(copy->silwords, wid);
+        if (fsg_model_is_alt(fsg, wid))
+            bitvec_set(copy->altwords, wid);
+    }
+
+    for (int32 state = 0; state < fsg_model_n_state(fsg); state++) {
+        fsg_arciter_t *itor;
+        for (itor = fsg_model_arcs(fsg, state); itor;
+             itor = fsg_arciter_next(itor)) {
+            fsg_link_t *link = fsg_arciter_get(itor);
+            if (fsg_link_wid(link) < 0)
+                fsg_model_null_trans_add(copy, fsg_link_from_state(link),
+                                         fsg_link_to_state(link),
+                                         fsg_link_logs2prob(link));
+            else if (edit == NULL || !link_removed(fsg, link, edit))
+                fsg_model_trans_add(copy, fsg_link_from_state(link),
+                                    fsg_link_to_state(link),
+                                    fsg_link_logs2prob(link),
+                                    fsg_link_wid(link));
+        }
+    }
+
+    return copy;
+}
+
+fsg_model_t *
+fsg_edit_apply(fsg_model_t *fsg, fsg_edit_t const *edit) {
+    bool removing = edit->type == FSG_EDIT_REMOVE;
+    if (!state_in_range(fsg, edit->from_state, removing) ||
+        !state_in_range(fsg, edit->to_state, removing))
+        return NULL;
+
+    if (removing)
+        return copy_without(fsg, edit);
+
+    // Scale the probability the same way grammar files are.
+    int32 logp = (int32)(logmath_log(fsg->lmath, edit->prob) * fsg->lw);
+    if (edit->word == NULL) {
+        fsg_model_null_trans_add(fsg, edit->from_state, edit->to_state, logp);
+        glist_free(fsg_model_null_trans_closure(fsg, NULL));
+    } else {
+        int32 wid = fsg_model_word_add(fsg, edit->word);
+        fsg_model_trans_add(fsg, edit->from_state, edit->to_state, logp, wid);
+    }
+
+    return fsg_model_retain(fsg);
+}
+
+int
+fsg_edits_apply_to_search(ps_decoder_t *ps, const char *name,
+                          fsg_edit_t const *edits) {
+    fsg_model_t *fsg = ps_get_fsg(ps, name);
+    if (fsg == NULL)
+        return -1;
+
+    // Check added words are in the dictionary before touching the grammar in
+    // use, since the search can't be set up again without them.
+    fsg_edit_t const *edit;
+    for (edit = edits; edit != NULL; edit = edit->next) {
+        if (edit->type != FSG_EDIT_ADD || edit->word == NULL)
+            continue;
+        char *phones = ps_lookup_word(ps, edit->word);
+        if (phones == NULL)
+            return -1;
+        ckd_free(phones);
+    }
+
+    // Edit a copy, so that the search keeps its grammar unchanged unless
+    // every edit succeeds and the search is set up with the copy.
+    fsg = copy_without(fsg, NULL);
+    for (edit = edits; edit != NULL; edit = edit->next) {
+        fsg_model_t *edited = fsg_edit_apply(fsg, edit);
+        fsg_model_free(fsg);
+        if (edited == NULL)
+            return -1;
+        fsg = edited;
+    }
+
+    uint64 span = trace_begin();
+    int set_result = ps_set_fsg(ps, name, fsg);
+    trace_end(span, "ps_set_fsg");
+    fsg_model_free(fsg);
+    return set_result < 0 ? -1 : 0;
+}
@@ -0,0 +1,203 @@
+/*
+ * governor.c
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#include <math.h>
+#include <sphinxbase/ckd_alloc.h>
+
+#include "governor.h"
+
+// Weight of each chunk in the moving average of the real time factor
+#define RTF_SMOOTHING 0.1
+
+// Beams are widened again once the real time factor is below this fraction
+// of the target.
+#define RELAX_RATIO 0.7
+
+// Each level scales the beams' logarithms by another LEVEL_STEP, down to
+// 1 - MAX_LEVEL * LEVEL_STEP of the configured width.
+#define LEVEL_STEP 0.1
+#define MAX_LEVEL 5
+
+const char *governor_beam_names[GOVERNOR_N_BEAMS] = {
+    "-beam", "-wbeam", "-pbeam"
+};
+
+static void
+write_beams(governor_t *governor, cmd_ln_t *config, int level) {
+    float64 scale = 1.0 - level * LEVEL_STEP;
+    for (int i = 0; i < GOVERNOR_N_BEAMS; i++) {
+        // Beams are probabilities; narrowing one moves it towards 1.
+        float64 base = governor->base_beams[i];
+        float64 beam = base > 0 ? exp(log(base) * scale) : base;
+        governor->beams[i] = beam;
+        cmd_ln_set_float_r(config, governor_beam_names[i], beam);
+    }
+}
+
+static void *
+governor_main(void *arg) {
+    governor_t *governor = arg;
+    pthread_mutex_lock(&governor->mutex);
+    for (;;) {
+        while (!governor->requested && !governor->stopping)
+            pthread_cond_wait(&governor->cond, &governor->mutex);
+        if (governor->stopping)
+            break;
+        governor->requested = false;
+
+        pthread_mutex_unlock(&governor->mutex);
+        governor->rebuild(governor->rebuild_arg);
+        pthread_mutex_lock(&governor->mutex);
+    }
+    pthread_mutex_unlock(&governor->mutex);
+    return NULL;
+}
+
+governor_t *
+governor_init(cmd_ln_t *config, float64 target_rtf,
+              governor_rebuild_fn rebuild, void *arg) {
+    governor_t *governor = ckd_calloc(1, sizeof(*governor));
+    governor->target_rtf = target_rtf;
+    governor->rebuild = rebuild;
+    governor->rebuild_arg = arg;
+    governor_reset(governor, config);
+
+    pthread_mutex_init(&governor->mutex, NULL);
+    pthread_cond_init(&governor->cond, NULL);
+    if (pthread_create(&governor->thread, NULL, governor_main, governor) != 0) {
+        pthread_cond_destroy(&governor->cond);
+        pthread_mutex_destroy(&governor->mutex);
+        ckd_free(governor);
+        return NULL;
+    }
+    return governor;
+}
+
+void
+governor_reset(governor_t *governor, cmd_ln_t *config) {
+    governor->samprate = cmd_ln_float32_r(config, "-samprate");
+    for (int i = 0; i < GOVERNOR_N_BEAMS; i++) {
+        governor->base_beams[i] = cmd_ln_float_r(config, governor_beam_names[i]);
+        governor->beams[i] = governor->base_beams[i];
+    }
+    governor->level = 0;
+    governor->pending_level = 0;
+    governor->seconds_since_change = 0;
+}
+
+void
+governor_start(governor_t *governor) {
+    clock_gettime(CLOCK_MONOTONIC, &governor->chunk_start);
+}
+
+void
+governor_stop(governor_t *governor, size_t n_samples) {
+    if (n_samples == 0 || governor->samprate <= 0)
+        return;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    float64 elapsed = (now.tv_sec - governor->chunk_start.tv_sec) +
+        (now.tv_nsec - governor->chunk_start.tv_nsec) / 1e9;
+    float64 seconds = n_samples / governor->samprate;
+    float64 rtf = elapsed / seconds;
+    if (governor->rtf == 0)
+        governor->rtf = rtf;
+    else
+        governor->rtf += RTF_SMOOTHING * (rtf - governor->rtf);
+
+    // Move at most one level per utterance, and not so often that setting
+    // the search up again adds to the load.
+    governor->seconds_since_change += seconds;
+    if (governor->pending_level != governor->level ||
+        governor->seconds_since_change < GOVERNOR_MIN_INTERVAL)
+        return;
+    if (governor->rtf > governor->target_rtf && governor->level < MAX_LEVEL)
+        governor->pending_level = governor->level + 1;
+    else if (governor->rtf < governor->target_rtf * RELAX_RATIO &&
+             governor->level > 0)
+        governor->pending_level = governor->level - 1;
+}
+
+void
+governor_request(governor_t *governor) {
+    if (governor->pending_level == governor->level)
+        return;
+
+    pthread_mutex_lock(&governor->mutex);
+    governor->requested = true;
+    pthread_cond_signal(&governor->cond);
+    pthread_mutex_unlock(&governor->mutex);
+}
+
+bool
+governor_apply(governor_t *governor, cmd_ln_t *config) {
+    if (governor->pending_level == governor->level)
+        return false;
+
+    write_beams(governor, config, governor->pending_level);
+    return true;
+}
+
+void
+governor_applied(governor_t *governor, cmd_ln_t *config, bool applied) {
+    if (applied) {
+        governor->level = governor->pending_level;
+        governor->n_adjustments++;
+    } else {
+        // Keep the beams the search is still using and give up on the level.
+        write_beams(governor, config, governor->level);
+        governor->pending_level = governor->level;
+        governor->n_failures++;
+    }
+    governor->seconds_since_change = 0;
+}
+
+void
+governor_restore(governor_t *governor, cmd_ln_t *config) {
+    write_beams(governor, config, 0);
+    governor->level = 0;
+    governor->pending_level = 0;
+    governor->seconds_since_change = 0;
+}
+
+void
+governor_free(governor_t *governor) {
+    if (governor == NULL)
+        return;
+
+    pthread_mutex_lock(&governor->mutex);
+    governor->stopping = true;
+    pthread_cond_signal(&governor->cond);
+    pthread_mutex_unlock(&governor->mutex);
+    pthread_join(governor->thread, NULL);
+
+    pthread_cond_destroy(&governor->cond);
+    pthread_mutex_destroy(&governor->mutex);
+    ckd_free(governor);
+}
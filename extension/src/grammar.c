@@ -0,0 +1,399 @@
+/*
+ * grammar.c
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <time.h>
+#include <pthread.h>
+#include <sphinxbase/ckd_alloc.h>
+#include <sphinxbase/jsgf.h>
+
+#include "grammar.h"
+#include "trace.h"
+
+struct grammar_job_s {
+    pthread_mutex_t lock;
+    pthread_cond_t finished; // signalled when the state leaves COMPILING
+    int refcount;
+    grammar_state_t state;
+    ps_search_type type;
+    char *name;
+    char *value; // file path or string, depending on the type
+    bool interrupt;
+    fsg_model_t *fsg;
+    fsg_edit_t *edit; // edit to make to the named search instead, or NULL
+    char *error;
+    struct grammar_job_s *next; // next job in the compiler's queue
+};
+
+struct grammar_compiler_s {
+    logmath_t *lmath;
+    float32 lw;
+    char *toprule;
+
+    // Jobs are compiled in queue order and stay queued until they are popped.
+    pthread_mutex_t lock;
+    pthread_cond_t job_ready;
+    grammar_job_t *head;
+    grammar_job_t *tail;
+    int n_jobs;
+    bool stopping;
+    pthread_t thread;
+};
+
+static void
+set_job_state(grammar_job_t *job, grammar_state_t state, const char *error) {
+    pthread_mutex_lock(&job->lock);
+    job->state = state;
+    if (error != NULL && job->error == NULL)
+        job->error = ckd_salloc(error);
+    pthread_cond_broadcast(&job->finished);
+    pthread_mutex_unlock(&job->lock);
+}
+
+/* Compile a job's grammar into an FSG model.
+ * @return NULL with an error message in error on failure
+ */
+static fsg_model_t *
+compile(grammar_compiler_t *gc, grammar_job_t *job, char *error,
+        size_t error_size) {
+    if (job->type == FSG_FILE) {
+        fsg_model_t *fsg = fsg_model_readfile(job->value, gc->lmath, gc->lw);
+        if (fsg == NULL)
+            snprintf(error, error_size, "failed to read FSG file '%s'.",
+                     job->value);
+        return fsg;
+    }
+
+    jsgf_t *jsgf;
+    if (job->type == JSGF_FILE)
+        jsgf = jsgf_parse_file(job->value, NULL);
+    else
+        jsgf = jsgf_parse_string(job->value, NULL);
+    if (jsgf == NULL) {
+        snprintf(error, error_size, "failed to parse the JSGF grammar for "
+                 "search '%s'.", job->name);
+        return NULL;
+    }
+
+    // Use the same rule as ps_set_jsgf_file and ps_set_jsgf_string would.
+    jsgf_rule_t *rule;
+    if (gc->toprule != NULL)
+        rule = jsgf_get_rule(jsgf, gc->toprule);
+    else
+        rule = jsgf_get_public_rule(jsgf);
+
+    fsg_model_t *fsg = NULL;
+    if (rule == NULL)
+        snprintf(error, error_size, "the JSGF grammar for search '%s' has no "
+                 "%s rule.", job->name, gc->toprule ? gc->toprule : "public");
+    else if ((fsg = jsgf_build_fsg(jsgf, rule, gc->lmath, gc->lw)) == NULL)
+        snprintf(error, error_size, "failed to build an FSG from the JSGF "
+                 "grammar for search '%s'.", job->name);
+
+    jsgf_grammar_free(jsgf);
+    return fsg;
+}
+
+static void *
+compiler_main(void *arg) {
+    grammar_compiler_t *gc = arg;
+
+    pthread_mutex_lock(&gc->lock);
+    for (;;) {
+        grammar_job_t *job = gc->head;
+        while (job != NULL && grammar_job_state(job) != GRAMMAR_COMPILING)
+            job = job->next;
+        if (gc->stopping)
+            break;
+        if (job == NULL) {
+            pthread_cond_wait(&gc->job_ready, &gc->lock);
+            continue;
+        }
+
+        // Hold a reference in case the job is popped and released meanwhile.
+        grammar_job_retain(job);
+        pthread_mutex_unlock(&gc->lock);
+
+        char error[256];
+        uint64 span = trace_begin();
+        fsg_model_t *fsg = compile(gc, job, error, sizeof(error));
+        trace_end(span, "compile_grammar");
+        job->fsg = fsg;
+        if (fsg != NULL)
+            set_job_state(job, GRAMMAR_COMPILED, NULL);
+        else
+            set_job_state(job, GRAMMAR_FAILED, error);
+        grammar_job_free(job);
+
+        pthread_mutex_lock(&gc->lock);
+    }
+    pthread_mutex_unlock(&gc->lock);
+    return NULL;
+}
+
+grammar_compiler_t *
+grammar_compiler_init(logmath_t *lmath, float32 lw, const char *toprule) {
+    grammar_compiler_t *gc = ckd_calloc(1, sizeof(*gc));
+    gc->lmath = logmath_retain(lmath);
+    gc->lw = lw;
+    gc->toprule = toprule != NULL ? ckd_salloc(toprule) : NULL;
+    pthread_mutex_init(&gc->lock, NULL);
+    pthread_cond_init(&gc->job_ready, NULL);
+
+    if (pthread_create(&gc->thread, NULL, compiler_main, gc) != 0) {
+        pthread_cond_destroy(&gc->job_ready);
+        pthread_mutex_destroy(&gc->lock);
+        logmath_free(gc->lmath);
+        ckd_free(gc->toprule);
+        ckd_free(gc);
+        return NULL;
+    }
+
+    return gc;
+}
+
+static grammar_job_t *
+job_init(grammar_state_t state, ps_search_type type, const char *name,
+         const char *value, bool interrupt) {
+    grammar_job_t *job = ckd_calloc(1, sizeof(*job));
+    pthread_mutex_init(&job->lock, NULL);
+    pthread_cond_init(&job->finished, NULL);
+    job->refcount = 2; // one for the queue and one for the caller
+    job->state = state;
+    job->type = type;
+    job->name = ckd_salloc(name);
+    job->value = value != NULL ? ckd_salloc(value) : NULL;
+    job->interrupt = interrupt;
+    return job;
+}
+
+static void
+enqueue(grammar_compiler_t *gc, grammar_job_t *job) {
+    pthread_mutex_lock(&gc->lock);
+    if (gc->tail != NULL)
+        gc->tail->next = job;
+    else
+        gc->head = job;
+    gc->tail = job;
+    gc->n_jobs++;
+    pthread_cond_signal(&gc->job_ready);
+    pthread_mutex_unlock(&gc->lock);
+}
+
+grammar_job_t *
+grammar_compiler_submit(grammar_compiler_t *gc, ps_search_type type,
+                        const char *name, const char *value, bool interrupt) {
+    grammar_job_t *job = job_init(GRAMMAR_COMPILING, type, name, value,
+                                  interrupt);
+    enqueue(gc, job);
+    return job;
+}
+
+grammar_job_t *
+grammar_compiler_submit_edit(grammar_compiler_t *gc, const char *name,
+                             fsg_edit_t *edit, bool interrupt) {
+    // There is nothing to compile, but the edit waits its turn behind any
+    // searches submitted before it.
+    grammar_job_t *job = job_init(GRAMMAR_COMPILED, FSG_FILE, name, NULL,
+                                  interrupt);
+    job->edit = edit;
+    enqueue(gc, job);
+    return job;
+}
+
+grammar_job_t *
+grammar_compiler_peek(grammar_compiler_t *gc) {
+    pthread_mutex_lock(&gc->lock);
+    grammar_job_t *job = gc->head;
+    pthread_mutex_unlock(&gc->lock);
+
+    if (job != NULL && grammar_job_state(job) == GRAMMAR_COMPILING)
+        return NULL;
+    return job;
+}
+
+grammar_job_t *
+grammar_compiler_pop(grammar_compiler_t *gc) {
+    pthread_mutex_lock(&gc->lock);
+    grammar_job_t *job = gc->head;
+    if (job != NULL) {
+        gc->head = job->next;
+        if (gc->head == NULL)
+            gc->tail = NULL;
+        job->next = NULL;
+        gc->n_jobs--;
+    }
+    pthread_mutex_unlock(&gc->lock);
+    return job;
+}
+
+int
+grammar_compiler_pending(grammar_compiler_t *gc) {
+    pthread_mutex_lock(&gc->lock);
+    int n_jobs = gc->n_jobs;
+    pthread_mutex_unlock(&gc->lock);
+    return n_jobs;
+}
+
+void
+grammar_compiler_free(grammar_compiler_t *gc) {
+    if (gc == NULL)
+        return;
+
+    pthread_mutex_lock(&gc->lock);
+    gc->stopping = true;
+    pthread_cond_signal(&gc->job_ready);
+    pthread_mutex_unlock(&gc->lock);
+    pthread_join(gc->thread, NULL);
+
+    grammar_job_t *job;
+    while ((job = grammar_compiler_pop(gc)) != NULL) {
+        set_job_state(job, GRAMMAR_FAILED, "the decoder stopped compiling "
+                      "grammars before the search was set.");
+        grammar_job_free(job);
+    }
+
+    pthread_cond_destroy(&gc->job_ready);
+    pthread_mutex_destroy(&gc->lock);
+    logmath_free(gc->lmath);
+    ckd_free(gc->toprule);
+    ckd_free(gc);
+}
+
+grammar_state_t
+grammar_job_state(grammar_job_t *job) {
+    pthread_mutex_lock(&job->lock);
+    grammar_state_t state = job->state;
+    pthread_mutex_unlock(&job->lock);
+    return state;
+}
+
+grammar_state_t
+grammar_job_wait(grammar_job_t *job, double timeout) {
+    struct timespec deadline;
+    if (timeout >= 0) {
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += (time_t)timeout;
+        deadline.tv_nsec += (long)((timeout - (time_t)timeout) * 1e9);
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+    }
+
+    pthread_mutex_lock(&job->lock);
+    while (job->state == GRAMMAR_COMPILING) {
+        if (timeout < 0)
+            pthread_cond_wait(&job->finished, &job->lock);
+        else if (pthread_cond_timedwait(&job->finished, &job->lock,
+                                        &deadline) == ETIMEDOUT)
+            break;
+    }
+    grammar_state_t state = job->state;
+    pthread_mutex_unlock(&job->lock);
+    return state;
+}
+
+void
+grammar_job_finish(grammar_job_t *job, const char *error) {
+    set_job_state(job, error == NULL ? GRAMMAR_APPLIED : GRAMMAR_FAILED, error);
+
+    // The decoder holds its own reference to the model once it is set.
+    if (job->fsg != NULL)
+        fsg_model_free(job->fsg);
+    job->fsg = NULL;
+}
+
+ps_search_type
+grammar_job_type(grammar_job_t *job) {
+    return job->type;
+}
+
+const char *
+grammar_job_name(grammar_job_t *job) {
+    return job->name;
+}
+
+const char *
+grammar_job_value(grammar_job_t *job) {
+    return job->value;
+}
+
+bool
+grammar_job_interrupts(grammar_job_t *job) {
+    return job->interrupt;
+}
+
+fsg_model_t *
+grammar_job_fsg(grammar_job_t *job) {
+    return job->fsg;
+}
+
+fsg_edit_t *
+grammar_job_edit(grammar_job_t *job) {
+    return job->edit;
+}
+
+const char *
+grammar_job_error(grammar_job_t *job) {
+    pthread_mutex_lock(&job->lock);
+    const char *error = job->error;
+    pthread_mutex_unlock(&job->lock);
+    return error;
+}
+
+grammar_job_t *
+grammar_job_retain(grammar_job_t *job) {
+    pthread_mutex_lock(&job->lock);
+    job->refcount++;
+    pthread_mutex_unlock(&job->lock);
+    return job;
+}
+
+void
+grammar_job_free(grammar_job_t *job) {
+    if (job == NULL)
+        return;
+
+    pthread_mutex_lock(&job->lock);
+    int refcount = --job->refcount;
+    pthread_mutex_unlock(&job->lock);
+    if (refcount > 0)
+        return;
+
+    if (job->fsg != NULL)
+        fsg_model_free(job->fsg);
+    fsg_edits_free(job->edit);
+    pthread_cond_destroy(&job->finished);
+    pthread_mutex_destroy(&job->lock);
+    ckd_free(job->name);
+    ckd_free(job->value);
+    ckd_free(job->error);
+    ckd_free(job);
+}
@@ -0,0 +1,175 @@
+/*
+ * logqueue.c
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#include <errno.h>
+#include <semaphore.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "logqueue.h"
+
+/* A slot's sequence number tells the producers and the consumer whose turn it
+ * is: it equals the enqueue position when the slot is free, and the position
+ * plus one once the message is written.
+ */
+typedef struct {
+    uint32 sequence;
+    err_lvl_t level;
+    char message[LOG_MESSAGE_SIZE];
+} log_slot_t;
+
+static log_slot_t slots[LOG_QUEUE_SIZE];
+static uint32 enqueue_pos = 0;
+static uint32 dequeue_pos = 0;
+static uint32 n_dropped = 0;
+static err_lvl_t min_level = ERR_INFO;
+
+// Posted for each message and wakeup, so log_queue_pop can wait without
+// polling.
+static sem_t available;
+static bool woken = false;
+static bool initialised = false;
+
+// Whether the last message of this thread was queued, which decides whether
+// its continuation lines are too.
+static __thread bool last_queued = false;
+
+static void
+log_queue_cb(void *user_data, err_lvl_t level, const char *fmt, ...) {
+    bool queue = level == ERR_INFOCONT ? last_queued :
+        level >= __atomic_load_n(&min_level, __ATOMIC_RELAXED);
+    last_queued = queue;
+    if (!queue)
+        return;
+
+    // Claim the slot at the enqueue position unless the consumer hasn't freed
+    // it yet, in which case the queue is full.
+    uint32 pos = __atomic_load_n(&enqueue_pos, __ATOMIC_RELAXED);
+    log_slot_t *slot;
+    for (;;) {
+        slot = &slots[pos % LOG_QUEUE_SIZE];
+        uint32 sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+        int32 diff = (int32)(sequence - pos);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&enqueue_pos, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        } else if (diff < 0) {
+            __atomic_add_fetch(&n_dropped, 1, __ATOMIC_RELAXED);
+            return;
+        } else {
+            pos = __atomic_load_n(&enqueue_pos, __ATOMIC_RELAXED);
+        }
+    }
+
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(slot->message, sizeof(slot->message), fmt, args);
+    va_end(args);
+    slot->level = level;
+    __atomic_store_n(&slot->sequence, pos + 1, __ATOMIC_RELEASE);
+    sem_post(&available);
+}
+
+void
+log_queue_start(err_lvl_t level) {
+    if (!initialised) {
+        for (uint32 i = 0; i < LOG_QUEUE_SIZE; i++)
+            slots[i].sequence = i;
+        sem_init(&available, 0, 0);
+        initialised = true;
+    }
+    log_queue_set_level(level);
+    err_set_callback(log_queue_cb, NULL);
+}
+
+void
+log_queue_stop(void) {
+    err_set_callback(err_logfp_cb, NULL);
+}
+
+void
+log_queue_set_level(err_lvl_t level) {
+    __atomic_store_n(&min_level, level, __ATOMIC_RELAXED);
+}
+
+int
+log_queue_pop(err_lvl_t *level, char *message, int timeout_ms) {
+    struct timespec deadline;
+    if (timeout_ms > 0) {
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+    }
+
+    // Producers finish writing out of order, so the semaphore is only a hint
+    // that something changed and the slot itself says whether it's ready.
+    bool timed_out = false;
+    for (;;) {
+        log_slot_t *slot = &slots[dequeue_pos % LOG_QUEUE_SIZE];
+        if (__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) ==
+            dequeue_pos + 1) {
+            *level = slot->level;
+            memcpy(message, slot->message, LOG_MESSAGE_SIZE);
+            __atomic_store_n(&slot->sequence, dequeue_pos + LOG_QUEUE_SIZE,
+                             __ATOMIC_RELEASE);
+            dequeue_pos++;
+            return 1;
+        }
+
+        if (timed_out || timeout_ms == 0 ||
+            __atomic_exchange_n(&woken, false, __ATOMIC_ACQUIRE))
+            return 0;
+
+        int wait_result;
+        if (timeout_ms < 0)
+            wait_result = sem_wait(&available);
+        else
+            wait_result = sem_timedwait(&available, &deadline);
+        if (wait_result < 0 && errno == ETIMEDOUT)
+            timed_out = true;
+    }
+}
+
+void
+log_queue_wake(void) {
+    __atomic_store_n(&woken, true, __ATOMIC_RELEASE);
+    sem_post(&available);
+}
+
+uint32
+log_queue_take_dropped(void) {
+    return __atomic_exchange_n(&n_dropped, 0, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,404 @@
+/*
+ * longaudio.c
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <pthread.h>
+#include <sphinxbase/ckd_alloc.h>
+
+#include "longaudio.h"
+#include "psconfig.h"
+
+// Frames used for finding silences are 10ms long.
+#define ENERGY_FRAMES_PER_SEC 100
+
+// The silence threshold is this many times the energy of the quietest 10% of
+// frames, but never below MIN_SILENCE_ENERGY (roughly +/-10 amplitude).
+#define SILENCE_ENERGY_RATIO 10.0
+#define MIN_SILENCE_ENERGY 100.0
+
+typedef struct {
+    size_t start; // first sample this segment is responsible for
+    size_t end;
+    size_t decode_start; // first sample decoded, including the overlap
+    size_t decode_end;
+    long_audio_word_t *words;
+    size_t n_words;
+    size_t words_size;
+    int failed;
+} segment_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    size_t next_segment;
+    segment_t *segments;
+    size_t n_segments;
+    int16 const *samples;
+    float64 samprate;
+    int32 frate;
+    char **fillers; // words in the filler dictionary
+    size_t n_fillers;
+} long_audio_job_t;
+
+typedef struct {
+    long_audio_job_t *job;
+    ps_decoder_t *ps;
+} worker_t;
+
+static int
+compare_float64(const void *a, const void *b) {
+    float64 x = *(const float64 *)a, y = *(const float64 *)b;
+    return (x > y) - (x < y);
+}
+
+/* Find segment boundaries in the audio. Each segment is at least
+ * segment_length long where possible and ends at the middle of the first
+ * long enough silence after that. Segments without any silence are cut at
+ * twice the segment length.
+ */
+static segment_t *
+find_segments(int16 const *samples, size_t n_samples, float64 samprate,
+              long_audio_opts_t const *opts, size_t *n_segments) {
+    size_t frame_size = (size_t)(samprate / ENERGY_FRAMES_PER_SEC);
+    if (frame_size == 0)
+        frame_size = 1;
+    size_t n_frames = (n_samples + frame_size - 1) / frame_size;
+
+    // Mean square amplitude of each frame.
+    float64 *energy = ckd_calloc(n_frames + 1, sizeof(float64));
+    for (size_t f = 0; f < n_frames; f++) {
+        size_t start = f * frame_size;
+        size_t end = start + frame_size < n_samples ? start + frame_size
+                                                    : n_samples;
+        float64 sum = 0;
+        for (size_t i = start; i < end; i++)
+            sum += (float64)samples[i] * samples[i];
+        energy[f] = sum / (end - start);
+    }
+
+    float64 threshold = MIN_SILENCE_ENERGY;
+    if (n_frames > 0) {
+        float64 *sorted = ckd_calloc(n_frames, sizeof(float64));
+        memcpy(sorted, energy, n_frames * sizeof(float64));
+        qsort(sorted, n_frames, sizeof(float64), compare_float64);
+        float64 quiet = sorted[n_frames / 10] * SILENCE_ENERGY_RATIO;
+        if (quiet > threshold)
+            threshold = quiet;
+        ckd_free(sorted);
+    }
+
+    size_t segment_frames = (size_t)(opts->segment_length * ENERGY_FRAMES_PER_SEC);
+    size_t silence_frames = (size_t)(opts->min_silence * ENERGY_FRAMES_PER_SEC);
+    size_t overlap = (size_t)(opts->overlap * samprate);
+    if (segment_frames == 0)
+        segment_frames = 1;
+    if (silence_frames == 0)
+        silence_frames = 1;
+
+    // Collect cut points in frames, always starting at 0 and ending at
+    // n_frames.
+    size_t cuts_size = n_frames / segment_frames + 2, n_cuts = 0;
+    size_t *cuts = ckd_calloc(cuts_size, sizeof(size_t));
+    cuts[n_cuts++] = 0;
+    size_t segment_start = 0, silence_start = 0, silence_length = 0;
+    for (size_t f = 0; f < n_frames; f++) {
+        if (energy[f] < threshold) {
+            if (silence_length++ == 0)
+                silence_start = f;
+        } else {
+            silence_length = 0;
+        }
+
+        size_t cut = 0;
+        if (f - segment_start >= 2 * segment_frames)
+            cut = f;
+        else if (f - segment_start >= segment_frames &&
+                 silence_length >= silence_frames &&
+                 (f + 1 == n_frames || energy[f + 1] >= threshold))
+            cut = silence_start + silence_length / 2;
+
+        if (cut > segment_start && cut < n_frames) {
+            if (n_cuts + 1 >= cuts_size) {
+                cuts_size *= 2;
+                cuts = ckd_realloc(cuts, cuts_size * sizeof(size_t));
+            }
+            cuts[n_cuts++] = cut;
+            segment_start = cut;
+            silence_length = 0;
+        }
+    }
+    cuts[n_cuts++] = n_frames;
+    ckd_free(energy);
+
+    *n_segments = n_cuts - 1;
+    segment_t *segments = ckd_calloc(*n_segments, sizeof(segment_t));
+    for (size_t i = 0; i < *n_segments; i++) {
+        segment_t *segment = &segments[i];
+        segment->start = cuts[i] * frame_size;
+        segment->end = cuts[i + 1] * frame_size;
+        if (segment->end > n_samples)
+            segment->end = n_samples;
+        segment->decode_start = segment->start > overlap
+            ? segment->start - overlap : 0;
+        segment->decode_end = segment->end + overlap < n_samples
+            ? segment->end + overlap : n_samples;
+    }
+    ckd_free(cuts);
+    return segments;
+}
+
+/* Read the words of the filler dictionary named by -fdict, or the acoustic
+ * model's noisedict if it isn't set.
+ * @return the words, or NULL if there is no filler dictionary
+ */
+static char **
+read_fillers(cmd_ln_t *config, size_t *n_fillers) {
+    *n_fillers = 0;
+    const char *path = cmd_ln_str_r(config, "-fdict");
+    char default_path[4096];
+    if (path == NULL) {
+        const char *hmm = cmd_ln_str_r(config, "-hmm");
+        if (hmm == NULL)
+            return NULL;
+        snprintf(default_path, sizeof(default_path), "%s/noisedict", hmm);
+        path = default_path;
+    }
+
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+        return NULL;
+
+    size_t size = 16;
+    char **fillers = ckd_calloc(size, sizeof(char *));
+    char line[1024];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        // Each entry starts with the word; ## and ;; start comments.
+        char *word = strtok(line, " \t\r\n");
+        if (word == NULL || strncmp(word, "##", 2) == 0 ||
+            strncmp(word, ";;", 2) == 0)
+            continue;
+        if (*n_fillers == size) {
+            size *= 2;
+            fillers = ckd_realloc(fillers, size * sizeof(char *));
+        }
+        fillers[(*n_fillers)++] = ckd_salloc(word);
+    }
+    fclose(file);
+    return fillers;
+}
+
+/* Whether a segment word is a silence or filler. Alternate pronunciations of
+ * fillers, like "++NOISE++(2)", count too.
+ */
+static int
+is_filler(long_audio_job_t *job, const char *word) {
+    if (word[0] == '<' || word[0] == '[')
+        return 1;
+
+    size_t length = strlen(word);
+    const char *paren = strchr(word, '(');
+    if (paren != NULL && paren != word && word[length - 1] == ')')
+        length = paren - word;
+    for (size_t i = 0; i < job->n_fillers; i++) {
+        if (strlen(job->fillers[i]) == length &&
+            strncmp(job->fillers[i], word, length) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+static void
+segment_add_word(segment_t *segment, const char *word, float64 start,
+                 float64 end) {
+    if (segment->n_words == segment->words_size) {
+        segment->words_size = segment->words_size ? segment->words_size * 2 : 16;
+        segment->words = ckd_realloc(segment->words, segment->words_size *
+                                     sizeof(long_audio_word_t));
+    }
+
+    // Strip alternate pronunciation markers like "(2)".
+    size_t length = strlen(word);
+    const char *paren = strchr(word, '(');
+    if (paren != NULL && paren != word && word[length - 1] == ')')
+        length = paren - word;
+
+    long_audio_word_t *w = &segment->words[segment->n_words++];
+    w->word = ckd_calloc(length + 1, 1);
+    memcpy(w->word, word, length);
+    w->start = start;
+    w->end = end;
+}
+
+static void
+decode_segment(long_audio_job_t *job, ps_decoder_t *ps, segment_t *segment) {
+    if (ps_start_utt(ps) < 0 ||
+        ps_process_raw(ps, job->samples + segment->decode_start,
+                       segment->decode_end - segment->decode_start,
+                       FALSE, TRUE) < 0 ||
+        ps_end_utt(ps) < 0) {
+        segment->failed = 1;
+        return;
+    }
+
+    float64 offset = segment->decode_start / job->samprate;
+    float64 start_time = segment->start / job->samprate;
+    float64 end_time = segment->end / job->samprate;
+    for (ps_seg_t *seg = ps_seg_iter(ps); seg != NULL; seg = ps_seg_next(seg)) {
+        const char *word = ps_seg_word(seg);
+        // Skip silences and fillers.
+        if (word == NULL || is_filler(job, word))
+            continue;
+
+        int sf, ef;
+        ps_seg_frames(seg, &sf, &ef);
+        float64 start = offset + (float64)sf / job->frate;
+        float64 end = offset + (float64)(ef + 1) / job->frate;
+
+        // Words in the overlaps belong to whichever segment holds most of
+        // them.
+        float64 middle = (start + end) / 2;
+        if (middle >= start_time && middle < end_time)
+            segment_add_word(segment, word, start, end);
+    }
+}
+
+static void *
+worker_main(void *arg) {
+    worker_t *worker = arg;
+    long_audio_job_t *job = worker->job;
+
+    for (;;) {
+        pthread_mutex_lock(&job->lock);
+        size_t i = job->next_segment++;
+        pthread_mutex_unlock(&job->lock);
+        if (i >= job->n_segments)
+            break;
+        decode_segment(job, worker->ps, &job->segments[i]);
+    }
+    return NULL;
+}
+
+ssize_t
+decode_long_audio(cmd_ln_t *config, search_source_t *sources,
+                  const char *active, int16 const *samples, size_t n_samples,
+                  long_audio_opts_t const *opts, long_audio_word_t **words) {
+    long_audio_job_t job;
+    job.samples = samples;
+    job.samprate = cmd_ln_float32_r(config, "-samprate");
+    job.frate = cmd_ln_int32_r(config, "-frate");
+    job.next_segment = 0;
+    job.fillers = read_fillers(config, &job.n_fillers);
+    job.segments = find_segments(samples, n_samples, job.samprate, opts,
+                                 &job.n_segments);
+    pthread_mutex_init(&job.lock, NULL);
+
+    int n_workers = opts->n_workers;
+    if ((size_t)n_workers > job.n_segments)
+        n_workers = job.n_segments;
+    if (n_workers < 1)
+        n_workers = 1;
+
+    // Word times are only meaningful if no frames are dropped, so the worker
+    // decoders don't remove silence. They use a copy of the config, which
+    // ps_init may change, so the caller's decoder is left alone.
+    cmd_ln_t *worker_config = copy_ps_args(config);
+    int failed = worker_config == NULL;
+    if (!failed)
+        cmd_ln_set_boolean_r(worker_config, "-remove_silence", FALSE);
+
+    worker_t *workers = ckd_calloc(n_workers, sizeof(worker_t));
+    for (int i = 0; i < n_workers && !failed; i++) {
+        workers[i].job = &job;
+        workers[i].ps = ps_init(worker_config);
+        if (workers[i].ps == NULL ||
+            search_sources_apply(sources, workers[i].ps, active) < 0)
+            failed = 1;
+    }
+    if (worker_config != NULL)
+        cmd_ln_free_r(worker_config);
+
+    pthread_t *threads = ckd_calloc(n_workers, sizeof(pthread_t));
+    int n_threads = 0;
+    if (!failed) {
+        // The calling thread decodes too.
+        for (; n_threads < n_workers - 1; n_threads++) {
+            if (pthread_create(&threads[n_threads], NULL, worker_main,
+                               &workers[n_threads + 1]) != 0)
+                break;
+        }
+        worker_main(&workers[0]);
+        for (int i = 0; i < n_threads; i++)
+            pthread_join(threads[i], NULL);
+    }
+
+    // Join the segments' words in order.
+    size_t n_words = 0;
+    for (size_t i = 0; i < job.n_segments; i++) {
+        n_words += job.segments[i].n_words;
+        failed |= job.segments[i].failed;
+    }
+    *words = ckd_calloc(n_words + 1, sizeof(long_audio_word_t));
+    size_t j = 0;
+    for (size_t i = 0; i < job.n_segments; i++) {
+        segment_t *segment = &job.segments[i];
+        memcpy(*words + j, segment->words,
+               segment->n_words * sizeof(long_audio_word_t));
+        j += segment->n_words;
+        ckd_free(segment->words);
+    }
+
+    for (int i = 0; i < n_workers; i++) {
+        if (workers[i].ps != NULL)
+            ps_free(workers[i].ps);
+    }
+    ckd_free(threads);
+    ckd_free(workers);
+    ckd_free(job.segments);
+    for (size_t i = 0; i < job.n_fillers; i++)
+        ckd_free(job.fillers[i]);
+    ckd_free(job.fillers);
+    pthread_mutex_destroy(&job.lock);
+
+    if (failed) {
+        long_audio_words_free(*words, n_words);
+        *words = NULL;
+        return -1;
+    }
+    return n_words;
+}
+
+void
+long_audio_words_free(long_audio_word_t *words, size_t n_words) {
+    if (words == NULL)
+        return;
+    for (size_t i = 0; i < n_words; i++)
+        ckd_free(words[i].word);
+    ckd_free(words);
+}
@@ -0,0 +1,230 @@
+/*
+ * memreport.c
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sphinxbase/ckd_alloc.h>
+#include <sphinxbase/fsg_model.h>
+#include <sphinxbase/ngram_model.h>
+
+#include "memreport.h"
+
+// Approximate sizes of structures Pocket Sphinx doesn't expose, for a 64-bit
+// build.
+#define HMM_BYTES 96 // an HMM in a search's lexicon tree, with its links
+#define WORD_BYTES 32 // a vocabulary word's hash table entry and string
+#define FSG_STATE_BYTES 16 // a grammar state's transition tables
+#define FSG_LINK_BYTES 48 // a transition with its list and hash table entries
+#define LATNODE_BYTES 64 // a lattice node
+#define LATLINK_BYTES 80 // a lattice link with its entry and exit list cells
+
+static size_t
+file_size(const char *path) {
+    struct stat st;
+    if (path == NULL || stat(path, &st) < 0)
+        return 0;
+    return (size_t)st.st_size;
+}
+
+/* Size of the file named by a config argument, or of the file with the
+ * default name in the acoustic model directory if it isn't set.
+ */
+static size_t
+model_file_size(cmd_ln_t *config, const char *arg, const char *default_name) {
+    const char *path = cmd_ln_str_r(config, arg);
+    if (path != NULL)
+        return file_size(path);
+
+    const char *hmm = cmd_ln_str_r(config, "-hmm");
+    if (hmm == NULL)
+        return 0;
+
+    char default_path[4096];
+    snprintf(default_path, sizeof(default_path), "%s/%s", hmm, default_name);
+    return file_size(default_path);
+}
+
+size_t
+mem_acoustic_model(cmd_ln_t *config) {
+    size_t bytes = model_file_size(config, "-mdef", "mdef") +
+        model_file_size(config, "-mean", "means") +
+        model_file_size(config, "-var", "variances") +
+        model_file_size(config, "-tmat", "transition_matrices");
+
+    // Compressed mixture weights are loaded instead of the full ones.
+    size_t sendump = model_file_size(config, "-sendump", "sendump");
+    return bytes + (sendump > 0 ? sendump :
+                    model_file_size(config, "-mixw", "mixture_weights"));
+}
+
+size_t
+mem_dictionary(cmd_ln_t *config) {
+    return file_size(cmd_ln_str_r(config, "-dict")) +
+        model_file_size(config, "-fdict", "noisedict");
+}
+
+/* Number of phones in a word's pronunciation, or 0 if it has none. */
+static size_t
+count_phones(ps_decoder_t *ps, const char *word) {
+    char *phones = ps_lookup_word(ps, word);
+    if (phones == NULL)
+        return 0;
+
+    size_t n_phones = 0;
+    bool in_phone = false;
+    for (const char *c = phones; *c != '\0'; c++) {
+        if (isspace((unsigned char)*c)) {
+            in_phone = false;
+        } else if (!in_phone) {
+            in_phone = true;
+            n_phones++;
+        }
+    }
+    ckd_free(phones);
+    return n_phones;
+}
+
+/* Bits needed to store values below n. */
+static size_t
+bits_for(size_t n) {
+    size_t bits = 1;
+    while (bits < 64 && ((size_t)1 << bits) < n)
+        bits++;
+    return bits;
+}
+
+static size_t
+mem_ngram(ps_decoder_t *ps, ngram_model_t *lm) {
+    int32 order = ngram_model_get_size(lm);
+    uint32 const *counts = ngram_model_get_counts(lm);
+    if (order < 1)
+        return 0;
+
+    // Unigrams are stored whole; higher orders are bit packed with quantised
+    // probabilities and back-off weights.
+    size_t word_bits = bits_for(counts[0]);
+    size_t bytes = (size_t)counts[0] * (12 + WORD_BYTES);
+    for (int32 i = 1; i < order; i++) {
+        size_t bits = word_bits + 16;
+        if (i < order - 1)
+            bits += 16 + bits_for(counts[i + 1]);
+        bytes += ((size_t)counts[i] * bits + 7) / 8;
+    }
+
+    // At most one HMM per phone of each word, less where the lexicon tree
+    // shares prefixes.
+    for (int32 wid = 0; wid < (int32)counts[0]; wid++)
+        bytes += count_phones(ps, ngram_word(lm, wid)) * HMM_BYTES;
+    return bytes;
+}
+
+static size_t
+mem_fsg(ps_decoder_t *ps, fsg_model_t *fsg) {
+    int32 n_words = fsg_model_n_word(fsg);
+    size_t *word_hmms = ckd_calloc(n_words > 0 ? n_words : 1,
+                                   sizeof(*word_hmms));
+    for (int32 wid = 0; wid < n_words; wid++)
+        word_hmms[wid] = count_phones(ps, fsg_model_word_str(fsg, wid));
+
+    // The lexicon tree has a copy of a word's HMMs for each transition.
+    size_t bytes = (size_t)n_words * WORD_BYTES +
+        (size_t)fsg_model_n_state(fsg) * FSG_STATE_BYTES;
+    for (int32 state = 0; state < fsg_model_n_state(fsg); state++) {
+        fsg_arciter_t *itor;
+        for (itor = fsg_model_arcs(fsg, state); itor;
+             itor = fsg_arciter_next(itor)) {
+            int32 wid = fsg_link_wid(fsg_arciter_get(itor));
+            bytes += FSG_LINK_BYTES;
+            if (wid >= 0 && wid < n_words)
+                bytes += word_hmms[wid] * HMM_BYTES;
+        }
+    }
+
+    ckd_free(word_hmms);
+    return bytes;
+}
+
+static size_t
+mem_kws(ps_decoder_t *ps, const char *keyphrases) {
+    size_t bytes = strlen(keyphrases) + 1;
+
+    // Each line holds a keyphrase, optionally followed by a /threshold/.
+    char *copy = ckd_salloc(keyphrases);
+    char *save = NULL;
+    for (char *word = strtok_r(copy, " \t\r\n", &save); word != NULL;
+         word = strtok_r(NULL, " \t\r\n", &save)) {
+        if (word[0] != '/')
+            bytes += count_phones(ps, word) * HMM_BYTES;
+    }
+    ckd_free(copy);
+    return bytes;
+}
+
+size_t
+mem_search(ps_decoder_t *ps, const char *name, mem_search_type_t *type) {
+    ngram_model_t *lm = ps_get_lm(ps, name);
+    if (lm != NULL) {
+        *type = SEARCH_NGRAM;
+        return mem_ngram(ps, lm);
+    }
+
+    fsg_model_t *fsg = ps_get_fsg(ps, name);
+    if (fsg != NULL) {
+        *type = SEARCH_FSG;
+        return mem_fsg(ps, fsg);
+    }
+
+    const char *keyphrases = ps_get_kws(ps, name);
+    if (keyphrases != NULL) {
+        *type = SEARCH_KWS;
+        return mem_kws(ps, keyphrases);
+    }
+
+    *type = SEARCH_OTHER;
+    return 0;
+}
+
+size_t
+mem_lattice(ps_lattice_t *dag) {
+    if (dag == NULL)
+        return 0;
+
+    size_t bytes = 0;
+    ps_latnode_iter_t *it;
+    for (it = ps_latnode_iter(dag); it; it = ps_latnode_iter_next(it)) {
+        ps_latlink_iter_t *exits;
+        bytes += LATNODE_BYTES;
+        for (exits = ps_latnode_exits(ps_latnode_iter_node(it)); exits;
+             exits = ps_latlink_iter_next(exits))
+            bytes += LATLINK_BYTES;
+    }
+    return bytes;
+}
@@ -0,0 +1,219 @@
+/*
+ * modstate.c
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "audio.h"
+#include "modstate.h"
+
+#ifndef PYCOMPAT_MODULE_STATE
+// The state shared by the process when the static types are used directly.
+static module_state global_state;
+#endif
+
+module_state *
+get_module_state(PyObject *module) {
+#ifdef PYCOMPAT_MODULE_STATE
+    return (module_state *)PyModule_GetState(module);
+#else
+    return &global_state;
+#endif
+}
+
+module_state *
+get_type_state(PyTypeObject *type) {
+#ifdef PYCOMPAT_MODULE_STATE
+    // This only fails for types the module didn't define, which are never
+    // passed here.
+    PyObject *module = PyType_GetModuleByDef(type, &sphinxwrapper_moduledef);
+    return module != NULL ? get_module_state(module) : NULL;
+#else
+    return &global_state;
+#endif
+}
+
+#ifdef PYCOMPAT_MODULE_STATE
+/* Build a heap type for a module from a static type definition. */
+static PyTypeObject *
+heap_type_from_static(PyObject *module, PyTypeObject *type) {
+    PyType_Slot slots[32];
+    int n = 0;
+
+#define ADD_SLOT(slot_id, value)                            \
+    if ((value) != NULL)                                    \
+        slots[n++] = (PyType_Slot){slot_id, (void *)(value)}
+
+    ADD_SLOT(Py_tp_dealloc, type->tp_dealloc);
+    ADD_SLOT(Py_tp_repr, type->tp_repr);
+    ADD_SLOT(Py_tp_hash, type->tp_hash);
+    ADD_SLOT(Py_tp_call, type->tp_call);
+    ADD_SLOT(Py_tp_str, type->tp_str);
+    ADD_SLOT(Py_tp_getattro, type->tp_getattro);
+    ADD_SLOT(Py_tp_setattro, type->tp_setattro);
+    ADD_SLOT(Py_tp_doc, type->tp_doc);
+    ADD_SLOT(Py_tp_traverse, type->tp_traverse);
+    ADD_SLOT(Py_tp_clear, type->tp_clear);
+    ADD_SLOT(Py_tp_richcompare, type->tp_richcompare);
+    ADD_SLOT(Py_tp_iter, type->tp_iter);
+    ADD_SLOT(Py_tp_iternext, type->tp_iternext);
+    ADD_SLOT(Py_tp_methods, type->tp_methods);
+    ADD_SLOT(Py_tp_members, type->tp_members);
+    ADD_SLOT(Py_tp_getset, type->tp_getset);
+    ADD_SLOT(Py_tp_descr_get, type->tp_descr_get);
+    ADD_SLOT(Py_tp_descr_set, type->tp_descr_set);
+    ADD_SLOT(Py_tp_init, type->tp_init);
+    ADD_SLOT(Py_tp_alloc, type->tp_alloc);
+    ADD_SLOT(Py_tp_new, type->tp_new);
+    ADD_SLOT(Py_tp_free, type->tp_free);
+    if (type->tp_as_buffer != NULL) {
+        ADD_SLOT(Py_bf_getbuffer, type->tp_as_buffer->bf_getbuffer);
+        ADD_SLOT(Py_bf_releasebuffer, type->tp_as_buffer->bf_releasebuffer);
+    }
+#undef ADD_SLOT
+    slots[n] = (PyType_Slot){0, NULL};
+
+    // Static types can't be changed from Python, so keep it that way.
+    PyType_Spec spec = {
+        type->tp_name,
+        (int)type->tp_basicsize,
+        (int)type->tp_itemsize,
+        (unsigned int)(type->tp_flags | Py_TPFLAGS_IMMUTABLETYPE),
+        slots
+    };
+    return (PyTypeObject *)PyType_FromModuleAndSpec(module, &spec, NULL);
+}
+#endif
+
+PyTypeObject *
+add_module_type(PyObject *module, PyTypeObject *type) {
+#ifdef PYCOMPAT_MODULE_STATE
+    type = heap_type_from_static(module, type);
+    if (type == NULL)
+        return NULL;
+#else
+    if (PyType_Ready(type) < 0)
+        return NULL;
+    Py_INCREF(type);
+#endif
+
+    // The module state keeps the first reference; the module gets another.
+    const char *name = strrchr(type->tp_name, '.') + 1;
+    Py_INCREF(type);
+    if (PyModule_AddObject(module, name, (PyObject *)type) < 0) {
+        Py_DECREF(type);
+        Py_DECREF(type);
+        return NULL;
+    }
+    return type;
+}
+
+PyObject *
+add_module_exception(PyObject *module, const char *name) {
+    char full_name[64];
+    snprintf(full_name, sizeof(full_name), "sphinxwrapper.%s", name);
+    PyObject *exception = PyErr_NewException(full_name, NULL, NULL);
+    if (exception == NULL)
+        return NULL;
+
+    Py_INCREF(exception);
+    if (PyModule_AddObject(module, name, exception) < 0) {
+        Py_DECREF(exception);
+        Py_DECREF(exception);
+        return NULL;
+    }
+    return exception;
+}
+
+void
+free_module_object(PyObject *self) {
+    PyTypeObject *type = Py_TYPE(self);
+    type->tp_free(self);
+#ifdef PYCOMPAT_MODULE_STATE
+    Py_DECREF(type);
+#endif
+}
+
+#ifdef PYCOMPAT_MODULE_STATE
+int
+module_state_traverse(PyObject *module, visitproc visit, void *arg) {
+    module_state *state = get_module_state(module);
+    Py_VISIT(state->PSType);
+    Py_VISIT(state->AudioDataType);
+    Py_VISIT(state->AudioDeviceType);
+    Py_VISIT(state->AudioFileType);
+    Py_VISIT(state->StreamManagerType);
+    Py_VISIT(state->FeaturesType);
+    Py_VISIT(state->LatticeType);
+    Py_VISIT(state->SearchFutureType);
+    Py_VISIT(state->AudioRingType);
+    Py_VISIT(state->PocketSphinxError);
+    Py_VISIT(state->AudioDataError);
+    Py_VISIT(state->AudioDeviceError);
+    Py_VISIT(state->AudioFileError);
+    Py_VISIT(state->StreamManagerError);
+    Py_VISIT(state->FeaturesError);
+    Py_VISIT(state->AudioRingError);
+    return 0;
+}
+
+int
+module_state_clear(PyObject *module) {
+    module_state *state = get_module_state(module);
+    Py_CLEAR(state->PSType);
+    Py_CLEAR(state->AudioDataType);
+    Py_CLEAR(state->AudioDeviceType);
+    Py_CLEAR(state->AudioFileType);
+    Py_CLEAR(state->StreamManagerType);
+    Py_CLEAR(state->FeaturesType);
+    Py_CLEAR(state->LatticeType);
+    Py_CLEAR(state->SearchFutureType);
+    Py_CLEAR(state->AudioRingType);
+    Py_CLEAR(state->PocketSphinxError);
+    Py_CLEAR(state->AudioDataError);
+    Py_CLEAR(state->AudioDeviceError);
+    Py_CLEAR(state->AudioFileError);
+    Py_CLEAR(state->StreamManagerError);
+    Py_CLEAR(state->FeaturesError);
+    Py_CLEAR(state->AudioRingError);
+
+    // Objects on the free list have already released their type.
+    while (state->audio_data_n_free > 0) {
+        PyObject *audio_data =
+            state->audio_data_free_list[--state->audio_data_n_free];
+        obj_lock_free(&((AudioDataObj *)audio_data)->lock);
+        PyObject_Free(audio_data);
+    }
+    return 0;
+}
+
+void
+module_state_free(void *module) {
+    module_state_clear((PyObject *)module);
+}
+#endif
@@ -0,0 +1,305 @@
+/*
+ * multisearch.c
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#include <string.h>
+#include <pthread.h>
+#include <sphinxbase/ckd_alloc.h>
+#include <sphinxbase/fe.h>
+
+#include "multisearch.h"
+
+typedef struct {
+    multi_search_t *ms;
+    char *name;
+    ps_decoder_t *ps;
+    mfcc_t **cep; // private copy of the frames; CMN modifies them in place
+    int32 cep_size;
+    int generation; // last task generation this search completed
+    pthread_t thread;
+    bool started; // whether the thread was started
+} search_worker_t;
+
+struct multi_search_s {
+    decoder_pool_t *pool; // where the decoders come from and go back to
+    fe_t *fe;
+    int32 n_ceps;
+    int32 frame_shift;
+    mfcc_t **cep; // frames computed from the current chunk
+    int32 cep_size;
+    utterance_state_t state;
+
+    search_worker_t *workers;
+    int n_searches;
+
+    // The current task, read by every worker. generation is incremented for
+    // each new task and n_pending counts the workers yet to finish it.
+    pthread_mutex_t lock;
+    pthread_cond_t task_ready;
+    pthread_cond_t task_done;
+    int generation;
+    int n_pending;
+    bool stopping;
+    bool task_start_utt;
+    int32 task_n_frames;
+    bool task_end_utt;
+};
+
+/* Make sure a frame buffer has room for at least n_frames frames. */
+static void
+ensure_frames(mfcc_t ***cep, int32 *cep_size, int32 n_frames, int32 n_ceps) {
+    if (*cep_size >= n_frames)
+        return;
+
+    mfcc_t **new_cep = ckd_calloc_2d(n_frames, n_ceps, sizeof(mfcc_t));
+    if (*cep != NULL) {
+        memcpy(new_cep[0], (*cep)[0], (size_t)*cep_size * n_ceps * sizeof(mfcc_t));
+        ckd_free_2d(*cep);
+    }
+    *cep = new_cep;
+    *cep_size = n_frames;
+}
+
+static void
+run_task(search_worker_t *worker) {
+    multi_search_t *ms = worker->ms;
+    ps_decoder_t *ps = worker->ps;
+
+    if (ms->task_start_utt)
+        ps_start_utt(ps);
+
+    int32 n_frames = ms->task_n_frames;
+    if (n_frames > 0) {
+        ensure_frames(&worker->cep, &worker->cep_size, n_frames, ms->n_ceps);
+        memcpy(worker->cep[0], ms->cep[0],
+               (size_t)n_frames * ms->n_ceps * sizeof(mfcc_t));
+        ps_process_cep(ps, worker->cep, n_frames, FALSE, FALSE);
+    }
+
+    if (ms->task_end_utt)
+        ps_end_utt(ps);
+}
+
+static void *
+worker_main(void *arg) {
+    search_worker_t *worker = arg;
+    multi_search_t *ms = worker->ms;
+
+    pthread_mutex_lock(&ms->lock);
+    for (;;) {
+        while (!ms->stopping && worker->generation == ms->generation)
+            pthread_cond_wait(&ms->task_ready, &ms->lock);
+        if (ms->stopping)
+            break;
+
+        // The task fields aren't changed until every worker has finished.
+        worker->generation = ms->generation;
+        pthread_mutex_unlock(&ms->lock);
+        run_task(worker);
+        pthread_mutex_lock(&ms->lock);
+
+        if (--ms->n_pending == 0)
+            pthread_cond_signal(&ms->task_done);
+    }
+    pthread_mutex_unlock(&ms->lock);
+    return NULL;
+}
+
+/* Give the current task to every worker and wait for them to finish it. */
+static void
+run_task_on_all(multi_search_t *ms, bool start_utt, int32 n_frames,
+                bool end_utt) {
+    if (!start_utt && n_frames == 0 && !end_utt)
+        return;
+
+    pthread_mutex_lock(&ms->lock);
+    ms->task_start_utt = start_utt;
+    ms->task_n_frames = n_frames;
+    ms->task_end_utt = end_utt;
+    ms->n_pending = ms->n_searches;
+    ms->generation++;
+    pthread_cond_broadcast(&ms->task_ready);
+    while (ms->n_pending > 0)
+        pthread_cond_wait(&ms->task_done, &ms->lock);
+    pthread_mutex_unlock(&ms->lock);
+}
+
+multi_search_t *
+multi_search_init(decoder_pool_t *pool, cmd_ln_t *config,
+                  search_source_t *sources, char const **names,
+                  int n_searches) {
+    if (n_searches < 1)
+        return NULL;
+
+    fe_t *fe = fe_init_auto_r(config);
+    if (fe == NULL)
+        return NULL;
+
+    multi_search_t *ms = ckd_calloc(1, sizeof(*ms));
+    ms->pool = pool;
+    ms->fe = fe;
+    ms->n_ceps = fe_get_output_size(fe);
+    int frame_size;
+    fe_get_input_size(fe, &ms->frame_shift, &frame_size);
+    ms->state = ENDED;
+    pthread_mutex_init(&ms->lock, NULL);
+    pthread_cond_init(&ms->task_ready, NULL);
+    pthread_cond_init(&ms->task_done, NULL);
+
+    ms->workers = ckd_calloc(n_searches, sizeof(search_worker_t));
+    ms->n_searches = n_searches;
+    bool failed = false;
+    for (int i = 0; i < n_searches && !failed; i++) {
+        search_worker_t *worker = &ms->workers[i];
+        worker->ms = ms;
+        worker->name = ckd_salloc(names[i]);
+        worker->ps = decoder_pool_take(pool, config, sources, names[i]);
+        if (worker->ps == NULL ||
+            pthread_create(&worker->thread, NULL, worker_main, worker) != 0)
+            failed = true;
+        else
+            worker->started = true;
+    }
+
+    if (failed) {
+        multi_search_free(ms);
+        return NULL;
+    }
+
+    return ms;
+}
+
+utterance_event_t
+multi_search_process_raw(multi_search_t *ms, int16 const *buf,
+                         size_t n_samples) {
+    bool start_utt = false;
+    if (ms->state == ENDED) {
+        fe_start_utt(ms->fe);
+        ms->state = IDLE;
+        start_utt = true;
+    }
+
+    // Room for every frame in the chunk, the frames the front end buffered
+    // from the last chunk and the one fe_end_utt may produce.
+    int32 max_frames = (int32)(n_samples / ms->frame_shift) + 3;
+    ensure_frames(&ms->cep, &ms->cep_size, max_frames, ms->n_ceps);
+
+    int32 n_frames = 0;
+    while (n_samples > 0) {
+        // One frame is always left for fe_end_utt.
+        if (ms->cep_size - n_frames <= 1)
+            ensure_frames(&ms->cep, &ms->cep_size, ms->cep_size * 2,
+                          ms->n_ceps);
+        int32 n = ms->cep_size - n_frames - 1;
+        size_t n_before = n_samples;
+        if (fe_process_frames(ms->fe, &buf, &n_samples, ms->cep + n_frames,
+                              &n, NULL) < 0 ||
+            (n == 0 && n_samples == n_before))
+            break;
+        n_frames += n;
+    }
+
+    utterance_event_t event = utterance_update(&ms->state,
+                                               fe_get_vad_state(ms->fe));
+    bool end_utt = event == UTT_EVENT_HYPOTHESIS;
+    if (end_utt) {
+        int32 n_last = 0;
+        fe_end_utt(ms->fe, ms->cep[n_frames], &n_last);
+        n_frames += n_last;
+    }
+
+    run_task_on_all(ms, start_utt, n_frames, end_utt);
+    return event;
+}
+
+bool
+multi_search_end_utt(multi_search_t *ms) {
+    if (ms->state == ENDED)
+        return false;
+
+    int32 n_frames = 0;
+    ensure_frames(&ms->cep, &ms->cep_size, 1, ms->n_ceps);
+    fe_end_utt(ms->fe, ms->cep[0], &n_frames);
+    ms->state = ENDED;
+    run_task_on_all(ms, false, n_frames, true);
+    return true;
+}
+
+uint8
+multi_search_in_speech(multi_search_t *ms) {
+    return fe_get_vad_state(ms->fe);
+}
+
+int
+multi_search_count(multi_search_t *ms) {
+    return ms->n_searches;
+}
+
+const char *
+multi_search_name(multi_search_t *ms, int i) {
+    return ms->workers[i].name;
+}
+
+const char *
+multi_search_hyp(multi_search_t *ms, int i) {
+    return ps_get_hyp(ms->workers[i].ps, NULL);
+}
+
+void
+multi_search_free(multi_search_t *ms) {
+    if (ms == NULL)
+        return;
+
+    pthread_mutex_lock(&ms->lock);
+    ms->stopping = true;
+    pthread_cond_broadcast(&ms->task_ready);
+    pthread_mutex_unlock(&ms->lock);
+
+    for (int i = 0; i < ms->n_searches; i++) {
+        search_worker_t *worker = &ms->workers[i];
+        if (worker->started)
+            pthread_join(worker->thread, NULL);
+        // Any utterance in progress is ended so the decoder can be reused.
+        if (worker->ps != NULL && ms->state != ENDED &&
+            ps_end_utt(worker->ps) < 0)
+            ps_free(worker->ps);
+        else
+            decoder_pool_return(ms->pool, worker->ps);
+        if (worker->cep != NULL)
+            ckd_free_2d(worker->cep);
+        ckd_free(worker->name);
+    }
+
+    if (ms->cep != NULL)
+        ckd_free_2d(ms->cep);
+    fe_free(ms->fe);
+    pthread_cond_destroy(&ms->task_done);
+    pthread_cond_destroy(&ms->task_ready);
+    pthread_mutex_destroy(&ms->lock);
+    ckd_free(ms->workers);
+    ckd_free(ms);
+}
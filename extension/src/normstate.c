@@ -0,0 +1,144 @@
+/*
+ * normstate.c
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sphinxbase/ckd_alloc.h>
+#include <sphinxbase/feat.h>
+
+#include "normstate.h"
+
+#define NORM_STATE_MAGIC "SWNORM1"
+
+// Largest blob accepted from a file; real feature vectors are far smaller.
+#define MAX_NORM_STATE_SIZE 65536
+
+// Header at the start of each blob, followed by the CMN mean vector.
+typedef struct {
+    char magic[8];
+    uint32 mfcc_size; // sizeof(mfcc_t) of the build that saved the state
+    int32 veclen; // length of the CMN mean vector
+    int32 has_agc;
+    float32 agc_max;
+} norm_state_header_t;
+
+size_t
+norm_state_size(ps_decoder_t *ps) {
+    feat_t *feat = ps_get_feat(ps);
+    if (feat == NULL || feat->cmn_struct == NULL)
+        return 0;
+    return sizeof(norm_state_header_t) +
+        feat->cmn_struct->veclen * sizeof(mfcc_t);
+}
+
+int
+norm_state_get(ps_decoder_t *ps, void *buf, size_t size) {
+    feat_t *feat = ps_get_feat(ps);
+    if (size == 0 || size != norm_state_size(ps))
+        return -1;
+
+    norm_state_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, NORM_STATE_MAGIC, sizeof(NORM_STATE_MAGIC));
+    header.mfcc_size = sizeof(mfcc_t);
+    header.veclen = feat->cmn_struct->veclen;
+    if (feat->agc_struct != NULL) {
+        header.has_agc = 1;
+        header.agc_max = agc_emax_get(feat->agc_struct);
+    }
+
+    memcpy(buf, &header, sizeof(header));
+    cmn_prior_get(feat->cmn_struct, (mfcc_t *)((char *)buf + sizeof(header)));
+    return 0;
+}
+
+int
+norm_state_set(ps_decoder_t *ps, void const *buf, size_t size) {
+    feat_t *feat = ps_get_feat(ps);
+    norm_state_header_t header;
+    if (size < sizeof(header) || size != norm_state_size(ps))
+        return -1;
+
+    memcpy(&header, buf, sizeof(header));
+    if (memcmp(header.magic, NORM_STATE_MAGIC, sizeof(NORM_STATE_MAGIC)) != 0 ||
+        header.mfcc_size != sizeof(mfcc_t) ||
+        header.veclen != feat->cmn_struct->veclen)
+        return -1;
+
+    // Copy the vector out in case buf isn't suitably aligned.
+    mfcc_t *mean = ckd_calloc(header.veclen, sizeof(mfcc_t));
+    memcpy(mean, (char const *)buf + sizeof(header),
+           header.veclen * sizeof(mfcc_t));
+    cmn_prior_set(feat->cmn_struct, mean);
+    ckd_free(mean);
+
+    if (header.has_agc && feat->agc_struct != NULL)
+        agc_emax_set(feat->agc_struct, header.agc_max);
+    return 0;
+}
+
+int
+norm_state_save(ps_decoder_t *ps, const char *path) {
+    size_t size = norm_state_size(ps);
+    if (size == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    char *buf = ckd_calloc(size, 1);
+    norm_state_get(ps, buf, size);
+    FILE *file = fopen(path, "wb");
+    int failed = file == NULL || fwrite(buf, size, 1, file) != 1;
+    if (file != NULL && fclose(file) != 0)
+        failed = 1;
+    ckd_free(buf);
+    return failed ? -1 : 0;
+}
+
+int
+norm_state_load(ps_decoder_t *ps, const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+        return -1;
+
+    char *buf = ckd_calloc(MAX_NORM_STATE_SIZE, 1);
+    size_t size = fread(buf, 1, MAX_NORM_STATE_SIZE, file);
+    int read_failed = ferror(file);
+    fclose(file);
+
+    int result = -1;
+    if (read_failed)
+        errno = EIO;
+    else if (norm_state_set(ps, buf, size) < 0)
+        errno = EINVAL;
+    else
+        result = 0;
+    ckd_free(buf);
+    return result;
+}
@@ -0,0 +1,91 @@
+/*
+ * objlock.c
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#include "objlock.h"
+
+int
+obj_lock_init(obj_lock_t *lock) {
+    lock->lock = PyThread_allocate_lock();
+    lock->owner = 0;
+    lock->depth = 0;
+    if (lock->lock == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    return 0;
+}
+
+void
+obj_lock_free(obj_lock_t *lock) {
+    if (lock->lock != NULL)
+        PyThread_free_lock(lock->lock);
+    lock->lock = NULL;
+}
+
+void
+obj_lock_acquire(obj_lock_t *lock) {
+    // Only the owner stores its own ident, so other threads can't match it.
+    unsigned long ident = PyThread_get_thread_ident();
+    if (__atomic_load_n(&lock->owner, __ATOMIC_ACQUIRE) == ident) {
+        lock->depth++;
+        return;
+    }
+
+    if (!PyThread_acquire_lock(lock->lock, NOWAIT_LOCK)) {
+        // Let the holder run, and take the GIL back, while waiting.
+        Py_BEGIN_ALLOW_THREADS
+        PyThread_acquire_lock(lock->lock, WAIT_LOCK);
+        Py_END_ALLOW_THREADS
+    }
+    __atomic_store_n(&lock->owner, ident, __ATOMIC_RELEASE);
+    lock->depth = 1;
+}
+
+int
+obj_lock_try_acquire(obj_lock_t *lock) {
+    unsigned long ident = PyThread_get_thread_ident();
+    if (__atomic_load_n(&lock->owner, __ATOMIC_ACQUIRE) == ident) {
+        lock->depth++;
+        return 1;
+    }
+
+    if (!PyThread_acquire_lock(lock->lock, NOWAIT_LOCK))
+        return 0;
+    __atomic_store_n(&lock->owner, ident, __ATOMIC_RELEASE);
+    lock->depth = 1;
+    return 1;
+}
+
+void
+obj_lock_release(obj_lock_t *lock) {
+    if (--lock->depth > 0)
+        return;
+
+    __atomic_store_n(&lock->owner, 0, __ATOMIC_RELEASE);
+    PyThread_release_lock(lock->lock);
+}
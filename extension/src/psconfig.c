@@ -0,0 +1,114 @@
+/*
+ * psconfig.c
+ *
+ * Part of this file is based on source code from the CMU Pocket Sphinx project.
+ * As such, the below copyright notice and conditions apply IN ADDITION TO the 
+ * sphinxwrapper project's LICENSE file.
+ *
+ * ====================================================================
+ * Copyright (c) 1999-2016 Carnegie Mellon University.  All rights
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND 
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ *
+ */
+
+#include <string.h>
+
+#include "psconfig.h"
+
+const arg_t cont_args_def[] = {
+    POCKETSPHINX_OPTIONS,
+    /* Argument file. */
+    {"-argfile",
+     ARG_STRING,
+     NULL, 
+     "Argument file giving extra arguments."},
+    CMDLN_EMPTY_OPTION
+};
+
+cmd_ln_t *
+parse_ps_args(int argc, char *argv[]) {
+    char const *cfg; 
+    cmd_ln_t *config = cmd_ln_parse_r(NULL, cont_args_def, argc, argv, TRUE);
+    
+    /* Handle argument file as -argfile. */
+    if (config && (cfg = cmd_ln_str_r(config, "-argfile")) != NULL) {
+        config = cmd_ln_parse_file_r(config, cont_args_def, cfg, FALSE);
+    }
+
+    if (config == NULL) {
+        return NULL;
+    }
+    
+    ps_default_search_args(config);
+    return config;
+}
+
+cmd_ln_t *
+copy_ps_args(cmd_ln_t *config) {
+    cmd_ln_t *copy = cmd_ln_init(NULL, cont_args_def, FALSE, NULL);
+    if (copy == NULL)
+        return NULL;
+
+    // Pocket Sphinx has no string list arguments, so those are left alone.
+    for (arg_t const *arg = cont_args_def; arg->name != NULL; arg++) {
+        int type = arg->type & ~ARG_REQUIRED;
+        if (type == ARG_STRING)
+            cmd_ln_set_str_r(copy, arg->name, cmd_ln_str_r(config, arg->name));
+        else if (type == ARG_INTEGER || type == ARG_BOOLEAN)
+            cmd_ln_set_int_r(copy, arg->name, cmd_ln_int_r(config, arg->name));
+        else if (type == ARG_FLOATING)
+            cmd_ln_set_float_r(copy, arg->name,
+                               cmd_ln_float_r(config, arg->name));
+    }
+
+    return copy;
+}
+
+bool
+ps_args_equal(cmd_ln_t *a, cmd_ln_t *b) {
+    for (arg_t const *arg = cont_args_def; arg->name != NULL; arg++) {
+        int type = arg->type & ~ARG_REQUIRED;
+        if (type == ARG_STRING) {
+            char const *a_str = cmd_ln_str_r(a, arg->name);
+            char const *b_str = cmd_ln_str_r(b, arg->name);
+            if (a_str != b_str && (a_str == NULL || b_str == NULL ||
+                                   strcmp(a_str, b_str) != 0))
+                return false;
+        } else if (type == ARG_INTEGER || type == ARG_BOOLEAN) {
+            if (cmd_ln_int_r(a, arg->name) != cmd_ln_int_r(b, arg->name))
+                return false;
+        } else if (type == ARG_FLOATING) {
+            if (cmd_ln_float_r(a, arg->name) != cmd_ln_float_r(b, arg->name))
+                return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,494 @@
+/*
+ * pyaudioring.c
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#include <errno.h>
+#include <limits.h>
+
+#include "pyaudioring.h"
+#include "trace.h"
+
+/* Return the ring of an AudioRing object or set an error and return NULL. */
+static audio_ring_t *
+get_audio_ring(AudioRingObj *self) {
+    if (self->ring == NULL)
+        PyErr_SetString(GET_MODULE_STATE(self)->AudioRingError,
+                        "AudioRing is not initialised.");
+    return self->ring;
+}
+
+/*
+ * Convert a timeout in seconds, or None to wait forever, to milliseconds.
+ * @return 0 on success, -1 with an exception set on failure
+ */
+static int
+get_timeout_ms(PyObject *timeout, int *timeout_ms) {
+    if (timeout == Py_None) {
+        *timeout_ms = -1;
+        return 0;
+    }
+
+    double seconds = PyFloat_AsDouble(timeout);
+    if (seconds == -1.0 && PyErr_Occurred())
+        return -1;
+    if (seconds < 0) {
+        PyErr_SetString(PyExc_ValueError, "timeout must not be negative.");
+        return -1;
+    }
+
+    *timeout_ms = seconds * 1000 > INT_MAX ? INT_MAX : (int)(seconds * 1000);
+    return 0;
+}
+
+/* Release the audio referenced by the last AudioData object read, unsetting
+ * the object so that it can't be used to reach audio the writer may overwrite.
+ */
+static void
+release_acquired(AudioRingObj *self) {
+    AudioDataObj *view = self->view;
+    self->view = NULL;
+    if (view != NULL) {
+        view->samples = NULL;
+        view->n_samples = 0;
+        view->is_set = false;
+        Py_CLEAR(view->base);
+    }
+
+    if (self->n_acquired > 0)
+        audio_ring_release(self->ring, self->n_acquired);
+    self->n_acquired = 0;
+}
+
+void
+AudioRingObj_forget_view(AudioRingObj *self, AudioDataObj *view) {
+    if (self->view == view)
+        self->view = NULL;
+}
+
+PyObject *
+AudioRingObj_write(AudioRingObj *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"audio", "timeout", NULL};
+    PyObject *audio = NULL;
+    PyObject *timeout = Py_None;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|O", kwlist, &audio,
+                                     &timeout))
+        return NULL;
+
+    int timeout_ms;
+    audio_ring_t *ring = get_audio_ring(self);
+    if (ring == NULL || get_timeout_ms(timeout, &timeout_ms) < 0)
+        return NULL;
+
+    Py_buffer view;
+    int16 const *samples;
+    size_t n_samples;
+    if (get_audio_samples(GET_MODULE_STATE(self), audio, &view, &samples,
+                          &n_samples) < 0)
+        return NULL;
+
+    // Wait for the reader to make room without the GIL.
+    int32 n_written;
+    Py_INCREF(audio);
+    obj_lock_acquire(&self->write_lock);
+    Py_BEGIN_ALLOW_THREADS
+    n_written = audio_ring_write(ring, samples, n_samples, timeout_ms);
+    Py_END_ALLOW_THREADS
+    obj_lock_release(&self->write_lock);
+    PyBuffer_Release(&view);
+    Py_DECREF(audio);
+
+    if (n_written < 0) {
+        PyErr_SetString(GET_MODULE_STATE(self)->AudioRingError,
+                        "The audio ring is closed.");
+        return NULL;
+    }
+    return PyLong_FromLong(n_written);
+}
+
+PyObject *
+AudioRingObj_read_audio(AudioRingObj *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"n_samples", "timeout", NULL};
+    int32 max_samples = 2048;
+    PyObject *timeout = Py_None;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|iO", kwlist, &max_samples,
+                                     &timeout))
+        return NULL;
+
+    int timeout_ms;
+    audio_ring_t *ring = get_audio_ring(self);
+    if (ring == NULL || get_timeout_ms(timeout, &timeout_ms) < 0)
+        return NULL;
+
+    if (max_samples <= 0) {
+        PyErr_SetString(PyExc_ValueError, "n_samples must be positive.");
+        return NULL;
+    }
+
+    // The previous AudioData object is only valid until this read.
+    int16 const *samples;
+    int32 n_samples;
+    obj_lock_acquire(&self->read_lock);
+    release_acquired(self);
+    Py_BEGIN_ALLOW_THREADS
+    n_samples = audio_ring_acquire(ring, max_samples, &samples, timeout_ms);
+    Py_END_ALLOW_THREADS
+
+    // Nothing was read before the timeout or the end of the audio.
+    if (n_samples <= 0) {
+        obj_lock_release(&self->read_lock);
+        Py_INCREF(Py_None);
+        return Py_None;
+    }
+
+    PyObject *result = AudioDataObj_new_view(GET_MODULE_STATE(self),
+                                             (PyObject *)self,
+                                             (int16 *)samples, n_samples);
+    if (result == NULL) {
+        audio_ring_release(ring, n_samples);
+    } else {
+        self->n_acquired = n_samples;
+        self->view = (AudioDataObj *)result;
+    }
+    obj_lock_release(&self->read_lock);
+    return result;
+}
+
+PyObject *
+AudioRingObj_release(AudioRingObj *self) {
+    if (get_audio_ring(self) == NULL)
+        return NULL;
+
+    obj_lock_acquire(&self->read_lock);
+    release_acquired(self);
+    obj_lock_release(&self->read_lock);
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+PyObject *
+AudioRingObj_close(AudioRingObj *self) {
+    audio_ring_t *ring = get_audio_ring(self);
+    if (ring == NULL)
+        return NULL;
+
+    audio_ring_close(ring);
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+PyObject *
+AudioRingObj_iternext(AudioRingObj *self) {
+    PyObject *args = PyTuple_New(0);
+    if (args == NULL)
+        return NULL;
+    PyObject *result = AudioRingObj_read_audio(self, args, NULL);
+    Py_DECREF(args);
+
+    // None signals the end of iteration, which is done by returning NULL
+    // without an exception set.
+    if (result == Py_None) {
+        Py_DECREF(result);
+        return NULL;
+    }
+    return result;
+}
+
+PyObject *
+AudioRingObj_get_name(AudioRingObj *self, void *closure) {
+    audio_ring_t *ring = get_audio_ring(self);
+    if (ring == NULL)
+        return NULL;
+    return Py_BuildValue("s", ring->name);
+}
+
+PyObject *
+AudioRingObj_get_capacity(AudioRingObj *self, void *closure) {
+    audio_ring_t *ring = get_audio_ring(self);
+    if (ring == NULL)
+        return NULL;
+    return PyLong_FromUnsignedLong(audio_ring_capacity(ring));
+}
+
+PyObject *
+AudioRingObj_get_available(AudioRingObj *self, void *closure) {
+    audio_ring_t *ring = get_audio_ring(self);
+    if (ring == NULL)
+        return NULL;
+    return PyLong_FromUnsignedLong(audio_ring_available(ring));
+}
+
+PyObject *
+AudioRingObj_get_closed(AudioRingObj *self, void *closure) {
+    audio_ring_t *ring = get_audio_ring(self);
+    if (ring == NULL)
+        return NULL;
+    return PyBool_FromLong(audio_ring_closed(ring));
+}
+
+void
+AudioRingObj_dealloc(AudioRingObj *self) {
+    // AudioData views keep this object alive, so the last read's audio is no
+    // longer in use and the writer may have its space back.
+    if (self->ring != NULL) {
+        release_acquired(self);
+        audio_ring_free(self->ring);
+    }
+    obj_lock_free(&self->read_lock);
+    obj_lock_free(&self->write_lock);
+
+    // Free the Python type object
+    free_module_object((PyObject *)self);
+}
+
+PyObject *
+AudioRingObj_new(PyTypeObject *type, PyObject *args, PyObject *kwds) {
+    AudioRingObj *self;
+
+    self = (AudioRingObj *)type->tp_alloc(type, 0);
+    if (self != NULL) {
+        self->ring = NULL;
+        self->n_acquired = 0;
+        self->view = NULL;
+
+        if (obj_lock_init(&self->read_lock) < 0 ||
+            obj_lock_init(&self->write_lock) < 0) {
+            Py_DECREF(self);
+            return NULL;
+        }
+    }
+
+    return (PyObject *)self;
+}
+
+int
+AudioRingObj_init(AudioRingObj *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"name", "capacity", NULL};
+    const char *name = NULL;
+    unsigned int capacity = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|I", kwlist, &name,
+                                     &capacity))
+        return -1;
+
+    if (self->ring != NULL) {
+        PyErr_SetString(GET_MODULE_STATE(self)->AudioRingError,
+                        "AudioRing is already initialised.");
+        return -1;
+    }
+
+    // Create the ring if given a capacity, otherwise open an existing one.
+    if (capacity > 0)
+        self->ring = audio_ring_create(name, capacity);
+    else
+        self->ring = audio_ring_open(name);
+
+    if (self->ring == NULL) {
+        if (errno == EINVAL && capacity > 0)
+            PyErr_SetString(PyExc_ValueError, "capacity must be a power of "
+                            "two no greater than 2**30.");
+        else if (errno == EINVAL)
+            PyErr_Format(GET_MODULE_STATE(self)->AudioRingError,
+                         "'%s' is not an audio ring.", name);
+        else
+            PyErr_SetFromErrnoWithFilename(PyExc_OSError, name);
+        return -1;
+    }
+
+    return 0;
+}
+
+PyObject *
+AudioDeviceObj_read_into_ring(AudioDeviceObj *self, PyObject *args,
+                              PyObject *kwds) {
+    static char *kwlist[] = {"ring", "timeout", NULL};
+    PyObject *ring_obj = NULL;
+    PyObject *timeout = Py_None;
+    module_state *state = GET_MODULE_STATE(self);
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!|O", kwlist,
+                                     state->AudioRingType, &ring_obj,
+                                     &timeout))
+        return NULL;
+
+    AudioRingObj *ring_c = (AudioRingObj *)ring_obj;
+    int timeout_ms;
+    audio_ring_t *ring = get_audio_ring(ring_c);
+    if (ring == NULL || get_timeout_ms(timeout, &timeout_ms) < 0)
+        return NULL;
+
+    if (self->ad == NULL) {
+        PyErr_SetString(state->AudioDeviceError,
+                        "Failed to read audio. Have you called open() and "
+                        "record()?");
+        return NULL;
+    }
+
+    // Wait for space as the ring's write method does, then read the device's
+    // audio into the ring's memory.
+    int16 *space;
+    int32 n_space;
+    obj_lock_acquire(&ring_c->write_lock);
+    Py_BEGIN_ALLOW_THREADS
+    n_space = audio_ring_reserve(ring, 2048, &space, timeout_ms);
+    Py_END_ALLOW_THREADS
+
+    if (n_space < 0) {
+        obj_lock_release(&ring_c->write_lock);
+        PyErr_SetString(state->AudioRingError, "The audio ring is closed.");
+        return NULL;
+    }
+
+    int32 n_samples = 0;
+    if (n_space > 0) {
+        uint64 span = trace_begin();
+        n_samples = ad_read(self->ad, space, n_space);
+        trace_end(span, "ad_read");
+        if (n_samples > 0)
+            audio_ring_commit(ring, n_samples);
+    }
+    obj_lock_release(&ring_c->write_lock);
+
+    if (n_samples < 0) {
+        PyErr_SetString(state->AudioDeviceError, "Failed to read audio.");
+        return NULL;
+    }
+    return PyLong_FromLong(n_samples);
+}
+
+PyMethodDef AudioRingObj_methods[] = {
+    {"write",
+     (PyCFunction)AudioRingObj_write, METH_KEYWORDS | METH_VARARGS,
+     PyDoc_STR("Copy audio into the ring, waiting for the reader to make room "
+               "if it is full. Return the number of samples written, which is "
+               "less than the number given if the timeout expired.\n\n"
+               "Keyword arguments:\n"
+               "audio -- AudioData, AudioFile or buffer of 16-bit audio.\n"
+               "timeout -- seconds to wait for room, or None to wait as long "
+               "as needed (default None).\n"
+               ":rtype: int")},
+    {"read_audio",
+     (PyCFunction)AudioRingObj_read_audio, METH_KEYWORDS | METH_VARARGS,
+     PyDoc_STR("Wait for audio and return it as an AudioData object "
+               "referencing the ring's memory, or return None if the timeout "
+               "expired or the ring is closed and empty.\n"
+               "The audio is not copied, so the AudioData object is only valid "
+               "until the next read or release() call, which hand its space "
+               "back to the writer. Using it after that raises "
+               "AudioDataError.\n\n"
+               "Keyword arguments:\n"
+               "n_samples -- maximum number of samples to read (default "
+               "2048).\n"
+               "timeout -- seconds to wait for audio, or None to wait as long "
+               "as needed (default None).\n"
+               ":rtype: AudioData")},
+    {"release",
+     (PyCFunction)AudioRingObj_release, METH_NOARGS,
+     PyDoc_STR("Hand the space of the last audio read back to the writer "
+               "without reading more.")},
+    {"close",
+     (PyCFunction)AudioRingObj_close, METH_NOARGS,
+     PyDoc_STR("Mark the end of the audio. The reader gets the audio left in "
+               "the ring and then None, and further writes fail.")},
+    {NULL}  /* Sentinel */
+};
+
+PyGetSetDef AudioRingObj_getseters[] = {
+    {"name",
+     (getter)AudioRingObj_get_name, NULL,
+     "The shared memory name of the ring.", NULL},
+    {"capacity",
+     (getter)AudioRingObj_get_capacity, NULL,
+     "The number of samples the ring holds.", NULL},
+    {"available",
+     (getter)AudioRingObj_get_available, NULL,
+     "The number of samples written and not yet released.", NULL},
+    {"closed",
+     (getter)AudioRingObj_get_closed, NULL,
+     "Whether the ring has been closed.", NULL},
+    {NULL}  /* Sentinel */
+};
+
+PyTypeObject AudioRingType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "sphinxwrapper.AudioRing",            /* tp_name */
+    sizeof(AudioRingObj),                 /* tp_basicsize */
+    0,                                    /* tp_itemsize */
+    (destructor)AudioRingObj_dealloc,     /* tp_dealloc */
+    0,                                    /* tp_print */
+    0,                                    /* tp_getattr */
+    0,                                    /* tp_setattr */
+    0,                                    /* tp_compare */
+    0,                                    /* tp_repr */
+    0,                                    /* tp_as_number */
+    0,                                    /* tp_as_sequence */
+    0,                                    /* tp_as_mapping */
+    0,                                    /* tp_hash */
+    0,                                    /* tp_call */
+    0,                                    /* tp_str */
+    0,                                    /* tp_getattro */
+    0,                                    /* tp_setattro */
+    0,                                    /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT |
+    Py_TPFLAGS_BASETYPE,                  /* tp_flags */
+    "Ring buffer of audio in shared "
+    "memory for passing audio between "
+    "processes without copying it.",      /* tp_doc */
+    0,                                    /* tp_traverse */
+    0,                                    /* tp_clear */
+    0,                                    /* tp_richcompare */
+    0,                                    /* tp_weaklistoffset */
+    PyObject_SelfIter,                    /* tp_iter */
+    (iternextfunc)AudioRingObj_iternext,  /* tp_iternext */
+    AudioRingObj_methods,                 /* tp_methods */
+    0,                                    /* tp_members */
+    AudioRingObj_getseters,               /* tp_getset */
+    0,                                    /* tp_base */
+    0,                                    /* tp_dict */
+    0,                                    /* tp_descr_get */
+    0,                                    /* tp_descr_set */
+    0,                                    /* tp_dictoffset */
+    (initproc)AudioRingObj_init,          /* tp_init */
+    0,                                    /* tp_alloc */
+    AudioRingObj_new,                     /* tp_new */
+};
+
+PyObject *
+initaudioring(PyObject *module) {
+    module_state *state = get_module_state(module);
+    state->AudioRingType = add_module_type(module, &AudioRingType);
+    if (state->AudioRingType == NULL)
+        return NULL;
+
+    state->AudioRingError = add_module_exception(module, "AudioRingError");
+    if (state->AudioRingError == NULL)
+        return NULL;
+
+    return module;
+}
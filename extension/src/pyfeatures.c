@@ -0,0 +1,359 @@
+/*
+ * pyfeatures.c
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#include <errno.h>
+#include <sphinxbase/ckd_alloc.h>
+
+#include "pypocketsphinx.h"
+#include "pyfeatures.h"
+
+/* Return the store of a Features object or set an error and return NULL. */
+static feat_store_t *
+get_feat_store(module_state *state, PyObject *features) {
+    if (!PyObject_TypeCheck(features, state->FeaturesType)) {
+        PyErr_SetString(PyExc_TypeError, "argument must be a Features object.");
+        return NULL;
+    }
+
+    feat_store_t *store = ((FeaturesObj *)features)->store;
+    if (store == NULL)
+        PyErr_SetString(state->FeaturesError, "Features object is not "
+                        "initialised.");
+    return store;
+}
+
+PyObject *
+PSObj_extract_features(PSObj *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"audio", NULL};
+    PyObject *audio = NULL;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O", kwlist, &audio))
+        return NULL;
+
+    cmd_ln_t *config = get_cmd_ln_t(self);
+    if (config == NULL)
+        return NULL;
+
+    Py_buffer view;
+    int16 const *samples;
+    size_t n_samples;
+    if (get_audio_samples(GET_MODULE_STATE(self), audio, &view, &samples,
+                          &n_samples) < 0)
+        return NULL;
+
+    feat_store_t *store;
+    Py_INCREF(audio);
+    Py_BEGIN_ALLOW_THREADS
+    store = feat_store_extract(config, samples, n_samples);
+    Py_END_ALLOW_THREADS
+    PyBuffer_Release(&view);
+    Py_DECREF(audio);
+
+    if (store == NULL) {
+        PyErr_SetString(GET_MODULE_STATE(self)->FeaturesError,
+                        "something went wrong whilst extracting "
+                        "features.");
+        return NULL;
+    }
+
+    PyObject *result = FeaturesObj_from_store(GET_MODULE_STATE(self), store);
+    if (result == NULL)
+        feat_store_free(store);
+    return result;
+}
+
+PyObject *
+PSObj_decode_features(PSObj *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"features", "searches", NULL};
+    PyObject *features = NULL;
+    PyObject *searches = Py_None;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|O", kwlist, &features,
+                                     &searches))
+        return NULL;
+
+    ps_decoder_t *ps = get_ps_decoder_t(self);
+    cmd_ln_t *config = get_cmd_ln_t(self);
+    feat_store_t *store = get_feat_store(GET_MODULE_STATE(self), features);
+    if (ps == NULL || config == NULL || store == NULL)
+        return NULL;
+
+    // Hold a reference so the frames stay valid while the GIL is released.
+    Py_INCREF(features);
+
+    // Decode with the active search on this decoder.
+    if (searches == Py_None) {
+        utterance_end(ps, &self->utterance_state);
+
+        int decode_result;
+        Py_BEGIN_ALLOW_THREADS
+        decode_result = feat_store_decode(store, ps);
+        Py_END_ALLOW_THREADS
+        Py_DECREF(features);
+
+        if (decode_result < 0) {
+            PyErr_SetString(GET_MODULE_STATE(self)->PocketSphinxError,
+                            "something went wrong whilst "
+                            "decoding features. Were they extracted with the "
+                            "same acoustic model?");
+            return NULL;
+        }
+
+        const char *hyp = ps_get_hyp(ps, NULL);
+        return Py_BuildValue("s", hyp);
+    }
+
+    // Otherwise decode with each named search concurrently.
+    PyObject *result = NULL;
+    char **hyps = NULL;
+    Py_ssize_t n_searches = 0;
+    char **names = string_list_to_array(searches, &n_searches);
+    if (names == NULL)
+        goto done;
+
+    if (n_searches == 0) {
+        result = PyDict_New();
+        goto done;
+    }
+
+    hyps = PyMem_New(char *, n_searches);
+    if (hyps == NULL) {
+        PyErr_NoMemory();
+        goto done;
+    }
+
+    int decode_result;
+    Py_BEGIN_ALLOW_THREADS
+    decode_result = feat_store_decode_searches(store, self->decoder_pool,
+                                               config, self->search_sources,
+                                               (char const **)names,
+                                               n_searches, hyps);
+    Py_END_ALLOW_THREADS
+
+    if (decode_result < 0) {
+        PyErr_SetString(GET_MODULE_STATE(self)->PocketSphinxError,
+                        "something went wrong whilst "
+                        "decoding features. Do all of the searches exist?");
+        goto done;
+    }
+
+    result = PyDict_New();
+    for (Py_ssize_t i = 0; i < n_searches; i++) {
+        PyObject *hyp = Py_BuildValue("s", hyps[i]);
+        if (result != NULL && (hyp == NULL ||
+                               PyDict_SetItemString(result, names[i], hyp) < 0))
+            Py_CLEAR(result);
+        Py_XDECREF(hyp);
+        ckd_free(hyps[i]);
+    }
+
+done:
+    PyMem_Free(hyps);
+    PyMem_Free(names);
+    Py_DECREF(features);
+    return result;
+}
+
+PyObject *
+FeaturesObj_from_store(module_state *state, feat_store_t *store) {
+    PyTypeObject *type = state->FeaturesType;
+    FeaturesObj *self = (FeaturesObj *)type->tp_alloc(type, 0);
+    if (self != NULL)
+        self->store = store;
+    return (PyObject *)self;
+}
+
+PyObject *
+FeaturesObj_save(FeaturesObj *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"path", NULL};
+    const char *path = NULL;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s", kwlist, &path))
+        return NULL;
+
+    feat_store_t *store = get_feat_store(GET_MODULE_STATE(self),
+                                         (PyObject *)self);
+    if (store == NULL)
+        return NULL;
+
+    int save_result;
+    Py_BEGIN_ALLOW_THREADS
+    save_result = feat_store_save(store, path);
+    Py_END_ALLOW_THREADS
+    if (save_result < 0)
+        return PyErr_SetFromErrnoWithFilename(PyExc_IOError, path);
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+PyObject *
+FeaturesObj_get_n_frames(FeaturesObj *self, void *closure) {
+    feat_store_t *store = get_feat_store(GET_MODULE_STATE(self),
+                                         (PyObject *)self);
+    if (store == NULL)
+        return NULL;
+    return Py_BuildValue("i", store->n_frames);
+}
+
+PyObject *
+FeaturesObj_get_n_ceps(FeaturesObj *self, void *closure) {
+    feat_store_t *store = get_feat_store(GET_MODULE_STATE(self),
+                                         (PyObject *)self);
+    if (store == NULL)
+        return NULL;
+    return Py_BuildValue("i", store->n_ceps);
+}
+
+void
+FeaturesObj_dealloc(FeaturesObj *self) {
+    feat_store_free(self->store);
+
+    // Free the Python type object
+    free_module_object((PyObject *)self);
+}
+
+PyObject *
+FeaturesObj_new(PyTypeObject *type, PyObject *args, PyObject *kwds) {
+    FeaturesObj *self;
+
+    self = (FeaturesObj *)type->tp_alloc(type, 0);
+    if (self != NULL) {
+        self->store = NULL;
+    }
+
+    return (PyObject *)self;
+}
+
+int
+FeaturesObj_init(FeaturesObj *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"path", NULL};
+    const char *path = NULL;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s", kwlist, &path))
+        return -1;
+
+    if (self->store != NULL) {
+        PyErr_SetString(GET_MODULE_STATE(self)->FeaturesError,
+                        "Features object is already "
+                        "initialised.");
+        return -1;
+    }
+
+    self->store = feat_store_load(path);
+    if (self->store == NULL) {
+        if (errno == EINVAL)
+            PyErr_Format(GET_MODULE_STATE(self)->FeaturesError,
+                         "'%s' is not a feature file saved by "
+                         "this build.", path);
+        else
+            PyErr_SetFromErrnoWithFilename(PyExc_IOError, path);
+        return -1;
+    }
+
+    return 0;
+}
+
+PyMethodDef FeaturesObj_methods[] = {
+    {"save",
+     (PyCFunction)FeaturesObj_save, METH_KEYWORDS | METH_VARARGS,
+     PyDoc_STR(
+         "Save the features to a file. Saved features can be loaded with "
+         "Features(path), which memory maps the file.\n\n"
+         "Keyword arguments:\n"
+         "path -- file path to save to.\n")},
+    {NULL}  /* Sentinel */
+};
+
+PyGetSetDef FeaturesObj_getseters[] = {
+    {"n_frames",
+     (getter)FeaturesObj_get_n_frames, NULL,
+     "The number of cepstral frames.", NULL},
+    {"n_ceps",
+     (getter)FeaturesObj_get_n_ceps, NULL,
+     "The number of values in each frame.", NULL},
+    {NULL}  /* Sentinel */
+};
+
+PyTypeObject FeaturesType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "sphinxwrapper.Features",             /* tp_name */
+    sizeof(FeaturesObj),                  /* tp_basicsize */
+    0,                                    /* tp_itemsize */
+    (destructor)FeaturesObj_dealloc,      /* tp_dealloc */
+    0,                                    /* tp_print */
+    0,                                    /* tp_getattr */
+    0,                                    /* tp_setattr */
+    0,                                    /* tp_compare */
+    0,                                    /* tp_repr */
+    0,                                    /* tp_as_number */
+    0,                                    /* tp_as_sequence */
+    0,                                    /* tp_as_mapping */
+    0,                                    /* tp_hash */
+    0,                                    /* tp_call */
+    0,                                    /* tp_str */
+    0,                                    /* tp_getattro */
+    0,                                    /* tp_setattro */
+    0,                                    /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT |
+    Py_TPFLAGS_BASETYPE,                  /* tp_flags */
+    "Cepstral features extracted once "
+    "with PocketSphinx.extract_features() "
+    "or loaded from a file.",             /* tp_doc */
+    0,                                    /* tp_traverse */
+    0,                                    /* tp_clear */
+    0,                                    /* tp_richcompare */
+    0,                                    /* tp_weaklistoffset */
+    0,                                    /* tp_iter */
+    0,                                    /* tp_iternext */
+    FeaturesObj_methods,                  /* tp_methods */
+    0,                                    /* tp_members */
+    FeaturesObj_getseters,                /* tp_getset */
+    0,                                    /* tp_base */
+    0,                                    /* tp_dict */
+    0,                                    /* tp_descr_get */
+    0,                                    /* tp_descr_set */
+    0,                                    /* tp_dictoffset */
+    (initproc)FeaturesObj_init,           /* tp_init */
+    0,                                    /* tp_alloc */
+    FeaturesObj_new,                      /* tp_new */
+};
+
+PyObject *
+initfeatures(PyObject *module) {
+    module_state *state = get_module_state(module);
+    state->FeaturesType = add_module_type(module, &FeaturesType);
+    if (state->FeaturesType == NULL)
+        return NULL;
+
+    state->FeaturesError = add_module_exception(module, "FeaturesError");
+    if (state->FeaturesError == NULL)
+        return NULL;
+
+    return module;
+}
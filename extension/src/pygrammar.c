@@ -0,0 +1,540 @@
+/*
+ * pygrammar.c
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#include <string.h>
+
+#include "pypocketsphinx.h"
+#include "pygrammar.h"
+#include "trace.h"
+
+/* Return the decoder's grammar compiler, starting its thread the first time it
+ * is needed, or set an error and return NULL.
+ */
+static grammar_compiler_t *
+get_grammar_compiler(PSObj *self) {
+    ps_decoder_t *ps = get_ps_decoder_t(self);
+    cmd_ln_t *config = get_cmd_ln_t(self);
+    if (ps == NULL || config == NULL)
+        return NULL;
+
+    if (self->grammar_compiler == NULL) {
+        self->grammar_compiler = grammar_compiler_init(
+            ps_get_logmath(ps), cmd_ln_float32_r(config, "-lw"),
+            cmd_ln_str_r(config, "-toprule"));
+        if (self->grammar_compiler == NULL)
+            PyErr_SetString(GET_MODULE_STATE(self)->PocketSphinxError,
+                            "failed to start the grammar "
+                            "compiler thread.");
+    }
+    return self->grammar_compiler;
+}
+
+PyObject *
+PSObj_set_search_async_internal(PSObj *self, ps_search_type search_type,
+                                PyObject *args, PyObject *kwds) {
+    char *req_kw = search_type == JSGF_STR ? "str" : "path";
+    char *kwlist[] = {req_kw, "name", "interrupt", NULL};
+    const char *value = NULL;
+    const char *name = NULL;
+
+    // False by default. No need to increment this because it's only used internally.
+    PyObject *interrupt = Py_False;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|sO", kwlist, &value, &name,
+                                     &interrupt))
+        return NULL;
+
+    if (!PyBool_Check(interrupt)) {
+        PyErr_SetString(PyExc_TypeError, "'interrupt' parameter must be a "
+                        "boolean value.");
+        return NULL;
+    }
+
+    if (name == NULL)
+        name = PS_DEFAULT_SEARCH;
+
+    grammar_compiler_t *gc = get_grammar_compiler(self);
+    if (gc == NULL)
+        return NULL;
+
+    grammar_job_t *job = grammar_compiler_submit(gc, search_type, name, value,
+                                                 interrupt == Py_True);
+    return SearchFutureObj_from_job(job, (PyObject *)self);
+}
+
+PyObject *
+PSObj_set_jsgf_file_search_async(PSObj *self, PyObject *args, PyObject *kwds) {
+    return PSObj_set_search_async_internal(self, JSGF_FILE, args, kwds);
+}
+
+PyObject *
+PSObj_set_jsgf_str_search_async(PSObj *self, PyObject *args, PyObject *kwds) {
+    return PSObj_set_search_async_internal(self, JSGF_STR, args, kwds);
+}
+
+PyObject *
+PSObj_set_fsg_search_async(PSObj *self, PyObject *args, PyObject *kwds) {
+    return PSObj_set_search_async_internal(self, FSG_FILE, args, kwds);
+}
+
+/* Queue an edit to a search's grammar and apply it straight away if the
+ * utterance state allows.
+ */
+static PyObject *
+submit_fsg_edit(PSObj *self, const char *name, fsg_edit_t const *edit,
+                PyObject *interrupt) {
+    if (!PyBool_Check(interrupt)) {
+        PyErr_SetString(PyExc_TypeError, "'interrupt' parameter must be a "
+                        "boolean value.");
+        return NULL;
+    }
+
+    grammar_compiler_t *gc = get_grammar_compiler(self);
+    if (gc == NULL)
+        return NULL;
+
+    grammar_job_t *job = grammar_compiler_submit_edit(
+        gc, name, fsg_edit_copy(edit), interrupt == Py_True);
+    PyObject *future = SearchFutureObj_from_job(job, (PyObject *)self);
+    if (future != NULL)
+        PSObj_apply_grammars(self);
+    return future;
+}
+
+PyObject *
+PSObj_add_fsg_transition(PSObj *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"name", "from_state", "to_state", "word",
+                             "probability", "interrupt", NULL};
+    fsg_edit_t edit = {NULL, FSG_EDIT_ADD, NULL, -1, -1, 1.0};
+    const char *name = NULL;
+    PyObject *interrupt = Py_False;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "sii|zfO", kwlist, &name,
+                                     &edit.from_state, &edit.to_state,
+                                     &edit.word, &edit.prob, &interrupt))
+        return NULL;
+
+    if (edit.prob <= 0 || edit.prob > 1) {
+        PyErr_SetString(PyExc_ValueError, "'probability' must be greater than "
+                        "0 and no greater than 1.");
+        return NULL;
+    }
+
+    return submit_fsg_edit(self, name, &edit, interrupt);
+}
+
+PyObject *
+PSObj_remove_fsg_transitions(PSObj *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"name", "word", "from_state", "to_state",
+                             "interrupt", NULL};
+    fsg_edit_t edit = {NULL, FSG_EDIT_REMOVE, NULL, -1, -1, 0};
+    const char *name = NULL;
+    PyObject *interrupt = Py_False;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "ss|iiO", kwlist, &name,
+                                     &edit.word, &edit.from_state,
+                                     &edit.to_state, &interrupt))
+        return NULL;
+
+    return submit_fsg_edit(self, name, &edit, interrupt);
+}
+
+PyObject *
+PSObj_get_fsg_states(PSObj *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"name", NULL};
+    const char *name = NULL;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s", kwlist, &name))
+        return NULL;
+
+    ps_decoder_t *ps = get_ps_decoder_t(self);
+    if (ps == NULL)
+        return NULL;
+
+    // Set the search up again if it was evicted.
+    fsg_model_t *fsg = NULL;
+    if (PSObj_use_search(self, name) == 0)
+        fsg = ps_get_fsg(ps, name);
+    if (fsg == NULL) {
+        PyErr_Format(GET_MODULE_STATE(self)->PocketSphinxError,
+                     "there is no JSGF or FSG search named "
+                     "'%s'.", name);
+        return NULL;
+    }
+
+    return Py_BuildValue("(iii)", fsg_model_n_state(fsg),
+                         fsg_model_start_state(fsg),
+                         fsg_model_final_state(fsg));
+}
+
+/* End any utterance in progress so the decoder's searches can be changed.
+ * Utterances without speech are ended without a hypothesis, as are those a
+ * job may interrupt.
+ */
+static void
+end_utterance_for_job(PSObj *self, ps_decoder_t *ps) {
+    if (self->cascade != NULL)
+        cascade_end(self->cascade, ps, &self->utterance_state);
+    else
+        utterance_end(ps, &self->utterance_state);
+}
+
+/* Edit the grammar of a search on the decoder, keeping it active if it was.
+ * @return NULL on success or an error message
+ */
+static const char *
+apply_edit_job(PSObj *self, ps_decoder_t *ps, grammar_job_t *job) {
+    const char *name = grammar_job_name(job);
+    fsg_edit_t *edit = grammar_job_edit(job);
+    end_utterance_for_job(self, ps);
+
+    // Editing replaces the search, so the active search must be set again.
+    // An evicted search is set up again first.
+    const char *active = ps_get_search(ps);
+    bool was_active = active != NULL && strcmp(active, name) == 0;
+    if (PSObj_use_search(self, name) < 0 ||
+        fsg_edits_apply_to_search(ps, name, edit) < 0)
+        return "failed to edit the search's grammar. Check that it is a JSGF "
+            "or FSG search, that the states exist and that any added word is "
+            "in the dictionary.";
+
+    // Remember the edit so it is made again wherever the search is rebuilt.
+    search_sources_add_edit(self->search_sources, name, fsg_edit_copy(edit));
+    if (was_active && ps_set_search(ps, name) < 0)
+        return "something went wrong whilst activating the edited search.";
+    return NULL;
+}
+
+/* Set a compiled search on the decoder and activate it.
+ * @return NULL on success or an error message
+ */
+static const char *
+apply_grammar_job(PSObj *self, ps_decoder_t *ps, grammar_job_t *job) {
+    const char *name = grammar_job_name(job);
+    if (grammar_job_edit(job) != NULL)
+        return apply_edit_job(self, ps, job);
+
+    // The decoder can't change searches during an utterance.
+    end_utterance_for_job(self, ps);
+
+    // Replacing the active search frees it, so it must be set again. While a
+    // cascade is in use, it decides which search is active.
+    const char *active = ps_get_search(ps);
+    bool was_active = active != NULL && strcmp(active, name) == 0;
+    uint64 span = trace_begin();
+    int set_result = ps_set_fsg(ps, name, grammar_job_fsg(job));
+    trace_end(span, "ps_set_fsg");
+    if (set_result < 0)
+        return "something went wrong whilst setting up the compiled search.";
+
+    self->search_sources = search_sources_add(self->search_sources,
+                                              grammar_job_type(job), name,
+                                              grammar_job_value(job));
+    PSObj_use_search(self, name);
+    if (self->cascade == NULL || was_active) {
+        // Use the source's copy of the name; the job may be freed first.
+        name = search_sources_find(self->search_sources, name)->name;
+        if (ps_set_search(ps, name) < 0)
+            return "something went wrong whilst activating the compiled "
+                "search.";
+    }
+
+    if (self->cascade == NULL) {
+        // Keep the current search name up to date
+        Py_XDECREF(self->search_name);
+        self->search_name = Py_BuildValue("s", name);
+    }
+    return NULL;
+}
+
+void
+PSObj_apply_grammars(PSObj *self) {
+    grammar_compiler_t *gc = self->grammar_compiler;
+    ps_decoder_t *ps = self->ps;
+    if (gc == NULL || ps == NULL)
+        return;
+
+    grammar_job_t *job;
+    while ((job = grammar_compiler_peek(gc)) != NULL) {
+        // Wait for the end of an utterance with speech unless interrupting.
+        if (self->utterance_state == STARTED && !grammar_job_interrupts(job))
+            break;
+
+        grammar_compiler_pop(gc);
+        if (grammar_job_state(job) == GRAMMAR_COMPILED)
+            grammar_job_finish(job, apply_grammar_job(self, ps, job));
+        grammar_job_free(job);
+    }
+}
+
+PyObject *
+SearchFutureObj_from_job(grammar_job_t *job, PyObject *decoder) {
+    PyTypeObject *type = GET_MODULE_STATE(decoder)->SearchFutureType;
+    SearchFutureObj *self = (SearchFutureObj *)type->tp_alloc(type, 0);
+    if (self == NULL) {
+        grammar_job_free(job);
+        return NULL;
+    }
+
+    self->job = job;
+    Py_INCREF(decoder);
+    self->decoder = decoder;
+    return (PyObject *)self;
+}
+
+/* Return the job of a SearchFuture object or set an error and return NULL. */
+static grammar_job_t *
+get_grammar_job(SearchFutureObj *self) {
+    grammar_job_t *job = self->job;
+    if (job == NULL)
+        PyErr_SetString(GET_MODULE_STATE(self)->PocketSphinxError,
+                        "SearchFuture object is not "
+                        "initialised.");
+    return job;
+}
+
+static bool
+grammar_job_done(grammar_job_t *job) {
+    grammar_state_t state = grammar_job_state(job);
+    return state == GRAMMAR_APPLIED || state == GRAMMAR_FAILED;
+}
+
+PyObject *
+SearchFutureObj_done(SearchFutureObj *self) {
+    grammar_job_t *job = get_grammar_job(self);
+    if (job == NULL)
+        return NULL;
+    return PyBool_FromLong(grammar_job_done(job));
+}
+
+/* Wait for the job to compile and set it on the decoder if it can be set now.
+ * @return -1 with an exception set on failure
+ */
+static int
+wait_for_job(SearchFutureObj *self, PyObject *timeout_obj) {
+    grammar_job_t *job = get_grammar_job(self);
+    if (job == NULL)
+        return -1;
+
+    double timeout = -1;
+    if (timeout_obj != Py_None) {
+        timeout = PyFloat_AsDouble(timeout_obj);
+        if (timeout == -1 && PyErr_Occurred())
+            return -1;
+        if (timeout < 0) {
+            PyErr_SetString(PyExc_ValueError, "'timeout' must not be "
+                            "negative.");
+            return -1;
+        }
+    }
+
+    grammar_state_t state;
+    Py_BEGIN_ALLOW_THREADS
+    state = grammar_job_wait(job, timeout);
+    Py_END_ALLOW_THREADS
+
+    // Jobs are compiled in order, so every job before this one is compiled
+    // too and they can all be set now.
+    if (state == GRAMMAR_COMPILED) {
+        PSObj *decoder = (PSObj *)self->decoder;
+        obj_lock_acquire(&decoder->lock);
+        PSObj_apply_grammars(decoder);
+        obj_lock_release(&decoder->lock);
+    }
+    return 0;
+}
+
+PyObject *
+SearchFutureObj_wait(SearchFutureObj *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"timeout", NULL};
+    PyObject *timeout = Py_None;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O", kwlist, &timeout))
+        return NULL;
+
+    if (wait_for_job(self, timeout) < 0)
+        return NULL;
+    return PyBool_FromLong(grammar_job_done(self->job));
+}
+
+PyObject *
+SearchFutureObj_result(SearchFutureObj *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"timeout", NULL};
+    PyObject *timeout = Py_None;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O", kwlist, &timeout))
+        return NULL;
+
+    if (wait_for_job(self, timeout) < 0)
+        return NULL;
+
+    grammar_job_t *job = self->job;
+    switch (grammar_job_state(job)) {
+    case GRAMMAR_APPLIED:
+        return Py_BuildValue("s", grammar_job_name(job));
+    case GRAMMAR_FAILED:
+        PyErr_SetString(GET_MODULE_STATE(self)->PocketSphinxError,
+                        grammar_job_error(job));
+        return NULL;
+    default:
+        PyErr_Format(GET_MODULE_STATE(self)->PocketSphinxError,
+                     "search '%s' hasn't been set yet.",
+                     grammar_job_name(job));
+        return NULL;
+    }
+}
+
+PyObject *
+SearchFutureObj_get_name(SearchFutureObj *self, void *closure) {
+    grammar_job_t *job = get_grammar_job(self);
+    if (job == NULL)
+        return NULL;
+    return Py_BuildValue("s", grammar_job_name(job));
+}
+
+void
+SearchFutureObj_dealloc(SearchFutureObj *self) {
+    grammar_job_free(self->job);
+    Py_XDECREF(self->decoder);
+
+    // Free the Python type object
+    free_module_object((PyObject *)self);
+}
+
+PyObject *
+SearchFutureObj_new(PyTypeObject *type, PyObject *args, PyObject *kwds) {
+    SearchFutureObj *self;
+
+    self = (SearchFutureObj *)type->tp_alloc(type, 0);
+    if (self != NULL) {
+        self->job = NULL;
+        self->decoder = NULL;
+    }
+
+    return (PyObject *)self;
+}
+
+int
+SearchFutureObj_init(SearchFutureObj *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {NULL};
+
+    // Accept no arguments. Futures come from the *_search_async methods.
+    if (! PyArg_ParseTupleAndKeywords(args, kwds, "", kwlist))
+        return -1;
+
+    return 0;
+}
+
+PyMethodDef SearchFutureObj_methods[] = {
+    {"done",
+     (PyCFunction)SearchFutureObj_done, METH_NOARGS,
+     PyDoc_STR(
+         "Return whether the search has been set on the decoder or failed.\n")},
+    {"wait",
+     (PyCFunction)SearchFutureObj_wait, METH_KEYWORDS | METH_VARARGS,
+     PyDoc_STR(
+         "Wait for the search to be compiled, set it on the decoder if that "
+         "can be done straight away and return whether the future is done.\n"
+         "A search that doesn't interrupt utterances is set once the current "
+         "utterance ends. The GIL is released while waiting.\n\n"
+         "Keyword arguments:\n"
+         "timeout -- seconds to wait for, or None to wait until the search is "
+         "compiled (default None)\n")},
+    {"result",
+     (PyCFunction)SearchFutureObj_result, METH_KEYWORDS | METH_VARARGS,
+     PyDoc_STR(
+         "Wait like wait() and return the search name if it was set, or raise "
+         "a PocketSphinxError if compiling or setting it failed or it hasn't "
+         "been set yet.\n\n"
+         "Keyword arguments:\n"
+         "timeout -- seconds to wait for, or None to wait until the search is "
+         "compiled (default None)\n")},
+    {NULL}  /* Sentinel */
+};
+
+PyGetSetDef SearchFutureObj_getseters[] = {
+    {"name",
+     (getter)SearchFutureObj_get_name, NULL,
+     "The name of the search being set.", NULL},
+    {NULL}  /* Sentinel */
+};
+
+PyTypeObject SearchFutureType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "sphinxwrapper.SearchFuture",         /* tp_name */
+    sizeof(SearchFutureObj),              /* tp_basicsize */
+    0,                                    /* tp_itemsize */
+    (destructor)SearchFutureObj_dealloc,  /* tp_dealloc */
+    0,                                    /* tp_print */
+    0,                                    /* tp_getattr */
+    0,                                    /* tp_setattr */
+    0,                                    /* tp_compare */
+    0,                                    /* tp_repr */
+    0,                                    /* tp_as_number */
+    0,                                    /* tp_as_sequence */
+    0,                                    /* tp_as_mapping */
+    0,                                    /* tp_hash */
+    0,                                    /* tp_call */
+    0,                                    /* tp_str */
+    0,                                    /* tp_getattro */
+    0,                                    /* tp_setattro */
+    0,                                    /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT |
+    Py_TPFLAGS_BASETYPE,                  /* tp_flags */
+    "Pending search compiled in the "
+    "background by one of the "
+    "PocketSphinx *_search_async "
+    "methods.",                           /* tp_doc */
+    0,                                    /* tp_traverse */
+    0,                                    /* tp_clear */
+    0,                                    /* tp_richcompare */
+    0,                                    /* tp_weaklistoffset */
+    0,                                    /* tp_iter */
+    0,                                    /* tp_iternext */
+    SearchFutureObj_methods,              /* tp_methods */
+    0,                                    /* tp_members */
+    SearchFutureObj_getseters,            /* tp_getset */
+    0,                                    /* tp_base */
+    0,                                    /* tp_dict */
+    0,                                    /* tp_descr_get */
+    0,                                    /* tp_descr_set */
+    0,                                    /* tp_dictoffset */
+    (initproc)SearchFutureObj_init,       /* tp_init */
+    0,                                    /* tp_alloc */
+    SearchFutureObj_new,                  /* tp_new */
+};
+
+PyObject *
+initgrammar(PyObject *module) {
+    module_state *state = get_module_state(module);
+    state->SearchFutureType = add_module_type(module, &SearchFutureType);
+    if (state->SearchFutureType == NULL)
+        return NULL;
+
+    return module;
+}
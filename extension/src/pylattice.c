@@ -0,0 +1,360 @@
+/*
+ * pylattice.c
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#include <sphinxbase/ckd_alloc.h>
+
+#include "pypocketsphinx.h"
+#include "pylattice.h"
+#include "trace.h"
+
+/* Return the lattice of a Lattice object or set an error and return NULL. */
+static ps_lattice_t *
+get_lattice(LatticeObj *self) {
+    ps_lattice_t *dag = self->dag;
+    if (dag == NULL)
+        PyErr_SetString(GET_MODULE_STATE(self)->PocketSphinxError,
+                        "Lattice object is not "
+                        "initialised.");
+    return dag;
+}
+
+PyObject *
+PSObj_get_lattice(PSObj *self) {
+    ps_decoder_t *ps = get_ps_decoder_t(self);
+    if (ps == NULL)
+        return NULL;
+
+    ps_lattice_t *dag = ps_get_lattice(ps);
+    if (dag == NULL) {
+        Py_INCREF(Py_None);
+        return Py_None;
+    }
+
+    return LatticeObj_from_lattice(GET_MODULE_STATE(self), dag);
+}
+
+void
+PSObj_rescore_utterance(PSObj *self) {
+    ps_decoder_t *ps = self->ps;
+    rescorer_t *rescorer = self->rescorer;
+    if (ps == NULL || rescorer == NULL)
+        return;
+
+    // Copying the lattice doesn't touch any Python objects.
+    Py_BEGIN_ALLOW_THREADS
+    rescorer_submit(rescorer, rescore_graph_from_lattice(ps_get_lattice(ps)));
+    Py_END_ALLOW_THREADS
+}
+
+int
+PSObj_dispatch_rescored(PSObj *self) {
+    char *hyp;
+
+    // The callback may disable rescoring, so check the rescorer each time.
+    while (self->rescorer != NULL && rescorer_poll(self->rescorer, &hyp)) {
+        PyObject *callback = self->rescored_hypothesis_callback;
+        if (PyCallable_Check(callback)) {
+            uint64 span = trace_begin();
+            PyObject *cb_result = PyObject_CallFunction(callback, "z", hyp);
+            trace_end(span, "rescored_hypothesis_callback");
+            ckd_free(hyp);
+            if (cb_result == NULL)
+                return -1;
+            Py_DECREF(cb_result);
+        } else {
+            ckd_free(hyp);
+        }
+    }
+
+    return 0;
+}
+
+PyObject *
+PSObj_enable_rescoring(PSObj *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"lm_file", "language_weight", NULL};
+    const char *lm_file = NULL;
+    float lw = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|f", kwlist, &lm_file, &lw))
+        return NULL;
+
+    if (lw < 0) {
+        PyErr_SetString(PyExc_ValueError, "'language_weight' must be "
+                        "positive.");
+        return NULL;
+    }
+
+    ps_decoder_t *ps = get_ps_decoder_t(self);
+    cmd_ln_t *config = get_cmd_ln_t(self);
+    if (ps == NULL || config == NULL)
+        return NULL;
+
+    // Use the first pass language weight by default.
+    if (lw == 0)
+        lw = cmd_ln_float32_r(config, "-lw");
+
+    // Loading a large model takes a while, so let other threads run.
+    rescorer_t *rescorer;
+    logmath_t *lmath = ps_get_logmath(ps);
+    Py_BEGIN_ALLOW_THREADS
+    rescorer = rescorer_init(config, lmath, lm_file, lw);
+    Py_END_ALLOW_THREADS
+
+    if (rescorer == NULL) {
+        PyErr_Format(GET_MODULE_STATE(self)->PocketSphinxError,
+                     "failed to load language model '%s' "
+                     "for rescoring.", lm_file);
+        return NULL;
+    }
+
+    // Replace the current rescorer, discarding its unfinished work.
+    rescorer_t *old = self->rescorer;
+    self->rescorer = rescorer;
+    Py_BEGIN_ALLOW_THREADS
+    rescorer_free(old);
+    Py_END_ALLOW_THREADS
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+PyObject *
+PSObj_disable_rescoring(PSObj *self) {
+    rescorer_t *rescorer = self->rescorer;
+    self->rescorer = NULL;
+    Py_BEGIN_ALLOW_THREADS
+    rescorer_free(rescorer);
+    Py_END_ALLOW_THREADS
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+PyObject *
+PSObj_wait_for_rescoring(PSObj *self) {
+    rescorer_t *rescorer = self->rescorer;
+    if (rescorer != NULL) {
+        Py_BEGIN_ALLOW_THREADS
+        rescorer_wait(rescorer);
+        Py_END_ALLOW_THREADS
+    }
+
+    if (PSObj_dispatch_rescored(self) < 0)
+        return NULL;
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+PyObject *
+PSObj_get_rescored_hypothesis_callback(PSObj *self, void *closure) {
+    Py_INCREF(self->rescored_hypothesis_callback);
+    return self->rescored_hypothesis_callback;
+}
+
+int
+PSObj_set_rescored_hypothesis_callback(PSObj *self, PyObject *value,
+                                       void *closure) {
+    if (value == NULL) {
+        PyErr_SetString(PyExc_AttributeError, "Cannot delete the "
+                        "rescored_hypothesis_callback attribute.");
+        return -1;
+    }
+
+    if (!PyCallable_Check(value)) {
+        PyErr_SetString(PyExc_TypeError, "value must be callable.");
+        return -1;
+    }
+
+#ifdef IS_PY2
+    if (!assert_callable_arg_count(value, 1))
+        return -1;
+#endif
+
+    Py_DECREF(self->rescored_hypothesis_callback);
+    Py_INCREF(value);
+    self->rescored_hypothesis_callback = value;
+
+    return 0;
+}
+
+PyObject *
+LatticeObj_from_lattice(module_state *state, ps_lattice_t *dag) {
+    PyTypeObject *type = state->LatticeType;
+    LatticeObj *self = (LatticeObj *)type->tp_alloc(type, 0);
+    if (self != NULL)
+        self->dag = ps_lattice_retain(dag);
+    return (PyObject *)self;
+}
+
+PyObject *
+LatticeObj_write(LatticeObj *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"path", "htk", NULL};
+    const char *path = NULL;
+
+    // False by default. No need to increment this because it's only used internally.
+    PyObject *htk = Py_False;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|O", kwlist, &path, &htk))
+        return NULL;
+
+    if (!PyBool_Check(htk)) {
+        PyErr_SetString(PyExc_TypeError, "'htk' parameter must be a boolean "
+                        "value.");
+        return NULL;
+    }
+
+    ps_lattice_t *dag = get_lattice(self);
+    if (dag == NULL)
+        return NULL;
+
+    int write_result;
+    if (htk == Py_True)
+        write_result = ps_lattice_write_htk(dag, path);
+    else
+        write_result = ps_lattice_write(dag, path);
+    if (write_result < 0) {
+        PyErr_Format(PyExc_IOError, "failed to write lattice to '%s'.", path);
+        return NULL;
+    }
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+PyObject *
+LatticeObj_get_n_frames(LatticeObj *self, void *closure) {
+    ps_lattice_t *dag = get_lattice(self);
+    if (dag == NULL)
+        return NULL;
+    return Py_BuildValue("i", ps_lattice_n_frames(dag));
+}
+
+void
+LatticeObj_dealloc(LatticeObj *self) {
+    if (self->dag != NULL)
+        ps_lattice_free(self->dag);
+
+    // Free the Python type object
+    free_module_object((PyObject *)self);
+}
+
+PyObject *
+LatticeObj_new(PyTypeObject *type, PyObject *args, PyObject *kwds) {
+    LatticeObj *self;
+
+    self = (LatticeObj *)type->tp_alloc(type, 0);
+    if (self != NULL) {
+        self->dag = NULL;
+    }
+
+    return (PyObject *)self;
+}
+
+int
+LatticeObj_init(LatticeObj *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {NULL};
+
+    // Accept no arguments. Lattices come from PocketSphinx.get_lattice().
+    if (! PyArg_ParseTupleAndKeywords(args, kwds, "", kwlist))
+        return -1;
+
+    return 0;
+}
+
+PyMethodDef LatticeObj_methods[] = {
+    {"write",
+     (PyCFunction)LatticeObj_write, METH_KEYWORDS | METH_VARARGS,
+     PyDoc_STR(
+         "Write the lattice to a file in Sphinx format, or in HTK format if "
+         "htk is True.\n\n"
+         "Keyword arguments:\n"
+         "path -- file path to write to.\n"
+         "htk -- whether to use the HTK lattice format (default False)\n")},
+    {NULL}  /* Sentinel */
+};
+
+PyGetSetDef LatticeObj_getseters[] = {
+    {"n_frames",
+     (getter)LatticeObj_get_n_frames, NULL,
+     "The number of frames the lattice spans.", NULL},
+    {NULL}  /* Sentinel */
+};
+
+PyTypeObject LatticeType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "sphinxwrapper.Lattice",              /* tp_name */
+    sizeof(LatticeObj),                   /* tp_basicsize */
+    0,                                    /* tp_itemsize */
+    (destructor)LatticeObj_dealloc,       /* tp_dealloc */
+    0,                                    /* tp_print */
+    0,                                    /* tp_getattr */
+    0,                                    /* tp_setattr */
+    0,                                    /* tp_compare */
+    0,                                    /* tp_repr */
+    0,                                    /* tp_as_number */
+    0,                                    /* tp_as_sequence */
+    0,                                    /* tp_as_mapping */
+    0,                                    /* tp_hash */
+    0,                                    /* tp_call */
+    0,                                    /* tp_str */
+    0,                                    /* tp_getattro */
+    0,                                    /* tp_setattro */
+    0,                                    /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT |
+    Py_TPFLAGS_BASETYPE,                  /* tp_flags */
+    "Word lattice of an utterance "
+    "from PocketSphinx.get_lattice().",   /* tp_doc */
+    0,                                    /* tp_traverse */
+    0,                                    /* tp_clear */
+    0,                                    /* tp_richcompare */
+    0,                                    /* tp_weaklistoffset */
+    0,                                    /* tp_iter */
+    0,                                    /* tp_iternext */
+    LatticeObj_methods,                   /* tp_methods */
+    0,                                    /* tp_members */
+    LatticeObj_getseters,                 /* tp_getset */
+    0,                                    /* tp_base */
+    0,                                    /* tp_dict */
+    0,                                    /* tp_descr_get */
+    0,                                    /* tp_descr_set */
+    0,                                    /* tp_dictoffset */
+    (initproc)LatticeObj_init,            /* tp_init */
+    0,                                    /* tp_alloc */
+    LatticeObj_new,                       /* tp_new */
+};
+
+PyObject *
+initlattice(PyObject *module) {
+    module_state *state = get_module_state(module);
+    state->LatticeType = add_module_type(module, &LatticeType);
+    if (state->LatticeType == NULL)
+        return NULL;
+
+    return module;
+}
@@ -0,0 +1,369 @@
+/*
+ * pylog.c
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "logqueue.h"
+#include "pylog.h"
+
+/* A log line being put together from a message and its continuations. */
+typedef struct {
+    err_lvl_t level;
+    size_t length;
+    char text[LOG_MESSAGE_SIZE * 4];
+} log_line_t;
+
+// Logging state, which is shared by the process as sphinxbase's is, so it is
+// owned by the main interpreter and only changed from there. The logger is
+// also guarded by logger_lock because the drain thread uses it without the
+// GIL on free-threaded builds.
+static pthread_mutex_t logger_lock = PTHREAD_MUTEX_INITIALIZER;
+static PyObject *logger = NULL; // object with a log method
+static PyThreadState *drain_tstate = NULL; // the drain thread's thread state
+static pthread_t drain_thread;
+static bool running = false;
+static bool stopping = false;
+static bool atexit_registered = false;
+
+static long
+get_python_level(err_lvl_t level) {
+    switch (level) {
+    case ERR_DEBUG:
+        return 10;
+    case ERR_INFO:
+    case ERR_INFOCONT:
+        return 20;
+    case ERR_WARN:
+        return 30;
+    case ERR_ERROR:
+        return 40;
+    default:
+        return 50;
+    }
+}
+
+/* Get the lowest sphinxbase level passed on for a Python logging level. */
+static err_lvl_t
+get_err_level(long level) {
+    if (level <= 10)
+        return ERR_DEBUG;
+    if (level <= 20)
+        return ERR_INFO;
+    if (level <= 30)
+        return ERR_WARN;
+    if (level <= 40)
+        return ERR_ERROR;
+    return ERR_FATAL;
+}
+
+/* Take a reference to the current logger, or return NULL if there isn't one.
+ * Called with the GIL held.
+ */
+static PyObject *
+get_current_logger(void) {
+    pthread_mutex_lock(&logger_lock);
+    PyObject *current = logger;
+    Py_XINCREF(current);
+    pthread_mutex_unlock(&logger_lock);
+    return current;
+}
+
+/* Replace the logger, taking ownership of the new one, which may be NULL. */
+static void
+set_logger(PyObject *new_logger) {
+    pthread_mutex_lock(&logger_lock);
+    PyObject *old_logger = logger;
+    logger = new_logger;
+    pthread_mutex_unlock(&logger_lock);
+    Py_XDECREF(old_logger);
+}
+
+/* Check whether the calling thread is running in the main interpreter. */
+static bool
+in_main_interpreter(void) {
+    PyInterpreterState *interp = PyThreadState_Get()->interp;
+#if PY_VERSION_HEX >= 0x03090000
+    return interp == PyInterpreterState_Main();
+#else
+    // The main interpreter is created first, so it is last in the list.
+    PyInterpreterState *main_interp = PyInterpreterState_Head();
+    while (PyInterpreterState_Next(main_interp) != NULL)
+        main_interp = PyInterpreterState_Next(main_interp);
+    return interp == main_interp;
+#endif
+}
+
+/* Pass a line to the logger. Called with the GIL held. */
+static void
+emit_line(PyObject *logger_obj, log_line_t *line) {
+    if (line->length > 0 && line->text[line->length - 1] == '\n')
+        line->length--;
+    line->text[line->length] = '\0';
+
+    PyObject *result = PyObject_CallMethod(logger_obj, "log", "ls",
+                                           get_python_level(line->level),
+                                           line->text);
+    if (result == NULL)
+        PyErr_WriteUnraisable(logger_obj);
+    Py_XDECREF(result);
+    line->length = 0;
+}
+
+/* Add a message to the line, logging the line once it is complete. */
+static void
+handle_message(PyObject *logger_obj, log_line_t *line, err_lvl_t level,
+               char *message) {
+    if (level != ERR_INFOCONT) {
+        if (line->length > 0)
+            emit_line(logger_obj, line);
+        line->level = level;
+
+        // The logger shows the level itself, so skip sphinxbase's prefix.
+        static const char *prefixes[] = {"DEBUG: ", "INFO: ", "", "WARN: ",
+                                         "ERROR: ", "FATAL: "};
+        if (level < ERR_MAX) {
+            size_t prefix_length = strlen(prefixes[level]);
+            if (strncmp(message, prefixes[level], prefix_length) == 0)
+                message += prefix_length;
+        }
+    }
+
+    size_t length = strlen(message);
+    if (length > sizeof(line->text) - 1 - line->length)
+        length = sizeof(line->text) - 1 - line->length;
+    memcpy(line->text + line->length, message, length);
+    line->length += length;
+
+    if (line->length > 0 && (line->text[line->length - 1] == '\n' ||
+                             line->length == sizeof(line->text) - 1))
+        emit_line(logger_obj, line);
+}
+
+/* Report messages dropped because the queue was full. */
+static void
+report_dropped(PyObject *logger_obj) {
+    uint32 n_dropped = log_queue_take_dropped();
+    if (n_dropped == 0)
+        return;
+
+    PyObject *result = PyObject_CallMethod(
+        logger_obj, "log", "ls", 30L, "Native log messages were dropped because "
+        "the log queue was full.");
+    if (result == NULL)
+        PyErr_WriteUnraisable(logger_obj);
+    Py_XDECREF(result);
+}
+
+/* Pass queued messages to the logger until logging stops. The thread only
+ * holds the GIL while it has messages to log.
+ */
+static void *
+drain_main(void *arg) {
+    static log_line_t line;
+    char message[LOG_MESSAGE_SIZE];
+    err_lvl_t level;
+    line.length = 0;
+
+    for (;;) {
+        bool popped = log_queue_pop(&level, message, -1);
+        bool last = __atomic_load_n(&stopping, __ATOMIC_ACQUIRE);
+        if (!popped && !last)
+            continue;
+
+        // Hold a reference so that replacing the logger while the messages
+        // are logged doesn't free it.
+        PyEval_AcquireThread(drain_tstate);
+        PyObject *current = get_current_logger();
+        while (popped) {
+            if (current != NULL)
+                handle_message(current, &line, level, message);
+            popped = log_queue_pop(&level, message, 0);
+        }
+        if (current != NULL) {
+            if (last && line.length > 0)
+                emit_line(current, &line);
+            report_dropped(current);
+            Py_DECREF(current);
+        }
+        PyEval_ReleaseThread(drain_tstate);
+
+        if (last)
+            break;
+    }
+    return NULL;
+}
+
+/* Get a logger for a name, or the sphinxwrapper logger for None. */
+static PyObject *
+get_logger(PyObject *logger_arg) {
+    if (logger_arg != Py_None && !PYCOMPAT_STRING_CHECK(logger_arg)) {
+        Py_INCREF(logger_arg);
+        return logger_arg;
+    }
+
+    PyObject *logging = PyImport_ImportModule("logging");
+    if (logging == NULL)
+        return NULL;
+    PyObject *result;
+    if (logger_arg == Py_None)
+        result = PyObject_CallMethod(logging, "getLogger", "s",
+                                     "sphinxwrapper");
+    else
+        result = PyObject_CallMethod(logging, "getLogger", "O", logger_arg);
+    Py_DECREF(logging);
+    return result;
+}
+
+/* Stop logging when the interpreter exits, while the drain thread can still
+ * take the GIL.
+ */
+static int
+register_atexit(void) {
+    if (atexit_registered)
+        return 0;
+
+    PyObject *module = PyImport_ImportModule("sphinxwrapper");
+    PyObject *atexit = PyImport_ImportModule("atexit");
+    PyObject *stop = NULL, *result = NULL;
+    if (module != NULL && atexit != NULL)
+        stop = PyObject_GetAttrString(module, "stop_logging");
+    if (stop != NULL)
+        result = PyObject_CallMethod(atexit, "register", "O", stop);
+    Py_XDECREF(module);
+    Py_XDECREF(atexit);
+    Py_XDECREF(stop);
+    if (result == NULL)
+        return -1;
+
+    Py_DECREF(result);
+    atexit_registered = true;
+    return 0;
+}
+
+PyObject *
+sphinxwrapper_start_logging(PyObject *module, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"logger", "level", NULL};
+    PyObject *logger_arg = Py_None;
+    PyObject *level_arg = Py_None;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|OO", kwlist, &logger_arg,
+                                     &level_arg))
+        return NULL;
+
+    if (!in_main_interpreter()) {
+        PyErr_SetString(PyExc_RuntimeError, "logging can only be started "
+                        "from the main interpreter.");
+        return NULL;
+    }
+
+    PyObject *new_logger = get_logger(logger_arg);
+    if (new_logger == NULL)
+        return NULL;
+
+    // Use the logger's level unless given one.
+    PyObject *level_obj;
+    if (level_arg == Py_None)
+        level_obj = PyObject_CallMethod(new_logger, "getEffectiveLevel", NULL);
+    else {
+        Py_INCREF(level_arg);
+        level_obj = level_arg;
+    }
+    long level = level_obj == NULL ? -1 : PyLong_AsLong(level_obj);
+    Py_XDECREF(level_obj);
+    if (level == -1 && PyErr_Occurred()) {
+        Py_DECREF(new_logger);
+        return NULL;
+    }
+
+    if (register_atexit() < 0) {
+        Py_DECREF(new_logger);
+        return NULL;
+    }
+
+    // Change the logger and level of running logging.
+    set_logger(new_logger);
+    if (running) {
+        log_queue_set_level(get_err_level(level));
+        Py_INCREF(Py_None);
+        return Py_None;
+    }
+
+#if PY_VERSION_HEX < 0x03070000
+    // The GIL is only created once another thread needs it.
+    PyEval_InitThreads();
+#endif
+    drain_tstate = PyThreadState_New(PyThreadState_Get()->interp);
+    if (drain_tstate == NULL)
+        return PyErr_NoMemory();
+
+    __atomic_store_n(&stopping, false, __ATOMIC_RELEASE);
+    log_queue_start(get_err_level(level));
+    if (pthread_create(&drain_thread, NULL, drain_main, NULL) != 0) {
+        log_queue_stop();
+        PyThreadState_Clear(drain_tstate);
+        PyThreadState_Delete(drain_tstate);
+        drain_tstate = NULL;
+        PyErr_SetString(PyExc_RuntimeError, "failed to start the log "
+                        "thread.");
+        return NULL;
+    }
+    running = true;
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+PyObject *
+sphinxwrapper_stop_logging(PyObject *module, PyObject *unused) {
+    if (!in_main_interpreter()) {
+        PyErr_SetString(PyExc_RuntimeError, "logging can only be stopped "
+                        "from the main interpreter.");
+        return NULL;
+    }
+
+    if (running) {
+        // Let the drain thread pass on the last messages before it exits.
+        log_queue_stop();
+        __atomic_store_n(&stopping, true, __ATOMIC_RELEASE);
+        log_queue_wake();
+        Py_BEGIN_ALLOW_THREADS
+        pthread_join(drain_thread, NULL);
+        Py_END_ALLOW_THREADS
+
+        PyThreadState_Clear(drain_tstate);
+        PyThreadState_Delete(drain_tstate);
+        drain_tstate = NULL;
+        running = false;
+    }
+
+    set_logger(NULL);
+    Py_INCREF(Py_None);
+    return Py_None;
+}
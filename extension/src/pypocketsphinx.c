@@ -41,21 +41,77 @@
  *
  */
 
-#include "pypocketsphinx.h"
+#include <errno.h>
+#include <string.h>
+#include <sphinxbase/ckd_alloc.h>
+#include <unistd.h>
 
-#define PS_DEFAULT_SEARCH "_default"
+#include "pypocketsphinx.h"
+#include "pygrammar.h"
+#include "trace.h"
 
-static PyObject *PocketSphinxError;
+/* Process audio with the concurrent searches, calling the speech start
+ * callback and the search hypothesis callback once for each search, or
+ * returning a dictionary of search names to hypotheses if callbacks aren't
+ * used.
+ */
+static PyObject *
+PSObj_process_multi_search(PSObj *self, AudioDataObj *audio_data_c,
+                           bool call_callbacks) {
+    multi_search_t *ms = self->multi_search;
+    utterance_event_t event;
+
+    // Only the main thread's front end and the search threads are used here.
+    // Other threads can't read into the audio meanwhile.
+    obj_lock_acquire(&audio_data_c->lock);
+    Py_BEGIN_ALLOW_THREADS
+    uint64 span = trace_begin();
+    event = multi_search_process_raw(ms, audio_data_c->samples,
+                                     audio_data_c->n_samples);
+    trace_end(span, "multi_search_process_raw");
+    Py_END_ALLOW_THREADS
+    obj_lock_release(&audio_data_c->lock);
+
+    if (event == UTT_EVENT_SPEECH_START) {
+        PyObject *callback = self->speech_start_callback;
+        if (call_callbacks && PyCallable_Check(callback)) {
+            uint64 span = trace_begin();
+            PyObject *cb_result = PyObject_CallObject(callback, NULL);
+            trace_end(span, "speech_start_callback");
+            if (cb_result == NULL)
+                return NULL;
+            Py_DECREF(cb_result);
+        }
+    } else if (event == UTT_EVENT_HYPOTHESIS) {
+        PyObject *callback = self->search_hypothesis_callback;
+        if (call_callbacks && PyCallable_Check(callback)) {
+            for (int i = 0; i < multi_search_count(ms); i++) {
+                uint64 span = trace_begin();
+                PyObject *cb_result = PyObject_CallFunction(
+                    callback, "sz", multi_search_name(ms, i),
+                    multi_search_hyp(ms, i));
+                trace_end(span, "search_hypothesis_callback");
+                if (cb_result == NULL)
+                    return NULL;
+                Py_DECREF(cb_result);
+            }
+        } else if (!call_callbacks) {
+            // Return the hypotheses instead
+            PyObject *result = PyDict_New();
+            for (int i = 0; result != NULL && i < multi_search_count(ms); i++) {
+                PyObject *hyp = Py_BuildValue("z", multi_search_hyp(ms, i));
+                if (hyp == NULL || PyDict_SetItemString(
+                        result, multi_search_name(ms, i), hyp) < 0)
+                    Py_CLEAR(result);
+                Py_XDECREF(hyp);
+            }
+            return result;
+        }
+    }
 
-const arg_t cont_args_def[] = {
-    POCKETSPHINX_OPTIONS,
-    /* Argument file. */
-    {"-argfile",
-     ARG_STRING,
-     NULL, 
-     "Argument file giving extra arguments."},
-    CMDLN_EMPTY_OPTION
-};
+    Py_INCREF(Py_None);
+    return Py_None;
+}
 
 PyObject *
 PSObj_process_audio_internal(PSObj *self, PyObject *audio_data,
@@ -65,7 +121,8 @@ PSObj_process_audio_internal(PSObj *self, PyObject *audio_data,
     if (ps == NULL)
         return NULL;
 
-    if (!PyObject_TypeCheck(audio_data, &AudioDataType)) {
+    module_state *state = GET_MODULE_STATE(self);
+    if (!PyObject_TypeCheck(audio_data, state->AudioDataType)) {
         PyErr_SetString(PyExc_TypeError, "argument or item is not an AudioData "
                         "object.");
         return NULL;
@@ -74,39 +131,100 @@ PSObj_process_audio_internal(PSObj *self, PyObject *audio_data,
     AudioDataObj *audio_data_c = (AudioDataObj *)audio_data;
 
     if (!audio_data_c->is_set) {
-        PyErr_SetString(AudioDataError, "AudioData object is not set up properly. "
-                        "Try using the result from AudioDevice.read_audio()");
+        PyErr_SetString(state->AudioDataError, "AudioData object is not set up "
+                        "properly. Try using the result from "
+                        "AudioDevice.read_audio()");
         return NULL;
     }
 
-    // Call ps_start_utt if necessary
-    if (self->utterance_state == ENDED) {
-        ps_start_utt(ps);
-        self->utterance_state = IDLE;
+    // Report lattices rescored and utterances decoded again since the last
+    // call.
+    if (call_callbacks && (PSObj_dispatch_rescored(self) < 0 ||
+                           PSObj_dispatch_second_pass(self) < 0))
+        return NULL;
+
+    // Swap in searches compiled since the last call.
+    PSObj_apply_grammars(self);
+
+    if (self->multi_search != NULL)
+        return PSObj_process_multi_search(self, audio_data_c, call_callbacks);
+
+    // Keep other threads from reading into the audio until it is decoded and
+    // kept for the second pass. Callbacks are called without the lock.
+    obj_lock_acquire(&audio_data_c->lock);
+    governor_t *governor = self->governor;
+    if (governor != NULL)
+        governor_start(governor);
+
+    utterance_event_t event;
+    const char *keyphrase = NULL;
+    if (self->cascade != NULL) {
+        event = cascade_process_raw(self->cascade, ps, &self->utterance_state,
+                                    audio_data_c->samples,
+                                    audio_data_c->n_samples, &keyphrase);
+    } else if (self->endpointer != NULL) {
+        event = endpointer_process_raw(self->endpointer, ps,
+                                       &self->utterance_state,
+                                       audio_data_c->samples,
+                                       audio_data_c->n_samples);
+    } else {
+        event = utterance_process_raw(ps, &self->utterance_state,
+                                      audio_data_c->samples,
+                                      audio_data_c->n_samples);
     }
+    if (governor != NULL) {
+        governor_stop(governor, audio_data_c->n_samples);
 
-    ps_process_raw(ps, audio_data_c->audio_buffer, audio_data_c->n_samples, FALSE, FALSE);
+        // Change the beams between utterances if the governor wants to.
+        if (self->utterance_state == ENDED)
+            governor_request(governor);
+    }
 
-    uint8 in_speech = ps_get_in_speech(ps);
+    // Keep the utterance's audio for the second pass, along with the chunk
+    // before speech started.
+    if (self->second_pass != NULL && self->cascade == NULL) {
+        bool restart = event == UTT_EVENT_NONE &&
+            self->utterance_state != STARTED && !ps_get_in_speech(ps);
+        second_pass_retain(self->second_pass, audio_data_c->samples,
+                           audio_data_c->n_samples, restart);
+    }
+    obj_lock_release(&audio_data_c->lock);
     PyObject *result = Py_None; // incremented at end of function as result
 
-    if (in_speech && self->utterance_state == IDLE) {
-        self->utterance_state = STARTED;
+    // Call the keyphrase callback if the cascade woke up
+    if (keyphrase != NULL && call_callbacks &&
+        PyCallable_Check(self->keyphrase_callback)) {
+        uint64 span = trace_begin();
+        PyObject *cb_result = PyObject_CallFunction(self->keyphrase_callback,
+                                                    "s", keyphrase);
+        trace_end(span, "keyphrase_callback");
+        if (cb_result == NULL)
+            return NULL;
+        Py_DECREF(cb_result);
+    }
 
+    if (event == UTT_EVENT_SPEECH_START) {
         // Call speech_start callback if necessary
         PyObject *callback = self->speech_start_callback;
         if (call_callbacks && PyCallable_Check(callback)) {
             // NULL args means no args are required.
+            uint64 span = trace_begin();
             PyObject *cb_result = PyObject_CallObject(callback, NULL);
+            trace_end(span, "speech_start_callback");
             if (cb_result == NULL) {
                 result = cb_result;
             }
         }
-    } else if (!in_speech && self->utterance_state == STARTED) {
-        /* speech -> silence transition, time to start new utterance  */
-        ps_end_utt(ps);
-        self->utterance_state = ENDED;
+    } else if (event == UTT_EVENT_HYPOTHESIS) {
+        uint64 span = trace_begin();
         char const *hyp = ps_get_hyp(ps, NULL);
+        trace_end(span, "ps_get_hyp");
+
+        // Hand the lattice and audio over before the callback can change the
+        // search.
+        if (call_callbacks)
+            PSObj_rescore_utterance(self);
+        PSObj_second_pass_utterance(self, hyp, call_callbacks);
 	
         // Call the Python hypothesis callback if it is callable
         // It should have the correct number of arguments because
@@ -121,7 +239,9 @@ PSObj_process_audio_internal(PSObj *self, PyObject *audio_data,
                 args = Py_BuildValue("(O)", Py_None);
             }
             
+            span = trace_begin();
             PyObject *cb_result = PyObject_CallObject(callback, args);
+            trace_end(span, "hypothesis_callback");
             if (cb_result == NULL) {
                 result = cb_result;
             }
@@ -129,6 +249,9 @@ PSObj_process_audio_internal(PSObj *self, PyObject *audio_data,
             // Return the hypothesis instead
             result = Py_BuildValue("s", hyp);
         }
+
+        // Searches waiting for the utterance to end can be set now.
+        PSObj_apply_grammars(self);
     }
 
     Py_XINCREF(result);
@@ -170,9 +293,10 @@ PSObj_batch_process(PSObj *self, PyObject *args, PyObject *kwds) {
         result = Py_None;
     }
 
+    PyTypeObject *audio_data_type = GET_MODULE_STATE(self)->AudioDataType;
     for (Py_ssize_t i = 0; i < list_size; i++) {
         PyObject *item = PyList_GetItem(audio, i);
-        if (!PyObject_TypeCheck(item, &AudioDataType)) {
+        if (!PyObject_TypeCheck(item, audio_data_type)) {
             PyErr_SetString(PyExc_TypeError, "all list items must be AudioData "
                             "objects!");
             return NULL;
@@ -201,10 +325,15 @@ PSObj_end_utterance(PSObj *self) {
     if (ps == NULL)
         return NULL;
 
-    if (self->utterance_state != ENDED) {
-        ps_end_utt(ps);
-        self->utterance_state = ENDED;
-    }
+    if (self->cascade != NULL)
+        cascade_end(self->cascade, ps, &self->utterance_state);
+    else
+        utterance_end(ps, &self->utterance_state);
+    if (self->multi_search != NULL)
+        multi_search_end_utt(self->multi_search);
+
+    // Searches waiting for the utterance to end can be set now.
+    PSObj_apply_grammars(self);
 
     Py_INCREF(Py_None);
     return Py_None;
@@ -241,49 +370,17 @@ PSObj_set_search_internal(PSObj *self, ps_search_type search_type,
     if (name == NULL)
         name = PS_DEFAULT_SEARCH;
 
-    // TODO Do dictionary and LM checks for missing words - maybe add them using 
-    // ps_add_word
-
-    int set_result = -1;
-    switch (search_type) {
-    case JSGF_FILE:
-        set_result = ps_set_jsgf_file(ps, name, value);
-        break;
-    case JSGF_STR:
-        set_result = ps_set_jsgf_string(ps, name, value);
-        break;
-    case LM_FILE:
-        set_result = ps_set_lm_file(ps, name, value);
-        break;
-    case FSG_FILE:
-        ; // required because you cannot declare immediately after a label in C
-        // Get the config used to initialise the decoder
-        cmd_ln_t *config = get_cmd_ln_t(self);
-        // Create a fsg model from the file and set it using the search name
-        fsg_model_t *fsg = fsg_model_readfile(value, ps_get_logmath(ps),
-                                              cmd_ln_float32_r(config, "-lw"));
-        if (!fsg) {
-            set_result = -1;
-            break;
-        }
-	
-        set_result = ps_set_fsg(ps, name, fsg);
-
-        // This should be done whether or not ps_set_fsg fails, apparently..
-        fsg_model_free(fsg);
-        break;
-    case KWS_FILE:
-        // TODO Allow use of a Python list of keyword arguments rather than a file
-        set_result = ps_set_kws(ps, name, value);
-        break;
-    case KWS_STR:
-        set_result = ps_set_keyphrase(ps, name, value);
-        break;
+    int set_result = add_ps_search(ps, search_type, name, value);
+    if (set_result == 0) {
+        self->search_sources = search_sources_add(self->search_sources,
+                                                  search_type, name, value);
+        set_result = PSObj_use_search(self, name);
     }
 
     // Set the search if set_result is fine or set an error
     if (set_result < 0 || (ps_set_search(ps, name) < 0)) {
-        PyErr_Format(PocketSphinxError, "something went wrong whilst setting up a "
+        PyErr_Format(GET_MODULE_STATE(self)->PocketSphinxError,
+                     "something went wrong whilst setting up a "
                      "Pocket Sphinx search with name '%s'.", name);
         result = NULL;
     }
@@ -297,6 +394,60 @@ PSObj_set_search_internal(PSObj *self, ps_search_type search_type,
     return result;
 }
 
+int
+PSObj_use_search(PSObj *self, const char *name) {
+    ps_decoder_t *ps = self->ps;
+    if (search_sources_restore(self->search_sources, ps, name) < 0)
+        return -1;
+
+    search_sources_used(self->search_sources, ps, name, ++self->search_clock);
+    if (self->max_searches == 0 && self->max_search_bytes == 0)
+        return 0;
+
+    cascade_t *cascade = self->cascade;
+    char const *keep[] = {
+        name, ps_get_search(ps),
+        cascade != NULL ? cascade_wake_search(cascade) : NULL,
+        cascade != NULL ? cascade_command_search(cascade) : NULL
+    };
+    search_sources_evict(self->search_sources, ps, self->max_searches,
+                         self->max_search_bytes, keep, 4);
+    return 0;
+}
+
+PyObject *
+PSObj_set_search_limit(PSObj *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"max_searches", "max_bytes", NULL};
+    int max_searches = 0;
+    Py_ssize_t max_bytes = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|in", kwlist, &max_searches,
+                                     &max_bytes))
+        return NULL;
+
+    if (max_searches < 0 || max_bytes < 0) {
+        PyErr_SetString(PyExc_ValueError, "limits must not be negative.");
+        return NULL;
+    }
+
+    ps_decoder_t *ps = get_ps_decoder_t(self);
+    if (ps == NULL)
+        return NULL;
+
+    self->max_searches = max_searches;
+    self->max_search_bytes = (size_t)max_bytes;
+
+    // Apply the new limits straight away.
+    const char *active = ps_get_search(ps);
+    if (active != NULL && PSObj_use_search(self, active) < 0) {
+        PyErr_SetString(GET_MODULE_STATE(self)->PocketSphinxError,
+                        "failed to set up the active search again.");
+        return NULL;
+    }
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
 
 PyObject *
 PSObj_set_jsgf_file_search(PSObj *self, PyObject *args, PyObject *kwds) {
@@ -328,6 +479,34 @@ PSObj_set_keyphrases_search(PSObj *self, PyObject *args, PyObject *kwds) {
     return PSObj_set_search_internal(self, KWS_FILE, args, kwds);
 }
 
+PyObject *
+PSObj_add_word(PSObj *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"word", "phones", NULL};
+    const char *word = NULL;
+    const char *phones = NULL;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "ss", kwlist, &word, &phones))
+        return NULL;
+
+    ps_decoder_t *ps = get_ps_decoder_t(self);
+    if (ps == NULL)
+        return NULL;
+
+    if (add_ps_search(ps, DICT_WORD, word, phones) < 0) {
+        PyErr_Format(GET_MODULE_STATE(self)->PocketSphinxError,
+                     "couldn't add word '%s' to the dictionary. Is it already "
+                     "there or are its phones wrong?", word);
+        return NULL;
+    }
+
+    // Remember the word so that decoders set up from the search sources know
+    // it too.
+    self->search_sources = search_sources_add(self->search_sources, DICT_WORD,
+                                              word, phones);
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
 PyObject *
 PSObj_set_config_argument(PSObj *self, PyObject *args, PyObject *kwds) {
     cmd_ln_t *config = get_cmd_ln_t(self);
@@ -372,15 +551,44 @@ PSObj_set_config_argument(PSObj *self, PyObject *args, PyObject *kwds) {
         ps_decoder_t *ps = get_ps_decoder_t(self);
         if (ps == NULL)
             return NULL;
-        if (ps_reinit(ps, NULL) < 0) {
-            PyErr_SetString(PocketSphinxError, "failed to reinitialise Pocket "
+        // Reinitialising frees every search, so remember the active one.
+        const char *active = ps_get_search(ps);
+        char *active_name = active != NULL ? ckd_salloc(active) : NULL;
+        uint64 span = trace_begin();
+        int reinit_result = ps_reinit(ps, NULL);
+        trace_end(span, "ps_reinit");
+        if (reinit_result < 0) {
+            ckd_free(active_name);
+            PyErr_SetString(GET_MODULE_STATE(self)->PocketSphinxError,
+                            "failed to reinitialise Pocket "
                             "Sphinx.");
             return NULL;
         }
+
+        // Searches from sources are set up again when next used, starting
+        // with the one that was active.
+        int restore_result = search_sources_reinit(self->search_sources, ps);
+        if (restore_result == 0 && active_name != NULL &&
+            search_sources_find(self->search_sources, active_name) != NULL) {
+            restore_result = PSObj_use_search(self, active_name);
+            if (restore_result == 0)
+                restore_result = ps_set_search(ps, active_name) < 0 ? -1 : 0;
+        }
+        ckd_free(active_name);
+        if (restore_result < 0) {
+            PyErr_SetString(GET_MODULE_STATE(self)->PocketSphinxError,
+                            "failed to set up the decoder's searches and "
+                            "words again after reinitialising it.");
+            return NULL;
+        }
     }
 
     self->config = config;
 
+    // The user's beams replace any the governor had chosen.
+    if (self->governor != NULL)
+        governor_reset(self->governor, config);
+
     Py_INCREF(Py_None);
     return Py_None;
 }
@@ -401,9 +609,8 @@ PSObj_get_config_argument(PSObj *self, PyObject *args, PyObject *kwds) {
     
     // Find the named argument because we need its type
     const arg_t *argument = NULL;
-    for (size_t i = 0; i < sizeof(cont_args_def) / sizeof(const arg_t); i++) {
-        if (cont_args_def[i].name != NULL &&
-            strcmp(cont_args_def[i].name, name) == 0) {
+    for (size_t i = 0; cont_args_def[i].name != NULL; i++) {
+        if (strcmp(cont_args_def[i].name, name) == 0) {
             argument = &cont_args_def[i];
             break;
         }
@@ -471,6 +678,536 @@ PSObj_get_config_argument(PSObj *self, PyObject *args, PyObject *kwds) {
     return result;
 }
 
+PyObject *
+PSObj_set_cascade(PSObj *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"keyphrase_search", "command_search", "timeout",
+                             NULL};
+    const char *wake_search = NULL;
+    const char *command_search = NULL;
+    float timeout = 5.0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "ss|f", kwlist, &wake_search,
+                                     &command_search, &timeout))
+        return NULL;
+
+    if (timeout <= 0) {
+        PyErr_SetString(PyExc_ValueError, "'timeout' must be positive.");
+        return NULL;
+    }
+
+    if (self->multi_search != NULL) {
+        PyErr_SetString(GET_MODULE_STATE(self)->PocketSphinxError,
+                        "a cascade cannot be used with "
+                        "concurrent searches. Set concurrent_searches to None "
+                        "first.");
+        return NULL;
+    }
+
+    ps_decoder_t *ps = get_ps_decoder_t(self);
+    cmd_ln_t *config = get_cmd_ln_t(self);
+    if (ps == NULL || config == NULL)
+        return NULL;
+
+    // End any utterance in progress and replace the current cascade, if any.
+    if (self->cascade != NULL)
+        cascade_end(self->cascade, ps, &self->utterance_state);
+    else
+        utterance_end(ps, &self->utterance_state);
+    cascade_free(self->cascade);
+    self->cascade = NULL;
+
+    // Check both searches exist, leaving the keyphrase search active.
+    const char *names[] = {command_search, wake_search};
+    for (int i = 0; i < 2; i++) {
+        if (PSObj_use_search(self, names[i]) < 0 ||
+            ps_set_search(ps, names[i]) < 0) {
+            PyErr_Format(GET_MODULE_STATE(self)->PocketSphinxError,
+                         "failed to set Pocket Sphinx search "
+                         "with name '%s'. Perhaps there isn't a search with "
+                         "that name?", names[i]);
+            return NULL;
+        }
+    }
+
+    self->cascade = cascade_init(wake_search, command_search, timeout,
+                                 cmd_ln_float32_r(config, "-samprate"),
+                                 cmd_ln_int32_r(config, "-frate"));
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+PyObject *
+PSObj_clear_cascade(PSObj *self) {
+    ps_decoder_t *ps = get_ps_decoder_t(self);
+    if (ps == NULL)
+        return NULL;
+
+    if (self->cascade != NULL) {
+        cascade_end(self->cascade, ps, &self->utterance_state);
+        cascade_free(self->cascade);
+        self->cascade = NULL;
+
+        // Go back to the search that was active before the cascade.
+        if (PYCOMPAT_STRING_CHECK(self->search_name)) {
+            const char *name = PYCOMPAT_STRING_AS_STRING(self->search_name);
+            if (PSObj_use_search(self, name) == 0)
+                ps_set_search(ps, name);
+        }
+    }
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+/* Set the active search up again with the governor's new beams. This runs on
+ * the governor's thread, so it only uses the decoder if no method is, and
+ * gives up until the next utterance boundary otherwise.
+ */
+static void
+PSObj_governor_rebuild(void *arg) {
+    PSObj *self = arg;
+    if (!obj_lock_try_acquire(&self->lock))
+        return;
+
+    ps_decoder_t *ps = self->ps;
+    cmd_ln_t *config = self->config;
+    governor_t *governor = self->governor;
+    if (ps != NULL && config != NULL && governor != NULL &&
+        self->utterance_state == ENDED && self->multi_search == NULL &&
+        governor_apply(governor, config)) {
+        bool applied = refresh_ps_search(ps, ps_get_search(ps)) == 0;
+        governor_applied(governor, config, applied);
+    }
+    obj_lock_release(&self->lock);
+}
+
+PyObject *
+PSObj_enable_governor(PSObj *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"target_rtf", NULL};
+    double target_rtf = 0.8;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|d", kwlist, &target_rtf))
+        return NULL;
+
+    if (target_rtf <= 0) {
+        PyErr_SetString(PyExc_ValueError, "'target_rtf' must be positive.");
+        return NULL;
+    }
+
+    cmd_ln_t *config = get_cmd_ln_t(self);
+    if (config == NULL)
+        return NULL;
+
+    // Keep the configured beams if the governor is already enabled.
+    if (self->governor != NULL) {
+        self->governor->target_rtf = target_rtf;
+    } else {
+        self->governor = governor_init(config, target_rtf,
+                                       PSObj_governor_rebuild, self);
+        if (self->governor == NULL) {
+            PyErr_SetString(GET_MODULE_STATE(self)->PocketSphinxError,
+                            "failed to start the governor's thread.");
+            return NULL;
+        }
+    }
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+PyObject *
+PSObj_disable_governor(PSObj *self) {
+    ps_decoder_t *ps = get_ps_decoder_t(self);
+    cmd_ln_t *config = get_cmd_ln_t(self);
+    if (ps == NULL || config == NULL)
+        return NULL;
+
+    governor_t *governor = self->governor;
+    if (governor != NULL) {
+        // Put the configured beams back, setting the search up again if they
+        // were changed.
+        bool changed = governor->level != 0;
+        governor_restore(governor, config);
+        governor_free(governor);
+        self->governor = NULL;
+
+        if (changed) {
+            utterance_end(ps, &self->utterance_state);
+            refresh_ps_search(ps, ps_get_search(ps));
+        }
+    }
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+PyObject *
+PSObj_set_endpointer(PSObj *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"trailing_silence", "min_speech",
+                             "max_utterance", NULL};
+    double trailing_silence = 0.0;
+    double min_speech = 0.0;
+    double max_utterance = 0.0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|ddd", kwlist,
+                                     &trailing_silence, &min_speech,
+                                     &max_utterance))
+        return NULL;
+
+    if (trailing_silence < 0 || min_speech < 0 || max_utterance < 0) {
+        PyErr_SetString(PyExc_ValueError, "durations must not be negative.");
+        return NULL;
+    }
+
+    if (max_utterance > 0 && max_utterance <= min_speech) {
+        PyErr_SetString(PyExc_ValueError, "'max_utterance' must be longer "
+                        "than 'min_speech'.");
+        return NULL;
+    }
+
+    cmd_ln_t *config = get_cmd_ln_t(self);
+    if (config == NULL)
+        return NULL;
+
+    // Counting starts again from the next chunk of audio.
+    endpointer_free(self->endpointer);
+    self->endpointer = endpointer_init(config, trailing_silence, min_speech,
+                                       max_utterance);
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+PyObject *
+PSObj_clear_endpointer(PSObj *self) {
+    endpointer_free(self->endpointer);
+    self->endpointer = NULL;
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+static const char *mem_search_type_names[] = {"ngram", "fsg", "kws", "other"};
+
+PyObject *
+PSObj_memory_report(PSObj *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"include_lattice", NULL};
+    int include_lattice = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|i", kwlist,
+                                     &include_lattice))
+        return NULL;
+
+    ps_decoder_t *ps = get_ps_decoder_t(self);
+    cmd_ln_t *config = get_cmd_ln_t(self);
+    if (ps == NULL || config == NULL)
+        return NULL;
+
+    PyObject *searches = PyDict_New();
+    if (searches == NULL)
+        return NULL;
+
+    size_t acoustic_model = mem_acoustic_model(config);
+    size_t dictionary = mem_dictionary(config);
+    size_t total = acoustic_model + dictionary;
+    ps_search_iter_t *itor;
+    for (itor = ps_search_iter(ps); itor; itor = ps_search_iter_next(itor)) {
+        const char *name = ps_search_iter_val(itor);
+        mem_search_type_t type;
+        size_t bytes = mem_search(ps, name, &type);
+        total += bytes;
+
+        PyObject *entry = Py_BuildValue("{s:s,s:n}",
+                                        "type", mem_search_type_names[type],
+                                        "bytes", (Py_ssize_t)bytes);
+        if (entry == NULL || PyDict_SetItemString(searches, name, entry) < 0) {
+            Py_XDECREF(entry);
+            Py_DECREF(searches);
+            ps_search_iter_free(itor);
+            return NULL;
+        }
+        Py_DECREF(entry);
+    }
+
+    // Getting the lattice builds it if needed, which takes time and memory
+    // of its own, so it is only done when asked for.  Asking for it
+    // mid-utterance would build a partial one.
+    size_t lattice = 0;
+    if (include_lattice && self->utterance_state == ENDED &&
+            self->multi_search == NULL)
+        lattice = mem_lattice(ps_get_lattice(ps));
+    total += lattice;
+
+    return Py_BuildValue("{s:n,s:n,s:N,s:n,s:n}",
+                         "acoustic_model", (Py_ssize_t)acoustic_model,
+                         "dictionary", (Py_ssize_t)dictionary,
+                         "searches", searches,
+                         "lattice", (Py_ssize_t)lattice,
+                         "total", (Py_ssize_t)total);
+}
+
+PyObject *
+PSObj_get_normalisation_state(PSObj *self) {
+    ps_decoder_t *ps = get_ps_decoder_t(self);
+    if (ps == NULL)
+        return NULL;
+
+    size_t size = norm_state_size(ps);
+    if (size == 0) {
+        PyErr_SetString(GET_MODULE_STATE(self)->PocketSphinxError,
+                        "the decoder has no normalisation "
+                        "state.");
+        return NULL;
+    }
+
+    PyObject *result = PyBytes_FromStringAndSize(NULL, size);
+    if (result == NULL)
+        return NULL;
+    norm_state_get(ps, PyBytes_AS_STRING(result), size);
+    return result;
+}
+
+PyObject *
+PSObj_set_normalisation_state(PSObj *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"state", NULL};
+    PyObject *state = NULL;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O", kwlist, &state))
+        return NULL;
+
+    ps_decoder_t *ps = get_ps_decoder_t(self);
+    if (ps == NULL)
+        return NULL;
+
+    Py_buffer view;
+    if (PyObject_GetBuffer(state, &view, PyBUF_SIMPLE) < 0)
+        return NULL;
+
+    int set_result = norm_state_set(ps, view.buf, view.len);
+    PyBuffer_Release(&view);
+    if (set_result < 0) {
+        PyErr_SetString(PyExc_ValueError, "state is not normalisation state "
+                        "from a decoder with the same feature configuration.");
+        return NULL;
+    }
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+PyObject *
+PSObj_save_normalisation_state(PSObj *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"path", NULL};
+    const char *path = NULL;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s", kwlist, &path))
+        return NULL;
+
+    ps_decoder_t *ps = get_ps_decoder_t(self);
+    if (ps == NULL)
+        return NULL;
+
+    if (norm_state_save(ps, path) < 0)
+        return PyErr_SetFromErrnoWithFilename(PyExc_IOError, path);
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+PyObject *
+PSObj_save_snapshot(PSObj *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"path", NULL};
+    const char *path = NULL;
+    int save_result;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s", kwlist, &path))
+        return NULL;
+
+    ps_decoder_t *ps = get_ps_decoder_t(self);
+    cmd_ln_t *config = get_cmd_ln_t(self);
+    if (ps == NULL || config == NULL)
+        return NULL;
+
+    Py_BEGIN_ALLOW_THREADS
+    save_result = snapshot_save(path, ps, config, self->search_sources);
+    Py_END_ALLOW_THREADS
+    if (save_result < 0)
+        return PyErr_SetFromErrnoWithFilename(PyExc_IOError, path);
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+PyObject *
+PSObj_load_normalisation_state(PSObj *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"path", NULL};
+    const char *path = NULL;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s", kwlist, &path))
+        return NULL;
+
+    ps_decoder_t *ps = get_ps_decoder_t(self);
+    if (ps == NULL)
+        return NULL;
+
+    if (norm_state_load(ps, path) < 0) {
+        if (errno == EINVAL)
+            PyErr_Format(PyExc_ValueError, "'%s' doesn't hold normalisation "
+                         "state from a decoder with the same feature "
+                         "configuration.", path);
+        else
+            PyErr_SetFromErrnoWithFilename(PyExc_IOError, path);
+        return NULL;
+    }
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+PyObject *
+PSObj_decode_long(PSObj *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"audio", "workers", "segment_length", "overlap",
+                             "min_silence", NULL};
+    PyObject *audio = NULL;
+    int n_workers = 0;
+    long_audio_opts_t opts = {30.0, 0.5, 0.3, 0};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|ifff", kwlist, &audio,
+                                     &n_workers, &opts.segment_length,
+                                     &opts.overlap, &opts.min_silence))
+        return NULL;
+
+    if (opts.segment_length <= 0 || opts.overlap < 0 || opts.min_silence <= 0) {
+        PyErr_SetString(PyExc_ValueError, "segment_length and min_silence must "
+                        "be positive and overlap must not be negative.");
+        return NULL;
+    }
+
+    // Use one worker per CPU by default
+    if (n_workers <= 0)
+        n_workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    opts.n_workers = n_workers > 0 ? n_workers : 1;
+
+    ps_decoder_t *ps = get_ps_decoder_t(self);
+    cmd_ln_t *config = get_cmd_ln_t(self);
+    if (ps == NULL || config == NULL)
+        return NULL;
+
+    Py_buffer view;
+    int16 const *samples;
+    size_t n_samples;
+    if (get_audio_samples(GET_MODULE_STATE(self), audio, &view, &samples,
+                          &n_samples) < 0)
+        return NULL;
+
+    // End any utterance in progress so the decoder's config isn't in use.
+    utterance_end(ps, &self->utterance_state);
+
+    long_audio_word_t *words = NULL;
+    ssize_t n_words;
+    const char *active = ps_get_search(ps);
+    Py_INCREF(audio);
+    Py_BEGIN_ALLOW_THREADS
+    n_words = decode_long_audio(config, self->search_sources, active, samples,
+                                n_samples, &opts, &words);
+    Py_END_ALLOW_THREADS
+    PyBuffer_Release(&view);
+    Py_DECREF(audio);
+
+    if (n_words < 0) {
+        PyErr_SetString(GET_MODULE_STATE(self)->PocketSphinxError,
+                        "something went wrong whilst "
+                        "decoding long audio.");
+        return NULL;
+    }
+
+    // Build the hypothesis and the list of (word, start, end) tuples
+    size_t hyp_size = 1;
+    for (ssize_t i = 0; i < n_words; i++)
+        hyp_size += strlen(words[i].word) + 1;
+    char *hyp = PyMem_Malloc(hyp_size);
+    PyObject *word_list = PyList_New(n_words);
+    if (hyp == NULL || word_list == NULL) {
+        PyMem_Free(hyp);
+        Py_XDECREF(word_list);
+        long_audio_words_free(words, n_words);
+        return PyErr_NoMemory();
+    }
+
+    char *end = hyp;
+    *end = '\0';
+    for (ssize_t i = 0; i < n_words; i++) {
+        if (i > 0)
+            *end++ = ' ';
+        size_t length = strlen(words[i].word);
+        memcpy(end, words[i].word, length + 1);
+        end += length;
+
+        PyObject *item = Py_BuildValue("(sdd)", words[i].word, words[i].start,
+                                       words[i].end);
+        if (item == NULL) {
+            PyMem_Free(hyp);
+            Py_DECREF(word_list);
+            long_audio_words_free(words, n_words);
+            return NULL;
+        }
+        PyList_SET_ITEM(word_list, i, item);
+    }
+    long_audio_words_free(words, n_words);
+
+    PyObject *result = Py_BuildValue("(sN)", hyp, word_list);
+    PyMem_Free(hyp);
+    return result;
+}
+
+// Hold the decoder's lock while methods run. Each decoder is used by one thread
+// at a time, even where the GIL is released or absent.
+OBJ_LOCKED_O(PSObj, PSObj_process_audio)
+OBJ_LOCKED_KWARGS(PSObj, PSObj_batch_process)
+OBJ_LOCKED_NOARGS(PSObj, PSObj_end_utterance)
+OBJ_LOCKED_KWARGS(PSObj, PSObj_set_jsgf_file_search)
+OBJ_LOCKED_KWARGS(PSObj, PSObj_set_jsgf_str_search)
+OBJ_LOCKED_KWARGS(PSObj, PSObj_set_jsgf_file_search_async)
+OBJ_LOCKED_KWARGS(PSObj, PSObj_set_jsgf_str_search_async)
+OBJ_LOCKED_KWARGS(PSObj, PSObj_set_lm_search)
+OBJ_LOCKED_KWARGS(PSObj, PSObj_set_fsg_search)
+OBJ_LOCKED_KWARGS(PSObj, PSObj_set_fsg_search_async)
+OBJ_LOCKED_KWARGS(PSObj, PSObj_add_fsg_transition)
+OBJ_LOCKED_KWARGS(PSObj, PSObj_remove_fsg_transitions)
+OBJ_LOCKED_KWARGS(PSObj, PSObj_get_fsg_states)
+OBJ_LOCKED_KWARGS(PSObj, PSObj_set_keyphrase_search)
+OBJ_LOCKED_KWARGS(PSObj, PSObj_set_keyphrases_search)
+OBJ_LOCKED_KWARGS(PSObj, PSObj_add_word)
+OBJ_LOCKED_KWARGS(PSObj, PSObj_set_config_argument)
+OBJ_LOCKED_KWARGS(PSObj, PSObj_get_config_argument)
+OBJ_LOCKED_NOARGS(PSObj, PSObj_warm_up)
+OBJ_LOCKED_NOARGS(PSObj, PSObj_reset)
+OBJ_LOCKED_KWARGS(PSObj, PSObj_fork_workers)
+OBJ_LOCKED_KWARGS(PSObj, PSObj_set_cascade)
+OBJ_LOCKED_NOARGS(PSObj, PSObj_clear_cascade)
+OBJ_LOCKED_KWARGS(PSObj, PSObj_enable_governor)
+OBJ_LOCKED_NOARGS(PSObj, PSObj_disable_governor)
+OBJ_LOCKED_KWARGS(PSObj, PSObj_set_endpointer)
+OBJ_LOCKED_NOARGS(PSObj, PSObj_clear_endpointer)
+OBJ_LOCKED_KWARGS(PSObj, PSObj_memory_report)
+OBJ_LOCKED_KWARGS(PSObj, PSObj_set_search_limit)
+OBJ_LOCKED_NOARGS(PSObj, PSObj_get_normalisation_state)
+OBJ_LOCKED_KWARGS(PSObj, PSObj_set_normalisation_state)
+OBJ_LOCKED_KWARGS(PSObj, PSObj_save_normalisation_state)
+OBJ_LOCKED_KWARGS(PSObj, PSObj_save_snapshot)
+OBJ_LOCKED_KWARGS(PSObj, PSObj_load_normalisation_state)
+OBJ_LOCKED_NOARGS(PSObj, PSObj_get_lattice)
+OBJ_LOCKED_KWARGS(PSObj, PSObj_enable_rescoring)
+OBJ_LOCKED_NOARGS(PSObj, PSObj_disable_rescoring)
+OBJ_LOCKED_NOARGS(PSObj, PSObj_wait_for_rescoring)
+OBJ_LOCKED_NOARGS(PSObj, PSObj_enable_two_pass)
+OBJ_LOCKED_NOARGS(PSObj, PSObj_disable_two_pass)
+OBJ_LOCKED_NOARGS(PSObj, PSObj_wait_for_second_pass)
+OBJ_LOCKED_KWARGS(PSObj, PSObj_decode_long)
+OBJ_LOCKED_KWARGS(PSObj, PSObj_extract_features)
+OBJ_LOCKED_KWARGS(PSObj, PSObj_decode_features)
+
 // Define a macro for documenting multiple search methods
 #define PS_SEARCH_DOCSTRING(first_line, first_keyword_docstring)        \
     PyDoc_STR(first_line "\n"                                           \
@@ -481,14 +1218,28 @@ PSObj_get_config_argument(PSObj *self, PyObject *args, PyObject *kwds) {
               "name -- name of the Pocket Sphinx search to set "        \
               "(default '" PS_DEFAULT_SEARCH "')\n")
 
+#define PS_SEARCH_ASYNC_DOCSTRING(first_line, first_keyword_docstring)  \
+    PyDoc_STR(first_line "\n"                                           \
+              "Returns a SearchFuture straight away. The compiled search "  \
+              "is set and activated between chunks of audio passed to "    \
+              "process_audio(), once any utterance with speech has ended. " \
+              "Searches are set in the order they were requested.\n\n"    \
+              "Keyword arguments:\n"                                      \
+              first_keyword_docstring "\n"                                \
+              "name -- name of the Pocket Sphinx search to set "          \
+              "(default '" PS_DEFAULT_SEARCH "')\n"                       \
+              "interrupt -- whether to end an utterance with speech "     \
+              "without a hypothesis rather than wait for it (default "    \
+              "False)\n")
+
 PyMethodDef PSObj_methods[] = {
     {"process_audio",
-     (PyCFunction)PSObj_process_audio, METH_O,  // takes self + one argument
+     (PyCFunction)PSObj_process_audio_locked, METH_O,  // takes self + one argument
      PyDoc_STR(
          "Process audio from an AudioData object and call the speech_start and "
          "hypothesis callbacks where necessary.\n")},
     {"batch_process",
-     (PyCFunction)PSObj_batch_process, METH_KEYWORDS | METH_VARARGS,
+     (PyCFunction)PSObj_batch_process_locked, METH_KEYWORDS | METH_VARARGS,
      PyDoc_STR(
          "Process a list of AudioData objects and return the speech hypothesis or "
          "use the decoder callbacks if use_callbacks is True.\n\n"
@@ -497,56 +1248,394 @@ PyMethodDef PSObj_methods[] = {
          "use_callbacks -- whether to use the decoder callbacks or return the "
          "speech hypothesis (default True)\n")},
     {"end_utterance",
-     (PyCFunction)PSObj_end_utterance, METH_NOARGS,  // takes no arguments
+     (PyCFunction)PSObj_end_utterance_locked, METH_NOARGS,  // takes no arguments
      PyDoc_STR(
          "End the current utterance if one was in progress.\n"
          "This method may be used, for example, to reset processing of audio via "
          "the process_audio method in the case of some sort of context change.\n")},
     {"set_jsgf_file_search",
-     (PyCFunction)PSObj_set_jsgf_file_search, METH_KEYWORDS | METH_VARARGS,
+     (PyCFunction)PSObj_set_jsgf_file_search_locked, METH_KEYWORDS | METH_VARARGS,
      PS_SEARCH_DOCSTRING(
          "Set a Pocket Sphinx search using a JSpeech Grammar Format grammar file",
          "path -- file path to the JSGF file to use.")},
     {"set_jsgf_str_search",
-     (PyCFunction)PSObj_set_jsgf_str_search, METH_KEYWORDS | METH_VARARGS,
+     (PyCFunction)PSObj_set_jsgf_str_search_locked, METH_KEYWORDS | METH_VARARGS,
      PS_SEARCH_DOCSTRING(
          "Set a Pocket Sphinx search using a JSpeech Grammar Format grammar string.",
          "str -- the JSGF string to use.")},
+    {"set_jsgf_file_search_async",
+     (PyCFunction)PSObj_set_jsgf_file_search_async_locked, METH_KEYWORDS | METH_VARARGS,
+     PS_SEARCH_ASYNC_DOCSTRING(
+         "Like set_jsgf_file_search(), but compile the grammar in the "
+         "background.",
+         "path -- file path to the JSGF file to use.")},
+    {"set_jsgf_str_search_async",
+     (PyCFunction)PSObj_set_jsgf_str_search_async_locked, METH_KEYWORDS | METH_VARARGS,
+     PS_SEARCH_ASYNC_DOCSTRING(
+         "Like set_jsgf_str_search(), but compile the grammar in the "
+         "background.",
+         "str -- the JSGF string to use.")},
     {"set_lm_search",
-     (PyCFunction)PSObj_set_lm_search, METH_KEYWORDS | METH_VARARGS,
+     (PyCFunction)PSObj_set_lm_search_locked, METH_KEYWORDS | METH_VARARGS,
      PS_SEARCH_DOCSTRING(
          "Set a Pocket Sphinx search using a language model file.",
          "path -- file path to the LM file to use.")},
     {"set_fsg_search",
-     (PyCFunction)PSObj_set_fsg_search, METH_KEYWORDS | METH_VARARGS,
+     (PyCFunction)PSObj_set_fsg_search_locked, METH_KEYWORDS | METH_VARARGS,
      PS_SEARCH_DOCSTRING(
          "Set a Pocket Sphinx search using a finite state grammar file.",
          "path -- file path to the FSG file to use.")},
+    {"set_fsg_search_async",
+     (PyCFunction)PSObj_set_fsg_search_async_locked, METH_KEYWORDS | METH_VARARGS,
+     PS_SEARCH_ASYNC_DOCSTRING(
+         "Like set_fsg_search(), but read the grammar in the background.",
+         "path -- file path to the FSG file to use.")},
+    {"add_fsg_transition",
+     (PyCFunction)PSObj_add_fsg_transition_locked, METH_KEYWORDS | METH_VARARGS,
+     PyDoc_STR(
+         "Add a transition to the grammar of a JSGF or FSG search without "
+         "compiling the grammar again. Returns a SearchFuture. The edit is "
+         "queued and made like the *_search_async methods set searches, after "
+         "any searches requested before it. The search's structures are built "
+         "again from the edited grammar and the edit is kept with the search's "
+         "source, but is lost if the search is set again.\n\n"
+         "Keyword arguments:\n"
+         "name -- name of the Pocket Sphinx search to edit.\n"
+         "from_state -- state the transition leaves.\n"
+         "to_state -- state the transition enters.\n"
+         "word -- dictionary word to recognise, or None for a null transition "
+         "(default None)\n"
+         "probability -- probability of the transition (default 1.0)\n"
+         "interrupt -- whether to end an utterance with speech without a "
+         "hypothesis rather than wait for it (default False)\n")},
+    {"remove_fsg_transitions",
+     (PyCFunction)PSObj_remove_fsg_transitions_locked, METH_KEYWORDS | METH_VARARGS,
+     PyDoc_STR(
+         "Remove the transitions of a word, including its alternate "
+         "pronunciations, from the grammar of a JSGF or FSG search. Returns a "
+         "SearchFuture and is queued like add_fsg_transition().\n\n"
+         "Keyword arguments:\n"
+         "name -- name of the Pocket Sphinx search to edit.\n"
+         "word -- the word to remove.\n"
+         "from_state -- only remove transitions leaving this state, or -1 for "
+         "any state (default -1)\n"
+         "to_state -- only remove transitions entering this state, or -1 for "
+         "any state (default -1)\n"
+         "interrupt -- whether to end an utterance with speech without a "
+         "hypothesis rather than wait for it (default False)\n")},
+    {"get_fsg_states",
+     (PyCFunction)PSObj_get_fsg_states_locked, METH_KEYWORDS | METH_VARARGS,
+     PyDoc_STR(
+         "Return the number of states and the start and final states of the "
+         "grammar of a JSGF or FSG search as a tuple.\n\n"
+         "Keyword arguments:\n"
+         "name -- name of the Pocket Sphinx search.\n")},
     {"set_keyphrase_search",
-     (PyCFunction)PSObj_set_keyphrase_search, METH_KEYWORDS | METH_VARARGS,
+     (PyCFunction)PSObj_set_keyphrase_search_locked, METH_KEYWORDS | METH_VARARGS,
      PS_SEARCH_DOCSTRING(
          "Set a Pocket Sphinx search using a single keyphrase to listen for.",
          "keyphrase -- the keyphrase to listen for.")},
     {"set_keyphrases_search",
-     (PyCFunction)PSObj_set_keyphrases_search, METH_KEYWORDS | METH_VARARGS,
+     (PyCFunction)PSObj_set_keyphrases_search_locked, METH_KEYWORDS | METH_VARARGS,
      PS_SEARCH_DOCSTRING(
          "Set a Pocket Sphinx search using a file containing keyphrases to listen "
          "for.", "path -- file path to the keyphrases file to use.")},
+    {"add_word",
+     (PyCFunction)PSObj_add_word_locked, METH_KEYWORDS | METH_VARARGS,
+     PyDoc_STR(
+         "Add a word to the decoder's dictionary so that searches set up "
+         "afterwards can use it. The active search is updated to recognise "
+         "the word as well.\n"
+         "Added words are set up again on every decoder made from this one's "
+         "searches and are saved by save_snapshot().\n\n"
+         "Keyword arguments:\n"
+         "word -- the word to add.\n"
+         "phones -- the word's pronunciation as space separated phones from "
+         "the acoustic model.\n")},
     {"set_config_argument",
-     (PyCFunction)PSObj_set_config_argument, METH_KEYWORDS | METH_VARARGS,
+     (PyCFunction)PSObj_set_config_argument_locked, METH_KEYWORDS | METH_VARARGS,
      PyDoc_STR(
          "Set a Sphinx decoder configuration argument.\n\n"
          "Keyword arguments:\n"
          "name -- the name of the configuration argument to set.\n"
          "value -- the new value for the configuration argument.\n"
          "reinitialise -- whether to reinitialise this decoder after setting the "
-         "argument (default True).\n")},
+         "argument (default True). Added words and the active search are set up "
+         "again straight away, and other searches the next time they are "
+         "activated.\n")},
     {"get_config_argument",
-     (PyCFunction)PSObj_get_config_argument, METH_KEYWORDS | METH_VARARGS,
+     (PyCFunction)PSObj_get_config_argument_locked, METH_KEYWORDS | METH_VARARGS,
      PyDoc_STR(
          "Get the value of a Sphinx decoder configuration argument.\n\n"
          "Keyword arguments:\n"
          "name -- the name of the configuration argument to get.\n")},
+    {"warm_up",
+     (PyCFunction)PSObj_warm_up_locked, METH_NOARGS,
+     PyDoc_STR(
+         "Decode a second of silence so that the decoder's buffers and search "
+         "structures are allocated before it is used or forked. Any utterance in "
+         "progress is ended and the cepstral mean normalisation estimate is left "
+         "unchanged.\n")},
+    {"reset",
+     (PyCFunction)PSObj_reset_locked, METH_NOARGS,
+     PyDoc_STR(
+         "Discard any utterance in progress without calling the hypothesis "
+         "callback, unset both callbacks and restart the active search.\n"
+         "This is used to give forked worker processes a clean decoder.\n")},
+    {"fork_workers",
+     (PyCFunction)PSObj_fork_workers_locked, METH_KEYWORDS | METH_VARARGS,
+     PyDoc_STR(
+         "Fork worker processes that share this decoder's models copy-on-write "
+         "and return their process IDs.\n"
+         "Each worker calls reset() and then target(decoder, index) before "
+         "exiting with status 0, or 1 if target raised an exception. Initialise "
+         "the decoder with '-mmap yes' to also share model files with other "
+         "processes through the page cache. This decoder should not be used to "
+         "decode audio in the parent process afterwards, otherwise the "
+         "pages it modifies are copied.\n\n"
+         "Keyword arguments:\n"
+         "count -- number of worker processes to fork.\n"
+         "target -- callable run in each worker with the decoder and the "
+         "worker's index.\n"
+         "warm_up -- whether to call warm_up() before forking (default True)\n")},
+    {"set_cascade",
+     (PyCFunction)PSObj_set_cascade_locked, METH_KEYWORDS | METH_VARARGS,
+     PyDoc_STR(
+         "Decode with a keyphrase search until the keyphrase is detected, then "
+         "switch to a command search within the same chunk of audio.\n"
+         "The audio following the keyphrase is decoded again with the command "
+         "search so the start of the command isn't lost. keyphrase_callback is "
+         "called when the keyphrase is detected and the speech start and "
+         "hypothesis callbacks are only called for the command search. The "
+         "keyphrase search is used again after the command utterance ends or "
+         "the timeout passes. active_search cannot be set while the cascade "
+         "is in use.\n\n"
+         "Keyword arguments:\n"
+         "keyphrase_search -- name of a keyphrase search.\n"
+         "command_search -- name of the search to decode commands with.\n"
+         "timeout -- seconds of audio after the keyphrase before going back "
+         "to the keyphrase search (default 5.0)\n")},
+    {"clear_cascade",
+     (PyCFunction)PSObj_clear_cascade_locked, METH_NOARGS,
+     PyDoc_STR(
+         "Stop using the cascade set up with set_cascade(), ending any "
+         "utterance in progress without calling the hypothesis callback, and "
+         "go back to the active search.\n")},
+    {"enable_governor",
+     (PyCFunction)PSObj_enable_governor_locked, METH_KEYWORDS | METH_VARARGS,
+     PyDoc_STR(
+         "Measure the real time factor of each chunk passed to process_audio() "
+         "and narrow the -beam, -wbeam and -pbeam pruning beams when the "
+         "average is above the target, widening them again when there is "
+         "headroom.\n"
+         "Beams can't be changed while a search is decoding, so new beams are "
+         "applied between utterances by setting up the active search again with "
+         "the grammar or language model it already uses, without reading any "
+         "files. This is done on the governor's own thread while no method is "
+         "using the decoder, and at most once per 5 seconds of audio. "
+         "Keyphrase searches can't be set up again this way; levels that "
+         "couldn't be applied are counted as failures in governor_stats.\n\n"
+         "Keyword arguments:\n"
+         "target_rtf -- real time factor to stay under (default 0.8)\n")},
+    {"disable_governor",
+     (PyCFunction)PSObj_disable_governor_locked, METH_NOARGS,
+     PyDoc_STR(
+         "Stop the governor and restore the configured beams, ending any "
+         "utterance in progress if they had changed.\n")},
+    {"set_endpointer",
+     (PyCFunction)PSObj_set_endpointer_locked, METH_KEYWORDS | METH_VARARGS,
+     PyDoc_STR(
+         "Decide where utterances passed to process_audio() start and end "
+         "with configurable durations, rather than only when the decoder's "
+         "voice activity detection changes.\n"
+         "Speech shorter than the minimum is discarded without calling the "
+         "callbacks. Utterances reaching the maximum length are ended and "
+         "their hypotheses reported, which bounds the time and memory taken "
+         "to end each utterance. Durations are checked after each chunk of "
+         "audio. The endpointer isn't used while a cascade is set.\n\n"
+         "Keyword arguments:\n"
+         "trailing_silence -- seconds of silence, after the decoder's "
+         "-vad_postspeech, that end an utterance (default 0)\n"
+         "min_speech -- seconds of speech needed to start an utterance "
+         "(default 0)\n"
+         "max_utterance -- seconds after which an utterance is ended, or 0 "
+         "for no limit (default 0)\n")},
+    {"clear_endpointer",
+     (PyCFunction)PSObj_clear_endpointer_locked, METH_NOARGS,
+     PyDoc_STR(
+         "Stop using the endpointer set up with set_endpointer(), ending "
+         "utterances when the decoder's voice activity detection detects "
+         "silence again.\n")},
+    {"memory_report",
+     (PyCFunction)PSObj_memory_report_locked, METH_KEYWORDS | METH_VARARGS,
+     PyDoc_STR(
+         "Return a dictionary estimating the bytes used by the decoder's "
+         "acoustic model, dictionary, each registered search and optionally "
+         "the last utterance's lattice, with their total.\n"
+         "'searches' maps each search name to a dictionary of its 'type' "
+         "('ngram', 'fsg', 'kws' or 'other') and 'bytes'. Model sizes come "
+         "from the model files and search sizes from what each model holds, "
+         "including the HMMs of the search's lexicon tree. Memory mapped and "
+         "shared models are counted in full.\n\n"
+         "Keyword arguments:\n"
+         "include_lattice -- whether to measure the last utterance's "
+         "lattice, building it if it wasn't already; 'lattice' is 0 "
+         "otherwise and during an utterance (default False)\n")},
+    {"set_search_limit",
+     (PyCFunction)PSObj_set_search_limit_locked, METH_KEYWORDS | METH_VARARGS,
+     PyDoc_STR(
+         "Limit the searches set up on the decoder by number or estimated "
+         "memory use, unsetting the least recently activated searches when "
+         "there are too many.\n"
+         "Evicted searches are set up again from their files or strings the "
+         "next time they are activated, with any grammar edits made to them. "
+         "The active search and any cascade's searches are never evicted, "
+         "and searches from the decoder's configuration aren't counted.\n\n"
+         "Keyword arguments:\n"
+         "max_searches -- most searches to keep set up, or 0 for no limit "
+         "(default 0)\n"
+         "max_bytes -- most memory for the searches to use in bytes, as "
+         "estimated by memory_report(), or 0 for no limit (default 0)\n")},
+    {"get_normalisation_state",
+     (PyCFunction)PSObj_get_normalisation_state_locked, METH_NOARGS,
+     PyDoc_STR(
+         "Return the decoder's live cepstral mean normalisation estimate and "
+         "automatic gain control maximum as a small bytes object.\n"
+         "Restoring it with set_normalisation_state() lets a new decoder or "
+         "session start from a warm estimate rather than the defaults.\n")},
+    {"set_normalisation_state",
+     (PyCFunction)PSObj_set_normalisation_state_locked, METH_KEYWORDS | METH_VARARGS,
+     PyDoc_STR(
+         "Restore normalisation state returned by get_normalisation_state(). "
+         "This is best done between utterances.\n\n"
+         "Keyword arguments:\n"
+         "state -- bytes from a decoder with the same feature configuration.\n")},
+    {"save_normalisation_state",
+     (PyCFunction)PSObj_save_normalisation_state_locked, METH_KEYWORDS | METH_VARARGS,
+     PyDoc_STR(
+         "Save the decoder's normalisation state to a file, such as one per "
+         "audio device or speaker.\n\n"
+         "Keyword arguments:\n"
+         "path -- file path to save to.\n")},
+    {"load_normalisation_state",
+     (PyCFunction)PSObj_load_normalisation_state_locked, METH_KEYWORDS | METH_VARARGS,
+     PyDoc_STR(
+         "Restore normalisation state saved by save_normalisation_state().\n\n"
+         "Keyword arguments:\n"
+         "path -- file path to load from.\n")},
+    {"save_snapshot",
+     (PyCFunction)PSObj_save_snapshot_locked, METH_KEYWORDS | METH_VARARGS,
+     PyDoc_STR(
+         "Save the decoder's configuration, added words and searches to a "
+         "file, which PocketSphinx(snapshot=path) restores without compiling "
+         "the grammars again.\n"
+         "JSGF and FSG searches are saved as compiled grammars with any edits "
+         "made to them, language model and keyphrase file searches as their "
+         "file paths. Model files are loaded from their paths when the "
+         "snapshot is restored, so they must still be there.\n\n"
+         "Keyword arguments:\n"
+         "path -- file path to save to.\n")},
+    {"get_lattice",
+     (PyCFunction)PSObj_get_lattice_locked, METH_NOARGS,
+     PyDoc_STR(
+         "Return the word lattice of the last utterance as a Lattice object, or "
+         "None if the active search doesn't produce lattices.\n")},
+    {"enable_rescoring",
+     (PyCFunction)PSObj_enable_rescoring_locked, METH_KEYWORDS | METH_VARARGS,
+     PyDoc_STR(
+         "Load a second, usually larger, n-gram language model and rescore the "
+         "lattice of each utterance with it on a background thread.\n"
+         "The first pass hypothesis is passed to hypothesis_callback as usual. "
+         "The lattice is then rescored using its acoustic scores and the "
+         "second model's language scores, and the result is passed to "
+         "rescored_hypothesis_callback during a later call to process_audio() "
+         "or wait_for_rescoring(). Results arrive in utterance order, one for "
+         "each hypothesis. The GIL is released while loading the model.\n\n"
+         "Keyword arguments:\n"
+         "lm_file -- file path to the language model to rescore with.\n"
+         "language_weight -- language weight for the model (default: the "
+         "decoder's -lw value)\n")},
+    {"disable_rescoring",
+     (PyCFunction)PSObj_disable_rescoring_locked, METH_NOARGS,
+     PyDoc_STR(
+         "Stop rescoring lattices, discarding results that haven't been "
+         "reported yet, and free the rescoring language model.\n")},
+    {"wait_for_rescoring",
+     (PyCFunction)PSObj_wait_for_rescoring_locked, METH_NOARGS,
+     PyDoc_STR(
+         "Wait for every lattice handed to the rescorer to be rescored and call "
+         "rescored_hypothesis_callback with the results. The GIL is released "
+         "while waiting.\n")},
+    {"enable_two_pass",
+     (PyCFunction)PSObj_enable_two_pass_locked, METH_NOARGS,
+     PyDoc_STR(
+         "Decode the audio of each utterance again on a background thread "
+         "with a second decoder using the flat lexicon and best path "
+         "searches.\n"
+         "Running this decoder with -fwdflat and -bestpath turned off gives "
+         "a fast hypothesis from the tree search, which is passed to "
+         "hypothesis_callback as usual. If the second pass hypothesis "
+         "differs, it is passed to corrected_hypothesis_callback along with "
+         "the first hypothesis during a later call to process_audio() or "
+         "wait_for_second_pass(). The second decoder is set up with the "
+         "searches known when this is called, so utterances decoded with "
+         "searches set later aren't decoded again, and costs the memory of "
+         "another decoder. Utterances decoded "
+         "with a cascade or concurrent searches aren't decoded again. The GIL "
+         "is released while loading the models.\n")},
+    {"disable_two_pass",
+     (PyCFunction)PSObj_disable_two_pass_locked, METH_NOARGS,
+     PyDoc_STR(
+         "Stop decoding utterances again, discarding results that haven't "
+         "been reported yet, and free the second decoder.\n")},
+    {"wait_for_second_pass",
+     (PyCFunction)PSObj_wait_for_second_pass_locked, METH_NOARGS,
+     PyDoc_STR(
+         "Wait for every utterance handed to the second pass to be decoded "
+         "and call corrected_hypothesis_callback with any corrections. The "
+         "GIL is released while waiting.\n")},
+    {"decode_long",
+     (PyCFunction)PSObj_decode_long_locked, METH_KEYWORDS | METH_VARARGS,
+     PyDoc_STR(
+         "Decode a long recording by splitting it at silences and decoding the "
+         "segments in parallel with the active search.\n"
+         "Each worker uses a separate decoder set up with this decoder's "
+         "configuration and searches. Words decoded in the overlap around a "
+         "segment are kept by the segment holding most of the word. The GIL is "
+         "released while decoding. Returns a tuple of the hypothesis and a list "
+         "of (word, start, end) tuples, with times in seconds from the start of "
+         "the audio.\n\n"
+         "Keyword arguments:\n"
+         "audio -- AudioFile, AudioData or buffer of 16-bit audio samples.\n"
+         "workers -- number of decoding threads (default: number of CPUs)\n"
+         "segment_length -- minimum segment length in seconds (default 30.0)\n"
+         "overlap -- audio decoded either side of each segment in seconds "
+         "(default 0.5)\n"
+         "min_silence -- shortest silence to split at in seconds "
+         "(default 0.3)\n")},
+    {"extract_features",
+     (PyCFunction)PSObj_extract_features_locked, METH_KEYWORDS | METH_VARARGS,
+     PyDoc_STR(
+         "Run the front end over audio once and return the cepstral frames as a "
+         "Features object that can be decoded by decode_features() any number "
+         "of times. The GIL is released while extracting.\n\n"
+         "Keyword arguments:\n"
+         "audio -- AudioFile, AudioData or buffer of 16-bit audio samples.\n")},
+    {"decode_features",
+     (PyCFunction)PSObj_decode_features_locked, METH_KEYWORDS | METH_VARARGS,
+     PyDoc_STR(
+         "Decode features from extract_features() as one utterance, skipping "
+         "the front end, and return the hypothesis or None.\n"
+         "If a list of search names is given, the searches are decoded "
+         "concurrently over the same frames, each by a separate decoder set up "
+         "with this decoder's configuration and searches, and a dictionary of "
+         "search names to hypotheses is returned instead. Those decoders are "
+         "kept for later calls until the configuration or searches change. "
+         "The GIL is released while decoding.\n\n"
+         "Keyword arguments:\n"
+         "features -- Features object.\n"
+         "searches -- list of search names or None to use the active search "
+         "(default None)\n")},
     {NULL}  /* Sentinel */
 };
 
@@ -571,6 +1660,31 @@ PSObj_new(PyTypeObject *type, PyObject *args, PyObject *kwds) {
         self->config = NULL;
 
         self->utterance_state = ENDED;
+        self->search_sources = NULL;
+        self->multi_search = NULL;
+        Py_INCREF(Py_None);
+        self->search_hypothesis_callback = Py_None;
+        self->cascade = NULL;
+        Py_INCREF(Py_None);
+        self->keyphrase_callback = Py_None;
+        self->governor = NULL;
+        self->endpointer = NULL;
+        self->rescorer = NULL;
+        Py_INCREF(Py_None);
+        self->rescored_hypothesis_callback = Py_None;
+        self->second_pass = NULL;
+        Py_INCREF(Py_None);
+        self->corrected_hypothesis_callback = Py_None;
+        self->grammar_compiler = NULL;
+        self->max_searches = 0;
+        self->max_search_bytes = 0;
+        self->search_clock = 0;
+        self->decoder_pool = decoder_pool_init();
+
+        if (obj_lock_init(&self->lock) < 0) {
+            Py_DECREF(self);
+            return NULL;
+        }
     }
 
     return (PyObject *)self;
@@ -581,6 +1695,66 @@ PSObj_dealloc(PSObj *self) {
     Py_XDECREF(self->hypothesis_callback);
     Py_XDECREF(self->speech_start_callback);
     Py_XDECREF(self->search_name);
+    Py_XDECREF(self->search_hypothesis_callback);
+    Py_XDECREF(self->keyphrase_callback);
+    Py_XDECREF(self->rescored_hypothesis_callback);
+    Py_XDECREF(self->corrected_hypothesis_callback);
+    search_sources_free(self->search_sources);
+    cascade_free(self->cascade);
+    endpointer_free(self->endpointer);
+
+    // Stop the governor's thread before the decoder goes
+    governor_t *governor = self->governor;
+    self->governor = NULL;
+    if (governor != NULL) {
+        Py_BEGIN_ALLOW_THREADS
+        governor_free(governor);
+        Py_END_ALLOW_THREADS
+    }
+
+    // Stop the concurrent search threads
+    multi_search_t *ms = self->multi_search;
+    self->multi_search = NULL;
+    if (ms != NULL) {
+        Py_BEGIN_ALLOW_THREADS
+        multi_search_free(ms);
+        Py_END_ALLOW_THREADS
+    }
+
+    // Stop the grammar compiler thread
+    grammar_compiler_t *gc = self->grammar_compiler;
+    self->grammar_compiler = NULL;
+    if (gc != NULL) {
+        Py_BEGIN_ALLOW_THREADS
+        grammar_compiler_free(gc);
+        Py_END_ALLOW_THREADS
+    }
+
+    // Stop the rescoring thread
+    rescorer_t *rescorer = self->rescorer;
+    self->rescorer = NULL;
+    if (rescorer != NULL) {
+        Py_BEGIN_ALLOW_THREADS
+        rescorer_free(rescorer);
+        Py_END_ALLOW_THREADS
+    }
+
+    decoder_pool_t *pool = self->decoder_pool;
+    self->decoder_pool = NULL;
+    if (pool != NULL) {
+        Py_BEGIN_ALLOW_THREADS
+        decoder_pool_free(pool);
+        Py_END_ALLOW_THREADS
+    }
+
+    // Stop the second pass thread
+    second_pass_t *sp = self->second_pass;
+    self->second_pass = NULL;
+    if (sp != NULL) {
+        Py_BEGIN_ALLOW_THREADS
+        second_pass_free(sp);
+        Py_END_ALLOW_THREADS
+    }
     
     // Deallocate the config object
     cmd_ln_t *config = self->config;
@@ -592,8 +1766,10 @@ PSObj_dealloc(PSObj *self) {
     if (ps != NULL)
         ps_free(ps);
 
+    obj_lock_free(&self->lock);
+
     // Finally free the PSObj itself
-    Py_TYPE(self)->tp_free((PyObject*)self);
+    free_module_object((PyObject *)self);
 }
 
 ps_decoder_t *
@@ -615,41 +1791,75 @@ get_cmd_ln_t(PSObj *self) {
     return config;
 }
 
+static int
+PSObj_init_from_snapshot(PSObj *self, const char *path) {
+    snapshot_t *snap = snapshot_open(path);
+    if (snap == NULL) {
+        if (errno == EINVAL)
+            PyErr_Format(GET_MODULE_STATE(self)->PocketSphinxError,
+                         "'%s' is not a decoder snapshot.", path);
+        else
+            PyErr_SetFromErrnoWithFilename(PyExc_IOError, path);
+        return -1;
+    }
+
+    int result = 0;
+    if (!init_ps_decoder_with_config(self, snapshot_config(snap))) {
+        PyErr_Format(GET_MODULE_STATE(self)->PocketSphinxError,
+                     "PocketSphinx couldn't be initialised from snapshot "
+                     "'%s'. Are its model files still there?", path);
+        result = -1;
+    } else if (snapshot_restore(snap, self->ps, &self->search_sources) < 0) {
+        PyErr_Format(GET_MODULE_STATE(self)->PocketSphinxError,
+                     "couldn't restore the searches in snapshot '%s'.", path);
+        result = -1;
+    }
+    snapshot_close(snap);
+    if (result < 0)
+        return -1;
+
+    // Keep the current search name up to date
+    const char *name = ps_get_search(self->ps);
+    if (name != NULL) {
+        Py_XDECREF(self->search_name);
+        self->search_name = Py_BuildValue("s", name);
+        PSObj_use_search(self, name);
+    }
+    return 0;
+}
+
 int
 PSObj_init(PSObj *self, PyObject *args, PyObject *kwds) {
     PyObject *ps_args = NULL;
+    const char *snapshot = NULL;
     Py_ssize_t list_size;
 
-    static char *kwlist[] = {"ps_args", NULL};
+    static char *kwlist[] = {"ps_args", "snapshot", NULL};
     
-    if (! PyArg_ParseTupleAndKeywords(args, kwds, "|O", kwlist, &ps_args))
+    if (! PyArg_ParseTupleAndKeywords(args, kwds, "|Oz", kwlist, &ps_args,
+                                      &snapshot))
         return -1;
 
-    if (ps_args && ps_args != Py_None) {
-        if (!PyList_Check(ps_args)) {
-            // Raise the exception flag and return -1
-            PyErr_SetString(PyExc_TypeError, "parameter must be a list");
+    if (snapshot != NULL) {
+        if (ps_args && ps_args != Py_None) {
+            PyErr_SetString(PyExc_ValueError, "ps_args can't be used with a "
+                            "snapshot; the snapshot has the configuration.");
             return -1;
         }
-
+        return PSObj_init_from_snapshot(self, snapshot);
+    } else if (ps_args && ps_args != Py_None) {
         // Extract strings from Python list into a C string array and use that
         // to call init_ps_decoder_with_args
-        list_size = PyList_Size(ps_args);
-        char *strings[list_size];
-        for (Py_ssize_t i = 0; i < list_size; i++) {
-            PyObject *item = PyList_GetItem(ps_args, i);
-            char *err_msg = "all list items must be strings!";
-            if (!PYCOMPAT_STRING_CHECK(item)) {
-                PyErr_SetString(PyExc_TypeError, err_msg);
-                return -1;
-            }
-
-            strings[i] = PYCOMPAT_STRING_AS_STRING(item);
-        }
+        char **strings = string_list_to_array(ps_args, &list_size);
+        if (strings == NULL)
+            return -1;
 
         // Init a new pocket sphinx decoder or raise a PocketSphinxError and return -1
-        if (!init_ps_decoder_with_args(self, list_size, strings)) {
-            PyErr_SetString(PocketSphinxError, "PocketSphinx couldn't be initialised. "
+        bool initialised = init_ps_decoder_with_args(self, list_size, strings);
+        PyMem_Free(strings);
+        if (!initialised) {
+            PyErr_SetString(GET_MODULE_STATE(self)->PocketSphinxError,
+                            "PocketSphinx couldn't be initialised. "
                             "Is your configuration right?");
             return -1;
         }
@@ -657,7 +1867,8 @@ PSObj_init(PSObj *self, PyObject *args, PyObject *kwds) {
         // Let Pocket Sphinx use the default configuration if there aren't any arguments
         char *strings[0];
         if (!init_ps_decoder_with_args(self, 0, strings)) {
-            PyErr_SetString(PocketSphinxError, "PocketSphinx couldn't be initialised "
+            PyErr_SetString(GET_MODULE_STATE(self)->PocketSphinxError,
+                            "PocketSphinx couldn't be initialised "
                             "using the default configuration. Is it installed properly?");
             return -1;
         }
@@ -683,7 +1894,11 @@ PSObj_get_in_speech(PSObj *self, void *closure) {
     PyObject *result = NULL;
     ps_decoder_t *ps = get_ps_decoder_t(self);
     if (ps != NULL) {
-        uint8 in_speech = ps_get_in_speech(ps);
+        uint8 in_speech;
+        if (self->multi_search != NULL)
+            in_speech = multi_search_in_speech(self->multi_search);
+        else
+            in_speech = ps_get_in_speech(ps);
         if (in_speech)
             result = Py_True;
         else
@@ -773,9 +1988,20 @@ PSObj_set_active_search(PSObj *self, PyObject *value, void *closure) {
 
     new_search_name = PYCOMPAT_STRING_AS_STRING(value);
 
-    // Set the search and raise an error if something goes wrong
-    if (ps_set_search(ps, new_search_name) < 0) {
-        PyErr_Format(PocketSphinxError, "failed to set Pocket Sphinx search with "
+    if (self->cascade != NULL) {
+        PyErr_SetString(GET_MODULE_STATE(self)->PocketSphinxError,
+                        "the active search cannot be set "
+                        "while a cascade is in use. Call clear_cascade() "
+                        "first.");
+        return -1;
+    }
+
+    // Set the search, setting it up again if it was evicted, and raise an
+    // error if something goes wrong
+    if (PSObj_use_search(self, new_search_name) < 0 ||
+        ps_set_search(ps, new_search_name) < 0) {
+        PyErr_Format(GET_MODULE_STATE(self)->PocketSphinxError,
+                     "failed to set Pocket Sphinx search with "
                      "name '%s'. Perhaps there isn't a search with that name?",
                      new_search_name);
         return -1;
@@ -788,26 +2014,264 @@ PSObj_set_active_search(PSObj *self, PyObject *value, void *closure) {
     return 0;
 }
 
+PyObject *
+PSObj_get_concurrent_searches(PSObj *self, void *closure) {
+    multi_search_t *ms = self->multi_search;
+    if (ms == NULL) {
+        Py_INCREF(Py_None);
+        return Py_None;
+    }
+
+    PyObject *result = PyList_New(multi_search_count(ms));
+    for (int i = 0; result != NULL && i < multi_search_count(ms); i++) {
+        PyObject *name = Py_BuildValue("s", multi_search_name(ms, i));
+        if (name == NULL)
+            Py_CLEAR(result);
+        else
+            PyList_SET_ITEM(result, i, name);
+    }
+    return result;
+}
+
+int
+PSObj_set_concurrent_searches(PSObj *self, PyObject *value, void *closure) {
+    if (value == NULL) {
+        PyErr_SetString(PyExc_AttributeError, "Cannot delete the "
+                        "concurrent_searches attribute.");
+        return -1;
+    }
+
+    ps_decoder_t *ps = get_ps_decoder_t(self);
+    cmd_ln_t *config = get_cmd_ln_t(self);
+    if (ps == NULL || config == NULL)
+        return -1;
+
+    if (value != Py_None && self->cascade != NULL) {
+        PyErr_SetString(GET_MODULE_STATE(self)->PocketSphinxError,
+                        "concurrent searches cannot be used "
+                        "with a cascade. Call clear_cascade() first.");
+        return -1;
+    }
+
+    char **names = NULL;
+    Py_ssize_t n_names = 0;
+    if (value != Py_None) {
+        names = string_list_to_array(value, &n_names);
+        if (names == NULL)
+            return -1;
+        if (n_names == 0) {
+            PyMem_Free(names);
+            PyErr_SetString(PyExc_ValueError, "value must be None or a "
+                            "non-empty list of search names.");
+            return -1;
+        }
+    }
+
+    // End any utterances in progress without reporting them and replace the
+    // concurrent searches. Creating decoders is slow, so release the GIL.
+    utterance_end(ps, &self->utterance_state);
+    multi_search_t *old_ms = self->multi_search;
+    multi_search_t *new_ms = NULL;
+    self->multi_search = NULL;
+    Py_BEGIN_ALLOW_THREADS
+    multi_search_free(old_ms);
+    if (names != NULL)
+        new_ms = multi_search_init(self->decoder_pool, config,
+                                   self->search_sources,
+                                   (char const **)names, n_names);
+    Py_END_ALLOW_THREADS
+    PyMem_Free(names);
+
+    if (value != Py_None && new_ms == NULL) {
+        PyErr_SetString(GET_MODULE_STATE(self)->PocketSphinxError,
+                        "something went wrong whilst "
+                        "setting up concurrent searches. Do all of the searches "
+                        "exist?");
+        return -1;
+    }
+
+    self->multi_search = new_ms;
+    return 0;
+}
+
+PyObject *
+PSObj_get_search_hypothesis_callback(PSObj *self, void *closure) {
+    Py_INCREF(self->search_hypothesis_callback);
+    return self->search_hypothesis_callback;
+}
+
+int
+PSObj_set_search_hypothesis_callback(PSObj *self, PyObject *value,
+                                     void *closure) {
+    if (value == NULL) {
+        PyErr_SetString(PyExc_AttributeError, "Cannot delete the "
+                        "search_hypothesis_callback attribute.");
+        return -1;
+    }
+
+    if (!PyCallable_Check(value)) {
+        PyErr_SetString(PyExc_TypeError, "value must be callable.");
+        return -1;
+    }
+
+#ifdef IS_PY2
+    if (!assert_callable_arg_count(value, 2))
+        return -1;
+#endif
+
+    Py_DECREF(self->search_hypothesis_callback);
+    Py_INCREF(value);
+    self->search_hypothesis_callback = value;
+
+    return 0;
+}
+
+PyObject *
+PSObj_get_keyphrase_callback(PSObj *self, void *closure) {
+    Py_INCREF(self->keyphrase_callback);
+    return self->keyphrase_callback;
+}
+
+int
+PSObj_set_keyphrase_callback(PSObj *self, PyObject *value, void *closure) {
+    if (value == NULL) {
+        PyErr_SetString(PyExc_AttributeError, "Cannot delete the "
+                        "keyphrase_callback attribute.");
+        return -1;
+    }
+
+    if (!PyCallable_Check(value)) {
+        PyErr_SetString(PyExc_TypeError, "value must be callable.");
+        return -1;
+    }
+
+#ifdef IS_PY2
+    if (!assert_callable_arg_count(value, 1))
+        return -1;
+#endif
+
+    Py_DECREF(self->keyphrase_callback);
+    Py_INCREF(value);
+    self->keyphrase_callback = value;
+
+    return 0;
+}
+
+PyObject *
+PSObj_get_governor_stats(PSObj *self, void *closure) {
+    governor_t *governor = self->governor;
+    if (governor == NULL) {
+        Py_INCREF(Py_None);
+        return Py_None;
+    }
+
+    return Py_BuildValue("{s:d,s:d,s:i,s:i,s:i,s:d,s:d,s:d}",
+                         "target_rtf", governor->target_rtf,
+                         "rtf", governor->rtf,
+                         "level", governor->level,
+                         "adjustments", governor->n_adjustments,
+                         "failures", governor->n_failures,
+                         "beam", governor->beams[0],
+                         "wbeam", governor->beams[1],
+                         "pbeam", governor->beams[2]);
+}
+
+PyObject *
+PSObj_get_endpointer_stats(PSObj *self, void *closure) {
+    endpointer_t *ep = self->endpointer;
+    if (ep == NULL) {
+        Py_INCREF(Py_None);
+        return Py_None;
+    }
+
+    return Py_BuildValue("{s:d,s:d,s:d,s:i}",
+                         "trailing_silence", ep->trailing_silence / ep->samprate,
+                         "min_speech", ep->min_speech / ep->samprate,
+                         "max_utterance", ep->max_utterance / ep->samprate,
+                         "forced_ends", ep->n_forced);
+}
+
+// Accessors and __init__ hold the decoder's lock too.
+OBJ_LOCKED_INIT(PSObj, PSObj_init)
+OBJ_LOCKED_GETTER(PSObj, PSObj_get_speech_start_callback)
+OBJ_LOCKED_GETTER(PSObj, PSObj_get_hypothesis_callback)
+OBJ_LOCKED_GETTER(PSObj, PSObj_get_in_speech)
+OBJ_LOCKED_GETTER(PSObj, PSObj_get_active_search)
+OBJ_LOCKED_GETTER(PSObj, PSObj_get_concurrent_searches)
+OBJ_LOCKED_GETTER(PSObj, PSObj_get_search_hypothesis_callback)
+OBJ_LOCKED_GETTER(PSObj, PSObj_get_keyphrase_callback)
+OBJ_LOCKED_GETTER(PSObj, PSObj_get_governor_stats)
+OBJ_LOCKED_GETTER(PSObj, PSObj_get_endpointer_stats)
+OBJ_LOCKED_GETTER(PSObj, PSObj_get_rescored_hypothesis_callback)
+OBJ_LOCKED_GETTER(PSObj, PSObj_get_corrected_hypothesis_callback)
+OBJ_LOCKED_SETTER(PSObj, PSObj_set_speech_start_callback)
+OBJ_LOCKED_SETTER(PSObj, PSObj_set_hypothesis_callback)
+OBJ_LOCKED_SETTER(PSObj, PSObj_set_active_search)
+OBJ_LOCKED_SETTER(PSObj, PSObj_set_concurrent_searches)
+OBJ_LOCKED_SETTER(PSObj, PSObj_set_search_hypothesis_callback)
+OBJ_LOCKED_SETTER(PSObj, PSObj_set_keyphrase_callback)
+OBJ_LOCKED_SETTER(PSObj, PSObj_set_rescored_hypothesis_callback)
+OBJ_LOCKED_SETTER(PSObj, PSObj_set_corrected_hypothesis_callback)
+
 PyGetSetDef PSObj_getseters[] = {
     {"speech_start_callback",
-     (getter)PSObj_get_speech_start_callback,
-     (setter)PSObj_set_speech_start_callback,
+     (getter)PSObj_get_speech_start_callback_locked,
+     (setter)PSObj_set_speech_start_callback_locked,
      "Callable object called when speech started.", NULL},
     {"hypothesis_callback",
-     (getter)PSObj_get_hypothesis_callback,
-     (setter)PSObj_set_hypothesis_callback,
+     (getter)PSObj_get_hypothesis_callback_locked,
+     (setter)PSObj_set_hypothesis_callback_locked,
      "Hypothesis callback called with Pocket Sphinx's hypothesis for "
      "what was said.", NULL},
     {"in_speech",
-     (getter)PSObj_get_in_speech, NULL, // No setter. AttributeError is thrown on set attempt.
+     (getter)PSObj_get_in_speech_locked, NULL, // No setter. AttributeError is thrown on set attempt.
      // From pocketsphinx.h:
      "Checks if the last feed audio buffer contained speech.", NULL},
     {"active_search",
-     (getter)PSObj_get_active_search,
-     (setter)PSObj_set_active_search,
+     (getter)PSObj_get_active_search_locked,
+     (setter)PSObj_set_active_search_locked,
      "The name of the currently active Pocket Sphinx search.\n"
      "If the setter is passed a name with no matching Pocket Sphinx search, an "
      "error will be raised.", NULL},
+    {"concurrent_searches",
+     (getter)PSObj_get_concurrent_searches_locked,
+     (setter)PSObj_set_concurrent_searches_locked,
+     "List of names of searches decoded concurrently instead of the active "
+     "search, or None.\n"
+     "Features are computed once per chunk of audio and decoded by a separate "
+     "decoder and thread for each search. Hypotheses are passed to "
+     "search_hypothesis_callback.", NULL},
+    {"search_hypothesis_callback",
+     (getter)PSObj_get_search_hypothesis_callback_locked,
+     (setter)PSObj_set_search_hypothesis_callback_locked,
+     "Callback called with the search name and hypothesis for each of the "
+     "concurrent searches when an utterance ends.", NULL},
+    {"keyphrase_callback",
+     (getter)PSObj_get_keyphrase_callback_locked,
+     (setter)PSObj_set_keyphrase_callback_locked,
+     "Callback called with the keyphrase when a cascade set up with "
+     "set_cascade() detects it.", NULL},
+    {"governor_stats",
+     (getter)PSObj_get_governor_stats_locked, NULL,
+     "Dictionary of the governor's target and average real time factor, "
+     "narrowing level, number of adjustments applied and failed and current "
+     "beams, or None if the governor isn't enabled.", NULL},
+    {"endpointer_stats",
+     (getter)PSObj_get_endpointer_stats_locked, NULL,
+     "Dictionary of the endpointer's durations in seconds and the number of "
+     "utterances ended at the maximum length, or None if no endpointer is "
+     "set.", NULL},
+    {"rescored_hypothesis_callback",
+     (getter)PSObj_get_rescored_hypothesis_callback_locked,
+     (setter)PSObj_set_rescored_hypothesis_callback_locked,
+     "Callback called with the hypothesis from rescoring each utterance's "
+     "lattice once rescoring is enabled with enable_rescoring().", NULL},
+    {"corrected_hypothesis_callback",
+     (getter)PSObj_get_corrected_hypothesis_callback_locked,
+     (setter)PSObj_set_corrected_hypothesis_callback_locked,
+     "Callback called with the hypothesis passed to hypothesis_callback for "
+     "an utterance and the second pass hypothesis when they differ, once the "
+     "second pass is enabled with enable_two_pass().", NULL},
     {NULL}  /* Sentinel */
 };
 
@@ -849,27 +2313,24 @@ PyTypeObject PSType = {
     0,                            /* tp_descr_get */
     0,                            /* tp_descr_set */
     0,                            /* tp_dictoffset */
-    (initproc)PSObj_init,         /* tp_init */
+    (initproc)PSObj_init_locked,  /* tp_init */
     0,                            /* tp_alloc */
     PSObj_new,                    /* tp_new */
 };
 
 bool
 init_ps_decoder_with_args(PSObj *self, int argc, char *argv[]) {
-    char const *cfg; 
+    return init_ps_decoder_with_config(self, parse_ps_args(argc, argv));
+}
+
+bool
+init_ps_decoder_with_config(PSObj *self, cmd_ln_t *config) {
     ps_decoder_t *ps;
-    cmd_ln_t *config = cmd_ln_parse_r(NULL, cont_args_def, argc, argv, TRUE);
-    
-    /* Handle argument file as -argfile. */
-    if (config && (cfg = cmd_ln_str_r(config, "-argfile")) != NULL) {
-        config = cmd_ln_parse_file_r(config, cont_args_def, cfg, FALSE);
-    }
 
     if (config == NULL) {
         return false;
     }
     
-    ps_default_search_args(config);
     ps = ps_init(config);
 
     if (ps == NULL) {
@@ -901,21 +2362,20 @@ init_ps_decoder_with_args(PSObj *self, int argc, char *argv[]) {
 
 PyObject *
 initpocketsphinx(PyObject *module) {
+    module_state *state = get_module_state(module);
+
     // Set up the 'PocketSphinx' type
     PSType.tp_new = PSObj_new;
-    if (PyType_Ready(&PSType) < 0) {
+    state->PSType = add_module_type(module, &PSType);
+    if (state->PSType == NULL)
         return NULL;
-    }
-
-    Py_INCREF(&PSType);
-    PyModule_AddObject(module, "PocketSphinx", (PyObject *)&PSType);
 
     // Define a new Python exception
-    PocketSphinxError = PyErr_NewException("sphinxwrapper.PocketSphinxError",
-                                           NULL, NULL);
-    Py_INCREF(PocketSphinxError);
+    state->PocketSphinxError = add_module_exception(module,
+                                                    "PocketSphinxError");
+    if (state->PocketSphinxError == NULL)
+        return NULL;
 
-    PyModule_AddObject(module, "PocketSphinxError", PocketSphinxError);
     return module;
 }
 
@@ -0,0 +1,69 @@
+/*
+ * pytrace.c
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#include <errno.h>
+
+#include "pytrace.h"
+#include "trace.h"
+
+PyObject *
+sphinxwrapper_start_trace(PyObject *module, PyObject *unused) {
+    trace_start();
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+PyObject *
+sphinxwrapper_stop_trace(PyObject *module, PyObject *unused) {
+    trace_stop();
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+PyObject *
+sphinxwrapper_save_trace(PyObject *module, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"path", NULL};
+    const char *path = NULL;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s", kwlist, &path))
+        return NULL;
+
+    int save_result = -1;
+    Py_BEGIN_ALLOW_THREADS
+    FILE *file = fopen(path, "w");
+    if (file != NULL) {
+        save_result = trace_write_json(file);
+        if (fclose(file) != 0)
+            save_result = -1;
+    }
+    Py_END_ALLOW_THREADS
+    if (save_result < 0)
+        return PyErr_SetFromErrnoWithFilename(PyExc_IOError, path);
+
+    return PyLong_FromUnsignedLongLong(trace_dropped());
+}
@@ -0,0 +1,165 @@
+/*
+ * pytwopass.c
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#include <sphinxbase/ckd_alloc.h>
+
+#include "pypocketsphinx.h"
+#include "trace.h"
+
+void
+PSObj_second_pass_utterance(PSObj *self, const char *hyp, bool submit) {
+    ps_decoder_t *ps = self->ps;
+    second_pass_t *sp = self->second_pass;
+    if (ps == NULL || sp == NULL || self->cascade != NULL)
+        return;
+
+    if (submit)
+        second_pass_submit(sp, ps_get_search(ps), hyp);
+    else
+        second_pass_retain(sp, NULL, 0, true);
+}
+
+int
+PSObj_dispatch_second_pass(PSObj *self) {
+    char *first_hyp, *hyp;
+    bool changed;
+
+    // The callback may disable the second pass, so check it each time.
+    while (self->second_pass != NULL &&
+           second_pass_poll(self->second_pass, &first_hyp, &hyp, &changed)) {
+        PyObject *callback = self->corrected_hypothesis_callback;
+        int result = 0;
+        if (changed && PyCallable_Check(callback)) {
+            uint64 span = trace_begin();
+            PyObject *cb_result = PyObject_CallFunction(callback, "zz",
+                                                        first_hyp, hyp);
+            trace_end(span, "corrected_hypothesis_callback");
+            if (cb_result == NULL)
+                result = -1;
+            Py_XDECREF(cb_result);
+        }
+        ckd_free(first_hyp);
+        ckd_free(hyp);
+        if (result < 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+PyObject *
+PSObj_enable_two_pass(PSObj *self) {
+    ps_decoder_t *ps = get_ps_decoder_t(self);
+    cmd_ln_t *config = get_cmd_ln_t(self);
+    if (ps == NULL || config == NULL)
+        return NULL;
+
+    // Loading the models again takes a while, so let other threads run.
+    second_pass_t *sp;
+    search_source_t *sources = self->search_sources;
+    const char *search = ps_get_search(ps);
+    Py_BEGIN_ALLOW_THREADS
+    sp = second_pass_init(config, sources, search);
+    Py_END_ALLOW_THREADS
+
+    if (sp == NULL) {
+        PyErr_SetString(GET_MODULE_STATE(self)->PocketSphinxError,
+                        "failed to set up the second pass decoder.");
+        return NULL;
+    }
+
+    // Replace the current second pass, discarding its unfinished work.
+    second_pass_t *old = self->second_pass;
+    self->second_pass = sp;
+    Py_BEGIN_ALLOW_THREADS
+    second_pass_free(old);
+    Py_END_ALLOW_THREADS
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+PyObject *
+PSObj_disable_two_pass(PSObj *self) {
+    second_pass_t *sp = self->second_pass;
+    self->second_pass = NULL;
+    Py_BEGIN_ALLOW_THREADS
+    second_pass_free(sp);
+    Py_END_ALLOW_THREADS
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+PyObject *
+PSObj_wait_for_second_pass(PSObj *self) {
+    second_pass_t *sp = self->second_pass;
+    if (sp != NULL) {
+        Py_BEGIN_ALLOW_THREADS
+        second_pass_wait(sp);
+        Py_END_ALLOW_THREADS
+    }
+
+    if (PSObj_dispatch_second_pass(self) < 0)
+        return NULL;
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+PyObject *
+PSObj_get_corrected_hypothesis_callback(PSObj *self, void *closure) {
+    Py_INCREF(self->corrected_hypothesis_callback);
+    return self->corrected_hypothesis_callback;
+}
+
+int
+PSObj_set_corrected_hypothesis_callback(PSObj *self, PyObject *value,
+                                        void *closure) {
+    if (value == NULL) {
+        PyErr_SetString(PyExc_AttributeError, "Cannot delete the "
+                        "corrected_hypothesis_callback attribute.");
+        return -1;
+    }
+
+    if (!PyCallable_Check(value)) {
+        PyErr_SetString(PyExc_TypeError, "value must be callable.");
+        return -1;
+    }
+
+#ifdef IS_PY2
+    if (!assert_callable_arg_count(value, 2))
+        return -1;
+#endif
+
+    Py_DECREF(self->corrected_hypothesis_callback);
+    Py_INCREF(value);
+    self->corrected_hypothesis_callback = value;
+
+    return 0;
+}
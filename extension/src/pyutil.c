@@ -67,3 +67,38 @@ assert_callable_arg_count(PyObject *value, const unsigned int arg_count) {
 #endif
 }
 
+
+char **
+string_list_to_array(PyObject *list, Py_ssize_t *size) {
+    if (!PyList_Check(list)) {
+        PyErr_SetString(PyExc_TypeError, "parameter must be a list");
+        return NULL;
+    }
+
+    Py_ssize_t list_size = PyList_Size(list);
+
+    // Allocate at least one element so an empty list doesn't give NULL
+    char **strings = PyMem_New(char *, list_size > 0 ? list_size : 1);
+    if (strings == NULL) {
+        PyErr_NoMemory();
+        return NULL;
+    }
+
+    for (Py_ssize_t i = 0; i < list_size; i++) {
+        PyObject *item = PyList_GetItem(list, i);
+        if (!PYCOMPAT_STRING_CHECK(item)) {
+            PyErr_SetString(PyExc_TypeError, "all list items must be strings!");
+            PyMem_Free(strings);
+            return NULL;
+        }
+
+        strings[i] = (char *)PYCOMPAT_STRING_AS_STRING(item);
+        if (strings[i] == NULL) {
+            PyMem_Free(strings);
+            return NULL;
+        }
+    }
+
+    *size = list_size;
+    return strings;
+}
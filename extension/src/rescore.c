@@ -0,0 +1,417 @@
+/*
+ * rescore.c
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sphinxbase/ckd_alloc.h>
+#include <sphinxbase/ngram_model.h>
+
+#include "rescore.h"
+
+typedef struct {
+    char *word; // base word of the link's source node
+    int32 ascr; // acoustic score of that word
+    int32 *preds; // indices of the links entering the source node
+    int32 n_preds;
+    bool final; // whether the link enters a node without exits
+} rescore_link_t;
+
+struct rescore_graph_s {
+    rescore_link_t *links;
+    int32 n_links;
+};
+
+typedef struct rescore_job_s {
+    rescore_graph_t *graph;
+    char *hyp; // result, set once done
+    bool done;
+    struct rescore_job_s *next;
+} rescore_job_t;
+
+struct rescorer_s {
+    ngram_model_t *lm;
+    int32 start_wid;
+    int32 end_wid;
+    int32 oov_score; // used for words the model can't score at all
+
+    // Jobs in submission order. The thread works on the oldest job that isn't
+    // done; finished jobs stay at the head until they are polled.
+    pthread_mutex_t lock;
+    pthread_cond_t job_ready;
+    pthread_cond_t job_done;
+    rescore_job_t *head;
+    rescore_job_t *tail;
+    bool stopping;
+    pthread_t thread;
+};
+
+typedef struct {
+    ps_latlink_t *link;
+    int32 index;
+} link_index_t;
+
+static int
+compare_link_index(const void *a, const void *b) {
+    ps_latlink_t *x = ((link_index_t const *)a)->link;
+    ps_latlink_t *y = ((link_index_t const *)b)->link;
+    return x < y ? -1 : x > y;
+}
+
+static int32
+find_link(link_index_t *index, int32 n_links, ps_latlink_t *link) {
+    link_index_t key = {link, 0};
+    link_index_t *found = bsearch(&key, index, n_links, sizeof(key),
+                                  compare_link_index);
+    return found != NULL ? found->index : -1;
+}
+
+rescore_graph_t *
+rescore_graph_from_lattice(ps_lattice_t *dag) {
+    if (dag == NULL)
+        return NULL;
+
+    // Collect the links in topological order.
+    int32 n_links = 0, size = 64;
+    ps_latlink_t **order = ckd_calloc(size, sizeof(*order));
+    for (ps_latlink_t *link = ps_lattice_traverse_edges(dag, NULL, NULL);
+         link != NULL; link = ps_lattice_traverse_next(dag, NULL)) {
+        if (n_links == size) {
+            size *= 2;
+            order = ckd_realloc(order, size * sizeof(*order));
+        }
+        order[n_links++] = link;
+    }
+
+    // Predecessors are found by address, so sort the links by it.
+    link_index_t *index = ckd_calloc(n_links, sizeof(*index));
+    for (int32 i = 0; i < n_links; i++) {
+        index[i].link = order[i];
+        index[i].index = i;
+    }
+    qsort(index, n_links, sizeof(*index), compare_link_index);
+
+    rescore_graph_t *graph = ckd_calloc(1, sizeof(*graph));
+    graph->links = ckd_calloc(n_links, sizeof(*graph->links));
+    graph->n_links = n_links;
+    for (int32 i = 0; i < n_links; i++) {
+        rescore_link_t *out = &graph->links[i];
+        ps_latnode_t *src;
+        ps_latnode_t *dest = ps_latlink_nodes(order[i], &src);
+
+        out->word = ckd_salloc(ps_latnode_baseword(dag, src));
+        ps_latlink_prob(dag, order[i], &out->ascr);
+
+        ps_latlink_iter_t *exits = ps_latnode_exits(dest);
+        out->final = exits == NULL;
+        ps_latlink_iter_free(exits);
+
+        // Count the entering links, then record those that were traversed.
+        int32 n_entries = 0;
+        ps_latlink_iter_t *it;
+        for (it = ps_latnode_entries(src); it; it = ps_latlink_iter_next(it))
+            n_entries++;
+        out->preds = ckd_calloc(n_entries > 0 ? n_entries : 1,
+                                sizeof(*out->preds));
+        for (it = ps_latnode_entries(src); it; it = ps_latlink_iter_next(it)) {
+            int32 pred = find_link(index, n_links, ps_latlink_iter_link(it));
+            if (pred >= 0 && pred < i)
+                out->preds[out->n_preds++] = pred;
+        }
+    }
+
+    ckd_free(index);
+    ckd_free(order);
+    return graph;
+}
+
+void
+rescore_graph_free(rescore_graph_t *graph) {
+    if (graph == NULL)
+        return;
+
+    for (int32 i = 0; i < graph->n_links; i++) {
+        ckd_free(graph->links[i].word);
+        ckd_free(graph->links[i].preds);
+    }
+    ckd_free(graph->links);
+    ckd_free(graph);
+}
+
+/* Whether a word that isn't in the language model is a filler, like <sil> or
+ * [NOISE], rather than a real out of vocabulary word.
+ */
+static bool
+is_filler(const char *word) {
+    return word[0] == '<' || word[0] == '[' || word[0] == '+';
+}
+
+static int32
+lm_score(rescorer_t *r, int32 wid, int32 h1, int32 h2) {
+    if (wid == NGRAM_INVALID_WID)
+        return r->oov_score;
+
+    // Back off to a shorter history where it ends at an unscorable word.
+    int32 history[2] = {h1, h2};
+    int32 n_hist = 0, n_used;
+    while (n_hist < 2 && history[n_hist] != NGRAM_INVALID_WID)
+        n_hist++;
+    return ngram_ng_score(r->lm, wid, history, n_hist, &n_used);
+}
+
+/* Find the best path through the graph using the rescorer's language model
+ * for the language scores and the first pass acoustic scores.
+ * @return the words on the best path, or NULL if there is none
+ */
+static char *
+rescore(rescorer_t *r, rescore_graph_t *graph) {
+    if (graph == NULL || graph->n_links == 0)
+        return NULL;
+
+    int32 n = graph->n_links;
+    int64 *score = ckd_calloc(n, sizeof(*score));
+    int32 *bp = ckd_calloc(n, sizeof(*bp));
+    bool *fillers = ckd_calloc(n, sizeof(*fillers));
+    int32 (*ctx)[2] = ckd_calloc(n, sizeof(*ctx)); // language model history
+    int32 unknown = ngram_unknown_wid(r->lm);
+    int64 best_final = 0;
+    int32 best_link = -1;
+
+    for (int32 i = 0; i < n; i++) {
+        rescore_link_t *link = &graph->links[i];
+        int32 wid = ngram_wid(r->lm, link->word);
+        bool filler = strcmp(link->word, "<s>") == 0 ||
+            strcmp(link->word, "</s>") == 0 ||
+            (wid == unknown && is_filler(link->word));
+        fillers[i] = filler;
+
+        // Links out of the start node have <s> as their history.
+        int64 best = 0;
+        int32 best_pred = -1;
+        for (int32 j = 0; j < link->n_preds; j++) {
+            int32 p = link->preds[j];
+            if (bp[p] == -2)
+                continue; // unreachable
+            int64 s = score[p];
+            if (!filler)
+                s += lm_score(r, wid, ctx[p][0], ctx[p][1]);
+            if (best_pred < 0 || s > best) {
+                best = s;
+                best_pred = p;
+            }
+        }
+        if (link->n_preds > 0 && best_pred < 0) {
+            bp[i] = -2;
+            continue;
+        }
+        if (best_pred < 0 && !filler)
+            best = lm_score(r, wid, r->start_wid, NGRAM_INVALID_WID);
+
+        score[i] = best + link->ascr;
+        bp[i] = best_pred;
+        if (filler && best_pred >= 0) {
+            ctx[i][0] = ctx[best_pred][0];
+            ctx[i][1] = ctx[best_pred][1];
+        } else if (filler) {
+            ctx[i][0] = r->start_wid;
+            ctx[i][1] = NGRAM_INVALID_WID;
+        } else {
+            ctx[i][0] = wid;
+            ctx[i][1] = best_pred >= 0 ? ctx[best_pred][0] : r->start_wid;
+        }
+
+        if (link->final) {
+            int64 s = score[i] + lm_score(r, r->end_wid, ctx[i][0], ctx[i][1]);
+            if (best_link < 0 || s > best_final) {
+                best_final = s;
+                best_link = i;
+            }
+        }
+    }
+
+    // Follow the back pointers, measuring then filling the hypothesis.
+    char *hyp = NULL;
+    if (best_link >= 0) {
+        size_t len = 0;
+        for (int32 i = best_link; i >= 0; i = bp[i])
+            if (!fillers[i])
+                len += strlen(graph->links[i].word) + 1;
+        hyp = ckd_calloc(len + 1, 1);
+        size_t end = len;
+        for (int32 i = best_link; i >= 0; i = bp[i]) {
+            const char *word = graph->links[i].word;
+            if (fillers[i])
+                continue;
+            size_t word_len = strlen(word);
+            end -= word_len + 1;
+            memcpy(hyp + end, word, word_len);
+            hyp[end + word_len] = ' ';
+        }
+        if (len == 0) {
+            ckd_free(hyp);
+            hyp = NULL;
+        } else {
+            hyp[len - 1] = '\0';
+        }
+    }
+
+    ckd_free(ctx);
+    ckd_free(fillers);
+    ckd_free(bp);
+    ckd_free(score);
+    return hyp;
+}
+
+static void *
+rescorer_main(void *arg) {
+    rescorer_t *r = arg;
+
+    pthread_mutex_lock(&r->lock);
+    for (;;) {
+        rescore_job_t *job = r->head;
+        while (job != NULL && job->done)
+            job = job->next;
+        if (r->stopping)
+            break;
+        if (job == NULL) {
+            pthread_cond_wait(&r->job_ready, &r->lock);
+            continue;
+        }
+
+        // Jobs are only removed once done, so this one stays valid.
+        pthread_mutex_unlock(&r->lock);
+        char *hyp = rescore(r, job->graph);
+        pthread_mutex_lock(&r->lock);
+
+        rescore_graph_free(job->graph);
+        job->graph = NULL;
+        job->hyp = hyp;
+        job->done = true;
+        pthread_cond_broadcast(&r->job_done);
+    }
+    pthread_mutex_unlock(&r->lock);
+    return NULL;
+}
+
+rescorer_t *
+rescorer_init(cmd_ln_t *config, logmath_t *lmath, const char *lm_path,
+              float32 lw) {
+    ngram_model_t *lm = ngram_model_read(config, lm_path, NGRAM_AUTO, lmath);
+    if (lm == NULL)
+        return NULL;
+    ngram_model_apply_weights(lm, lw, cmd_ln_float32_r(config, "-wip"));
+
+    rescorer_t *r = ckd_calloc(1, sizeof(*r));
+    r->lm = lm;
+    r->start_wid = ngram_wid(lm, "<s>");
+    r->end_wid = ngram_wid(lm, "</s>");
+    r->oov_score = (int32)(logmath_log(lmath, 1e-7) * lw);
+    pthread_mutex_init(&r->lock, NULL);
+    pthread_cond_init(&r->job_ready, NULL);
+    pthread_cond_init(&r->job_done, NULL);
+
+    if (pthread_create(&r->thread, NULL, rescorer_main, r) != 0) {
+        pthread_cond_destroy(&r->job_done);
+        pthread_cond_destroy(&r->job_ready);
+        pthread_mutex_destroy(&r->lock);
+        ngram_model_free(lm);
+        ckd_free(r);
+        return NULL;
+    }
+
+    return r;
+}
+
+void
+rescorer_submit(rescorer_t *rescorer, rescore_graph_t *graph) {
+    rescore_job_t *job = ckd_calloc(1, sizeof(*job));
+    job->graph = graph;
+
+    pthread_mutex_lock(&rescorer->lock);
+    if (rescorer->tail != NULL)
+        rescorer->tail->next = job;
+    else
+        rescorer->head = job;
+    rescorer->tail = job;
+    pthread_cond_signal(&rescorer->job_ready);
+    pthread_mutex_unlock(&rescorer->lock);
+}
+
+bool
+rescorer_poll(rescorer_t *rescorer, char **hyp) {
+    pthread_mutex_lock(&rescorer->lock);
+    rescore_job_t *job = rescorer->head;
+    bool taken = job != NULL && job->done;
+    if (taken) {
+        rescorer->head = job->next;
+        if (rescorer->head == NULL)
+            rescorer->tail = NULL;
+    }
+    pthread_mutex_unlock(&rescorer->lock);
+
+    if (taken) {
+        *hyp = job->hyp;
+        ckd_free(job);
+    }
+    return taken;
+}
+
+void
+rescorer_wait(rescorer_t *rescorer) {
+    pthread_mutex_lock(&rescorer->lock);
+    while (rescorer->tail != NULL && !rescorer->tail->done)
+        pthread_cond_wait(&rescorer->job_done, &rescorer->lock);
+    pthread_mutex_unlock(&rescorer->lock);
+}
+
+void
+rescorer_free(rescorer_t *rescorer) {
+    if (rescorer == NULL)
+        return;
+
+    pthread_mutex_lock(&rescorer->lock);
+    rescorer->stopping = true;
+    pthread_cond_signal(&rescorer->job_ready);
+    pthread_mutex_unlock(&rescorer->lock);
+    pthread_join(rescorer->thread, NULL);
+
+    rescore_job_t *job = rescorer->head;
+    while (job != NULL) {
+        rescore_job_t *next = job->next;
+        rescore_graph_free(job->graph);
+        ckd_free(job->hyp);
+        ckd_free(job);
+        job = next;
+    }
+
+    pthread_cond_destroy(&rescorer->job_done);
+    pthread_cond_destroy(&rescorer->job_ready);
+    pthread_mutex_destroy(&rescorer->lock);
+    ngram_model_free(rescorer->lm);
+    ckd_free(rescorer);
+}
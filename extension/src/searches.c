@@ -0,0 +1,357 @@
+/*
+ * searches.c
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <sphinxbase/ckd_alloc.h>
+#include <sphinxbase/cmd_ln.h>
+#include <sphinxbase/fsg_model.h>
+#include <sphinxbase/ngram_model.h>
+
+#include "fsgedit.h"
+#include "memreport.h"
+#include "searches.h"
+#include "trace.h"
+
+// Source versions are unique across every list so that a replaced list never
+// looks unchanged.
+static uint64 last_version = 0;
+
+static uint64
+next_version(void) {
+    return __atomic_add_fetch(&last_version, 1, __ATOMIC_SEQ_CST);
+}
+
+int
+add_ps_search(ps_decoder_t *ps, ps_search_type type, const char *name,
+              const char *value) {
+    // TODO Do dictionary and LM checks for missing words - maybe add them using 
+    // ps_add_word
+
+    int set_result = -1;
+    uint64 span = trace_begin();
+    switch (type) {
+    case JSGF_FILE:
+        set_result = ps_set_jsgf_file(ps, name, value);
+        break;
+    case JSGF_STR:
+        set_result = ps_set_jsgf_string(ps, name, value);
+        break;
+    case LM_FILE:
+        set_result = ps_set_lm_file(ps, name, value);
+        break;
+    case FSG_FILE:
+    case FSG_STR:
+        ; // required because you cannot declare immediately after a label in C
+        // Get the config used to initialise the decoder
+        cmd_ln_t *config = ps_get_config(ps);
+        float32 lw = cmd_ln_float32_r(config, "-lw");
+        // Create a fsg model from the file or string and set it using the
+        // search name
+        fsg_model_t *fsg = NULL;
+        if (type == FSG_FILE) {
+            fsg = fsg_model_readfile(value, ps_get_logmath(ps), lw);
+        } else {
+            FILE *file = fmemopen((void *)value, strlen(value), "r");
+            if (file != NULL) {
+                fsg = fsg_model_read(file, ps_get_logmath(ps), lw);
+                fclose(file);
+            }
+        }
+        if (!fsg) {
+            set_result = -1;
+            break;
+        }
+	
+        set_result = ps_set_fsg(ps, name, fsg);
+
+        // This should be done whether or not ps_set_fsg fails, apparently..
+        fsg_model_free(fsg);
+        break;
+    case KWS_FILE:
+        // TODO Allow use of a Python list of keyword arguments rather than a file
+        set_result = ps_set_kws(ps, name, value);
+        break;
+    case KWS_STR:
+        set_result = ps_set_keyphrase(ps, name, value);
+        break;
+    case DICT_WORD:
+        // Update the active search so that it can recognise the word.
+        set_result = add_ps_word(ps, name, value, true);
+        break;
+    }
+    trace_end(span, "add_ps_search");
+
+    return set_result < 0 ? -1 : 0;
+}
+
+int
+add_ps_word(ps_decoder_t *ps, const char *word, const char *phones,
+            bool update) {
+    return ps_add_word(ps, word, phones, update) < 0 ? -1 : 0;
+}
+
+int
+refresh_ps_search(ps_decoder_t *ps, const char *name) {
+    // The decoder's copy of the name is freed with the old search.
+    char *search_name = ckd_salloc(name);
+    int set_result = -1;
+    uint64 span = trace_begin();
+    fsg_model_t *fsg = ps_get_fsg(ps, search_name);
+    ngram_model_t *lm = fsg == NULL ? ps_get_lm(ps, search_name) : NULL;
+    if (fsg != NULL) {
+        // Keep the grammar while the old search is freed.
+        fsg_model_retain(fsg);
+        set_result = ps_set_fsg(ps, search_name, fsg);
+        fsg_model_free(fsg);
+    } else if (lm != NULL) {
+        // N-gram searches wrap their model in a set named after the search.
+        // Use the model itself so that the sets don't nest.
+        ngram_model_t *model = ngram_model_set_lookup(lm, search_name);
+        if (model == NULL)
+            model = lm;
+        ngram_model_retain(model);
+        set_result = ps_set_lm(ps, search_name, model);
+        ngram_model_free(model);
+    }
+
+    if (set_result >= 0)
+        set_result = ps_set_search(ps, search_name);
+    trace_end(span, "refresh_ps_search");
+    ckd_free(search_name);
+    return set_result < 0 ? -1 : 0;
+}
+
+/* Find the source of the named search or added word. Words and searches may
+ * share names.
+ */
+static search_source_t *
+find_source(search_source_t *sources, const char *name, bool word) {
+    while (sources != NULL && ((sources->type == DICT_WORD) != word ||
+                               strcmp(sources->name, name) != 0))
+        sources = sources->next;
+    return sources;
+}
+
+search_source_t *
+search_sources_add(search_source_t *sources, ps_search_type type,
+                   const char *name, const char *value) {
+    search_source_t *source = find_source(sources, name, type == DICT_WORD);
+    if (source == NULL) {
+        source = ckd_calloc(1, sizeof(*source));
+        source->name = ckd_salloc(name);
+
+        // Keep the sources in the order they were first added.
+        search_source_t **link = &sources;
+        while (*link != NULL)
+            link = &(*link)->next;
+        *link = source;
+    } else {
+        // Edits made to the old search don't apply to the new one.
+        ckd_free(source->value);
+        fsg_edits_free(source->edits);
+        source->edits = NULL;
+    }
+
+    // The caller has just set the search up, so its size is worked out again
+    // when it is next used.
+    source->type = type;
+    source->value = ckd_salloc(value);
+    source->resident = true;
+    source->bytes = 0;
+    source->version = next_version();
+    return sources;
+}
+
+int
+search_sources_add_edit(search_source_t *sources, const char *name,
+                        fsg_edit_t *edit) {
+    search_source_t *source = search_sources_find(sources, name);
+    if (source == NULL)
+        return -1;
+
+    // Keep the edits in the order they were made.
+    fsg_edit_t **link = &source->edits;
+    while (*link != NULL)
+        link = &(*link)->next;
+    *link = edit;
+    source->bytes = 0;
+    source->version = next_version();
+    return 0;
+}
+
+uint64
+search_sources_version(search_source_t *sources) {
+    uint64 version = 0;
+    for (; sources != NULL; sources = sources->next) {
+        if (sources->version > version)
+            version = sources->version;
+    }
+    return version;
+}
+
+search_source_t *
+search_sources_find(search_source_t *sources, const char *name) {
+    return find_source(sources, name, false);
+}
+
+static int
+add_source_search(search_source_t *source, ps_decoder_t *ps) {
+    if (add_ps_search(ps, source->type, source->name, source->value) < 0)
+        return -1;
+    if (source->edits != NULL &&
+        fsg_edits_apply_to_search(ps, source->name, source->edits) < 0)
+        return -1;
+    return 0;
+}
+
+int
+search_sources_apply(search_source_t *sources, ps_decoder_t *ps,
+                     const char *active) {
+    // Only the last word updates the active search, so that it is set up
+    // again once rather than for every word.
+    search_source_t *last_word = NULL;
+    for (search_source_t *s = sources; s != NULL; s = s->next) {
+        if (s->type == DICT_WORD)
+            last_word = s;
+    }
+
+    for (search_source_t *s = sources; s != NULL; s = s->next) {
+        int result = s->type == DICT_WORD ?
+            add_ps_word(ps, s->name, s->value, s == last_word) :
+            add_source_search(s, ps);
+        if (result < 0)
+            return -1;
+    }
+
+    if (active != NULL && ps_set_search(ps, active) < 0)
+        return -1;
+    return 0;
+}
+
+void
+search_sources_used(search_source_t *sources, ps_decoder_t *ps,
+                    const char *name, uint64 tick) {
+    search_source_t *source = search_sources_find(sources, name);
+    if (source == NULL)
+        return;
+
+    if (!source->resident || source->bytes == 0) {
+        mem_search_type_t type;
+        source->bytes = mem_search(ps, source->name, &type);
+    }
+    source->resident = true;
+    source->last_used = tick;
+}
+
+int
+search_sources_restore(search_source_t *sources, ps_decoder_t *ps,
+                       const char *name) {
+    search_source_t *source = search_sources_find(sources, name);
+    if (source == NULL || source->resident)
+        return 0;
+
+    uint64 span = trace_begin();
+    int result = add_source_search(source, ps);
+    trace_end(span, "restore_search");
+    return result;
+}
+
+int
+search_sources_reinit(search_source_t *sources, ps_decoder_t *ps) {
+    search_source_t *last_word = NULL;
+    for (search_source_t *s = sources; s != NULL; s = s->next) {
+        if (s->type == DICT_WORD)
+            last_word = s;
+        else
+            s->resident = false;
+        s->bytes = 0;
+    }
+
+    // Only the last word updates the active search, as in
+    // search_sources_apply.
+    for (search_source_t *s = sources; s != NULL; s = s->next) {
+        if (s->type == DICT_WORD &&
+            add_ps_word(ps, s->name, s->value, s == last_word) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+static bool
+is_kept(const char *name, char const **keep, int n_keep) {
+    for (int i = 0; i < n_keep; i++) {
+        if (keep[i] != NULL && strcmp(keep[i], name) == 0)
+            return true;
+    }
+    return false;
+}
+
+int
+search_sources_evict(search_source_t *sources, ps_decoder_t *ps,
+                     int max_searches, size_t max_bytes,
+                     char const **keep, int n_keep) {
+    int n_evicted = 0;
+    for (;;) {
+        int n_resident = 0;
+        size_t bytes = 0;
+        search_source_t *oldest = NULL;
+        for (search_source_t *s = sources; s != NULL; s = s->next) {
+            if (!s->resident || s->type == DICT_WORD)
+                continue;
+            n_resident++;
+            bytes += s->bytes;
+            if (!is_kept(s->name, keep, n_keep) &&
+                (oldest == NULL || s->last_used < oldest->last_used))
+                oldest = s;
+        }
+
+        bool over = (max_searches > 0 && n_resident > max_searches) ||
+            (max_bytes > 0 && bytes > max_bytes);
+        if (!over || oldest == NULL)
+            break;
+
+        // The source is kept so the search can be set up again later.
+        ps_unset_search(ps, oldest->name);
+        oldest->resident = false;
+        n_evicted++;
+    }
+    return n_evicted;
+}
+
+void
+search_sources_free(search_source_t *sources) {
+    while (sources != NULL) {
+        search_source_t *next = sources->next;
+        ckd_free(sources->name);
+        ckd_free(sources->value);
+        fsg_edits_free(sources->edits);
+        ckd_free(sources);
+        sources = next;
+    }
+}
@@ -0,0 +1,412 @@
+/*
+ * snapshot.c
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <sphinxbase/ckd_alloc.h>
+#include <sphinxbase/fsg_model.h>
+
+#include "psconfig.h"
+#include "snapshot.h"
+#include "trace.h"
+
+#define SNAPSHOT_MAGIC "SWSNAP1"
+
+// Pocket Sphinx's name for the search it sets up from the config.
+#define CONFIG_SEARCH "_default"
+
+/* Header at the start of snapshot files. It is followed by n_args argument
+ * name and value strings, then n_sources sources, each a uint32 type and name
+ * and value strings, then the name of the active search, which is empty if
+ * there wasn't one. Strings are written as a uint32 length followed by the
+ * characters and a NUL, so they can be used straight from the mapping.
+ */
+typedef struct {
+    char magic[8];
+    uint32 n_args;
+    uint32 n_sources;
+} snapshot_header_t;
+
+typedef struct {
+    ps_search_type type;
+    const char *name;
+    const char *value;
+} snapshot_source_t;
+
+struct snapshot_s {
+    void *map; // memory mapping of the whole file
+    size_t map_size;
+    int argc;
+    char **argv; // program name and argument pairs, pointing into the mapping
+    uint32 n_sources;
+    snapshot_source_t *sources;
+    const char *active; // NULL if there was no active search
+};
+
+typedef struct {
+    const char *pos;
+    const char *end;
+} reader_t;
+
+static int
+write_string(FILE *file, const char *s) {
+    uint32 length = (uint32)strlen(s);
+    if (fwrite(&length, sizeof(length), 1, file) != 1 ||
+        fwrite(s, 1, length + 1, file) != length + 1)
+        return -1;
+    return 0;
+}
+
+static int
+write_source(FILE *file, ps_search_type type, const char *name,
+             const char *value) {
+    uint32 type_value = type;
+    if (fwrite(&type_value, sizeof(type_value), 1, file) != 1 ||
+        write_string(file, name) < 0 || write_string(file, value) < 0)
+        return -1;
+    return 0;
+}
+
+/* Write a search's compiled FSG as a FSG_STR source. */
+static int
+write_fsg_source(FILE *file, ps_decoder_t *ps, const char *name) {
+    fsg_model_t *fsg = ps_get_fsg(ps, name);
+    if (fsg == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    char *text = NULL;
+    size_t size = 0;
+    FILE *stream = open_memstream(&text, &size);
+    if (stream == NULL)
+        return -1;
+    fsg_model_write(fsg, stream);
+    int result = fclose(stream);
+    if (result == 0)
+        result = write_source(file, FSG_STR, name, text);
+    free(text);
+    return result;
+}
+
+/* Write every argument with a value, except those in skip.
+ * @return the number of arguments written, or -1 on failure
+ */
+static int
+write_args(FILE *file, cmd_ln_t *config, char const **skip, int n_skip) {
+    int n_args = 0;
+    for (arg_t const *arg = cont_args_def; arg->name != NULL; arg++) {
+        bool skipped = false;
+        for (int i = 0; i < n_skip; i++)
+            skipped = skipped || strcmp(arg->name, skip[i]) == 0;
+        if (skipped)
+            continue;
+
+        // Pocket Sphinx has no string list arguments, so those are left out.
+        char buffer[64];
+        const char *value = buffer;
+        int type = arg->type & ~ARG_REQUIRED;
+        if (type == ARG_STRING)
+            value = cmd_ln_str_r(config, arg->name);
+        else if (type == ARG_INTEGER)
+            snprintf(buffer, sizeof(buffer), "%ld",
+                     cmd_ln_int_r(config, arg->name));
+        else if (type == ARG_FLOATING)
+            snprintf(buffer, sizeof(buffer), "%.17g",
+                     cmd_ln_float_r(config, arg->name));
+        else if (type == ARG_BOOLEAN)
+            value = cmd_ln_int_r(config, arg->name) ? "yes" : "no";
+        else
+            value = NULL;
+        if (value == NULL)
+            continue;
+
+        if (write_string(file, arg->name) < 0 ||
+            write_string(file, value) < 0)
+            return -1;
+        n_args++;
+    }
+    return n_args;
+}
+
+/* Write either the added words or the searches from the sources, with
+ * grammars compiled.
+ * @return the number of sources written, or -1 on failure
+ */
+static int
+write_sources(FILE *file, ps_decoder_t *ps, search_source_t *sources,
+              bool words) {
+    int n_sources = 0;
+    for (search_source_t *s = sources; s != NULL; s = s->next) {
+        if ((s->type == DICT_WORD) != words)
+            continue;
+
+        int result;
+        if (s->type == JSGF_FILE || s->type == JSGF_STR ||
+            s->type == FSG_FILE || s->type == FSG_STR) {
+            bool evicted = !s->resident;
+            if (evicted && search_sources_restore(sources, ps, s->name) < 0)
+                return -1;
+            result = write_fsg_source(file, ps, s->name);
+            if (evicted)
+                ps_unset_search(ps, s->name);
+        } else {
+            result = write_source(file, s->type, s->name, s->value);
+        }
+
+        if (result < 0)
+            return -1;
+        n_sources++;
+    }
+    return n_sources;
+}
+
+int
+snapshot_save(const char *path, ps_decoder_t *ps, cmd_ln_t *config,
+              search_source_t *sources) {
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+        return -1;
+
+    uint64 span = trace_begin();
+    snapshot_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    int failed = fwrite(&header, sizeof(header), 1, file) != 1;
+
+    // A grammar given in the config is saved compiled like the others, unless
+    // a search set up since has replaced it. The argument file has already
+    // been read into the config.
+    char const *skip[] = {"-argfile", "-jsgf", "-fsg"};
+    int n_skip = 1;
+    fsg_model_t *config_fsg = NULL;
+    if (cmd_ln_str_r(config, "-jsgf") != NULL ||
+        cmd_ln_str_r(config, "-fsg") != NULL) {
+        if (search_sources_find(sources, CONFIG_SEARCH) == NULL)
+            config_fsg = ps_get_fsg(ps, CONFIG_SEARCH);
+        if (config_fsg != NULL ||
+            search_sources_find(sources, CONFIG_SEARCH) != NULL)
+            n_skip = 3;
+    }
+
+    // Added words come first so that every grammar can use them, including
+    // the config's.
+    int n_args = failed ? -1 : write_args(file, config, skip, n_skip);
+    int n_words = 0, n_sources = 0;
+    if (n_args < 0)
+        failed = 1;
+    else if ((n_words = write_sources(file, ps, sources, true)) < 0)
+        failed = 1;
+    else if (config_fsg != NULL &&
+             write_fsg_source(file, ps, CONFIG_SEARCH) < 0)
+        failed = 1;
+    else if ((n_sources = write_sources(file, ps, sources, false)) < 0)
+        failed = 1;
+
+    const char *active = ps_get_search(ps);
+    if (!failed && write_string(file, active != NULL ? active : "") < 0)
+        failed = 1;
+
+    // Fill in the counts now they are known.
+    if (!failed) {
+        header.n_args = n_args;
+        header.n_sources = n_words + n_sources + (config_fsg != NULL);
+        failed = fseek(file, 0, SEEK_SET) != 0 ||
+            fwrite(&header, sizeof(header), 1, file) != 1;
+    }
+
+    int saved_errno = errno;
+    if (fclose(file) != 0 && !failed) {
+        failed = 1;
+        saved_errno = errno;
+    }
+    trace_end(span, "save_snapshot");
+
+    errno = saved_errno;
+    return failed ? -1 : 0;
+}
+
+static bool
+read_uint32(reader_t *reader, uint32 *value) {
+    if ((size_t)(reader->end - reader->pos) < sizeof(*value))
+        return false;
+    memcpy(value, reader->pos, sizeof(*value));
+    reader->pos += sizeof(*value);
+    return true;
+}
+
+/* Read a string in place. @return NULL if it runs past the end of the file */
+static const char *
+read_string(reader_t *reader) {
+    uint32 length;
+    if (!read_uint32(reader, &length) ||
+        (size_t)(reader->end - reader->pos) <= length ||
+        reader->pos[length] != '\0')
+        return NULL;
+
+    const char *s = reader->pos;
+    reader->pos += length + 1;
+    return s;
+}
+
+/* Point the snapshot's arguments and sources into its mapping.
+ * @return false if the file is truncated or malformed
+ */
+static bool
+read_snapshot(snapshot_t *snap) {
+    reader_t reader = {snap->map, (const char *)snap->map + snap->map_size};
+    snapshot_header_t header;
+    if (snap->map_size < sizeof(header))
+        return false;
+    memcpy(&header, reader.pos, sizeof(header));
+    reader.pos += sizeof(header);
+
+    // Every string takes at least five bytes, so larger counts can't be right.
+    if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 ||
+        header.n_args > snap->map_size / 10 ||
+        header.n_sources > snap->map_size / 14)
+        return false;
+
+    snap->argc = 1 + 2 * header.n_args;
+    snap->argv = ckd_calloc(snap->argc + 1, sizeof(*snap->argv));
+    snap->argv[0] = "sphinxwrapper";
+    for (int i = 1; i < snap->argc; i++) {
+        if ((snap->argv[i] = (char *)read_string(&reader)) == NULL)
+            return false;
+    }
+
+    snap->n_sources = header.n_sources;
+    snap->sources = ckd_calloc(header.n_sources + 1, sizeof(*snap->sources));
+    for (uint32 i = 0; i < header.n_sources; i++) {
+        snapshot_source_t *source = &snap->sources[i];
+        uint32 type;
+        if (!read_uint32(&reader, &type) || type > DICT_WORD ||
+            (source->name = read_string(&reader)) == NULL ||
+            (source->value = read_string(&reader)) == NULL)
+            return false;
+        source->type = type;
+    }
+
+    const char *active = read_string(&reader);
+    if (active == NULL || reader.pos != reader.end)
+        return false;
+    snap->active = *active != '\0' ? active : NULL;
+    return true;
+}
+
+snapshot_t *
+snapshot_open(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return NULL;
+    }
+
+    if (st.st_size == 0) {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return NULL;
+
+    snapshot_t *snap = ckd_calloc(1, sizeof(*snap));
+    snap->map = map;
+    snap->map_size = st.st_size;
+    if (!read_snapshot(snap)) {
+        snapshot_close(snap);
+        errno = EINVAL;
+        return NULL;
+    }
+    return snap;
+}
+
+cmd_ln_t *
+snapshot_config(snapshot_t *snap) {
+    // The saved config already has the default search arguments, so it isn't
+    // parsed with parse_ps_args.
+    return cmd_ln_parse_r(NULL, cont_args_def, snap->argc, snap->argv, TRUE);
+}
+
+int
+snapshot_restore(snapshot_t *snap, ps_decoder_t *ps,
+                 search_source_t **sources) {
+    uint64 span = trace_begin();
+    int result = 0;
+
+    // Only the last word updates the active search, so that it is set up
+    // again once rather than for every word.
+    uint32 last_word = snap->n_sources;
+    for (uint32 i = 0; i < snap->n_sources; i++) {
+        if (snap->sources[i].type == DICT_WORD)
+            last_word = i;
+    }
+
+    for (uint32 i = 0; i < snap->n_sources && result == 0; i++) {
+        snapshot_source_t *source = &snap->sources[i];
+        if (source->type == DICT_WORD)
+            result = add_ps_word(ps, source->name, source->value,
+                                 i == last_word);
+        else
+            result = add_ps_search(ps, source->type, source->name,
+                                   source->value);
+        if (result == 0)
+            *sources = search_sources_add(*sources, source->type,
+                                          source->name, source->value);
+    }
+
+    if (result == 0 && snap->active != NULL &&
+        ps_set_search(ps, snap->active) < 0)
+        result = -1;
+    trace_end(span, "restore_snapshot");
+    return result;
+}
+
+void
+snapshot_close(snapshot_t *snap) {
+    if (snap == NULL)
+        return;
+    munmap(snap->map, snap->map_size);
+    ckd_free(snap->argv);
+    ckd_free(snap->sources);
+    ckd_free(snap);
+}
@@ -32,32 +32,135 @@
 #include "pyutil.h"
 #include "audio.h"
 #include "pypocketsphinx.h"
-
-#ifdef IS_PY3
-struct module_state {};
-#define GETSTATE(m) ((struct module_state*)PyModule_GetState(m))
-#else
-#endif
+#include "streammanager.h"
+#include "pyfeatures.h"
+#include "pylattice.h"
+#include "pygrammar.h"
+#include "pyaudioring.h"
+#include "pytrace.h"
+#include "pylog.h"
+#include "modstate.h"
 
 static PyMethodDef sphinxwrapper_methods[] = {
+    {"start_trace",
+     (PyCFunction)sphinxwrapper_start_trace, METH_NOARGS,
+     PyDoc_STR("Start recording when each native decoding phase begins and "
+               "ends in every thread, discarding any previous trace.\n"
+               "Tracing adds almost no overhead while it is stopped.")},
+    {"stop_trace",
+     (PyCFunction)sphinxwrapper_stop_trace, METH_NOARGS,
+     PyDoc_STR("Stop recording. The recorded trace is kept until the next "
+               "start_trace() call.")},
+    {"save_trace",
+     (PyCFunction)sphinxwrapper_save_trace, METH_KEYWORDS | METH_VARARGS,
+     PyDoc_STR("Save the recorded trace as Chrome trace event JSON, which can "
+               "be opened in Perfetto or chrome://tracing. Return the number "
+               "of spans dropped because a thread's buffer was full.\n\n"
+               "Keyword arguments:\n"
+               "path -- file path to save to.\n"
+               ":rtype: int")},
+    {"start_logging",
+     (PyCFunction)sphinxwrapper_start_logging, METH_KEYWORDS | METH_VARARGS,
+     PyDoc_STR("Pass Pocket Sphinx's log messages to a Python logger instead "
+               "of writing them to its log file. Messages are queued by the "
+               "decoding threads without waiting and logged from a "
+               "background thread. Messages below the level are discarded "
+               "straight away. If logging is already started, the logger and "
+               "level are changed. Logging is shared by the process, so this "
+               "raises RuntimeError outside the main interpreter.\n\n"
+               "Keyword arguments:\n"
+               "logger -- logger or logger name (default 'sphinxwrapper').\n"
+               "level -- lowest logging level passed on (default: the "
+               "logger's effective level).\n")},
+    {"stop_logging",
+     (PyCFunction)sphinxwrapper_stop_logging, METH_NOARGS,
+     PyDoc_STR("Log the messages still queued and write Pocket Sphinx's log "
+               "messages to its log file again.")},
     {NULL, NULL, 0, NULL} // Sentinel signifying the end of definitions
 };
 
+/* Set up the module's types and exceptions.
+ * @return 0 on success, -1 with an exception set on failure
+ */
+static int
+sphinxwrapper_exec(PyObject *module) {
+    // Set up the 'PocketSphinx' type and anything else it needs
+    if (initpocketsphinx(module) == NULL)
+        return -1;
+
+    // Set up the audio related types
+    if (initaudio(module) == NULL)
+        return -1;
+
+    // Set up the shared memory audio ring
+    if (initaudioring(module) == NULL)
+        return -1;
+
+    // Set up the multi-stream decoder manager
+    if (initstreammanager(module) == NULL)
+        return -1;
+
+    // Set up the cached features type
+    if (initfeatures(module) == NULL)
+        return -1;
+
+    // Set up the word lattice type
+    if (initlattice(module) == NULL)
+        return -1;
+
+    // Set up the type of futures for searches compiled in the background
+    if (initgrammar(module) == NULL)
+        return -1;
+
+    return 0;
+}
+
+#ifdef PYCOMPAT_MODULE_STATE
+// Modules are initialised in multiple phases so that each interpreter can
+// create its own module object, types and state.
+static PyModuleDef_Slot sphinxwrapper_slots[] = {
+    {Py_mod_exec, sphinxwrapper_exec},
+#if PY_VERSION_HEX >= 0x030C0000
+    {Py_mod_multiple_interpreters, Py_MOD_PER_INTERPRETER_GIL_SUPPORTED},
+#endif
+#if PY_VERSION_HEX >= 0x030D0000
+    // Objects hold their own locks, so the module can run without the GIL on
+    // free-threaded builds of Python.
+    {Py_mod_gil, Py_MOD_GIL_NOT_USED},
+#endif
+    {0, NULL}
+};
+#endif
+
 #ifdef IS_PY3
 #define INIT_SPHINX_WRAPPER PyInit_sphinxwrapper
 
 // Python 3 extensions define modules similar to the way custom types are defined
-static struct PyModuleDef moduledef = {
+#ifdef PYCOMPAT_MODULE_STATE
+struct PyModuleDef sphinxwrapper_moduledef = {
+    PyModuleDef_HEAD_INIT,
+    "sphinxwrapper",             /* m_name */
+    NULL,                        /* m_doc */
+    sizeof(module_state),        /* m_size */
+    sphinxwrapper_methods,       /* m_methods */
+    sphinxwrapper_slots,         /* m_slots */
+    module_state_traverse,       /* m_traverse */
+    module_state_clear,          /* m_clear */
+    module_state_free            /* m_free */
+};
+#else
+static struct PyModuleDef sphinxwrapper_moduledef = {
     PyModuleDef_HEAD_INIT,
     "sphinxwrapper",             /* m_name */
     NULL,                        /* m_doc */
-    sizeof(struct module_state), /* m_size */
+    -1,                          /* m_size */
     sphinxwrapper_methods,       /* m_methods */
     NULL,                        /* m_slots */
     NULL,                        /* m_traverse */
     NULL,                        /* m_clear */
     NULL                         /* m_free */
 };
+#endif
 
 #else
 #define INIT_SPHINX_WRAPPER initsphinxwrapper
@@ -65,23 +168,22 @@ static struct PyModuleDef moduledef = {
 
 PyMODINIT_FUNC
 INIT_SPHINX_WRAPPER(void) {
+#ifdef PYCOMPAT_MODULE_STATE
+    return PyModuleDef_Init(&sphinxwrapper_moduledef);
+#else
 #ifdef IS_PY3
-    PyObject *module = PyModule_Create(&moduledef);
+    PyObject *module = PyModule_Create(&sphinxwrapper_moduledef);
 #else
     PyObject *module = Py_InitModule("sphinxwrapper", sphinxwrapper_methods);
 #endif
-    // Set up the 'PocketSphinx' type and anything else it needs
     // Return appropriately for the Python version if there's an error
-    if (initpocketsphinx(module) == NULL)
-        PYCOMPAT_INIT_ERROR;
-
-    // Set up the audio related types
-    if (initaudio(module) == NULL)
+    if (module == NULL || sphinxwrapper_exec(module) < 0)
         PYCOMPAT_INIT_ERROR;
 
 #ifdef IS_PY3
     return module;
 #endif
+#endif
 }
 
 int
@@ -0,0 +1,430 @@
+/*
+ * streammanager.c
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "streammanager.h"
+#include "audio.h"
+#include "pypocketsphinx.h"
+
+
+/* Stream pool callback. This is called from the pool's worker threads without
+ * the GIL, so it only queues the event for get_events().
+ */
+static void
+StreamManagerObj_queue_event(void *user_data, int64 stream_id,
+                             utterance_event_t event, char const *hyp) {
+    StreamManagerObj *self = (StreamManagerObj *)user_data;
+    stream_event_t *item = malloc(sizeof(*item));
+    if (item == NULL)
+        return;
+
+    item->next = NULL;
+    item->stream_id = stream_id;
+    item->event = event;
+    item->hyp = hyp != NULL ? strdup(hyp) : NULL;
+
+    pthread_mutex_lock(&self->events_lock);
+    if (self->events_tail == NULL)
+        self->events_head = item;
+    else
+        self->events_tail->next = item;
+    self->events_tail = item;
+    pthread_cond_signal(&self->events_ready);
+    pthread_mutex_unlock(&self->events_lock);
+}
+
+PyObject *
+StreamManagerObj_push(StreamManagerObj *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"stream_id", "audio", NULL};
+    PY_LONG_LONG stream_id;
+    PyObject *audio = NULL;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "LO", kwlist, &stream_id,
+                                     &audio))
+        return NULL;
+
+    if (self->pool == NULL) {
+        PyErr_SetString(GET_MODULE_STATE(self)->StreamManagerError,
+                        "StreamManager is not initialised.");
+        return NULL;
+    }
+
+    int push_result;
+    if (PyObject_TypeCheck(audio, GET_MODULE_STATE(self)->AudioDataType)) {
+        AudioDataObj *audio_data_c = (AudioDataObj *)audio;
+        if (!audio_data_c->is_set) {
+            PyErr_SetString(GET_MODULE_STATE(self)->AudioDataError,
+                            "AudioData object is not set up "
+                            "properly. Try using the result from "
+                            "AudioDevice.read_audio()");
+            return NULL;
+        }
+
+        // The samples are copied, so other threads can't read into the
+        // object meanwhile.
+        obj_lock_acquire(&audio_data_c->lock);
+        push_result = stream_pool_push(self->pool, stream_id,
+                                       audio_data_c->samples,
+                                       audio_data_c->n_samples);
+        obj_lock_release(&audio_data_c->lock);
+    } else {
+        // Anything else must be a buffer of raw 16-bit audio samples
+        Py_buffer view;
+        if (PyObject_GetBuffer(audio, &view, PyBUF_SIMPLE) < 0)
+            return NULL;
+
+        if (view.len % sizeof(int16) != 0) {
+            PyBuffer_Release(&view);
+            PyErr_SetString(PyExc_ValueError, "audio buffers must hold whole "
+                            "16-bit samples, so their length in bytes must be "
+                            "even.");
+            return NULL;
+        }
+
+        push_result = stream_pool_push(self->pool, stream_id,
+                                       (int16 const *)view.buf,
+                                       view.len / sizeof(int16));
+        PyBuffer_Release(&view);
+    }
+
+    if (push_result < 0) {
+        PyErr_Format(GET_MODULE_STATE(self)->StreamManagerError,
+                     "stream %lld is closing.",
+                     (long long)stream_id);
+        return NULL;
+    }
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+PyObject *
+StreamManagerObj_close_stream(StreamManagerObj *self, PyObject *args,
+                              PyObject *kwds) {
+    static char *kwlist[] = {"stream_id", NULL};
+    PY_LONG_LONG stream_id;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "L", kwlist, &stream_id))
+        return NULL;
+
+    if (self->pool == NULL) {
+        PyErr_SetString(GET_MODULE_STATE(self)->StreamManagerError,
+                        "StreamManager is not initialised.");
+        return NULL;
+    }
+
+    if (stream_pool_close_stream(self->pool, stream_id) < 0) {
+        PyErr_Format(PyExc_KeyError, "there is no open stream with the ID "
+                     "%lld.", (long long)stream_id);
+        return NULL;
+    }
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+PyObject *
+StreamManagerObj_get_events(StreamManagerObj *self, PyObject *args,
+                            PyObject *kwds) {
+    static char *kwlist[] = {"timeout", NULL};
+    PyObject *timeout = Py_None;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O", kwlist, &timeout))
+        return NULL;
+
+    double timeout_secs = -1.0; // wait forever
+    if (timeout != Py_None) {
+        timeout_secs = PyFloat_AsDouble(timeout);
+        if (timeout_secs == -1.0 && PyErr_Occurred())
+            return NULL;
+        if (timeout_secs < 0.0) {
+            PyErr_SetString(PyExc_ValueError, "'timeout' must be a non-negative "
+                            "number or None.");
+            return NULL;
+        }
+    }
+
+    // Take all of the queued events, waiting for some if necessary
+    stream_event_t *events;
+    Py_BEGIN_ALLOW_THREADS
+    struct timeval now;
+    struct timespec deadline;
+    gettimeofday(&now, NULL);
+    double until = now.tv_sec + now.tv_usec / 1e6 + timeout_secs;
+    deadline.tv_sec = (time_t)until;
+    deadline.tv_nsec = (long)((until - (double)deadline.tv_sec) * 1e9);
+
+    pthread_mutex_lock(&self->events_lock);
+    while (self->events_head == NULL && timeout_secs != 0.0) {
+        if (timeout_secs < 0.0) {
+            pthread_cond_wait(&self->events_ready, &self->events_lock);
+        } else if (pthread_cond_timedwait(&self->events_ready,
+                                          &self->events_lock,
+                                          &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    events = self->events_head;
+    self->events_head = self->events_tail = NULL;
+    pthread_mutex_unlock(&self->events_lock);
+    Py_END_ALLOW_THREADS
+
+    PyObject *result = PyList_New(0);
+    while (events != NULL) {
+        stream_event_t *next = events->next;
+        if (result != NULL) {
+            const char *name = "hypothesis";
+            if (events->event == UTT_EVENT_SPEECH_START)
+                name = "speech_start";
+            else if (events->event == UTT_EVENT_ERROR)
+                name = "error";
+            PyObject *item = Py_BuildValue("(Lsz)", (PY_LONG_LONG)events->stream_id,
+                                           name, events->hyp);
+            if (item == NULL || PyList_Append(result, item) < 0)
+                Py_CLEAR(result);
+            Py_XDECREF(item);
+        }
+
+        free(events->hyp);
+        free(events);
+        events = next;
+    }
+
+    return result;
+}
+
+PyObject *
+StreamManagerObj_get_stream_count(StreamManagerObj *self, void *closure) {
+    size_t n_streams = 0;
+    if (self->pool != NULL)
+        n_streams = stream_pool_n_streams(self->pool);
+    return PyLong_FromSize_t(n_streams);
+}
+
+void
+StreamManagerObj_dealloc(StreamManagerObj *self) {
+    // Stop and join the worker threads. They never need the GIL, so it's safe to
+    // release it while waiting.
+    stream_pool_t *pool = self->pool;
+    self->pool = NULL;
+    if (pool != NULL) {
+        Py_BEGIN_ALLOW_THREADS
+        stream_pool_free(pool);
+        Py_END_ALLOW_THREADS
+    }
+
+    stream_event_t *event = self->events_head;
+    while (event != NULL) {
+        stream_event_t *next = event->next;
+        free(event->hyp);
+        free(event);
+        event = next;
+    }
+
+    pthread_cond_destroy(&self->events_ready);
+    pthread_mutex_destroy(&self->events_lock);
+
+    // Free the Python type object
+    free_module_object((PyObject *)self);
+}
+
+PyObject *
+StreamManagerObj_new(PyTypeObject *type, PyObject *args, PyObject *kwds) {
+    StreamManagerObj *self;
+
+    self = (StreamManagerObj *)type->tp_alloc(type, 0);
+    if (self != NULL) {
+        self->pool = NULL;
+        self->events_head = NULL;
+        self->events_tail = NULL;
+        pthread_mutex_init(&self->events_lock, NULL);
+        pthread_cond_init(&self->events_ready, NULL);
+    }
+
+    return (PyObject *)self;
+}
+
+int
+StreamManagerObj_init(StreamManagerObj *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"ps_args", "workers", NULL};
+    PyObject *ps_args = NULL;
+    int n_workers = 4;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|Oi", kwlist, &ps_args,
+                                     &n_workers))
+        return -1;
+
+    if (self->pool != NULL) {
+        PyErr_SetString(GET_MODULE_STATE(self)->StreamManagerError,
+                        "StreamManager is already "
+                        "initialised.");
+        return -1;
+    }
+
+    if (n_workers < 1) {
+        PyErr_SetString(PyExc_ValueError, "'workers' must be at least 1.");
+        return -1;
+    }
+
+    Py_ssize_t list_size = 0;
+    char **strings;
+    if (ps_args && ps_args != Py_None) {
+        strings = string_list_to_array(ps_args, &list_size);
+    } else {
+        // Use the default configuration if there aren't any arguments
+        strings = PyMem_New(char *, 1);
+        if (strings == NULL)
+            PyErr_NoMemory();
+    }
+
+    if (strings == NULL)
+        return -1;
+
+    cmd_ln_t *config = parse_ps_args(list_size, strings);
+    PyMem_Free(strings);
+    if (config == NULL) {
+        PyErr_SetString(GET_MODULE_STATE(self)->StreamManagerError,
+                        "couldn't parse the Pocket Sphinx "
+                        "configuration. Is your configuration right?");
+        return -1;
+    }
+
+    // The pool retains its own reference to the config.
+    self->pool = stream_pool_init(config, n_workers,
+                                  StreamManagerObj_queue_event, self);
+    cmd_ln_free_r(config);
+    if (self->pool == NULL) {
+        PyErr_SetString(GET_MODULE_STATE(self)->StreamManagerError,
+                        "failed to start the stream "
+                        "manager's worker threads.");
+        return -1;
+    }
+
+    return 0;
+}
+
+PyMethodDef StreamManagerObj_methods[] = {
+    {"push",
+     (PyCFunction)StreamManagerObj_push, METH_KEYWORDS | METH_VARARGS,
+     PyDoc_STR(
+         "Queue audio for a stream, opening the stream if necessary.\n"
+         "This method may be called from any thread.\n\n"
+         "Keyword arguments:\n"
+         "stream_id -- integer identifying the stream.\n"
+         "audio -- AudioData object or buffer of raw 16-bit audio samples. "
+         "ValueError is raised if a buffer's length is odd.\n")},
+    {"close_stream",
+     (PyCFunction)StreamManagerObj_close_stream, METH_KEYWORDS | METH_VARARGS,
+     PyDoc_STR(
+         "Close a stream once its queued audio has been processed. A hypothesis "
+         "event is reported if an utterance was in progress.\n\n"
+         "Keyword arguments:\n"
+         "stream_id -- integer identifying the stream.\n")},
+    {"get_events",
+     (PyCFunction)StreamManagerObj_get_events, METH_KEYWORDS | METH_VARARGS,
+     PyDoc_STR(
+         "Return a list of (stream_id, event, hypothesis) tuples for events that "
+         "have occurred since the last call, oldest first. event is "
+         "'speech_start', 'hypothesis' or 'error'; hypothesis is None for "
+         "speech start events and the error message for error events, which "
+         "are reported when a stream's decoder can't be set up and its audio "
+         "is dropped.\n\n"
+         "Keyword arguments:\n"
+         "timeout -- seconds to wait for an event if there are none, or None to "
+         "wait indefinitely (default None)\n")},
+    {NULL}  /* Sentinel */
+};
+
+PyGetSetDef StreamManagerObj_getseters[] = {
+    {"stream_count",
+     (getter)StreamManagerObj_get_stream_count, NULL,
+     "The number of open streams.", NULL},
+    {NULL}  /* Sentinel */
+};
+
+PyTypeObject StreamManagerType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "sphinxwrapper.StreamManager",        /* tp_name */
+    sizeof(StreamManagerObj),             /* tp_basicsize */
+    0,                                    /* tp_itemsize */
+    (destructor)StreamManagerObj_dealloc, /* tp_dealloc */
+    0,                                    /* tp_print */
+    0,                                    /* tp_getattr */
+    0,                                    /* tp_setattr */
+    0,                                    /* tp_compare */
+    0,                                    /* tp_repr */
+    0,                                    /* tp_as_number */
+    0,                                    /* tp_as_sequence */
+    0,                                    /* tp_as_mapping */
+    0,                                    /* tp_hash */
+    0,                                    /* tp_call */
+    0,                                    /* tp_str */
+    0,                                    /* tp_getattro */
+    0,                                    /* tp_setattro */
+    0,                                    /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT |
+    Py_TPFLAGS_BASETYPE,                  /* tp_flags */
+    "Manager of many Pocket Sphinx "
+    "decoder streams processed by a "
+    "pool of native worker threads.",     /* tp_doc */
+    0,                                    /* tp_traverse */
+    0,                                    /* tp_clear */
+    0,                                    /* tp_richcompare */
+    0,                                    /* tp_weaklistoffset */
+    0,                                    /* tp_iter */
+    0,                                    /* tp_iternext */
+    StreamManagerObj_methods,             /* tp_methods */
+    0,                                    /* tp_members */
+    StreamManagerObj_getseters,           /* tp_getset */
+    0,                                    /* tp_base */
+    0,                                    /* tp_dict */
+    0,                                    /* tp_descr_get */
+    0,                                    /* tp_descr_set */
+    0,                                    /* tp_dictoffset */
+    (initproc)StreamManagerObj_init,      /* tp_init */
+    0,                                    /* tp_alloc */
+    StreamManagerObj_new,                 /* tp_new */
+};
+
+PyObject *
+initstreammanager(PyObject *module) {
+    module_state *state = get_module_state(module);
+    state->StreamManagerType = add_module_type(module, &StreamManagerType);
+    if (state->StreamManagerType == NULL)
+        return NULL;
+
+    state->StreamManagerError = add_module_exception(module,
+                                                     "StreamManagerError");
+    if (state->StreamManagerError == NULL)
+        return NULL;
+
+    return module;
+}
@@ -0,0 +1,428 @@
+/*
+ * streampool.c
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#include <pthread.h>
+#include <string.h>
+#include <sphinxbase/ckd_alloc.h>
+#include <sphinxbase/err.h>
+
+#include "streampool.h"
+#include "trace.h"
+
+// Number of hash buckets used to look up streams by their ID
+#define STREAM_POOL_BUCKETS 256
+
+typedef struct audio_chunk_s {
+    struct audio_chunk_s *next;
+    size_t n_samples;
+    int16 samples[]; // flexible array member holding the audio
+} audio_chunk_t;
+
+typedef struct stream_s {
+    int64 id;
+    ps_decoder_t *ps; // taken from the pool lazily by a worker thread
+    utterance_state_t utterance_state;
+    audio_chunk_t *head; // pending audio
+    audio_chunk_t *tail;
+    size_t n_pending; // samples in the pending audio
+    bool queued; // in the run queue or being processed by a worker
+    bool closing;
+    bool failed; // the decoder couldn't be initialised
+    struct stream_s *bucket_next;
+    struct stream_s *run_next;
+} stream_t;
+
+struct stream_pool_s {
+    cmd_ln_t *config;
+    stream_event_cb callback;
+    stream_closed_cb closed_callback;
+    void *user_data;
+
+    // Guards everything below
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready;
+    stream_t *buckets[STREAM_POOL_BUCKETS];
+    size_t n_streams;
+    stream_t *run_head; // streams with pending work, in turn order
+    stream_t *run_tail;
+    bool stopping;
+    // Decoders of closed streams, ready to be handed to new streams
+    ps_decoder_t **idle;
+    size_t n_idle;
+    size_t idle_size;
+
+    // ps_init isn't safe to call concurrently with a shared config because it
+    // expands model paths in place.
+    pthread_mutex_t init_lock;
+
+    pthread_t *workers;
+    int n_workers;
+};
+
+static stream_t **
+stream_pool_bucket(stream_pool_t *pool, int64 stream_id) {
+    return &pool->buckets[(uint64)stream_id % STREAM_POOL_BUCKETS];
+}
+
+static stream_t *
+stream_pool_find(stream_pool_t *pool, int64 stream_id) {
+    stream_t *stream = *stream_pool_bucket(pool, stream_id);
+    while (stream != NULL && stream->id != stream_id)
+        stream = stream->bucket_next;
+    return stream;
+}
+
+static void
+stream_pool_unlink(stream_pool_t *pool, stream_t *stream) {
+    stream_t **link = stream_pool_bucket(pool, stream->id);
+    while (*link != stream)
+        link = &(*link)->bucket_next;
+    *link = stream->bucket_next;
+    pool->n_streams--;
+}
+
+static void
+stream_pool_run_push(stream_pool_t *pool, stream_t *stream) {
+    stream->run_next = NULL;
+    if (pool->run_tail == NULL)
+        pool->run_head = stream;
+    else
+        pool->run_tail->run_next = stream;
+    pool->run_tail = stream;
+    pthread_cond_signal(&pool->work_ready);
+}
+
+static stream_t *
+stream_pool_run_pop(stream_pool_t *pool) {
+    stream_t *stream = pool->run_head;
+    pool->run_head = stream->run_next;
+    if (pool->run_head == NULL)
+        pool->run_tail = NULL;
+    return stream;
+}
+
+static void
+stream_free(stream_t *stream) {
+    audio_chunk_t *chunk = stream->head;
+    while (chunk != NULL) {
+        audio_chunk_t *next = chunk->next;
+        ckd_free(chunk);
+        chunk = next;
+    }
+
+    if (stream->ps != NULL)
+        ps_free(stream->ps);
+    ckd_free(stream);
+}
+
+/* Take an idle decoder or initialise a new one. Called without the pool lock.
+ * @return NULL on failure
+ */
+static ps_decoder_t *
+stream_pool_take_decoder(stream_pool_t *pool) {
+    ps_decoder_t *ps = NULL;
+    pthread_mutex_lock(&pool->lock);
+    if (pool->n_idle > 0)
+        ps = pool->idle[--pool->n_idle];
+    pthread_mutex_unlock(&pool->lock);
+    if (ps != NULL)
+        return ps;
+
+    uint64 span = trace_begin();
+    pthread_mutex_lock(&pool->init_lock);
+    ps = ps_init(pool->config);
+    pthread_mutex_unlock(&pool->init_lock);
+    trace_end(span, "ps_init");
+    return ps;
+}
+
+/* Keep a finished stream's decoder for the next new stream. Its utterance has
+ * already been ended. Called without the pool lock.
+ */
+static void
+stream_pool_return_decoder(stream_pool_t *pool, ps_decoder_t *ps) {
+    pthread_mutex_lock(&pool->lock);
+    if (pool->n_idle == pool->idle_size) {
+        pool->idle_size = pool->idle_size > 0 ? pool->idle_size * 2 : 8;
+        pool->idle = ckd_realloc(pool->idle,
+                                 pool->idle_size * sizeof(*pool->idle));
+    }
+    pool->idle[pool->n_idle++] = ps;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+static void
+stream_report(stream_pool_t *pool, stream_t *stream, utterance_event_t event) {
+    char const *hyp = NULL;
+    if (event == UTT_EVENT_NONE)
+        return;
+    if (event == UTT_EVENT_HYPOTHESIS) {
+        uint64 span = trace_begin();
+        hyp = ps_get_hyp(stream->ps, NULL);
+        trace_end(span, "ps_get_hyp");
+    }
+    pool->callback(pool->user_data, stream->id, event, hyp);
+}
+
+/* Process one chunk of audio for a stream. Called without the pool lock. */
+static void
+stream_process_chunk(stream_pool_t *pool, stream_t *stream,
+                     audio_chunk_t *chunk) {
+    if (stream->ps == NULL && !stream->failed) {
+        stream->ps = stream_pool_take_decoder(pool);
+        if (stream->ps == NULL) {
+            E_ERROR("Failed to initialise decoder for stream %lld\n",
+                    (long long)stream->id);
+            stream->failed = true;
+            pool->callback(pool->user_data, stream->id, UTT_EVENT_ERROR,
+                           "failed to initialise the stream's decoder");
+        }
+    }
+
+    // Audio for streams without a decoder is dropped
+    if (stream->ps == NULL)
+        return;
+
+    utterance_event_t event = utterance_process_raw(
+        stream->ps, &stream->utterance_state, chunk->samples, chunk->n_samples);
+    stream_report(pool, stream, event);
+}
+
+/* End a closed stream's utterance, if any. Called without the pool lock. */
+static void
+stream_finish(stream_pool_t *pool, stream_t *stream) {
+    if (stream->ps != NULL &&
+        utterance_end(stream->ps, &stream->utterance_state))
+        stream_report(pool, stream, UTT_EVENT_HYPOTHESIS);
+}
+
+static void *
+stream_pool_worker(void *arg) {
+    stream_pool_t *pool = (stream_pool_t *)arg;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->stopping && pool->run_head == NULL)
+            pthread_cond_wait(&pool->work_ready, &pool->lock);
+        if (pool->stopping)
+            break;
+
+        // Take one chunk from the stream at the front of the queue. The stream
+        // stays marked as queued so no other worker will pick it up meanwhile.
+        stream_t *stream = stream_pool_run_pop(pool);
+        audio_chunk_t *chunk = stream->head;
+        if (chunk != NULL) {
+            stream->head = chunk->next;
+            if (stream->head == NULL)
+                stream->tail = NULL;
+            stream->n_pending -= chunk->n_samples;
+        } else {
+            // Streams are only queued without audio when they are closing.
+            stream_pool_unlink(pool, stream);
+        }
+        pthread_mutex_unlock(&pool->lock);
+
+        if (chunk == NULL) {
+            stream_finish(pool, stream);
+            if (pool->closed_callback != NULL)
+                pool->closed_callback(pool->user_data, stream->id);
+            if (stream->ps != NULL) {
+                stream_pool_return_decoder(pool, stream->ps);
+                stream->ps = NULL;
+            }
+            stream_free(stream);
+            pthread_mutex_lock(&pool->lock);
+            continue;
+        }
+
+        stream_process_chunk(pool, stream, chunk);
+        ckd_free(chunk);
+
+        // Go to the back of the queue if there is more to do
+        pthread_mutex_lock(&pool->lock);
+        if (stream->head != NULL || stream->closing)
+            stream_pool_run_push(pool, stream);
+        else
+            stream->queued = false;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+stream_pool_t *
+stream_pool_init(cmd_ln_t *config, int n_workers, stream_event_cb callback,
+                 void *user_data) {
+    if (config == NULL || n_workers < 1 || callback == NULL)
+        return NULL;
+
+    stream_pool_t *pool = ckd_calloc(1, sizeof(*pool));
+    pool->config = cmd_ln_retain(config);
+    pool->callback = callback;
+    pool->user_data = user_data;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_mutex_init(&pool->init_lock, NULL);
+    pthread_cond_init(&pool->work_ready, NULL);
+
+    pool->workers = ckd_calloc(n_workers, sizeof(pthread_t));
+    for (int i = 0; i < n_workers; i++) {
+        if (pthread_create(&pool->workers[i], NULL, stream_pool_worker,
+                           pool) != 0) {
+            E_ERROR("Failed to start stream pool worker thread\n");
+            stream_pool_free(pool);
+            return NULL;
+        }
+        pool->n_workers++;
+    }
+
+    return pool;
+}
+
+int
+stream_pool_push(stream_pool_t *pool, int64 stream_id, int16 const *buf,
+                 size_t n_samples) {
+    audio_chunk_t *chunk = ckd_malloc(sizeof(*chunk) +
+                                      n_samples * sizeof(int16));
+    chunk->next = NULL;
+    chunk->n_samples = n_samples;
+    memcpy(chunk->samples, buf, n_samples * sizeof(int16));
+
+    pthread_mutex_lock(&pool->lock);
+    stream_t *stream = stream_pool_find(pool, stream_id);
+
+    // Audio can't be added to a stream that is being closed.
+    if (stream != NULL && stream->closing) {
+        pthread_mutex_unlock(&pool->lock);
+        ckd_free(chunk);
+        return -1;
+    }
+
+    if (stream == NULL) {
+        stream = ckd_calloc(1, sizeof(*stream));
+        stream->id = stream_id;
+        stream->utterance_state = ENDED;
+        stream_t **bucket = stream_pool_bucket(pool, stream_id);
+        stream->bucket_next = *bucket;
+        *bucket = stream;
+        pool->n_streams++;
+    }
+
+    if (stream->tail == NULL)
+        stream->head = chunk;
+    else
+        stream->tail->next = chunk;
+    stream->tail = chunk;
+    stream->n_pending += n_samples;
+
+    if (!stream->queued) {
+        stream->queued = true;
+        stream_pool_run_push(pool, stream);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return 0;
+}
+
+int
+stream_pool_close_stream(stream_pool_t *pool, int64 stream_id) {
+    int result = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    stream_t *stream = stream_pool_find(pool, stream_id);
+    if (stream == NULL || stream->closing) {
+        result = -1;
+    } else {
+        stream->closing = true;
+        if (!stream->queued) {
+            stream->queued = true;
+            stream_pool_run_push(pool, stream);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return result;
+}
+
+void
+stream_pool_set_closed_callback(stream_pool_t *pool,
+                                stream_closed_cb closed_callback) {
+    pthread_mutex_lock(&pool->lock);
+    pool->closed_callback = closed_callback;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+size_t
+stream_pool_pending(stream_pool_t *pool, int64 stream_id) {
+    pthread_mutex_lock(&pool->lock);
+    stream_t *stream = stream_pool_find(pool, stream_id);
+    size_t n_pending = stream != NULL ? stream->n_pending : 0;
+    pthread_mutex_unlock(&pool->lock);
+    return n_pending;
+}
+
+size_t
+stream_pool_n_streams(stream_pool_t *pool) {
+    pthread_mutex_lock(&pool->lock);
+    size_t n_streams = pool->n_streams;
+    pthread_mutex_unlock(&pool->lock);
+    return n_streams;
+}
+
+void
+stream_pool_free(stream_pool_t *pool) {
+    if (pool == NULL)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->work_ready);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->n_workers; i++)
+        pthread_join(pool->workers[i], NULL);
+    ckd_free(pool->workers);
+
+    for (int i = 0; i < STREAM_POOL_BUCKETS; i++) {
+        stream_t *stream = pool->buckets[i];
+        while (stream != NULL) {
+            stream_t *next = stream->bucket_next;
+            stream_free(stream);
+            stream = next;
+        }
+    }
+
+    for (size_t i = 0; i < pool->n_idle; i++)
+        ps_free(pool->idle[i]);
+    ckd_free(pool->idle);
+
+    pthread_cond_destroy(&pool->work_ready);
+    pthread_mutex_destroy(&pool->init_lock);
+    pthread_mutex_destroy(&pool->lock);
+    cmd_ln_free_r(pool->config);
+    ckd_free(pool);
+}
@@ -0,0 +1,224 @@
+/*
+ * trace.c
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
+#include <sphinxbase/ckd_alloc.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#include "trace.h"
+
+typedef struct {
+    const char *name;
+    uint64 start;
+    uint64 end;
+    uint64 tid; // thread that recorded the span
+} trace_event_t;
+
+/* The spans recorded by one thread. Buffers are never freed; a thread's buffer
+ * is handed to a new thread once it exits, so there are at most as many
+ * buffers as threads which were alive at once.
+ */
+typedef struct trace_buffer_s {
+    trace_event_t events[TRACE_BUFFER_SIZE];
+    uint32 n_events; // published to the writer of the trace with release
+    uint32 generation; // trace the events belong to
+    uint64 n_dropped;
+    int in_use; // whether a live thread owns the buffer
+    struct trace_buffer_s *next;
+} trace_buffer_t;
+
+int trace_enabled = 0;
+
+// Incremented by trace_start so that threads discard the previous spans.
+static uint32 trace_generation = 0;
+
+static trace_buffer_t *buffers = NULL;
+static __thread trace_buffer_t *thread_buffer = NULL;
+static pthread_key_t buffer_key;
+static pthread_once_t buffer_key_once = PTHREAD_ONCE_INIT;
+
+static void
+release_buffer(void *buffer) {
+    __atomic_store_n(&((trace_buffer_t *)buffer)->in_use, 0, __ATOMIC_RELEASE);
+}
+
+static void
+create_buffer_key(void) {
+    pthread_key_create(&buffer_key, release_buffer);
+}
+
+static uint64
+get_thread_id(void) {
+#ifdef __linux__
+    return (uint64)syscall(SYS_gettid);
+#else
+    return (uint64)(uintptr_t)pthread_self();
+#endif
+}
+
+/* Get the calling thread's buffer, reusing one of an exited thread if there
+ * is one.
+ */
+static trace_buffer_t *
+get_thread_buffer(void) {
+    if (thread_buffer != NULL)
+        return thread_buffer;
+
+    pthread_once(&buffer_key_once, create_buffer_key);
+    trace_buffer_t *buffer;
+    for (buffer = __atomic_load_n(&buffers, __ATOMIC_ACQUIRE); buffer != NULL;
+         buffer = buffer->next) {
+        int unused = 0;
+        if (__atomic_compare_exchange_n(&buffer->in_use, &unused, 1, false,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            break;
+    }
+
+    if (buffer == NULL) {
+        // Push a new buffer onto the list, which is only ever added to.
+        buffer = ckd_calloc(1, sizeof(*buffer));
+        buffer->in_use = 1;
+        buffer->next = __atomic_load_n(&buffers, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&buffers, &buffer->next, buffer,
+                                            true, __ATOMIC_RELEASE,
+                                            __ATOMIC_RELAXED))
+            ;
+    }
+
+    pthread_setspecific(buffer_key, buffer);
+    thread_buffer = buffer;
+    return buffer;
+}
+
+uint64
+trace_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64)now.tv_sec * 1000000000u + now.tv_nsec;
+}
+
+void
+trace_record(const char *name, uint64 start) {
+    uint64 end = trace_now();
+    trace_buffer_t *buffer = get_thread_buffer();
+
+    // Only this thread changes the buffer's events, so the count is published
+    // after the event is written for trace_write_json to read.
+    uint32 generation = __atomic_load_n(&trace_generation, __ATOMIC_ACQUIRE);
+    uint32 n_events = buffer->n_events;
+    if (buffer->generation != generation) {
+        n_events = 0;
+        __atomic_store_n(&buffer->n_events, 0, __ATOMIC_RELEASE);
+        __atomic_store_n(&buffer->n_dropped, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&buffer->generation, generation, __ATOMIC_RELEASE);
+    }
+
+    if (n_events >= TRACE_BUFFER_SIZE) {
+        __atomic_add_fetch(&buffer->n_dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    trace_event_t *event = &buffer->events[n_events];
+    event->name = name;
+    event->start = start;
+    event->end = end;
+    event->tid = get_thread_id();
+    __atomic_store_n(&buffer->n_events, n_events + 1, __ATOMIC_RELEASE);
+}
+
+void
+trace_start(void) {
+    __atomic_add_fetch(&trace_generation, 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&trace_enabled, 1, __ATOMIC_RELEASE);
+}
+
+void
+trace_stop(void) {
+    __atomic_store_n(&trace_enabled, 0, __ATOMIC_RELEASE);
+}
+
+/* Get the number of events a buffer holds for the current trace. */
+static uint32
+get_n_events(trace_buffer_t *buffer, uint32 generation) {
+    if (__atomic_load_n(&buffer->generation, __ATOMIC_ACQUIRE) != generation)
+        return 0;
+    return __atomic_load_n(&buffer->n_events, __ATOMIC_ACQUIRE);
+}
+
+int
+trace_write_json(FILE *file) {
+    uint32 generation = __atomic_load_n(&trace_generation, __ATOMIC_ACQUIRE);
+    long pid = (long)getpid();
+    const char *separator = "";
+
+    fprintf(file, "{\"traceEvents\":[");
+    for (trace_buffer_t *buffer = __atomic_load_n(&buffers, __ATOMIC_ACQUIRE);
+         buffer != NULL; buffer = buffer->next) {
+        uint32 n_events = get_n_events(buffer, generation);
+        for (uint32 i = 0; i < n_events; i++) {
+            // Complete events with timestamps and durations in microseconds.
+            trace_event_t *event = &buffer->events[i];
+            fprintf(file, "%s\n{\"name\":\"%s\",\"cat\":\"sphinxwrapper\","
+                    "\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%ld,"
+                    "\"tid\":%llu}", separator, event->name,
+                    event->start / 1000.0,
+                    (event->end - event->start) / 1000.0, pid,
+                    (unsigned long long)event->tid);
+            separator = ",";
+        }
+    }
+    fprintf(file, "\n],\"displayTimeUnit\":\"ms\","
+            "\"otherData\":{\"dropped_events\":%llu}}\n",
+            (unsigned long long)trace_dropped());
+
+    if (ferror(file)) {
+        if (errno == 0)
+            errno = EIO;
+        return -1;
+    }
+    return 0;
+}
+
+uint64
+trace_dropped(void) {
+    uint32 generation = __atomic_load_n(&trace_generation, __ATOMIC_ACQUIRE);
+    uint64 n_dropped = 0;
+    for (trace_buffer_t *buffer = __atomic_load_n(&buffers, __ATOMIC_ACQUIRE);
+         buffer != NULL; buffer = buffer->next) {
+        if (__atomic_load_n(&buffer->generation, __ATOMIC_ACQUIRE) == generation)
+            n_dropped += __atomic_load_n(&buffer->n_dropped, __ATOMIC_RELAXED);
+    }
+    return n_dropped;
+}
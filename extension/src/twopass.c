@@ -0,0 +1,284 @@
+/*
+ * twopass.c
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#include <string.h>
+#include <pthread.h>
+#include <sphinxbase/ckd_alloc.h>
+
+#include "psconfig.h"
+#include "trace.h"
+#include "twopass.h"
+
+typedef struct second_pass_job_s {
+    int16 *samples; // the utterance's audio
+    size_t n_samples;
+    char *search; // search to decode with, or NULL for the active one
+    char *first_hyp;
+    char *hyp; // result, set once done
+    bool done;
+    bool failed; // whether the search couldn't be selected
+    struct second_pass_job_s *next;
+} second_pass_job_t;
+
+struct second_pass_s {
+    ps_decoder_t *ps;
+    cmd_ln_t *config; // copy used by the second decoder
+
+    // Audio of the current utterance, only used by the caller's thread.
+    int16 *samples;
+    size_t n_samples;
+    size_t size;
+
+    // Jobs in submission order. The thread works on the oldest job that isn't
+    // done; finished jobs stay at the head until they are polled.
+    pthread_mutex_t lock;
+    pthread_cond_t job_ready;
+    pthread_cond_t job_done;
+    second_pass_job_t *head;
+    second_pass_job_t *tail;
+    bool stopping;
+    pthread_t thread;
+};
+
+/*
+ * Decode a job's audio, setting hyp to its hypothesis or NULL.
+ * @return 0 on success, -1 if the job's search couldn't be selected
+ */
+static int
+decode(second_pass_t *sp, second_pass_job_t *job, char **hyp_out) {
+    ps_decoder_t *ps = sp->ps;
+    *hyp_out = NULL;
+
+    // Searches set after the second pass was enabled aren't known here.
+    const char *active = ps_get_search(ps);
+    if (job->search != NULL &&
+        (active == NULL || strcmp(active, job->search) != 0) &&
+        ps_set_search(ps, job->search) < 0)
+        return -1;
+
+    uint64 span = trace_begin();
+    ps_start_utt(ps);
+    ps_process_raw(ps, job->samples, job->n_samples, FALSE, TRUE);
+    ps_end_utt(ps);
+    const char *hyp = ps_get_hyp(ps, NULL);
+    trace_end(span, "second_pass_decode");
+    *hyp_out = hyp != NULL ? ckd_salloc(hyp) : NULL;
+    return 0;
+}
+
+static void *
+second_pass_main(void *arg) {
+    second_pass_t *sp = arg;
+
+    pthread_mutex_lock(&sp->lock);
+    for (;;) {
+        second_pass_job_t *job = sp->head;
+        while (job != NULL && job->done)
+            job = job->next;
+        if (sp->stopping)
+            break;
+        if (job == NULL) {
+            pthread_cond_wait(&sp->job_ready, &sp->lock);
+            continue;
+        }
+
+        // Jobs are only removed once done, so this one stays valid.
+        pthread_mutex_unlock(&sp->lock);
+        char *hyp;
+        bool failed = decode(sp, job, &hyp) < 0;
+        pthread_mutex_lock(&sp->lock);
+
+        ckd_free(job->samples);
+        job->samples = NULL;
+        job->hyp = hyp;
+        job->failed = failed;
+        job->done = true;
+        pthread_cond_broadcast(&sp->job_done);
+    }
+    pthread_mutex_unlock(&sp->lock);
+    return NULL;
+}
+
+second_pass_t *
+second_pass_init(cmd_ln_t *config, search_source_t *sources,
+                 const char *search) {
+    cmd_ln_t *copy = copy_ps_args(config);
+    if (copy == NULL)
+        return NULL;
+    cmd_ln_set_boolean_r(copy, "-fwdflat", TRUE);
+    cmd_ln_set_boolean_r(copy, "-bestpath", TRUE);
+
+    ps_decoder_t *ps = ps_init(copy);
+    if (ps == NULL || search_sources_apply(sources, ps, search) < 0) {
+        if (ps != NULL)
+            ps_free(ps);
+        cmd_ln_free_r(copy);
+        return NULL;
+    }
+
+    second_pass_t *sp = ckd_calloc(1, sizeof(*sp));
+    sp->ps = ps;
+    sp->config = copy;
+    pthread_mutex_init(&sp->lock, NULL);
+    pthread_cond_init(&sp->job_ready, NULL);
+    pthread_cond_init(&sp->job_done, NULL);
+
+    if (pthread_create(&sp->thread, NULL, second_pass_main, sp) != 0) {
+        pthread_cond_destroy(&sp->job_done);
+        pthread_cond_destroy(&sp->job_ready);
+        pthread_mutex_destroy(&sp->lock);
+        ps_free(ps);
+        cmd_ln_free_r(copy);
+        ckd_free(sp);
+        return NULL;
+    }
+
+    return sp;
+}
+
+void
+second_pass_retain(second_pass_t *sp, int16 const *samples, size_t n_samples,
+                   bool restart) {
+    if (restart)
+        sp->n_samples = 0;
+
+    if (sp->n_samples + n_samples > sp->size) {
+        size_t size = sp->size > 0 ? sp->size : 4096;
+        while (size < sp->n_samples + n_samples)
+            size *= 2;
+        sp->samples = ckd_realloc(sp->samples, size * sizeof(*sp->samples));
+        sp->size = size;
+    }
+
+    memcpy(sp->samples + sp->n_samples, samples, n_samples * sizeof(*samples));
+    sp->n_samples += n_samples;
+}
+
+void
+second_pass_submit(second_pass_t *sp, const char *search,
+                   const char *first_hyp) {
+    // The job takes the buffer, which is trimmed to fit.
+    second_pass_job_t *job = ckd_calloc(1, sizeof(*job));
+    job->samples = ckd_realloc(sp->samples, (sp->n_samples > 0 ?
+                                             sp->n_samples : 1) *
+                               sizeof(*sp->samples));
+    job->n_samples = sp->n_samples;
+    job->search = search != NULL ? ckd_salloc(search) : NULL;
+    job->first_hyp = first_hyp != NULL ? ckd_salloc(first_hyp) : NULL;
+    sp->samples = NULL;
+    sp->n_samples = sp->size = 0;
+
+    pthread_mutex_lock(&sp->lock);
+    if (sp->tail != NULL)
+        sp->tail->next = job;
+    else
+        sp->head = job;
+    sp->tail = job;
+    pthread_cond_signal(&sp->job_ready);
+    pthread_mutex_unlock(&sp->lock);
+}
+
+static void
+job_free(second_pass_job_t *job) {
+    ckd_free(job->samples);
+    ckd_free(job->search);
+    ckd_free(job->first_hyp);
+    ckd_free(job);
+}
+
+bool
+second_pass_poll(second_pass_t *sp, char **first_hyp, char **hyp,
+                 bool *changed) {
+    for (;;) {
+        pthread_mutex_lock(&sp->lock);
+        second_pass_job_t *job = sp->head;
+        bool taken = job != NULL && job->done;
+        if (taken) {
+            sp->head = job->next;
+            if (sp->head == NULL)
+                sp->tail = NULL;
+        }
+        pthread_mutex_unlock(&sp->lock);
+
+        if (!taken)
+            return false;
+
+        // Nothing is known about utterances whose search the second decoder
+        // doesn't have.
+        if (job->failed) {
+            job_free(job);
+            continue;
+        }
+
+        if (job->hyp == NULL || job->first_hyp == NULL)
+            *changed = job->hyp != job->first_hyp;
+        else
+            *changed = strcmp(job->hyp, job->first_hyp) != 0;
+        *hyp = job->hyp;
+        *first_hyp = job->first_hyp;
+        job->first_hyp = NULL;
+        job_free(job);
+        return true;
+    }
+}
+
+void
+second_pass_wait(second_pass_t *sp) {
+    pthread_mutex_lock(&sp->lock);
+    while (sp->tail != NULL && !sp->tail->done)
+        pthread_cond_wait(&sp->job_done, &sp->lock);
+    pthread_mutex_unlock(&sp->lock);
+}
+
+void
+second_pass_free(second_pass_t *sp) {
+    if (sp == NULL)
+        return;
+
+    pthread_mutex_lock(&sp->lock);
+    sp->stopping = true;
+    pthread_cond_signal(&sp->job_ready);
+    pthread_mutex_unlock(&sp->lock);
+    pthread_join(sp->thread, NULL);
+
+    second_pass_job_t *job = sp->head;
+    while (job != NULL) {
+        second_pass_job_t *next = job->next;
+        ckd_free(job->hyp);
+        job_free(job);
+        job = next;
+    }
+
+    pthread_cond_destroy(&sp->job_done);
+    pthread_cond_destroy(&sp->job_ready);
+    pthread_mutex_destroy(&sp->lock);
+    ckd_free(sp->samples);
+    ps_free(sp->ps);
+    cmd_ln_free_r(sp->config);
+    ckd_free(sp);
+}
@@ -0,0 +1,81 @@
+/*
+ * utterance.c
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+#include <stdbool.h>
+
+#include "trace.h"
+#include "utterance.h"
+
+utterance_event_t
+utterance_process_raw(ps_decoder_t *ps, utterance_state_t *state,
+                      int16 const *buf, size_t n_samples) {
+    // Call ps_start_utt if necessary
+    if (*state == ENDED) {
+        ps_start_utt(ps);
+        *state = IDLE;
+    }
+
+    uint64 span = trace_begin();
+    ps_process_raw(ps, buf, n_samples, FALSE, FALSE);
+    trace_end(span, "ps_process_raw");
+
+    utterance_event_t event = utterance_update(state, ps_get_in_speech(ps));
+    if (event == UTT_EVENT_HYPOTHESIS) {
+        span = trace_begin();
+        ps_end_utt(ps);
+        trace_end(span, "ps_end_utt");
+    }
+
+    return event;
+}
+
+utterance_event_t
+utterance_update(utterance_state_t *state, uint8 in_speech) {
+    if (in_speech && *state == IDLE) {
+        *state = STARTED;
+        return UTT_EVENT_SPEECH_START;
+    } else if (!in_speech && *state == STARTED) {
+        /* speech -> silence transition, time to start new utterance  */
+        *state = ENDED;
+        return UTT_EVENT_HYPOTHESIS;
+    }
+
+    return UTT_EVENT_NONE;
+}
+
+bool
+utterance_end(ps_decoder_t *ps, utterance_state_t *state) {
+    if (*state == ENDED)
+        return false;
+
+    uint64 span = trace_begin();
+    ps_end_utt(ps);
+    trace_end(span, "ps_end_utt");
+    *state = ENDED;
+    return true;
+}
@@ -1,4 +1,6 @@
-from setuptools import setup
+import sys
+
+from setuptools import setup, Extension
 
 
 def get_long_description():
@@ -6,6 +8,17 @@ def get_long_description():
         return f.read()
 
 
+# Native helper for PocketSphinx.process_audio. The package falls back to
+# pure Python if it can't be built.
+utterance_libraries = ['dl'] if sys.platform.startswith('linux') else []
+utterance_extension = Extension(
+    'sphinxwrapper._utterance',
+    sources=['sphinxwrapper/_utterance.c'],
+    libraries=utterance_libraries,
+    optional=True
+)
+
+
 setup(
     name='sphinxwrapper',
     version='1.2.0',
@@ -29,5 +42,6 @@ setup(
         'Topic :: Software Development :: Libraries',
     ],
     packages=['sphinxwrapper'],
+    ext_modules=[utterance_extension],
     install_requires=['pocketsphinx']
 )
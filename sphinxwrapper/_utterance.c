@@ -0,0 +1,284 @@
+/*
+ * _utterance.c
+ *
+ * ==============================================================================
+ * MIT License
+ *
+ * Copyright (c) 2017 Dane Finlay
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * ==============================================================================
+ */
+
+/*
+ * Optional native helper for the SWIG-based PocketSphinx class in
+ * pocketsphinx_wrap.py. It runs the idle/started/ended utterance state machine
+ * over a list of audio buffers in one call, returning to Python only when a
+ * speech start or hypothesis event needs a callback.
+ *
+ * The Pocket Sphinx functions are looked up in the already loaded SWIG
+ * module, so no Pocket Sphinx headers or libraries are needed to build this.
+ */
+
+#include <Python.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+#if PY_MAJOR_VERSION >= 3
+#define IS_PY3
+#endif
+
+// Utterance states; these match the values used by pocketsphinx_wrap.py.
+#define UTT_IDLE 0
+#define UTT_STARTED 1
+#define UTT_ENDED 2
+
+// Events returned by process()
+#define EVENT_NONE 0
+#define EVENT_SPEECH_START 1
+#define EVENT_HYPOTHESIS 2
+
+// The decoder is opaque here.
+typedef struct ps_decoder_s ps_decoder_t;
+
+typedef int (*ps_start_utt_fn)(ps_decoder_t *ps);
+typedef int (*ps_end_utt_fn)(ps_decoder_t *ps);
+typedef int (*ps_process_raw_fn)(ps_decoder_t *ps, short const *data,
+                                 size_t n_samples, int no_search, int full_utt);
+typedef unsigned char (*ps_get_in_speech_fn)(ps_decoder_t *ps);
+
+static ps_start_utt_fn ps_start_utt_ptr = NULL;
+static ps_end_utt_fn ps_end_utt_ptr = NULL;
+static ps_process_raw_fn ps_process_raw_ptr = NULL;
+static ps_get_in_speech_fn ps_get_in_speech_ptr = NULL;
+
+/* Look up a symbol in the library at path, which must already be loaded. */
+static void *
+find_symbol(const char *path, const char *name) {
+#ifdef _WIN32
+    HMODULE handle = GetModuleHandleA(path);
+    return handle != NULL ? (void *)GetProcAddress(handle, name) : NULL;
+#else
+    void *handle = dlopen(path, RTLD_LAZY | RTLD_NOLOAD);
+    if (handle == NULL)
+        return NULL;
+    void *symbol = dlsym(handle, name);
+    dlclose(handle);
+    return symbol;
+#endif
+}
+
+static PyObject *
+utterance_init(PyObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"path", NULL};
+    const char *path = NULL;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s", kwlist, &path))
+        return NULL;
+
+    ps_start_utt_ptr = (ps_start_utt_fn)find_symbol(path, "ps_start_utt");
+    ps_end_utt_ptr = (ps_end_utt_fn)find_symbol(path, "ps_end_utt");
+    ps_process_raw_ptr = (ps_process_raw_fn)find_symbol(path, "ps_process_raw");
+    ps_get_in_speech_ptr = (ps_get_in_speech_fn)find_symbol(path,
+                                                            "ps_get_in_speech");
+
+    if (ps_start_utt_ptr && ps_end_utt_ptr && ps_process_raw_ptr &&
+        ps_get_in_speech_ptr)
+        Py_RETURN_TRUE;
+
+    ps_start_utt_ptr = NULL;
+    Py_RETURN_FALSE;
+}
+
+/* Raise a RuntimeError for a failed ps_process_raw call. The utterance may
+ * have been started before the call, so the new state is given as the
+ * exception's utterance_state attribute for the caller to keep.
+ */
+static void
+raise_process_error(int process_result, int state) {
+    char message[64];
+    PyOS_snprintf(message, sizeof(message), "Decoder_process_raw returned %d",
+                  process_result);
+    PyObject *exc = PyObject_CallFunction(PyExc_RuntimeError, "s", message);
+    if (exc == NULL)
+        return;
+
+    PyObject *state_obj = Py_BuildValue("i", state);
+    if (state_obj == NULL ||
+        PyObject_SetAttrString(exc, "utterance_state", state_obj) < 0) {
+        Py_XDECREF(state_obj);
+        Py_DECREF(exc);
+        return;
+    }
+    Py_DECREF(state_obj);
+    PyErr_SetObject(PyExc_RuntimeError, exc);
+    Py_DECREF(exc);
+}
+
+static PyObject *
+utterance_process(PyObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"decoder", "state", "buffers", "start",
+                             "no_search", "full_utterance", NULL};
+    PyObject *decoder_ptr = NULL;
+    int state = UTT_ENDED;
+    PyObject *buffers = NULL;
+    Py_ssize_t start = 0;
+    int no_search = 0;
+    int full_utt = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OiO|nii", kwlist,
+                                     &decoder_ptr, &state, &buffers, &start,
+                                     &no_search, &full_utt))
+        return NULL;
+
+    if (ps_start_utt_ptr == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "init() has not been called "
+                        "successfully.");
+        return NULL;
+    }
+
+    ps_decoder_t *ps = (ps_decoder_t *)PyLong_AsVoidPtr(decoder_ptr);
+    if (ps == NULL) {
+        if (!PyErr_Occurred())
+            PyErr_SetString(PyExc_ValueError, "decoder pointer is NULL.");
+        return NULL;
+    }
+
+    PyObject *seq = PySequence_Fast(buffers, "buffers must be a sequence.");
+    if (seq == NULL)
+        return NULL;
+
+    Py_ssize_t n_buffers = PySequence_Fast_GET_SIZE(seq);
+    Py_ssize_t i;
+    int event = EVENT_NONE;
+    for (i = start; i < n_buffers && event == EVENT_NONE; i++) {
+        Py_buffer view;
+        PyObject *buf = PySequence_Fast_GET_ITEM(seq, i);
+        if (PyObject_GetBuffer(buf, &view, PyBUF_SIMPLE) < 0) {
+            Py_DECREF(seq);
+            return NULL;
+        }
+
+        int process_result;
+        unsigned char in_speech;
+        Py_BEGIN_ALLOW_THREADS
+        if (state == UTT_ENDED) {
+            ps_start_utt_ptr(ps);
+            state = UTT_IDLE;
+        }
+
+        process_result = ps_process_raw_ptr(ps, (short const *)view.buf,
+                                            view.len / sizeof(short),
+                                            no_search, full_utt);
+        in_speech = ps_get_in_speech_ptr(ps);
+        if (process_result >= 0) {
+            if (in_speech && state == UTT_IDLE) {
+                state = UTT_STARTED;
+                event = EVENT_SPEECH_START;
+            } else if (!in_speech && state == UTT_STARTED) {
+                // We're not in speech any more; utterance is over.
+                ps_end_utt_ptr(ps);
+                state = UTT_ENDED;
+                event = EVENT_HYPOTHESIS;
+            }
+        }
+        Py_END_ALLOW_THREADS
+        PyBuffer_Release(&view);
+
+        if (process_result < 0) {
+            Py_DECREF(seq);
+            raise_process_error(process_result, state);
+            return NULL;
+        }
+    }
+    Py_DECREF(seq);
+
+    // Return the new state, the index of the next buffer to process and the
+    // event that stopped processing, if any.
+    return Py_BuildValue("(ini)", state, i, event);
+}
+
+static PyMethodDef utterance_methods[] = {
+    {"init",
+     (PyCFunction)utterance_init, METH_KEYWORDS | METH_VARARGS,
+     PyDoc_STR(
+         "Look up the Pocket Sphinx functions in an already loaded library and "
+         "return whether they were all found.\n\n"
+         "Keyword arguments:\n"
+         "path -- path of the library, normally the pocketsphinx package's "
+         "_pocketsphinx module.\n")},
+    {"process",
+     (PyCFunction)utterance_process, METH_KEYWORDS | METH_VARARGS,
+     PyDoc_STR(
+         "Process audio buffers with a decoder until a speech start or "
+         "hypothesis event occurs, or until all buffers are processed. Returns "
+         "a tuple of the new utterance state, the index of the next buffer to "
+         "process and the event. If ps_process_raw fails, the RuntimeError "
+         "raised has the new state as its utterance_state attribute.\n\n"
+         "Keyword arguments:\n"
+         "decoder -- address of the decoder, int(decoder.this).\n"
+         "state -- utterance state: IDLE, STARTED or ENDED.\n"
+         "buffers -- sequence of buffers of 16-bit audio samples.\n"
+         "start -- index of the first buffer to process (default 0)\n"
+         "no_search -- passed to ps_process_raw (default False)\n"
+         "full_utterance -- passed to ps_process_raw (default False)\n")},
+    {NULL, NULL, 0, NULL}  /* Sentinel */
+};
+
+#ifdef IS_PY3
+static struct PyModuleDef utterance_module = {
+    PyModuleDef_HEAD_INIT,
+    "_utterance",
+    "Native utterance state machine for sphinxwrapper.PocketSphinx.",
+    -1,
+    utterance_methods
+};
+#endif
+
+static PyObject *
+add_constants(PyObject *module) {
+    if (module == NULL)
+        return NULL;
+
+    PyModule_AddIntConstant(module, "IDLE", UTT_IDLE);
+    PyModule_AddIntConstant(module, "STARTED", UTT_STARTED);
+    PyModule_AddIntConstant(module, "ENDED", UTT_ENDED);
+    PyModule_AddIntConstant(module, "EVENT_NONE", EVENT_NONE);
+    PyModule_AddIntConstant(module, "EVENT_SPEECH_START", EVENT_SPEECH_START);
+    PyModule_AddIntConstant(module, "EVENT_HYPOTHESIS", EVENT_HYPOTHESIS);
+    return module;
+}
+
+#ifdef IS_PY3
+PyMODINIT_FUNC
+PyInit__utterance(void) {
+    return add_constants(PyModule_Create(&utterance_module));
+}
+#else
+PyMODINIT_FUNC
+init_utterance(void) {
+    add_constants(Py_InitModule3("_utterance", utterance_methods,
+                                 "Native utterance state machine for "
+                                 "sphinxwrapper.PocketSphinx."));
+}
+#endif
@@ -13,6 +13,26 @@ from .config import (set_hmm_and_dict_paths, search_arguments_set,
                      set_lm_path, ConfigError)
 
 
+def _load_native_helper():
+    """
+    Load the optional native utterance helper if it was built and can find
+    the Pocket Sphinx functions in the SWIG module, otherwise return None.
+    """
+    try:
+        from . import _utterance
+        from pocketsphinx import _pocketsphinx
+    except ImportError:
+        return None
+
+    path = getattr(_pocketsphinx, "__file__", None)
+    if path and _utterance.init(path):
+        return _utterance
+    return None
+
+
+_native = _load_native_helper()
+
+
 class PocketSphinx(Decoder):
     """
     Pocket Sphinx decoder subclass with processing methods providing
@@ -37,10 +57,11 @@ class PocketSphinx(Decoder):
 
     # Internal values used in process_audio to keep track of the utterance
     # state between method calls.
-    # This is similar to how Pocket Sphinx handles utterance state in C.
-    _UTT_IDLE = object()
-    _UTT_STARTED = object()
-    _UTT_ENDED = object()
+    # This is similar to how Pocket Sphinx handles utterance state in C. The
+    # values are shared with the native helper.
+    _UTT_IDLE = 0
+    _UTT_STARTED = 1
+    _UTT_ENDED = 2
 
     def __init__(self, config=None):
         if config is None:
@@ -88,6 +109,10 @@ class PocketSphinx(Decoder):
         :type full_utterance: bool
         :type use_callbacks: bool
         """
+        if _native is not None:
+            return self._process_native([buf], no_search, full_utterance,
+                                        use_callbacks)
+
         if self.utt_ended:
             self.start_utt()
 
@@ -122,7 +147,14 @@ class PocketSphinx(Decoder):
         """
         Process a list of audio buffers and return the speech hypothesis or use the
         decoder callbacks if use_callbacks is True.
+
+        If the native helper is available, the whole list is processed in one
+        call, returning to Python only for callbacks.
         """
+        if _native is not None:
+            return self._process_native(buffers, no_search, full_utterance,
+                                        use_callbacks)
+
         result = None
         for buf in buffers:
             if use_callbacks:
@@ -135,6 +167,47 @@ class PocketSphinx(Decoder):
 
         return result
 
+    def _process_native(self, buffers, no_search, full_utterance,
+                        use_callbacks):
+        """
+        Process audio buffers using the native helper's state machine, calling
+        callbacks for each event it stops at. Returns the last hypothesis if
+        not using callbacks.
+        """
+        if not isinstance(buffers, (list, tuple)):
+            buffers = list(buffers)
+
+        result = None
+        decoder = int(self.this)
+        start = 0
+        while start < len(buffers):
+            try:
+                self._utterance_state, start, event = _native.process(
+                    decoder, self._utterance_state, buffers, start,
+                    no_search, full_utterance)
+            except RuntimeError as e:
+                # Keep the utterance started before the failure, if any.
+                self._utterance_state = getattr(e, "utterance_state",
+                                                self._utterance_state)
+                raise
+
+            if event == _native.EVENT_SPEECH_START:
+                # Call speech start callback if it is set
+                if use_callbacks and self.speech_start_callback:
+                    self.speech_start_callback()
+
+            elif event == _native.EVENT_HYPOTHESIS:
+                hyp = self.hyp()
+
+                # Call the hypothesis callback if using callbacks and if it is
+                # set
+                if use_callbacks and self.hypothesis_callback:
+                    self.hypothesis_callback(hyp)
+                elif not use_callbacks and hyp:
+                    result = hyp
+
+        return result
+
     def get_in_speech(self):
         """
         Check if the last audio buffer contained speech.